@@ -0,0 +1,133 @@
+#include "BuddyAllocator.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+
+void CBuddyAllocator::Reset(size_t InProcessorCount)
+{
+	ProcessorCount = InProcessorCount;
+	FreeCount = InProcessorCount;
+	Size = InProcessorCount == 0 ? 0 : GetBlockSize(InProcessorCount);
+
+	Largest.assign(Size == 0 ? 0 : 2 * Size - 1, 0);
+	for (size_t Processor = 0; Processor < InProcessorCount; Processor++)
+		Largest[Size - 1 + Processor] = 1;
+
+	// Level by level from the leaves up, a level of nodes of NodeSize starts at Size / NodeSize - 1
+	for (size_t NodeSize = 2; NodeSize <= Size; NodeSize *= 2)
+	{
+		size_t First = Size / NodeSize - 1;
+		for (size_t Node = First; Node < 2 * First + 1; Node++)
+		{
+			uint32_t Left = Largest[2 * Node + 1];
+			uint32_t Right = Largest[2 * Node + 2];
+			Largest[Node] = Left == NodeSize / 2 && Right == NodeSize / 2 ? uint32_t(NodeSize) : std::max(Left, Right);
+		}
+	}
+}
+
+
+size_t CBuddyAllocator::GetBlockSize(size_t InCount)
+{
+	size_t BlockSize = 1;
+	while (BlockSize < InCount)
+		BlockSize *= 2;
+
+	return BlockSize;
+}
+
+
+size_t CBuddyAllocator::Allocate(size_t InCount)
+{
+	size_t BlockSize = GetBlockSize(InCount);
+	if (!CanAllocate(InCount))
+		return SIZE_MAX;
+
+	// Down to a whole free block, through the child with the smaller block that still fits (the left one among equal ones)
+	size_t Node = 0;
+	size_t NodeBegin = 0;
+	size_t NodeSize = Size;
+
+	while (NodeSize > BlockSize && Largest[Node] != NodeSize)
+	{
+		uint32_t Left = Largest[2 * Node + 1];
+		uint32_t Right = Largest[2 * Node + 2];
+
+		NodeSize /= 2;
+		if (Left >= BlockSize && (Right < BlockSize || Left <= Right))
+			Node = 2 * Node + 1;
+
+		else
+		{
+			Node = 2 * Node + 2;
+			NodeBegin += NodeSize;
+		}
+	}
+
+	// Only the first InCount processors of the block are taken, the rest of it stays free
+	Mark(0, 0, Size, NodeBegin, NodeBegin + InCount, false);
+	FreeCount -= InCount;
+
+	return NodeBegin;
+}
+
+
+void CBuddyAllocator::Free(size_t InFirst, size_t InCount)
+{
+	if (InFirst + InCount > ProcessorCount)
+		throw(std::runtime_error("Buddy allocator has no such processor!"));
+
+	Mark(0, 0, Size, InFirst, InFirst + InCount, true);
+	FreeCount += InCount;
+}
+
+
+void CBuddyAllocator::Mark(size_t InNode, size_t InNodeBegin, size_t InNodeSize, size_t InBegin, size_t InEnd, bool InFree)
+{
+	if (InEnd <= InNodeBegin || InBegin >= InNodeBegin + InNodeSize)
+		return;
+
+	if (InBegin <= InNodeBegin && InNodeBegin + InNodeSize <= InEnd)
+	{
+		Largest[InNode] = InFree ? uint32_t(InNodeSize) : 0;
+		return;
+	}
+
+	size_t Half = InNodeSize / 2;
+	size_t Left = 2 * InNode + 1;
+	size_t Right = 2 * InNode + 2;
+
+	// A wholly free or wholly taken node does not keep its children up to date, they get its state before a part of it changes
+	if (Largest[InNode] == InNodeSize || Largest[InNode] == 0)
+		Largest[Left] = Largest[Right] = Largest[InNode] == 0 ? 0 : uint32_t(Half);
+
+	Mark(Left, InNodeBegin, Half, InBegin, InEnd, InFree);
+	Mark(Right, InNodeBegin + Half, Half, InBegin, InEnd, InFree);
+
+	// Free buddies merge into one block
+	Largest[InNode] = Largest[Left] == Half && Largest[Right] == Half ? uint32_t(InNodeSize) : std::max(Largest[Left], Largest[Right]);
+}
+
+
+void CBuddyAllocator::MarkRuns(const std::set<unsigned>& InProcessors, bool InFree)
+{
+	for (auto Processor = InProcessors.begin(); Processor != InProcessors.end();)
+	{
+		if (*Processor >= ProcessorCount)
+			throw(std::runtime_error("Buddy allocator has no such processor!"));
+
+		// Consecutive processors are marked at once
+		size_t Begin = *Processor;
+		size_t End = Begin + 1;
+		for (++Processor; Processor != InProcessors.end() && *Processor == End; ++Processor)
+			End++;
+
+		Mark(0, 0, Size, Begin, End, InFree);
+
+		if (InFree)
+			FreeCount += End - Begin;
+		else
+			FreeCount -= End - Begin;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+
+// Binary buddy allocator over processor IDs, kept as a flat tree of the largest free aligned block under every node.
+// A program gets the lowest free aligned block of the power of two that holds it, the rest of the block stays free
+// (as smaller aligned blocks), freed blocks merge with their free buddies.
+class CBuddyAllocator
+{
+	size_t ProcessorCount = 0;
+
+	// Power of two, processors past ProcessorCount are never free
+	size_t Size = 0;
+
+	// Heap order, the root is 0 and the leaves start at Size - 1
+	std::vector<uint32_t> Largest;
+
+	size_t FreeCount = 0;
+
+	// Sets the processors [InBegin, InEnd) of the subtree free or taken
+	void Mark(size_t InNode, size_t InNodeBegin, size_t InNodeSize, size_t InBegin, size_t InEnd, bool InFree);
+	void MarkRuns(const std::set<unsigned>& InProcessors, bool InFree);
+
+public:
+	void Reset(size_t InProcessorCount);
+	bool IsSet() const { return Size != 0; }
+
+	static size_t GetBlockSize(size_t InCount);
+
+	bool CanAllocate(size_t InCount) const { return InCount != 0 && GetLargestFreeBlock() >= GetBlockSize(InCount); }
+
+	// First processor of the InCount taken ones, SIZE_MAX when no block is large enough
+	size_t Allocate(size_t InCount);
+
+	// Frees InCount processors starting with InFirst
+	void Free(size_t InFirst, size_t InCount);
+
+	// Processors taken or freed outside of Allocate (e.g. restored programs), not necessarily consecutive
+	void Occupy(const std::set<unsigned>& InProcessors) { MarkRuns(InProcessors, false); }
+	void Release(const std::set<unsigned>& InProcessors) { MarkRuns(InProcessors, true); }
+
+	size_t GetFreeCount() const { return FreeCount; }
+	size_t GetLargestFreeBlock() const { return Size == 0 ? 0 : Largest[0]; }
+
+	// Share of the free processors outside of the largest free block
+	float GetExternalFragmentation() const { return FreeCount == 0 ? 0 : 1 - float(GetLargestFreeBlock()) / FreeCount; }
+};
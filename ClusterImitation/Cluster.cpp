@@ -1,16 +1,49 @@
-#include "Queue.h"
+#include "PersistentQueue.h"
 #include "Cluster.h"
+#include "Journal.h"
+#include "Snapshot.h"
+#include <thread>
+#include <algorithm>
+#include <cmath>
 
 
 CCluster::CCluster(size_t InMaxTime, size_t InProcessorCount, size_t InQueueAnalysisDepth, size_t InMaxProgramsStartPerTick)
 {
-	ProcessorCount = InProcessorCount;
 	MaxTime = InMaxTime;
-	CurrentTime = 0;
 
 	QueueAnalysisDepth = InQueueAnalysisDepth;
 	MaxProgramsStartPerTick = InMaxProgramsStartPerTick;
 
+	ResetState(InProcessorCount);
+}
+
+
+void CCluster::ResetState(size_t InProcessorCount)
+{
+	ProcessorCount = InProcessorCount;
+	CurrentTime = 0;
+
+	RunningPrograms = TCopyOnWrite<std::map<std::string, TProgram>>();
+	PreemptionIndex = TCopyOnWrite<std::set<TPreemptionKey>>();
+	EndTimeIndex = TCopyOnWrite<std::multiset<std::pair<size_t, size_t>>>();
+	Workflows = TCopyOnWrite<std::map<size_t, TWorkflowState>>();
+	RealCallsWaiting = 0;
+	ThisTickFinishedPrograms.clear();
+	WaitingProgramCalls = TPersistentQueue<TProgramCall>();
+	WaitingCallFields.Clear();
+
+	ClusterReportData = TClusterReportData();
+
+	Processors.clear();
+	NodeResources.Reset(InProcessorCount);
+	if (BuddyAllocator.IsSet())
+		BuddyAllocator.Reset(InProcessorCount);
+	if (GangMatrix.IsSet())
+		GangMatrix.Reset(GangMatrix.GetRowCount(), InProcessorCount);
+	ActiveSlice = 0;
+	SliceStartTime = 0;
+	SwitchEndTime = 0;
+	FreeLicenses = LicenseCount;
 	FreeProcessors = 0;
 	for (int i = 0; i < InProcessorCount; i++)
 	{
@@ -22,17 +55,66 @@ CCluster::CCluster(size_t InMaxTime, size_t InProcessorCount, size_t InQueueAnal
 }
 
 
+CCluster::~CCluster() {}
+
+
 void CCluster::Start(OnClasterUpdateFunction InUpdateEvent)
 {
 	OnUpdateEvent = InUpdateEvent;
 
-	while (CurrentTime <= MaxTime)
+	std::chrono::steady_clock::time_point NextTickTime = std::chrono::steady_clock::now();
+
+	while (CurrentTime <= MaxTime && !StopRequested)
+	{
 		Update();
+
+		if (TickDuration != std::chrono::steady_clock::duration::zero() && !StopRequested)
+			WaitForNextTick(NextTickTime);
+	}
+
+	StopRequested = false;
+}
+
+
+void CCluster::SetRealTimePacing(float InTickDuration, ECatchUpPolicy InCatchUpPolicy)
+{
+	if (InTickDuration < 0)
+		throw(std::runtime_error("Tick duration can not be negative!"));
+
+	TickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(InTickDuration));
+	CatchUpPolicy = InCatchUpPolicy;
+}
+
+
+void CCluster::WaitForNextTick(std::chrono::steady_clock::time_point& NextTickTime)
+{
+	NextTickTime += TickDuration;
+
+	std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+	if (Now <= NextTickTime)
+	{
+		std::this_thread::sleep_until(NextTickTime);
+		return;
+	}
+
+	float Overrun = std::chrono::duration<float>(Now - NextTickTime).count();
+
+	ClusterReportData.TickOverruns++;
+	ClusterReportData.MaxTickOverrun = std::max(ClusterReportData.MaxTickOverrun, Overrun);
+
+	// With CatchUp the schedule is kept, so the next ticks start without sleeping until they are back on time
+	if (CatchUpPolicy == ECatchUpPolicy::Skip)
+		NextTickTime = Now;
 }
 
 
 void CCluster::Update()
 {
+	for (auto Source : SubmissionSources)
+		Source->DrainSubmissions(*this);
+
+	if (GangMatrix.IsSet())
+		RotateGangSlice();
 
 	for (int i = 0; i < MaxProgramsStartPerTick; i++)
 	{
@@ -41,30 +123,61 @@ void CCluster::Update()
 			size_t TopProgramID = GetTopProgram();
 			const TProgramCall& TopProgram = WaitingProgramCalls.Check(TopProgramID);
 			if (CanExecuteProgram(TopProgram))
+				StartWaitingCall(TopProgramID);
+
+			else if (Preemption)
 			{
-				StartProgramExecution(TopProgram);
-				WaitingProgramCalls.Pop(TopProgramID);
+				size_t PreemptingID = FindPreemptingProgram();
+				if (PreemptingID == SIZE_MAX)
+					continue;
+
+				// Copied, the stopped programs are queued behind it
+				TProgramCall PreemptingProgram = WaitingProgramCalls.Check(PreemptingID);
+				if (PreemptFor(PreemptingProgram))
+					StartWaitingCall(PreemptingID);
 			}
 		}
 	}
 
-	if (RunningPrograms.size() > 0)
-		for (auto& Program : RunningPrograms)
-			if ((Program.second.ExecutionStartTime + Program.second.MaxExecutionTime) <= CurrentTime)
+	if (GangMatrix.IsSet())
+		AdvanceGangPrograms();
+
+	else if (RunningPrograms->size() > 0)
+		for (auto& Program : RunningPrograms.Get())
+			if (!Program.second.RealExecution && (Program.second.ExecutionStartTime + Program.second.ActualExecutionTime) <= CurrentTime)
 				FinishProgramExecution(Program.first);
 
+	CollectFinishedTasks();
+
 	for (auto& Processor : Processors)
 		if (Processor.IsOccupied())
 			ClusterReportData.AllTicksPerProcessorProgramsRunning[Processor.GetID()]++;
 
-	ClusterReportData.AllTicksProgramsRunning += RunningPrograms.size();
+	ClusterReportData.AllTicksProgramsRunning += RunningPrograms->size();
+
+	if (BuddyAllocator.IsSet())
+	{
+		float Fragmentation = BuddyAllocator.GetExternalFragmentation();
+		ClusterReportData.AllTicksExternalFragmentation += Fragmentation;
+		ClusterReportData.MaxExternalFragmentation = std::max(ClusterReportData.MaxExternalFragmentation, Fragmentation);
+
+		if (FragmentationBlocked)
+			ClusterReportData.FragmentationBlockedTicks++;
+
+		FragmentationBlocked = false;
+	}
 
+	UpdateEventRunning = true;
 	OnUpdateEvent(this);
+	UpdateEventRunning = false;
 
 	for (auto& FinishedProgram : ThisTickFinishedPrograms)
-		RunningPrograms.erase(FinishedProgram);
+		RunningPrograms.Mutate().erase(FinishedProgram);
 
 	ThisTickFinishedPrograms.clear();
+
+	if (Journal)
+		Journal->Commit(CurrentTime);
 	
 	CurrentTime++;
 }
@@ -78,45 +191,372 @@ TClusterReportData& CCluster::GetReportData()
 	for (int i = 0; i < ProcessorCount; i++)
 		ClusterReportData.PerProcessorAverageLoad[i] = float(ClusterReportData.AllTicksPerProcessorProgramsRunning[i]) / CurrentTime;
 
+	std::map<float, size_t> SpeedClassSizes;
+	ClusterReportData.PerSpeedClassAverageLoad.clear();
+
+	for (auto& Processor : Processors)
+	{
+		ClusterReportData.PerSpeedClassAverageLoad[Processor.GetSpeedFactor()] += ClusterReportData.PerProcessorAverageLoad[Processor.GetID()];
+		SpeedClassSizes[Processor.GetSpeedFactor()]++;
+	}
+
+	for (auto& SpeedClass : ClusterReportData.PerSpeedClassAverageLoad)
+		SpeedClass.second /= SpeedClassSizes[SpeedClass.first];
+
+	size_t DeadlinesFinished = ClusterReportData.DeadlinesMet + ClusterReportData.DeadlinesMissed;
+	if (DeadlinesFinished > 0)
+	{
+		ClusterReportData.DeadlineHitRate = float(ClusterReportData.DeadlinesMet) / DeadlinesFinished;
+		ClusterReportData.DeadlineMissRate = float(ClusterReportData.DeadlinesMissed) / DeadlinesFinished;
+	}
+
+	for (auto& JobClass : ClusterReportData.PerJobClassProgramsFinished)
+		ClusterReportData.PerJobClassAverageResponseTime[JobClass.first] = float(ClusterReportData.PerJobClassTotalResponseTime[JobClass.first] / JobClass.second);
+
+	if (BuddyAllocator.IsSet())
+	{
+		ClusterReportData.LargestFreeBlock = BuddyAllocator.GetLargestFreeBlock();
+		ClusterReportData.AverageExternalFragmentation = float(ClusterReportData.AllTicksExternalFragmentation / CurrentTime);
+	}
+
 	return ClusterReportData;
 }
 
 
 bool CCluster::CanExecuteProgram(const TProgramCall& InProgramCall)
 {
-	size_t FoundFreeProcessors = 0;
-	for (auto& Pr : Processors)
-	{
-		FoundFreeProcessors += !Pr.IsOccupied();
+	if (GangMatrix.IsSet())
+		return FreeLicenses >= InProgramCall.Resources[EResource::Licenses] && GangMatrix.FindRow(InProgramCall.RequiredProcessors, ActiveSlice) != SIZE_MAX;
 
-		if (FoundFreeProcessors >= InProgramCall.RequiredProcessors)
-			break;
+	if (FreeProcessors < InProgramCall.RequiredProcessors || FreeLicenses < InProgramCall.Resources[EResource::Licenses])
+		return false;
+
+	if (BuddyAllocator.IsSet() && !BuddyAllocator.CanAllocate(InProgramCall.RequiredProcessors))
+	{
+		FragmentationBlocked = true;
+		return false;
 	}
 
-	return FoundFreeProcessors >= InProgramCall.RequiredProcessors;
+	if (!InProgramCall.Resources.HasNodeDemand())
+		return true;
+
+	return NodeResources.CountFitting(InProgramCall.Resources) >= InProgramCall.RequiredProcessors;
+}
+
+
+size_t CCluster::GetDominantProcessors(const TProgramCall& InProgramCall) const
+{
+	double Share = double(InProgramCall.RequiredProcessors) / ProcessorCount;
+
+	for (EResource Kind : { EResource::Memory, EResource::Accelerators })
+		if (NodeResources.GetTotalCapacity(Kind) != 0)
+			Share = std::max(Share, double(InProgramCall.RequiredProcessors) * InProgramCall.Resources[Kind] / NodeResources.GetTotalCapacity(Kind));
+
+	if (LicenseCount != 0)
+		Share = std::max(Share, double(InProgramCall.Resources[EResource::Licenses]) / LicenseCount);
+
+	// Rounded up, with some room for the error of the division
+	size_t Dominant = size_t(ceil(Share * ProcessorCount - 1e-9));
+	return std::max(InProgramCall.RequiredProcessors, std::min(Dominant, ProcessorCount));
+}
+
+
+void CCluster::OccupyProcessor(unsigned InProcessor, const std::string& InProgramName)
+{
+	Processors.at(InProcessor).AssignProgram(InProgramName);
+	NodeResources.SetOccupied(InProcessor, true);
+	FreeProcessors--;
+}
+
+
+void CCluster::ReleaseProcessor(unsigned InProcessor)
+{
+	Processors[InProcessor].ProgramFinished();
+	NodeResources.SetOccupied(InProcessor, false);
+	FreeProcessors++;
+}
+
+
+void CCluster::SetNodeResources(unsigned InProcessor, const TResources& InCapacity)
+{
+	if (BuddyAllocator.IsSet())
+		throw(std::runtime_error("Buddy allocation does not place programs by node resources!"));
+
+	if (GangMatrix.IsSet())
+		throw(std::runtime_error("Gang scheduling does not place programs by node resources!"));
+
+	NodeResources.SetCapacity(InProcessor, InCapacity);
+}
+
+
+void CCluster::SetNodeResources(const TResources& InCapacity)
+{
+	for (unsigned Processor = 0; Processor < ProcessorCount; Processor++)
+		SetNodeResources(Processor, InCapacity);
+}
+
+
+void CCluster::SetProcessorSpeed(unsigned InProcessor, float InSpeedFactor)
+{
+	if (!(InSpeedFactor > 0))
+		throw(std::runtime_error("Processor speed factor has to be positive!"));
+
+	Processors.at(InProcessor).SetSpeedFactor(InSpeedFactor);
+	HasSpeedFactors = HasSpeedFactors || InSpeedFactor != 1;
+}
+
+
+void CCluster::EnableBuddyAllocation()
+{
+	if (NodeResources.HasCapacities())
+		throw(std::runtime_error("Buddy allocation does not place programs by node resources!"));
+
+	if (GangMatrix.IsSet())
+		throw(std::runtime_error("Buddy allocation does not work with gang scheduling!"));
+
+	BuddyAllocator.Reset(ProcessorCount);
+	for (auto& Program : RunningPrograms.Get())
+		BuddyAllocator.Occupy(Program.second.OccupiedProcessors);
+}
+
+
+void CCluster::SetTopology(const TTopologyShape& InShape)
+{
+	if (GangMatrix.IsSet())
+		throw(std::runtime_error("Gang scheduling does not place programs by the topology!"));
+
+	Topology = CTopology(ProcessorCount, InShape);
+}
+
+
+void CCluster::EnablePreemption(size_t InCheckpointCost)
+{
+	if (GangMatrix.IsSet())
+		throw(std::runtime_error("Preemption does not work with gang scheduling!"));
+
+	Preemption = true;
+	CheckpointCost = InCheckpointCost;
+
+	std::set<TPreemptionKey>& Index = PreemptionIndex.Mutate();
+	Index.clear();
+
+	for (auto& Program : RunningPrograms.Get())
+		if (!Program.second.RealExecution)
+			Index.insert(TPreemptionKey(Program.second));
+}
+
+
+// Tick a running program ends at, real programs are expected to end by their requested time
+static size_t GetEndTime(const TProgram& InProgram)
+{
+	return InProgram.ExecutionStartTime + (InProgram.RealExecution ? InProgram.MaxExecutionTime : InProgram.ActualExecutionTime);
+}
+
+
+void CCluster::EnableDeadlineScheduling()
+{
+	if (GangMatrix.IsSet())
+		throw(std::runtime_error("Deadline scheduling does not work with gang scheduling!"));
+
+	DeadlineScheduling = true;
+
+	std::multiset<std::pair<size_t, size_t>>& Index = EndTimeIndex.Mutate();
+	Index.clear();
+
+	for (auto& Program : RunningPrograms.Get())
+		Index.insert({ GetEndTime(Program.second), Program.second.RequiredProcessorCount });
+}
+
+
+void CCluster::EnableGangScheduling(size_t InSliceCount, size_t InQuantum, size_t InContextSwitchCost)
+{
+	if (InSliceCount == 0)
+		throw(std::runtime_error("Gang scheduling needs at least one time slice!"));
+
+	if (InQuantum <= InContextSwitchCost)
+		throw(std::runtime_error("Gang scheduling quantum has to be longer than the context switch!"));
+
+	if (!RunningPrograms->empty() || RealCallsWaiting > 0)
+		throw(std::runtime_error("Gang scheduling has to be enabled before the programs start, and only for simulated programs!"));
+
+	if (Journal)
+		throw(std::runtime_error("Gang scheduling can not be journaled!"));
+
+	if (Preemption || DeadlineScheduling || BuddyAllocator.IsSet() || Topology.IsSet() || NodeResources.HasCapacities())
+		throw(std::runtime_error("Gang scheduling only places programs by its matrix!"));
+
+	GangMatrix.Reset(InSliceCount, ProcessorCount);
+	GangQuantum = InQuantum;
+	ContextSwitchCost = InContextSwitchCost;
+
+	ActiveSlice = 0;
+	SliceStartTime = CurrentTime;
+	SwitchEndTime = 0;
+}
+
+
+size_t CCluster::GetStartableProcessors() const
+{
+	// A call starts in any row of the matrix that has room, not only on the processors free now
+	return GangMatrix.IsSet() ? GangMatrix.GetLargestFreeCount() : FreeProcessors;
+}
+
+
+void CCluster::RotateGangSlice()
+{
+	if (!GangMatrix.IsRowEmpty(ActiveSlice) && CurrentTime - SliceStartTime < GangQuantum)
+		return;
+
+	size_t NextSlice = GangMatrix.FindNextBusyRow(ActiveSlice);
+	if (NextSlice != SIZE_MAX)
+		SwitchGangSlice(NextSlice);
+}
+
+
+void CCluster::SwitchGangSlice(size_t InSlice)
+{
+	// The rows share the processors, so the programs of the old row leave all of them before the new ones take theirs
+	for (auto& Program : RunningPrograms.Get())
+		if (Program.second.Slice == ActiveSlice)
+			for (unsigned Processor : Program.second.OccupiedProcessors)
+				ReleaseProcessor(Processor);
+
+	for (auto& Program : RunningPrograms.Get())
+		if (Program.second.Slice == InSlice)
+			for (unsigned Processor : Program.second.OccupiedProcessors)
+				OccupyProcessor(Processor, Program.first);
+
+	ActiveSlice = InSlice;
+	SliceStartTime = CurrentTime;
+	SwitchEndTime = CurrentTime + ContextSwitchCost;
+
+	ClusterReportData.ContextSwitches++;
+}
+
+
+void CCluster::AdvanceGangPrograms()
+{
+	for (auto& Program : RunningPrograms.Get())
+		if (Program.second.TicksRun >= Program.second.ActualExecutionTime)
+			FinishProgramExecution(Program.first);
+
+	if (CurrentTime < SwitchEndTime || GangMatrix.IsRowEmpty(ActiveSlice))
+		return;
+
+	for (auto& Program : RunningPrograms.Mutate())
+		if (Program.second.Slice == ActiveSlice && Program.second.TicksRun < Program.second.ActualExecutionTime)
+			Program.second.TicksRun++;
+}
+
+
+void CCluster::SetLicenseCount(uint32_t InLicenseCount)
+{
+	uint32_t UsedLicenses = LicenseCount - FreeLicenses;
+	if (InLicenseCount < UsedLicenses)
+		throw(std::runtime_error("Running programs use more licenses than that!"));
+
+	LicenseCount = InLicenseCount;
+	FreeLicenses = InLicenseCount - UsedLicenses;
 }
 
 
 size_t CCluster::GetTopProgram()
 {
-	size_t Index = 0;
-	float MaxScore = -1000000000000000000000000000000000.0;
+	if (!AdaptiveDepth)
+		return FindTopProgram();
 
-	size_t i = 0;
+	AdaptQueueAnalysisDepth();
 
-	while (i < std::min(QueueAnalysisDepth, WaitingProgramCalls.size()))
+	if (AdaptiveDepthSettings.DecisionBudget == 0)
+		return FindTopProgram();
+
+	std::chrono::steady_clock::time_point Begin = std::chrono::steady_clock::now();
+	size_t TopProgram = FindTopProgram();
+	double Elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - Begin).count();
+
+	// Smoothed, so that a single preempted pick does not collapse the window
+	size_t Scored = std::min(QueueAnalysisDepth, WaitingCallFields.size());
+	ScoringTimePerCall += (Elapsed / Scored - ScoringTimePerCall) / 8;
+
+	return TopProgram;
+}
+
+
+void CCluster::AdaptQueueAnalysisDepth()
+{
+	// Nothing can start without free processors, so a longer window would be wasted
+	size_t Depth = GetStartableProcessors() == 0 ? AdaptiveDepthSettings.MinDepth : WaitingCallFields.size();
+
+	if (AdaptiveDepthSettings.DecisionBudget > 0 && ScoringTimePerCall > 0)
+		Depth = std::min(Depth, size_t(std::min(AdaptiveDepthSettings.DecisionBudget / ScoringTimePerCall, double(AdaptiveDepthSettings.MaxDepth))));
+
+	QueueAnalysisDepth = std::max(AdaptiveDepthSettings.MinDepth, std::min(Depth, AdaptiveDepthSettings.MaxDepth));
+}
+
+
+void CCluster::SetAdaptiveQueueAnalysisDepth(const TAdaptiveDepthSettings& InSettings)
+{
+	if (InSettings.MinDepth == 0 || InSettings.MinDepth > InSettings.MaxDepth)
+		throw(std::runtime_error("Adaptive queue analysis depth needs 0 < MinDepth <= MaxDepth!"));
+
+	if (InSettings.DecisionBudget < 0)
+		throw(std::runtime_error("Decision budget can not be negative!"));
+
+	AdaptiveDepthSettings = InSettings;
+	AdaptiveDepth = true;
+	ScoringTimePerCall = 0;
+}
+
+
+// Same as picking the first call with the highest EvaluateWaitingCallScore, but scores the whole window at once
+size_t CCluster::FindTopProgram()
+{
+	if (DeadlineScheduling)
 	{
-		float Score = EvaluateWaitingCallScore(i);
-		if (Score > MaxScore)
-		{
-			Index = i;
-			MaxScore = Score;
-		}
+		size_t Earliest = WaitingCallFields.FindEarliestDeadline(QueueAnalysisDepth);
+		if (Earliest != SIZE_MAX)
+			return Earliest;
+	}
+
+	if (!Workflows->empty())
+	{
+		size_t Longest = WaitingCallFields.FindLongestCriticalPath(QueueAnalysisDepth);
+		if (Longest != SIZE_MAX)
+			return Longest;
+	}
+
+	size_t Startable = GetStartableProcessors();
+
+	if (ScoreWeights == TScoreWeights(TDefaultScoreWeights()))
+		return WaitingCallFields.FindTop(TDefaultScoreWeights(), QueueAnalysisDepth, QueueAnalysisDepth, CurrentTime, Startable, WaitingCallScores);
+
+	if (ScoreWeights.FairShare == 0 || !FairShare)
+		return WaitingCallFields.FindTop(ScoreWeights, QueueAnalysisDepth, QueueAnalysisDepth, CurrentTime, Startable, WaitingCallScores);
+
+	// Only the users of the window need their penalties for this tick
+	for (size_t i = 0; i < std::min(QueueAnalysisDepth, WaitingCallFields.size()); i++)
+		GetUserPenalty(WaitingCallFields.GetUserID(i));
+
+	return WaitingCallFields.FindTop(ScoreWeights, QueueAnalysisDepth, QueueAnalysisDepth, CurrentTime, Startable, WaitingCallScores, UserPenalties.data());
+}
+
 
-		i++;
+float CCluster::GetUserPenalty(uint32_t InUserID)
+{
+	if (UserPenalties.size() < FairShare->GetUserCount())
+	{
+		UserPenalties.resize(FairShare->GetUserCount());
+		UserPenaltyTimes.resize(FairShare->GetUserCount(), 0);
+	}
+
+	// Starts and finishes do not change the usage at the beginning of the tick, so it holds for the whole tick
+	if (UserPenaltyTimes[InUserID] != CurrentTime + 1)
+	{
+		UserPenalties[InUserID] = float(FairShare->GetUsage(InUserID, CurrentTime) / ProcessorCount);
+		UserPenaltyTimes[InUserID] = CurrentTime + 1;
 	}
 
-	return Index;
+	return UserPenalties[InUserID];
 }
 
 
@@ -127,80 +567,1290 @@ float CCluster::EvaluateWaitingCallScore(size_t Index)
 	const TProgramCall& Call = WaitingProgramCalls.Check(Index);
 
 	if (Index <= QueueAnalysisDepth)
-		OutScore += (QueueAnalysisDepth - Index) * 15;
-	OutScore += (CurrentTime - Call.TimeCalled) * 5;
+		OutScore += (QueueAnalysisDepth - Index) * ScoreWeights.Position;
+	OutScore += (CurrentTime - Call.TimeCalled) * ScoreWeights.Waiting;
 
-	OutScore -= Call.ExecutionTime * 4;
+	OutScore -= Call.PredictedExecutionTime * ScoreWeights.ExecutionTime;
 
-	if (FreeProcessors < Call.RequiredProcessors)
-		OutScore -= Call.RequiredProcessors * 8;
-	
+	if (GetStartableProcessors() < Call.DominantProcessors)
+		OutScore -= Call.DominantProcessors * ScoreWeights.Processors;
+
+	if (ScoreWeights.Priority != 0)
+		OutScore += float(Call.Priority) * ScoreWeights.Priority;
+	if (ScoreWeights.FairShare != 0 && FairShare)
+		OutScore -= GetUserPenalty(FairShare->FindUserID(Call.User)) * ScoreWeights.FairShare;
 
 	return OutScore;
 }
 
 
-void CCluster::StartProgramExecution(const TProgramCall& InProgramCall)
+std::vector<unsigned> CCluster::ChooseProcessors(const TProgramCall& InProgramCall)
 {
-	TProgram NewProgram(InProgramCall, CurrentTime);
+	std::vector<unsigned> AssignedProcessors;
 
-	size_t AssignedProcessorCount = 0;
-	for (auto& Pr : Processors)
+	if (BuddyAllocator.IsSet())
 	{
-		if (!Pr.IsOccupied())
+		size_t First = BuddyAllocator.Allocate(InProgramCall.RequiredProcessors);
+		for (size_t Processor = First; First != SIZE_MAX && Processor < First + InProgramCall.RequiredProcessors; Processor++)
+			AssignedProcessors.push_back(unsigned(Processor));
+
+		return AssignedProcessors;
+	}
+
+	if (Topology.IsSet())
+	{
+		EligibleProcessors.resize(ProcessorCount);
+		for (unsigned Processor = 0; Processor < ProcessorCount; Processor++)
+			EligibleProcessors[Processor] = NodeResources.Fits(Processor, InProgramCall.Resources);
+
+		return Topology.ChooseProcessors(EligibleProcessors, InProgramCall.RequiredProcessors);
+	}
+
+	if (NodeResources.HasCapacities())
+		return NodeResources.ChooseNodes(InProgramCall.Resources, InProgramCall.RequiredProcessors);
+
+	if (HasSpeedFactors)
+	{
+		for (auto& Pr : Processors)
+			if (!Pr.IsOccupied())
+				AssignedProcessors.push_back(Pr.GetID());
+
+		// Long programs take the fastest processors, short ones keep out of their way on the slowest
+		bool Long = InProgramCall.PredictedExecutionTime >= LongProgramTime;
+		std::stable_sort(AssignedProcessors.begin(), AssignedProcessors.end(), [&](unsigned A, unsigned B)
 		{
-			NewProgram.AssignProcessor(Pr.GetID());
-			Pr.AssignProgram(InProgramCall.Name);
-			
-			ClusterReportData.PerProcessorTotalPrograms[Pr.GetID()]++;
+			return Long ? Processors[A].GetSpeedFactor() > Processors[B].GetSpeedFactor() : Processors[A].GetSpeedFactor() < Processors[B].GetSpeedFactor();
+		});
 
-			AssignedProcessorCount++;
-			FreeProcessors--;
-		}
+		AssignedProcessors.resize(std::min(AssignedProcessors.size(), InProgramCall.RequiredProcessors));
+		return AssignedProcessors;
+	}
 
-		if (AssignedProcessorCount == InProgramCall.RequiredProcessors)
+	for (auto& Pr : Processors)
+	{
+		if (AssignedProcessors.size() == InProgramCall.RequiredProcessors)
 			break;
+
+		if (!Pr.IsOccupied())
+			AssignedProcessors.push_back(Pr.GetID());
 	}
 
-	if (AssignedProcessorCount != InProgramCall.RequiredProcessors)
-		throw(std::runtime_error("Tried to start a progam, without checking first!"));
+	return AssignedProcessors;
+}
 
-	RunningPrograms[InProgramCall.Name] = NewProgram;
 
-	ClusterReportData.TotalProgramsRunning++;
+float CCluster::GetSlowestSpeedFactor(const std::set<unsigned>& InProcessors) const
+{
+	float Slowest = Processors[*InProcessors.begin()].GetSpeedFactor();
+	for (unsigned Processor : InProcessors)
+		Slowest = std::min(Slowest, Processors[Processor].GetSpeedFactor());
+
+	return Slowest;
 }
 
 
-void CCluster::FinishProgramExecution(std::string ProgramName)
+void CCluster::AdjustRunTime(TProgram& InOutProgram) const
 {
-	for (auto& Pr : RunningPrograms[ProgramName].OccupiedProcessors)
+	if (InOutProgram.RealExecution)
+		return;
+
+	if (HasSpeedFactors)
 	{
-		Processors[Pr].ProgramFinished();
-		FreeProcessors++;
+		float Slowest = GetSlowestSpeedFactor(InOutProgram.OccupiedProcessors);
+
+		// Rounded up, with some room for the error of the division, at least one tick
+		size_t RunTime = size_t(ceil(InOutProgram.ActualExecutionTime / double(Slowest) - 1e-6));
+		InOutProgram.ActualExecutionTime = std::min(std::max<size_t>(RunTime, 1), InOutProgram.MaxExecutionTime);
 	}
 
-	ThisTickFinishedPrograms.push_back(ProgramName);
+	if (Topology.IsSet())
+		InOutProgram.ActualExecutionTime = Topology.ApplyCommunicationPenalty(InOutProgram.ActualExecutionTime, InOutProgram.MaxExecutionTime,
+			Topology.GetSpan(InOutProgram.OccupiedProcessors));
+}
 
-	ClusterReportData.TotalProgramsFinished++;
+
+size_t CCluster::GetRemainingRunTime(const TProgram& InProgram, size_t InElapsed) const
+{
+	size_t Remaining = InProgram.ActualExecutionTime - InElapsed;
+	if (InProgram.RealExecution)
+		return Remaining;
+
+	// Ticks left on its processors turned back into ticks of the reference processor, AdjustRunTime scales them again on restart
+	double Work = double(Remaining);
+
+	if (Topology.IsSet())
+		Work /= 1 + Topology.GetShape().CommunicationPenalty[size_t(Topology.GetSpan(InProgram.OccupiedProcessors))];
+
+	if (HasSpeedFactors)
+		Work *= GetSlowestSpeedFactor(InProgram.OccupiedProcessors);
+
+	return std::min(std::max<size_t>(size_t(ceil(Work - 1e-6)), 1), Remaining);
 }
 
 
-void CCluster::CallProgramExecution(TProgramCall InProgramCall)
+void CCluster::StartWaitingCall(size_t InIndex)
 {
-	if (InProgramCall.RequiredProcessors > ProcessorCount)
-		throw(std::runtime_error("Calling a program with too many required processors!"));
+	const TProgramCall& Call = WaitingProgramCalls.Check(InIndex);
 
-	if (InProgramCall.RequiredProcessors == 0)
-		throw (std::runtime_error("Calling a program with zero required processors!"));
+	if (Call.ArrayCount == 0)
+		StartProgramExecution(Call);
+	else
+		StartProgramExecution(Call.GetArrayTask());
 
-	if (InProgramCall.Name == "")
-		throw (std::runtime_error("Calling a program with an empty name"));
+	// Only the next task of a job array is made, the rest of it stays in the place of the call with the same scoring fields
+	if (Call.ArrayCount > 1)
+	{
+		TProgramCall Rest = Call;
+		Rest.ArrayCount--;
+		Rest.ArrayIndex++;
+		Rest.JobID++;
 
-	if (InProgramCall.ExecutionTime == 0)
-		throw (std::runtime_error("Calling a program with or zero execution time!"));
+		WaitingProgramCalls.Replace(InIndex, Rest);
+		return;
+	}
 
-	InProgramCall.TimeCalled = CurrentTime;
-	WaitingProgramCalls.Put(InProgramCall);
+	if (Call.Task || !Call.Command.empty())
+		RealCallsWaiting--;
 
-	ClusterReportData.TotalProgramCalls++;
-}
\ No newline at end of file
+	WaitingProgramCalls.Pop(InIndex);
+	WaitingCallFields.Pop(InIndex);
+}
+
+
+void CCluster::StartProgramExecution(const TProgramCall& InProgramCall)
+{
+	TProgram NewProgram(InProgramCall, CurrentTime);
+
+	std::vector<unsigned> AssignedProcessors;
+	if (GangMatrix.IsSet())
+	{
+		NewProgram.Slice = GangMatrix.FindRow(InProgramCall.RequiredProcessors, ActiveSlice);
+		AssignedProcessors = GangMatrix.Allocate(NewProgram.Slice, InProgramCall.RequiredProcessors);
+	}
+
+	else
+		AssignedProcessors = ChooseProcessors(InProgramCall);
+
+	if (AssignedProcessors.size() != InProgramCall.RequiredProcessors || FreeLicenses < InProgramCall.Resources[EResource::Licenses])
+		throw(std::runtime_error("Tried to start a progam, without checking first!"));
+
+	for (unsigned Processor : AssignedProcessors)
+	{
+		NewProgram.AssignProcessor(Processor);
+
+		// With gang scheduling only the programs of the active row are on their processors
+		if (!GangMatrix.IsSet() || NewProgram.Slice == ActiveSlice)
+			OccupyProcessor(Processor, InProgramCall.Name);
+
+		ClusterReportData.PerProcessorTotalPrograms[Processor]++;
+	}
+
+	AdjustRunTime(NewProgram);
+	FreeLicenses -= InProgramCall.Resources[EResource::Licenses];
+
+	RunningPrograms.Mutate()[InProgramCall.Name] = NewProgram;
+
+	IndexRunningProgram(NewProgram, true);
+	ChargeUser(NewProgram, true, CurrentTime);
+
+	ClusterReportData.TotalProgramsRunning++;
+
+	if (Journal)
+		Journal->LogStart(NewProgram);
+
+	if (OnProgramStarted)
+		OnProgramStarted(this, InProgramCall);
+
+	if (InProgramCall.Task)
+		DispatchTask(InProgramCall, NewProgram.OccupiedProcessors);
+
+	else if (!InProgramCall.Command.empty())
+		LaunchProcess(InProgramCall, NewProgram.OccupiedProcessors);
+}
+
+
+void CCluster::DispatchTask(const TProgramCall& InProgramCall, const std::set<unsigned>& InProcessors)
+{
+	if (!WorkerPool)
+		WorkerPool = std::make_unique<CWorkerPool>(ProcessorCount);
+
+	std::string ProgramName = InProgramCall.Name;
+
+	CJobExecutor::Launch(*WorkerPool, InProcessors, InProgramCall.Task, [this, ProgramName](bool Succeeded)
+	{
+		std::lock_guard<std::mutex> Lock(FinishedTasksMutex);
+		FinishedTasks.push_back({ ProgramName, Succeeded });
+	});
+}
+
+
+void CCluster::LaunchProcess(const TProgramCall& InProgramCall, const std::set<unsigned>& InProcessors)
+{
+	if (!ProcessLauncher)
+		ProcessLauncher = std::make_unique<CProcessLauncher>();
+
+	ProcessLauncher->Launch(InProgramCall.Name, InProgramCall.Command, InProcessors);
+}
+
+
+void CCluster::CollectFinishedTasks()
+{
+	std::vector<std::pair<std::string, bool>> Finished;
+
+	{
+		std::lock_guard<std::mutex> Lock(FinishedTasksMutex);
+		Finished.swap(FinishedTasks);
+	}
+
+	if (ProcessLauncher)
+		ProcessLauncher->CollectFinished(Finished);
+
+	for (auto& Task : Finished)
+	{
+		FinishProgramExecution(Task.first);
+
+		if (!Task.second)
+			ClusterReportData.TotalProgramsFailed++;
+	}
+}
+
+
+void CCluster::FinishProgramExecution(std::string ProgramName)
+{
+	const TProgram& Program = RunningPrograms->at(ProgramName);
+
+	ReleaseProgramResources(Program);
+
+	IndexRunningProgram(Program, false);
+	ChargeUser(Program, false, CurrentTime);
+
+	if (RuntimePredictor)
+	{
+		if (RuntimePredictor.use_count() > 1)
+			RuntimePredictor = std::make_shared<CRuntimePredictor>(*RuntimePredictor);
+
+		// Time sliced programs ran only part of the ticks since their start
+		size_t RunTime = GangMatrix.IsSet() ? Program.TicksRun : CurrentTime - Program.ExecutionStartTime;
+		RuntimePredictor->Observe(CRuntimePredictor::GetProgramKey(ProgramName), Program.MaxExecutionTime, RunTime);
+	}
+
+	ThisTickFinishedPrograms.push_back(ProgramName);
+
+	CountFinishedProgram(Program, CurrentTime);
+
+	if (!Workflows->empty())
+		ReleaseWorkflowSuccessors(Program.JobID);
+
+	if (Journal)
+		Journal->LogFinish(ProgramName, CurrentTime);
+}
+
+
+void CCluster::CountFinishedProgram(const TProgram& InProgram, size_t InTime)
+{
+	ClusterReportData.TotalProgramsFinished++;
+
+	if (InProgram.Deadline != 0)
+		(InTime <= InProgram.Deadline ? ClusterReportData.DeadlinesMet : ClusterReportData.DeadlinesMissed)++;
+
+	size_t JobClass = TClusterReportData::GetJobClass(InProgram.MaxExecutionTime);
+	ClusterReportData.PerJobClassProgramsFinished[JobClass]++;
+	ClusterReportData.PerJobClassTotalResponseTime[JobClass] += double(InTime - InProgram.TimeCalled);
+}
+
+
+void CCluster::ReleaseProgramResources(const TProgram& InProgram)
+{
+	if (GangMatrix.IsSet())
+		GangMatrix.Release(InProgram.Slice, InProgram.OccupiedProcessors);
+
+	for (auto& Pr : InProgram.OccupiedProcessors)
+		if (!GangMatrix.IsSet() || InProgram.Slice == ActiveSlice)
+			ReleaseProcessor(Pr);
+
+	if (BuddyAllocator.IsSet())
+		BuddyAllocator.Release(InProgram.OccupiedProcessors);
+
+	FreeLicenses += InProgram.Resources[EResource::Licenses];
+}
+
+
+size_t CCluster::FindPreemptingProgram() const
+{
+	if (PreemptionIndex->empty())
+		return SIZE_MAX;
+
+	// Only a call above the lowest running priority can stop anything
+	int32_t LowestPriority = PreemptionIndex->begin()->Priority;
+	size_t PreemptingID = SIZE_MAX;
+
+	for (size_t i = 0; i < std::min(QueueAnalysisDepth, WaitingProgramCalls.size()); i++)
+	{
+		int32_t Priority = WaitingProgramCalls.Check(i).Priority;
+		if (Priority > LowestPriority && (PreemptingID == SIZE_MAX || Priority > WaitingProgramCalls.Check(PreemptingID).Priority))
+			PreemptingID = i;
+	}
+
+	return PreemptingID;
+}
+
+
+bool CCluster::IsPreemptible(const TPreemptionKey& InKey, int32_t InPriority) const
+{
+	if (InKey.Priority >= InPriority)
+		return false;
+
+	// Finishes at the end of this tick anyway
+	const TProgram& Program = RunningPrograms->at(InKey.Name);
+	return Program.ExecutionStartTime + Program.ActualExecutionTime > CurrentTime;
+}
+
+
+bool CCluster::PreemptFor(const TProgramCall& InProgramCall)
+{
+	size_t Processors = FreeProcessors;
+	uint32_t Licenses = FreeLicenses;
+
+	// The index is ordered by priority, so the walk ends at the first program the call can not stop
+	for (auto& Key : PreemptionIndex.Get())
+	{
+		if (Processors >= InProgramCall.RequiredProcessors && Licenses >= InProgramCall.Resources[EResource::Licenses])
+			break;
+
+		if (Key.Priority >= InProgramCall.Priority)
+			return false;
+
+		if (!IsPreemptible(Key, InProgramCall.Priority))
+			continue;
+
+		Processors += Key.Processors;
+		Licenses += RunningPrograms->at(Key.Name).Resources[EResource::Licenses];
+	}
+
+	if (Processors < InProgramCall.RequiredProcessors || Licenses < InProgramCall.Resources[EResource::Licenses])
+		return false;
+
+	// Placed by node resources, the topology or the buddy allocator, enough free processors may still not hold it
+	while (!CanExecuteProgram(InProgramCall))
+	{
+		auto Victim = PreemptionIndex->begin();
+		while (Victim != PreemptionIndex->end() && !IsPreemptible(*Victim, InProgramCall.Priority))
+			++Victim;
+
+		if (Victim == PreemptionIndex->end())
+			return false;
+
+		PreemptProgram(Victim->Name);
+	}
+
+	return true;
+}
+
+
+void CCluster::PreemptProgram(const std::string& InProgramName)
+{
+	TProgram Program = RunningPrograms->at(InProgramName);
+
+	ReleaseProgramResources(Program);
+	ChargeUser(Program, false, CurrentTime);
+	IndexRunningProgram(Program, false);
+	RunningPrograms.Mutate().erase(Program.Name);
+
+	if (Journal)
+		Journal->LogPreempt(Program.Name, CurrentTime);
+
+	// Restarts from the checkpoint taken when it is stopped, with the ticks it ran so far done
+	size_t Elapsed = CurrentTime - Program.ExecutionStartTime;
+
+	TProgramCall Call(Program.Name, Program.RequiredProcessorCount, Program.MaxExecutionTime - Elapsed + CheckpointCost,
+		GetRemainingRunTime(Program, Elapsed) + CheckpointCost);
+	Call.Resources = Program.Resources;
+	Call.Priority = Program.Priority;
+	Call.TimeCalled = Program.TimeCalled;
+	Call.JobID = Program.JobID;
+	Call.User = Program.User;
+	Call.Deadline = Program.Deadline;
+
+	PutWaitingCall(Call);
+
+	ClusterReportData.TotalProgramsPreempted++;
+}
+
+
+size_t CCluster::CallProgramExecution(TProgramCall InProgramCall)
+{
+	if (InProgramCall.RequiredProcessors > ProcessorCount)
+		throw(std::runtime_error("Calling a program with too many required processors!"));
+
+	if (InProgramCall.RequiredProcessors == 0)
+		throw (std::runtime_error("Calling a program with zero required processors!"));
+
+	if (InProgramCall.Name == "")
+		throw (std::runtime_error("Calling a program with an empty name"));
+
+	if (InProgramCall.ExecutionTime == 0)
+		throw (std::runtime_error("Calling a program with or zero execution time!"));
+
+	if (InProgramCall.Task && !InProgramCall.Command.empty())
+		throw (std::runtime_error("Calling a program with both a task and a command!"));
+
+	if (GangMatrix.IsSet() && (InProgramCall.Task || !InProgramCall.Command.empty()))
+		throw (std::runtime_error("Gang scheduling only time slices simulated programs!"));
+
+	if (InProgramCall.Resources[EResource::Licenses] > LicenseCount)
+		throw (std::runtime_error("Calling a program with more licenses than the cluster has!"));
+
+	if (InProgramCall.Resources.HasNodeDemand() && NodeResources.CountFitting(InProgramCall.Resources, false) < InProgramCall.RequiredProcessors)
+		throw (std::runtime_error("Calling a program with more resources than enough processors have!"));
+
+	if (DeadlineScheduling && InProgramCall.Deadline != 0 && PredictStartTime(InProgramCall.RequiredProcessors) + PredictExecutionTime(InProgramCall) > InProgramCall.Deadline)
+	{
+		ClusterReportData.DeadlineCallsRejected++;
+		return SIZE_MAX;
+	}
+
+	InProgramCall.TimeCalled = CurrentTime;
+	InProgramCall.JobID = ClusterReportData.TotalProgramCalls;
+
+	PutWaitingCall(InProgramCall);
+
+	ClusterReportData.TotalProgramCalls += std::max<size_t>(InProgramCall.ArrayCount, 1);
+
+	return InProgramCall.JobID;
+}
+
+
+size_t CCluster::CallWorkflowExecution(CWorkflow InWorkflow)
+{
+	if (Journal)
+		throw(std::runtime_error("Workflows can not be journaled!"));
+
+	if (InWorkflow.GetJobCount() == 0)
+		throw(std::runtime_error("Calling a workflow without jobs!"));
+
+	for (size_t Job = 0; Job < InWorkflow.GetJobCount(); Job++)
+		if (InWorkflow.GetRequiredProcessors(Job) > ProcessorCount)
+			throw(std::runtime_error("Calling a workflow job with too many required processors!"));
+
+	InWorkflow.Prepare();
+
+	TWorkflowState State;
+	State.Workflow = std::make_shared<const CWorkflow>(std::move(InWorkflow));
+	State.Indegrees = State.Workflow->GetIndegrees();
+	State.FirstJobID = ClusterReportData.TotalProgramCalls;
+	State.JobsLeft = State.Workflow->GetJobCount();
+
+	ClusterReportData.TotalProgramCalls += State.JobsLeft;
+
+	const TWorkflowState& Added = Workflows.Mutate()[State.FirstJobID] = std::move(State);
+
+	for (size_t Job = 0; Job < Added.Workflow->GetJobCount(); Job++)
+		if (Added.Indegrees[Job] == 0)
+			QueueWorkflowJob(Added, Job);
+
+	return Added.FirstJobID;
+}
+
+
+const TWorkflowState* CCluster::FindWorkflow(size_t InJobID) const
+{
+	auto Found = Workflows->upper_bound(InJobID);
+	if (Found == Workflows->begin())
+		return nullptr;
+
+	--Found;
+	return InJobID - Found->first < Found->second.Workflow->GetJobCount() ? &Found->second : nullptr;
+}
+
+
+void CCluster::QueueWorkflowJob(const TWorkflowState& InState, size_t InJob)
+{
+	const CWorkflow& Workflow = *InState.Workflow;
+
+	TProgramCall Call(Workflow.GetJobName(InJob), Workflow.GetRequiredProcessors(InJob), Workflow.GetExecutionTime(InJob), Workflow.GetActualExecutionTime(InJob));
+	Call.Priority = Workflow.GetPriority();
+	Call.User = Workflow.GetUser();
+	Call.TimeCalled = CurrentTime;
+	Call.JobID = InState.FirstJobID + InJob;
+
+	PutWaitingCall(Call);
+}
+
+
+void CCluster::ReleaseWorkflowSuccessors(size_t InJobID)
+{
+	if (!FindWorkflow(InJobID))
+		return;
+
+	// Found again in the changed map, it is copied on the first change after a fork
+	auto Found = --Workflows.Mutate().upper_bound(InJobID);
+	TWorkflowState& State = Found->second;
+
+	size_t Job = InJobID - State.FirstJobID;
+	const uint32_t* Successors = State.Workflow->GetSuccessors(Job);
+
+	for (size_t i = 0; i < State.Workflow->GetSuccessorCount(Job); i++)
+		if (--State.Indegrees[Successors[i]] == 0)
+			QueueWorkflowJob(State, Successors[i]);
+
+	if (--State.JobsLeft == 0)
+		Workflows.Mutate().erase(Found);
+}
+
+
+void CCluster::PutWaitingCall(TProgramCall& InOutProgramCall)
+{
+	InOutProgramCall.PredictedExecutionTime = PredictExecutionTime(InOutProgramCall);
+	InOutProgramCall.DominantProcessors = GetDominantProcessors(InOutProgramCall);
+
+	WaitingProgramCalls.Put(InOutProgramCall);
+	PutWaitingFields(InOutProgramCall);
+
+	if (InOutProgramCall.Task || !InOutProgramCall.Command.empty())
+		RealCallsWaiting++;
+
+	if (Journal)
+		Journal->LogCall(InOutProgramCall);
+}
+
+
+void CCluster::PutWaitingFields(const TProgramCall& InProgramCall)
+{
+	uint32_t UserID = FairShare ? MutateFairShare().GetUserID(InProgramCall.User) : 0;
+
+	const TWorkflowState* State = Workflows->empty() ? nullptr : FindWorkflow(InProgramCall.JobID);
+	size_t CriticalPath = State ? State->Workflow->GetCriticalPath(InProgramCall.JobID - State->FirstJobID) : 0;
+
+	WaitingCallFields.Put(InProgramCall.TimeCalled, InProgramCall.PredictedExecutionTime, InProgramCall.DominantProcessors, UserID, InProgramCall.Priority,
+		InProgramCall.Deadline, CriticalPath);
+}
+
+
+size_t CCluster::PredictExecutionTime(const TProgramCall& InProgramCall) const
+{
+	return RuntimePredictor ? RuntimePredictor->Predict(CRuntimePredictor::GetProgramKey(InProgramCall.Name), InProgramCall.ExecutionTime) : InProgramCall.ExecutionTime;
+}
+
+
+void CCluster::IndexRunningProgram(const TProgram& InProgram, bool InStarted)
+{
+	if (Preemption && !InProgram.RealExecution)
+	{
+		if (InStarted)
+			PreemptionIndex.Mutate().insert(TPreemptionKey(InProgram));
+		else
+			PreemptionIndex.Mutate().erase(TPreemptionKey(InProgram));
+	}
+
+	if (!DeadlineScheduling)
+		return;
+
+	std::pair<size_t, size_t> Entry(GetEndTime(InProgram), InProgram.RequiredProcessorCount);
+
+	std::multiset<std::pair<size_t, size_t>>& Index = EndTimeIndex.Mutate();
+	if (InStarted)
+		Index.insert(Entry);
+
+	else
+	{
+		auto Found = Index.find(Entry);
+		if (Found != Index.end())
+			Index.erase(Found);
+	}
+}
+
+
+size_t CCluster::PredictStartTime(size_t InRequiredProcessors) const
+{
+	// Called from the update callback, the call can start on the next tick at the earliest
+	size_t StartTime = UpdateEventRunning ? CurrentTime + 1 : CurrentTime;
+	size_t Processors = FreeProcessors;
+
+	// Processors of a program that ends at a tick are free from the next one
+	for (auto& Entry : EndTimeIndex.Get())
+	{
+		if (Processors >= InRequiredProcessors)
+			break;
+
+		Processors += Entry.second;
+		StartTime = std::max(StartTime, Entry.first + 1);
+	}
+
+	return StartTime;
+}
+
+
+void CCluster::EnableRuntimePrediction(size_t InCapacity, float InSmoothing)
+{
+	RuntimePredictor = std::make_shared<CRuntimePredictor>(InCapacity, InSmoothing);
+}
+
+
+void CCluster::EnableFairShare(size_t InHalfLife)
+{
+	FairShare = std::make_shared<CFairShare>(InHalfLife);
+	UserPenalties.clear();
+	UserPenaltyTimes.clear();
+}
+
+
+CFairShare& CCluster::MutateFairShare()
+{
+	if (FairShare.use_count() > 1)
+		FairShare = std::make_shared<CFairShare>(*FairShare);
+
+	return *FairShare;
+}
+
+
+void CCluster::ChargeUser(const TProgram& InProgram, bool InStarted, size_t InTime)
+{
+	if (!FairShare)
+		return;
+
+	CFairShare& Accounts = MutateFairShare();
+	uint32_t UserID = Accounts.GetUserID(InProgram.User);
+
+	if (InStarted)
+		Accounts.Start(UserID, InProgram.RequiredProcessorCount, InTime);
+	else
+		Accounts.Finish(UserID, InProgram.RequiredProcessorCount, InTime);
+}
+
+
+void CCluster::AddSubmissionSource(ISubmissionSource* InSource)
+{
+	if (!InSource)
+		throw(std::runtime_error("Adding an empty submission source!"));
+
+	SubmissionSources.push_back(InSource);
+}
+
+
+void CCluster::RemoveSubmissionSource(ISubmissionSource* InSource)
+{
+	SubmissionSources.erase(std::remove(SubmissionSources.begin(), SubmissionSources.end(), InSource), SubmissionSources.end());
+}
+
+
+void CCluster::EnableJournal(const std::string& InPath)
+{
+	if (Journal)
+		throw(std::runtime_error("Cluster journal is already enabled!"));
+
+	if (GangMatrix.IsSet())
+		throw(std::runtime_error("Gang scheduling can not be journaled!"));
+
+	if (!Workflows->empty())
+		throw(std::runtime_error("Workflows can not be journaled!"));
+
+	std::vector<TJournalRecord> Records;
+	std::unique_ptr<CJournal> NewJournal = std::make_unique<CJournal>(InPath, Records);
+
+	ReplayJournal(Records);
+
+	Journal = std::move(NewJournal);
+}
+
+
+void CCluster::ReplayJournal(const std::vector<TJournalRecord>& InRecords)
+{
+	// Waiting calls are collected in the order they were queued (preempted programs are queued again with their job ID)
+	std::map<size_t, TProgramCall> Waiting;
+	std::map<size_t, size_t> QueuedAt;
+	size_t QueueOrder = 0;
+
+	WaitingProgramCalls.ForEach([&](const TProgramCall& Call)
+	{
+		QueuedAt[Call.JobID] = QueueOrder;
+		Waiting[QueueOrder++] = Call;
+	});
+
+	for (auto& Record : InRecords)
+	{
+		if (Record.Type == EJournalRecord::Call)
+		{
+			QueuedAt[Record.Call.JobID] = QueueOrder;
+			Waiting[QueueOrder++] = Record.Call;
+			ClusterReportData.TotalProgramCalls = std::max(ClusterReportData.TotalProgramCalls, Record.Call.JobID + std::max<size_t>(Record.Call.ArrayCount, 1));
+		}
+
+		else if (Record.Type == EJournalRecord::Start)
+		{
+			auto Order = QueuedAt.find(Record.Call.JobID);
+			if (Order == QueuedAt.end())
+				throw(std::runtime_error("Cluster journal starts a program that was never called!"));
+
+			auto Call = Waiting.find(Order->second);
+			TProgram Program(Call->second.ArrayCount == 0 ? Call->second : Call->second.GetArrayTask(), Record.Time);
+			for (unsigned Processor : Record.Processors)
+			{
+				Program.AssignProcessor(Processor);
+				OccupyProcessor(Processor, Program.Name);
+
+				ClusterReportData.PerProcessorTotalPrograms[Processor]++;
+			}
+
+			if (BuddyAllocator.IsSet())
+				BuddyAllocator.Occupy(Program.OccupiedProcessors);
+
+			AdjustRunTime(Program);
+			FreeLicenses -= Program.Resources[EResource::Licenses];
+
+			RunningPrograms.Mutate()[Program.Name] = Program;
+			ClusterReportData.TotalProgramsRunning++;
+
+			IndexRunningProgram(Program, true);
+			ChargeUser(Program, true, Record.Time);
+
+			// Tasks of a job array start in order, the rest of it waits for the next job ID
+			if (Call->second.ArrayCount > 1)
+			{
+				Call->second.ArrayCount--;
+				Call->second.ArrayIndex++;
+				Call->second.JobID++;
+				QueuedAt[Call->second.JobID] = Order->second;
+			}
+
+			else
+				Waiting.erase(Call);
+
+			QueuedAt.erase(Order);
+		}
+
+		else if (Record.Type == EJournalRecord::Finish || Record.Type == EJournalRecord::Preempt)
+		{
+			auto Program = RunningPrograms.Mutate().find(Record.Call.Name);
+			if (Program == RunningPrograms->end())
+				throw(std::runtime_error("Cluster journal finishes a program that is not running!"));
+
+			ReleaseProgramResources(Program->second);
+			ChargeUser(Program->second, false, Record.Time);
+
+			IndexRunningProgram(Program->second, false);
+
+			if (Record.Type == EJournalRecord::Finish)
+				CountFinishedProgram(Program->second, Record.Time);
+			else
+				ClusterReportData.TotalProgramsPreempted++;
+
+			RunningPrograms.Mutate().erase(Program);
+		}
+
+		else if (Record.Type == EJournalRecord::Tick)
+			CurrentTime = Record.Time + 1;
+	}
+
+	WaitingProgramCalls = TPersistentQueue<TProgramCall>();
+	WaitingCallFields.Clear();
+
+	for (auto& Call : Waiting)
+	{
+		WaitingProgramCalls.Put(Call.second);
+		PutWaitingFields(Call.second);
+	}
+}
+
+
+// Snapshot layout: magic and version, configuration, time, processors of the running programs,
+// waiting calls in queue order, report counters and the user state
+static const uint64_t SnapshotMagic = 0x31304E5053554C43; // "CLUSPN01"
+static const uint32_t SnapshotVersion = 12;
+
+
+void CCluster::SaveSnapshot(const std::string& InPath, const std::string& InUserState)
+{
+	for (auto& Program : RunningPrograms.Get())
+		if (Program.second.RealExecution)
+			throw(std::runtime_error("Can not snapshot a cluster with real programs running!"));
+
+	if (RealCallsWaiting > 0)
+		throw(std::runtime_error("Can not snapshot a cluster with real programs waiting!"));
+
+	if (!Workflows->empty())
+		throw(std::runtime_error("Can not snapshot a cluster with unfinished workflows!"));
+
+	CSnapshotWriter Writer;
+
+	Writer.Write<uint64_t>(SnapshotMagic);
+	Writer.Write<uint32_t>(SnapshotVersion);
+
+	Writer.Write<uint64_t>(ProcessorCount);
+	Writer.Write<uint64_t>(QueueAnalysisDepth);
+	Writer.Write<uint64_t>(MaxProgramsStartPerTick);
+
+	Writer.Write<uint8_t>(BuddyAllocator.IsSet());
+
+	Writer.Write<uint8_t>(Preemption);
+	Writer.Write<uint64_t>(CheckpointCost);
+
+	Writer.Write<uint8_t>(DeadlineScheduling);
+
+	Writer.Write<uint64_t>(GangMatrix.GetRowCount());
+	Writer.Write<uint64_t>(GangQuantum);
+	Writer.Write<uint64_t>(ContextSwitchCost);
+	Writer.Write<uint64_t>(ActiveSlice);
+	Writer.Write<uint64_t>(SliceStartTime);
+	Writer.Write<uint64_t>(SwitchEndTime);
+
+	Writer.Write<uint8_t>(bool(FairShare));
+	if (FairShare)
+	{
+		Writer.Write<uint64_t>(FairShare->GetHalfLife());
+		Writer.Write<uint64_t>(FairShare->GetUserCount());
+
+		for (uint32_t UserID = 0; UserID < FairShare->GetUserCount(); UserID++)
+		{
+			const CFairShare::TUserUsage& Usage = FairShare->GetUserState(UserID);
+			Writer.WriteString(FairShare->GetUserName(UserID));
+			Writer.Write<double>(Usage.Usage);
+			Writer.Write<uint64_t>(Usage.RunningProcessors);
+			Writer.Write<uint64_t>(Usage.UpdateTime);
+		}
+	}
+
+	Writer.Write<uint8_t>(bool(RuntimePredictor));
+	if (RuntimePredictor)
+	{
+		Writer.Write<uint64_t>(RuntimePredictor->GetCapacity());
+		Writer.Write<float>(RuntimePredictor->GetSmoothing());
+		Writer.Write<uint64_t>(RuntimePredictor->GetObservationCount());
+		Writer.Write<double>(RuntimePredictor->GetTotalAbsoluteError());
+
+		size_t KindCount = 0;
+		for (size_t Slot = 0; Slot < RuntimePredictor->GetCapacity(); Slot++)
+			KindCount += RuntimePredictor->GetEntry(Slot).Key != 0;
+
+		// Only the taken slots, with their positions
+		Writer.Write<uint64_t>(KindCount);
+		for (size_t Slot = 0; Slot < RuntimePredictor->GetCapacity(); Slot++)
+		{
+			const CRuntimePredictor::TEntry& Entry = RuntimePredictor->GetEntry(Slot);
+			if (Entry.Key == 0)
+				continue;
+
+			Writer.Write<uint64_t>(Slot);
+			Writer.Write<uint64_t>(Entry.Key);
+			Writer.Write<float>(Entry.Ratio);
+			Writer.Write<uint32_t>(Entry.Observations);
+		}
+	}
+
+	Writer.Write<uint8_t>(HasSpeedFactors);
+	Writer.Write<uint64_t>(LongProgramTime);
+	for (auto& Processor : Processors)
+		Writer.Write<float>(Processor.GetSpeedFactor());
+
+	Writer.Write<uint8_t>(Topology.IsSet());
+	if (Topology.IsSet())
+	{
+		const TTopologyShape& Shape = Topology.GetShape();
+		Writer.Write<uint64_t>(Shape.ProcessorsPerSocket);
+		Writer.Write<uint64_t>(Shape.SocketsPerNode);
+		Writer.Write<uint64_t>(Shape.NodesPerRack);
+
+		for (double Penalty : Shape.CommunicationPenalty)
+			Writer.Write<double>(Penalty);
+	}
+
+	Writer.Write<uint32_t>(LicenseCount);
+	for (unsigned Processor = 0; Processor < ProcessorCount; Processor++)
+		for (uint32_t Amount : NodeResources.GetCapacity(Processor).Amounts)
+			Writer.Write<uint32_t>(Amount);
+
+	// Saved from the update callback, the snapshot is taken at the end of the current tick
+	Writer.Write<uint64_t>(UpdateEventRunning ? CurrentTime + 1 : CurrentTime);
+
+	Writer.Write<uint64_t>(RunningPrograms->size() - ThisTickFinishedPrograms.size());
+	for (auto& Program : RunningPrograms.Get())
+	{
+		if (std::find(ThisTickFinishedPrograms.begin(), ThisTickFinishedPrograms.end(), Program.first) != ThisTickFinishedPrograms.end())
+			continue;
+
+		Writer.WriteString(Program.second.Name);
+		Writer.Write<uint64_t>(Program.second.JobID);
+		Writer.Write<uint64_t>(Program.second.RequiredProcessorCount);
+		Writer.Write<uint64_t>(Program.second.ExecutionStartTime);
+		Writer.Write<uint64_t>(Program.second.MaxExecutionTime);
+		Writer.Write<uint64_t>(Program.second.ActualExecutionTime);
+
+		for (uint32_t Amount : Program.second.Resources.Amounts)
+			Writer.Write<uint32_t>(Amount);
+
+		Writer.Write<int32_t>(Program.second.Priority);
+		Writer.Write<uint64_t>(Program.second.TimeCalled);
+		Writer.WriteString(Program.second.User);
+		Writer.Write<uint64_t>(Program.second.Deadline);
+		Writer.Write<uint64_t>(Program.second.Slice);
+		Writer.Write<uint64_t>(Program.second.TicksRun);
+
+		Writer.Write<uint64_t>(Program.second.OccupiedProcessors.size());
+		for (unsigned Processor : Program.second.OccupiedProcessors)
+			Writer.Write<uint32_t>(Processor);
+	}
+
+	Writer.Write<uint64_t>(WaitingProgramCalls.size());
+	WaitingProgramCalls.ForEach([&](const TProgramCall& Call)
+	{
+		Writer.WriteString(Call.Name);
+		Writer.Write<uint64_t>(Call.RequiredProcessors);
+		Writer.Write<uint64_t>(Call.ExecutionTime);
+		Writer.Write<uint64_t>(Call.ActualExecutionTime);
+		Writer.Write<uint64_t>(Call.PredictedExecutionTime);
+		Writer.Write<uint64_t>(Call.TimeCalled);
+		Writer.Write<uint64_t>(Call.JobID);
+
+		for (uint32_t Amount : Call.Resources.Amounts)
+			Writer.Write<uint32_t>(Amount);
+		Writer.Write<uint64_t>(Call.DominantProcessors);
+		Writer.Write<int32_t>(Call.Priority);
+		Writer.WriteString(Call.User);
+		Writer.Write<uint64_t>(Call.Deadline);
+		Writer.Write<uint64_t>(Call.ArrayCount);
+		Writer.Write<uint64_t>(Call.ArrayIndex);
+	});
+
+	Writer.Write<uint64_t>(ClusterReportData.TotalProgramCalls);
+	Writer.Write<uint64_t>(ClusterReportData.TotalProgramsRunning);
+	Writer.Write<uint64_t>(ClusterReportData.TotalProgramsFinished);
+	Writer.Write<uint64_t>(ClusterReportData.TotalProgramsFailed);
+	Writer.Write<uint64_t>(ClusterReportData.TotalProgramsPreempted);
+	Writer.Write<uint64_t>(ClusterReportData.DeadlinesMet);
+	Writer.Write<uint64_t>(ClusterReportData.DeadlinesMissed);
+	Writer.Write<uint64_t>(ClusterReportData.DeadlineCallsRejected);
+	Writer.Write<uint64_t>(ClusterReportData.AllTicksProgramsRunning);
+	Writer.Write<uint64_t>(ClusterReportData.TickOverruns);
+	Writer.Write<float>(ClusterReportData.MaxTickOverrun);
+	Writer.Write<double>(ClusterReportData.AllTicksExternalFragmentation);
+	Writer.Write<float>(ClusterReportData.MaxExternalFragmentation);
+	Writer.Write<uint64_t>(ClusterReportData.FragmentationBlockedTicks);
+	Writer.Write<uint64_t>(ClusterReportData.ContextSwitches);
+
+	Writer.Write<uint64_t>(ClusterReportData.PerJobClassProgramsFinished.size());
+	for (auto& JobClass : ClusterReportData.PerJobClassProgramsFinished)
+	{
+		Writer.Write<uint64_t>(JobClass.first);
+		Writer.Write<uint64_t>(JobClass.second);
+		Writer.Write<double>(ClusterReportData.PerJobClassTotalResponseTime[JobClass.first]);
+	}
+
+	for (unsigned i = 0; i < ProcessorCount; i++)
+	{
+		Writer.Write<uint64_t>(ClusterReportData.AllTicksPerProcessorProgramsRunning[i]);
+		Writer.Write<uint64_t>(ClusterReportData.PerProcessorTotalPrograms[i]);
+	}
+
+	Writer.WriteString(InUserState);
+
+	Writer.SaveToFile(InPath);
+}
+
+
+std::string CCluster::LoadSnapshot(const std::string& InPath)
+{
+	if (Journal)
+		throw(std::runtime_error("Can not load a snapshot into a journaled cluster!"));
+
+	for (auto& Program : RunningPrograms.Get())
+		if (Program.second.RealExecution)
+			throw(std::runtime_error("Can not load a snapshot while real programs are running!"));
+
+	CMappedFile File(InPath);
+	CSnapshotReader Reader(File.GetData(), File.GetSize());
+
+	if (Reader.Read<uint64_t>() != SnapshotMagic)
+		throw(std::runtime_error("Not a cluster snapshot!"));
+
+	if (Reader.Read<uint32_t>() != SnapshotVersion)
+		throw(std::runtime_error("Unsupported cluster snapshot version!"));
+
+	size_t NewProcessorCount = size_t(Reader.Read<uint64_t>());
+	size_t NewQueueAnalysisDepth = size_t(Reader.Read<uint64_t>());
+	size_t NewMaxProgramsStartPerTick = size_t(Reader.Read<uint64_t>());
+
+	BuddyAllocator = CBuddyAllocator();
+	if (Reader.Read<uint8_t>())
+		BuddyAllocator.Reset(NewProcessorCount);
+
+	Preemption = Reader.Read<uint8_t>() != 0;
+	CheckpointCost = size_t(Reader.Read<uint64_t>());
+
+	DeadlineScheduling = Reader.Read<uint8_t>() != 0;
+
+	GangMatrix = CGangMatrix();
+	size_t SliceCount = size_t(Reader.Read<uint64_t>());
+	if (SliceCount != 0)
+		GangMatrix.Reset(SliceCount, NewProcessorCount);
+
+	GangQuantum = size_t(Reader.Read<uint64_t>());
+	ContextSwitchCost = size_t(Reader.Read<uint64_t>());
+	size_t NewActiveSlice = size_t(Reader.Read<uint64_t>());
+	size_t NewSliceStartTime = size_t(Reader.Read<uint64_t>());
+	size_t NewSwitchEndTime = size_t(Reader.Read<uint64_t>());
+
+	if (SliceCount != 0 && NewActiveSlice >= SliceCount)
+		throw(std::runtime_error("Cluster snapshot activates a time slice that does not exist!"));
+
+	FairShare.reset();
+	UserPenalties.clear();
+	UserPenaltyTimes.clear();
+
+	if (Reader.Read<uint8_t>())
+	{
+		FairShare = std::make_shared<CFairShare>(size_t(Reader.Read<uint64_t>()));
+
+		uint64_t UserCount = Reader.Read<uint64_t>();
+		for (uint64_t i = 0; i < UserCount; i++)
+		{
+			uint32_t UserID = FairShare->GetUserID(Reader.ReadString());
+
+			CFairShare::TUserUsage Usage;
+			Usage.Usage = Reader.Read<double>();
+			Usage.RunningProcessors = size_t(Reader.Read<uint64_t>());
+			Usage.UpdateTime = size_t(Reader.Read<uint64_t>());
+			FairShare->SetUserState(UserID, Usage);
+		}
+	}
+
+	RuntimePredictor.reset();
+	if (Reader.Read<uint8_t>())
+	{
+		size_t Capacity = size_t(Reader.Read<uint64_t>());
+		float Smoothing = Reader.Read<float>();
+		RuntimePredictor = std::make_shared<CRuntimePredictor>(Capacity, Smoothing);
+
+		if (RuntimePredictor->GetCapacity() != Capacity)
+			throw(std::runtime_error("Cluster snapshot has a runtime predictor of a wrong capacity!"));
+
+		size_t PredictorObservations = size_t(Reader.Read<uint64_t>());
+		RuntimePredictor->SetObservationTotals(PredictorObservations, Reader.Read<double>());
+
+		uint64_t KindCount = Reader.Read<uint64_t>();
+		for (uint64_t i = 0; i < KindCount; i++)
+		{
+			size_t Slot = size_t(Reader.Read<uint64_t>());
+
+			CRuntimePredictor::TEntry Entry;
+			Entry.Key = Reader.Read<uint64_t>();
+			Entry.Ratio = Reader.Read<float>();
+			Entry.Observations = Reader.Read<uint32_t>();
+
+			if (Slot >= Capacity || Entry.Key == 0)
+				throw(std::runtime_error("Cluster snapshot has a damaged runtime predictor!"));
+
+			RuntimePredictor->SetEntry(Slot, Entry);
+		}
+	}
+
+	bool NewHasSpeedFactors = Reader.Read<uint8_t>() != 0;
+	LongProgramTime = size_t(Reader.Read<uint64_t>());
+
+	std::vector<float> SpeedFactors;
+	for (size_t Processor = 0; Processor < NewProcessorCount; Processor++)
+		SpeedFactors.push_back(Reader.Read<float>());
+
+	Topology = CTopology();
+	if (Reader.Read<uint8_t>())
+	{
+		TTopologyShape Shape;
+		Shape.ProcessorsPerSocket = size_t(Reader.Read<uint64_t>());
+		Shape.SocketsPerNode = size_t(Reader.Read<uint64_t>());
+		Shape.NodesPerRack = size_t(Reader.Read<uint64_t>());
+
+		for (double& Penalty : Shape.CommunicationPenalty)
+			Penalty = Reader.Read<double>();
+
+		Topology = CTopology(NewProcessorCount, Shape);
+	}
+
+	LicenseCount = Reader.Read<uint32_t>();
+
+	ResetState(NewProcessorCount);
+	QueueAnalysisDepth = NewQueueAnalysisDepth;
+
+	HasSpeedFactors = NewHasSpeedFactors;
+	for (unsigned Processor = 0; Processor < ProcessorCount; Processor++)
+		Processors[Processor].SetSpeedFactor(SpeedFactors[Processor]);
+
+	MaxProgramsStartPerTick = NewMaxProgramsStartPerTick;
+
+	ActiveSlice = NewActiveSlice;
+	SliceStartTime = NewSliceStartTime;
+	SwitchEndTime = NewSwitchEndTime;
+
+	for (unsigned Processor = 0; Processor < ProcessorCount; Processor++)
+	{
+		TResources Capacity;
+		for (uint32_t& Amount : Capacity.Amounts)
+			Amount = Reader.Read<uint32_t>();
+
+		NodeResources.SetCapacity(Processor, Capacity);
+	}
+
+	CurrentTime = size_t(Reader.Read<uint64_t>());
+
+	uint64_t RunningCount = Reader.Read<uint64_t>();
+	for (uint64_t i = 0; i < RunningCount; i++)
+	{
+		TProgram Program;
+		Program.Name = Reader.ReadString();
+		Program.JobID = size_t(Reader.Read<uint64_t>());
+		Program.RequiredProcessorCount = size_t(Reader.Read<uint64_t>());
+		Program.ExecutionStartTime = size_t(Reader.Read<uint64_t>());
+		Program.MaxExecutionTime = size_t(Reader.Read<uint64_t>());
+		Program.ActualExecutionTime = size_t(Reader.Read<uint64_t>());
+
+		for (uint32_t& Amount : Program.Resources.Amounts)
+			Amount = Reader.Read<uint32_t>();
+
+		Program.Priority = Reader.Read<int32_t>();
+		Program.TimeCalled = size_t(Reader.Read<uint64_t>());
+		Program.User = Reader.ReadString();
+		Program.Deadline = size_t(Reader.Read<uint64_t>());
+		Program.Slice = size_t(Reader.Read<uint64_t>());
+		Program.TicksRun = size_t(Reader.Read<uint64_t>());
+
+		if (GangMatrix.IsSet() ? Program.Slice >= GangMatrix.GetRowCount() : Program.Slice != 0)
+			throw(std::runtime_error("Cluster snapshot places a program into a time slice that does not exist!"));
+
+		if (Program.Resources[EResource::Licenses] > FreeLicenses)
+			throw(std::runtime_error("Cluster snapshot uses more licenses than it has!"));
+
+		FreeLicenses -= Program.Resources[EResource::Licenses];
+
+		uint64_t OccupiedCount = Reader.Read<uint64_t>();
+		for (uint64_t j = 0; j < OccupiedCount; j++)
+		{
+			unsigned Processor = Reader.Read<uint32_t>();
+			if (Processor >= ProcessorCount)
+				throw(std::runtime_error("Cluster snapshot references a processor that does not exist!"));
+
+			Program.AssignProcessor(Processor);
+			if (!GangMatrix.IsSet() || Program.Slice == ActiveSlice)
+				OccupyProcessor(Processor, Program.Name);
+		}
+
+		if (BuddyAllocator.IsSet())
+			BuddyAllocator.Occupy(Program.OccupiedProcessors);
+		if (GangMatrix.IsSet())
+			GangMatrix.Occupy(Program.Slice, Program.OccupiedProcessors);
+
+		RunningPrograms.Mutate()[Program.Name] = Program;
+
+		IndexRunningProgram(Program, true);
+	}
+
+	uint64_t WaitingCount = Reader.Read<uint64_t>();
+	for (uint64_t i = 0; i < WaitingCount; i++)
+	{
+		TProgramCall Call;
+		Call.Name = Reader.ReadString();
+		Call.RequiredProcessors = size_t(Reader.Read<uint64_t>());
+		Call.ExecutionTime = size_t(Reader.Read<uint64_t>());
+		Call.ActualExecutionTime = size_t(Reader.Read<uint64_t>());
+		Call.PredictedExecutionTime = size_t(Reader.Read<uint64_t>());
+		Call.TimeCalled = size_t(Reader.Read<uint64_t>());
+		Call.JobID = size_t(Reader.Read<uint64_t>());
+
+		for (uint32_t& Amount : Call.Resources.Amounts)
+			Amount = Reader.Read<uint32_t>();
+		Call.DominantProcessors = size_t(Reader.Read<uint64_t>());
+		Call.Priority = Reader.Read<int32_t>();
+		Call.User = Reader.ReadString();
+		Call.Deadline = size_t(Reader.Read<uint64_t>());
+		Call.ArrayCount = size_t(Reader.Read<uint64_t>());
+		Call.ArrayIndex = size_t(Reader.Read<uint64_t>());
+
+		WaitingProgramCalls.Put(Call);
+		PutWaitingFields(Call);
+	}
+
+	ClusterReportData.TotalProgramCalls = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.TotalProgramsRunning = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.TotalProgramsFinished = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.TotalProgramsFailed = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.TotalProgramsPreempted = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.DeadlinesMet = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.DeadlinesMissed = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.DeadlineCallsRejected = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.AllTicksProgramsRunning = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.TickOverruns = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.MaxTickOverrun = Reader.Read<float>();
+	ClusterReportData.AllTicksExternalFragmentation = Reader.Read<double>();
+	ClusterReportData.MaxExternalFragmentation = Reader.Read<float>();
+	ClusterReportData.FragmentationBlockedTicks = size_t(Reader.Read<uint64_t>());
+	ClusterReportData.ContextSwitches = size_t(Reader.Read<uint64_t>());
+
+	uint64_t JobClassCount = Reader.Read<uint64_t>();
+	for (uint64_t i = 0; i < JobClassCount; i++)
+	{
+		size_t JobClass = size_t(Reader.Read<uint64_t>());
+		ClusterReportData.PerJobClassProgramsFinished[JobClass] = size_t(Reader.Read<uint64_t>());
+		ClusterReportData.PerJobClassTotalResponseTime[JobClass] = Reader.Read<double>();
+	}
+
+	for (unsigned i = 0; i < ProcessorCount; i++)
+	{
+		ClusterReportData.AllTicksPerProcessorProgramsRunning[i] = size_t(Reader.Read<uint64_t>());
+		ClusterReportData.PerProcessorTotalPrograms[i] = size_t(Reader.Read<uint64_t>());
+	}
+
+	return Reader.ReadString();
+}
+
+
+std::unique_ptr<CCluster> CCluster::Fork(size_t InMaxTime) const
+{
+	for (auto& Program : RunningPrograms.Get())
+		if (Program.second.RealExecution)
+			throw(std::runtime_error("Can not fork a cluster with real programs running!"));
+
+	if (RealCallsWaiting > 0)
+		throw(std::runtime_error("Can not fork a cluster with real programs waiting!"));
+
+	std::unique_ptr<CCluster> Forked = std::make_unique<CCluster>(InMaxTime, 0, QueueAnalysisDepth, MaxProgramsStartPerTick);
+
+	Forked->ProcessorCount = ProcessorCount;
+	Forked->Processors = Processors;
+	Forked->FreeProcessors = FreeProcessors;
+
+	Forked->NodeResources = NodeResources;
+	Forked->LicenseCount = LicenseCount;
+	Forked->FreeLicenses = FreeLicenses;
+	Forked->Topology = Topology;
+	Forked->HasSpeedFactors = HasSpeedFactors;
+	Forked->LongProgramTime = LongProgramTime;
+	Forked->BuddyAllocator = BuddyAllocator;
+	Forked->Preemption = Preemption;
+	Forked->CheckpointCost = CheckpointCost;
+	Forked->PreemptionIndex = PreemptionIndex;
+	Forked->DeadlineScheduling = DeadlineScheduling;
+	Forked->EndTimeIndex = EndTimeIndex;
+	Forked->GangMatrix = GangMatrix;
+	Forked->GangQuantum = GangQuantum;
+	Forked->ContextSwitchCost = ContextSwitchCost;
+	Forked->ActiveSlice = ActiveSlice;
+	Forked->SliceStartTime = SliceStartTime;
+	Forked->SwitchEndTime = SwitchEndTime;
+	Forked->Workflows = Workflows;
+
+	Forked->RunningPrograms = RunningPrograms;
+	Forked->WaitingProgramCalls = WaitingProgramCalls;
+	Forked->WaitingCallFields = WaitingCallFields;
+	Forked->ScoreWeights = ScoreWeights;
+	Forked->RuntimePredictor = RuntimePredictor;
+	Forked->FairShare = FairShare;
+
+	Forked->AdaptiveDepth = AdaptiveDepth;
+	Forked->AdaptiveDepthSettings = AdaptiveDepthSettings;
+	Forked->ScoringTimePerCall = ScoringTimePerCall;
+
+	// Forked from the update callback, the fork starts from the end of the current tick
+	for (auto& FinishedProgram : ThisTickFinishedPrograms)
+		Forked->RunningPrograms.Mutate().erase(FinishedProgram);
+
+	Forked->CurrentTime = UpdateEventRunning ? CurrentTime + 1 : CurrentTime;
+	Forked->ClusterReportData = ClusterReportData;
+
+	return Forked;
+}
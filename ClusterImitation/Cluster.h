@@ -1,38 +1,142 @@
 #pragma once
-#include "Queue.h"
+#include "PersistentQueue.h"
+#include "CopyOnWrite.h"
+#include "WaitingCallFields.h"
+#include "WorkerPool.h"
+#include "JobExecutor.h"
+#include "ProcessLauncher.h"
+#include "RuntimePredictor.h"
+#include "FairShare.h"
+#include "Resources.h"
+#include "Topology.h"
+#include "BuddyAllocator.h"
+#include "GangMatrix.h"
+#include "Workflow.h"
 #include <string>
 #include <map>
 #include <set>
+#include <tuple>
 #include <vector>
 #include <iostream>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 class CCluster;
+class CJournal;
+struct TJournalRecord;
+struct TProgramCall;
 
 typedef void (*OnClasterUpdateFunction)(CCluster*);
+typedef std::function<void(CCluster*, const TProgramCall&)> OnProgramStartedFunction;
+
+
+// Source of program calls made outside of the update callback (e.g. by other processes),
+// drained by the cluster at the beginning of every tick
+class ISubmissionSource
+{
+public:
+	virtual ~ISubmissionSource() {}
+
+	virtual void DrainSubmissions(CCluster& Cluster) = 0;
+};
+
+
+// What the real-time pacer does when a tick takes longer than its time slot
+enum class ECatchUpPolicy
+{
+	// Drop the missed slots and re-anchor the schedule at the moment the overrun was detected
+	Skip,
+
+	// Keep the original schedule and run the following ticks back to back until it is met again
+	CatchUp
+};
+
+
+// Bounds of the adaptive queue analysis depth (see CCluster::SetAdaptiveQueueAnalysisDepth)
+struct TAdaptiveDepthSettings
+{
+	size_t MinDepth = 1;
+	size_t MaxDepth = 4096;
+
+	// Wall-clock seconds one pick of the top call may take, 0 - unlimited (the depth then only depends on the simulated state)
+	float DecisionBudget = 0;
+};
 
 
 struct TClusterReportData
 {
-	size_t Time;
+	size_t Time = 0;
+
+	size_t TotalProgramCalls = 0;
+	size_t TotalProgramsRunning = 0;
+	size_t TotalProgramsFinished = 0;
+	size_t TotalProgramsFailed = 0;
+	size_t TotalProgramsPreempted = 0;
 
-	size_t TotalProgramCalls;
-	size_t TotalProgramsRunning;
-	size_t TotalProgramsFinished;
+	// Programs with a deadline that finished by it and after it, calls rejected as unable to meet theirs (see CCluster::EnableDeadlineScheduling)
+	size_t DeadlinesMet = 0;
+	size_t DeadlinesMissed = 0;
+	size_t DeadlineCallsRejected = 0;
+	float DeadlineHitRate = 0;
+	float DeadlineMissRate = 0;
 
-	size_t AllTicksProgramsRunning;
+	// Active row changes of gang scheduling
+	size_t ContextSwitches = 0;
+
+	size_t AllTicksProgramsRunning = 0;
 	std::map<unsigned, size_t> AllTicksPerProcessorProgramsRunning;
 
-	float AverageProgramsRunning;
+	float AverageProgramsRunning = 0;
 	std::map<unsigned, size_t> PerProcessorTotalPrograms;
 	std::map<unsigned, float> PerProcessorAverageLoad;
 
+	// Average load of the processors of each speed factor
+	std::map<float, float> PerSpeedClassAverageLoad;
+
+	// Finished programs and their response (ticks from the call to the finish) by job class:
+	// the requested execution time rounded up to a power of two
+	std::map<size_t, size_t> PerJobClassProgramsFinished;
+	std::map<size_t, double> PerJobClassTotalResponseTime;
+	std::map<size_t, float> PerJobClassAverageResponseTime;
+
+	static size_t GetJobClass(size_t InExecutionTime)
+	{
+		size_t JobClass = 1;
+		while (JobClass < InExecutionTime)
+			JobClass *= 2;
+
+		return JobClass;
+	}
+
+	// Real-time pacing (only filled when the cluster is paced)
+	size_t TickOverruns = 0;
+	float MaxTickOverrun = 0;
+
+	// Buddy allocation (only filled when it is enabled): the largest free block now, the share of the free processors
+	// outside of it over the ticks, and the ticks a call could not start for lack of a block although enough processors were free
+	size_t LargestFreeBlock = 0;
+	double AllTicksExternalFragmentation = 0;
+	float AverageExternalFragmentation = 0;
+	float MaxExternalFragmentation = 0;
+	size_t FragmentationBlockedTicks = 0;
+
 	friend std::ostream& operator<<(std::ostream& OutStream, TClusterReportData& InReportData)
 	{
 		OutStream << "Total time: " << InReportData.Time << " ticks;" << std::endl
 			<< "Total Program Calls: " << InReportData.TotalProgramCalls << ";" << std::endl
 			<< "Total Programs Running: " << InReportData.TotalProgramsRunning << ";" << std::endl
 			<< "Total Programs Finished: " << InReportData.TotalProgramsFinished << ";" << std::endl
+			<< "Total Programs Failed: " << InReportData.TotalProgramsFailed << ";" << std::endl
+			<< "Total Programs Preempted: " << InReportData.TotalProgramsPreempted << ";" << std::endl
+			<< "Deadlines Met: " << InReportData.DeadlinesMet << ", Missed: " << InReportData.DeadlinesMissed << ", Hit Rate: " << InReportData.DeadlineHitRate
+			<< ", Miss Rate: " << InReportData.DeadlineMissRate << ", Calls Rejected: " << InReportData.DeadlineCallsRejected << ";" << std::endl
+			<< "Context Switches: " << InReportData.ContextSwitches << ";" << std::endl
 			<< "Average Programs Running: " << InReportData.AverageProgramsRunning << ";" << std::endl
+			<< "Tick Overruns: " << InReportData.TickOverruns << ", Max Overrun: " << InReportData.MaxTickOverrun << " seconds;" << std::endl
+			<< "Largest Free Block: " << InReportData.LargestFreeBlock << ", External Fragmentation: " << InReportData.AverageExternalFragmentation
+			<< " (max " << InReportData.MaxExternalFragmentation << "), Ticks Blocked By Fragmentation: " << InReportData.FragmentationBlockedTicks << ";" << std::endl
 			<< std::endl <<"Per Processor Stats: " << std::endl << std::endl;
 
 		for (auto Processor : InReportData.PerProcessorTotalPrograms)
@@ -40,6 +144,17 @@ struct TClusterReportData
 			OutStream << Processor.first << " : Total: " << Processor.second << ", " << "Utilization: " << InReportData.PerProcessorAverageLoad[Processor.first] << ";" << std::endl;
 		}
 
+		OutStream << std::endl << "Per Speed Class Stats: " << std::endl << std::endl;
+
+		for (auto SpeedClass : InReportData.PerSpeedClassAverageLoad)
+			OutStream << "Speed " << SpeedClass.first << " : Utilization: " << SpeedClass.second << ";" << std::endl;
+
+		OutStream << std::endl << "Per Job Class Stats: " << std::endl << std::endl;
+
+		for (auto JobClass : InReportData.PerJobClassProgramsFinished)
+			OutStream << "Up to " << JobClass.first << " ticks : Finished: " << JobClass.second << ", Average Response: "
+				<< InReportData.PerJobClassAverageResponseTime[JobClass.first] << ";" << std::endl;
+
 		return OutStream;
 	}
 };
@@ -49,31 +164,115 @@ struct TProgramCall
 {
 	std::string Name;
 	size_t RequiredProcessors;
+
+	// Requested limit, simulated programs are stopped when it runs out
 	size_t ExecutionTime;
 
+	// How long a simulated program really runs, 0 - the whole ExecutionTime
+	size_t ActualExecutionTime;
+
 	size_t TimeCalled;
 
-	TProgramCall(std::string InName = "", size_t InRequiredProcessors = 0, size_t InExecutionTime = 0) : Name(InName), RequiredProcessors(InRequiredProcessors), ExecutionTime(InExecutionTime) {}
+	// Assigned by the cluster when the call is made, used for scheduling instead of ExecutionTime
+	// (the same as it without runtime prediction)
+	size_t PredictedExecutionTime;
+
+	// Memory and accelerators needed on each of the processors, licenses for the whole program
+	TResources Resources;
+
+	// Assigned by the cluster when the call is made: the share of the cluster the call takes in its most demanded resource,
+	// in processors. Scored instead of RequiredProcessors (the same as it without other resources).
+	size_t DominantProcessors;
+
+	// Assigned by the cluster when the call is made
+	size_t JobID;
+
+	// Higher is more important, with preemption a waiting call may stop running simulated programs of a lower priority
+	int32_t Priority;
+
+	// Account the processor ticks of the program are charged to (see CCluster::EnableFairShare)
+	std::string User;
+
+	// Tick the program has to finish by, 0 - none
+	size_t Deadline;
+
+	// Job array: the call stands for ArrayCount identical programs (tasks) not started yet, named "<Name>.<index>" from ArrayIndex on
+	// and with the job IDs from JobID on. The call keeps its place in the queue until the last of them starts. 0 - a single program.
+	size_t ArrayCount;
+	size_t ArrayIndex;
+
+	// Real work to run on the workers of the assigned processors (see CJobContext). Calls without a task are only simulated,
+	// for calls with a task ExecutionTime is just an estimate used for scheduling, the program finishes with the task
+	JobTaskFunction Task;
+
+	// Alternatively, a local process to launch (program and its arguments), pinned to the CPUs of the assigned processors
+	std::vector<std::string> Command;
+
+	TProgramCall(std::string InName = "", size_t InRequiredProcessors = 0, size_t InExecutionTime = 0, size_t InActualExecutionTime = 0) : Name(InName), RequiredProcessors(InRequiredProcessors),
+		ExecutionTime(InExecutionTime), ActualExecutionTime(InActualExecutionTime), TimeCalled(0), PredictedExecutionTime(InExecutionTime),
+		DominantProcessors(InRequiredProcessors), JobID(0), Priority(0), Deadline(0), ArrayCount(0), ArrayIndex(0) {}
+
+	// Ticks a simulated program runs
+	size_t GetRunTime() const { return ActualExecutionTime != 0 && ActualExecutionTime < ExecutionTime ? ActualExecutionTime : ExecutionTime; }
+
+	// Next task of a job array as a single call
+	TProgramCall GetArrayTask() const
+	{
+		TProgramCall Task = *this;
+		Task.Name = Name + "." + std::to_string(ArrayIndex);
+		Task.ArrayCount = 0;
+		Task.ArrayIndex = 0;
+
+		return Task;
+	}
 };
 
 
 struct TProgram
 {
 	std::string Name;
+	size_t JobID;
 	size_t RequiredProcessorCount;
 	std::set<unsigned> OccupiedProcessors;
 
 	size_t ExecutionStartTime;
 	size_t MaxExecutionTime;
 
-	TProgram(): RequiredProcessorCount(0), ExecutionStartTime(0), MaxExecutionTime(0) {};
+	// Ticks a simulated program runs, up to MaxExecutionTime
+	size_t ActualExecutionTime;
+
+	TResources Resources;
+
+	int32_t Priority;
+	size_t TimeCalled;
+	std::string User;
+	size_t Deadline;
+
+	// Gang scheduling: row of the matrix the program is in and the ticks it has run so far
+	size_t Slice;
+	size_t TicksRun;
+
+	// Finished by its task or process completing instead of by MaxExecutionTime
+	bool RealExecution;
+
+	TProgram(): JobID(0), RequiredProcessorCount(0), ExecutionStartTime(0), MaxExecutionTime(0), ActualExecutionTime(0), Priority(0), TimeCalled(0), Deadline(0), Slice(0), TicksRun(0), RealExecution(false) {};
 
 	TProgram(const TProgramCall& InProgramData, size_t StartTime)
 	{
 		Name = InProgramData.Name;
+		JobID = InProgramData.JobID;
 		ExecutionStartTime = StartTime;
 		MaxExecutionTime = InProgramData.ExecutionTime;
+		ActualExecutionTime = InProgramData.GetRunTime();
+		Resources = InProgramData.Resources;
 		RequiredProcessorCount = InProgramData.RequiredProcessors;
+		Priority = InProgramData.Priority;
+		TimeCalled = InProgramData.TimeCalled;
+		User = InProgramData.User;
+		Deadline = InProgramData.Deadline;
+		Slice = 0;
+		TicksRun = 0;
+		RealExecution = bool(InProgramData.Task) || !InProgramData.Command.empty();
 	}
 
 	void AssignProcessor(unsigned InProcessor)
@@ -87,14 +286,20 @@ class CProcessor
 {
 	unsigned ProcessorID;
 
+	// Work done per tick relative to the reference processor
+	float SpeedFactor;
+
 	bool Occupied;
 	std::string AssignedProgram;
 
 public:
-	CProcessor(unsigned InProcessorID) : ProcessorID(InProcessorID), Occupied(false), AssignedProgram("None") {}
+	CProcessor(unsigned InProcessorID) : ProcessorID(InProcessorID), SpeedFactor(1), Occupied(false), AssignedProgram("None") {}
 
 	bool IsOccupied() const { return Occupied; }
 	unsigned GetID() const { return ProcessorID; }
+
+	float GetSpeedFactor() const { return SpeedFactor; }
+	void SetSpeedFactor(float InSpeedFactor) { SpeedFactor = InSpeedFactor; }
 	const std::string& GetAssignedProgram() const { return AssignedProgram; }
 
 	void AssignProgram(std::string InProgramName)
@@ -114,6 +319,37 @@ public:
 };
 
 
+// Submitted workflow (shared with forks of the cluster) and the predecessors of each of its jobs that have not finished yet.
+// Its jobs have the job IDs from FirstJobID on, in the order of the workflow.
+struct TWorkflowState
+{
+	std::shared_ptr<const CWorkflow> Workflow;
+	std::vector<uint32_t> Indegrees;
+
+	size_t FirstJobID = 0;
+	size_t JobsLeft = 0;
+};
+
+
+// Running simulated program in the order programs are preempted: the lowest priority first, then the widest one
+// (fewer programs to stop), then the last started one (less work to redo)
+struct TPreemptionKey
+{
+	int32_t Priority;
+	size_t Processors;
+	size_t StartTime;
+	std::string Name;
+
+	TPreemptionKey(const TProgram& InProgram) : Priority(InProgram.Priority), Processors(InProgram.RequiredProcessorCount),
+		StartTime(InProgram.ExecutionStartTime), Name(InProgram.Name) {}
+
+	bool operator<(const TPreemptionKey& InOther) const
+	{
+		return std::tie(Priority, InOther.Processors, InOther.StartTime, Name) < std::tie(InOther.Priority, Processors, StartTime, InOther.Name);
+	}
+};
+
+
 class CCluster
 {
 	size_t ProcessorCount;
@@ -121,46 +357,287 @@ class CCluster
 
 	size_t MaxProgramsStartPerTick;
 
-	std::map<std::string, TProgram> RunningPrograms;
-	TQueue<TProgramCall> WaitingProgramCalls;
+	// Shared with forks of the cluster until changed
+	TCopyOnWrite<std::map<std::string, TProgram>> RunningPrograms;
+	TPersistentQueue<TProgramCall> WaitingProgramCalls;
+
+	// Scoring mirror of the waiting calls, changed together with the queue
+	CWaitingCallFields WaitingCallFields;
+	TWaitingCallScores WaitingCallScores;
+
+	TScoreWeights ScoreWeights;
+
+	// Shared with forks until either of them learns from a finished program, empty without runtime prediction
+	std::shared_ptr<CRuntimePredictor> RuntimePredictor;
+
+	// Shared with forks the same way, empty without fair share. The penalties of the users are cached for the current tick.
+	std::shared_ptr<CFairShare> FairShare;
+	std::vector<float> UserPenalties;
+	std::vector<size_t> UserPenaltyTimes;
+
+	// Calls with a task or a command among the waiting ones
+	size_t RealCallsWaiting = 0;
 
 	size_t CurrentTime;
 	size_t MaxTime;
+	bool StopRequested = false;
 
 	OnClasterUpdateFunction OnUpdateEvent;
+	OnProgramStartedFunction OnProgramStarted;
+
+	std::vector<ISubmissionSource*> SubmissionSources;
 
 	std::vector<std::string> ThisTickFinishedPrograms;
+	bool UpdateEventRunning = false;
 
 	TClusterReportData ClusterReportData;
 
 	size_t FreeProcessors = 0;
 	size_t QueueAnalysisDepth;
 
+	// Other resources: capacities of the processors and the licenses shared by all of them
+	CNodeResources NodeResources;
+	uint32_t LicenseCount = 0;
+	uint32_t FreeLicenses = 0;
+
+	// Processor tree, programs are placed by it when it is set
+	CTopology Topology;
+	std::vector<uint8_t> EligibleProcessors;
+
+	// Processors differ in speed: programs at least LongProgramTime long take the fastest free processors, the others the slowest ones
+	bool HasSpeedFactors = false;
+	size_t LongProgramTime = 0;
+
+	// Set when programs are placed by the buddy allocator
+	CBuddyAllocator BuddyAllocator;
+	bool FragmentationBlocked = false;
+
+	// Preemption, with the running simulated programs indexed by TPreemptionKey (shared with forks until changed)
+	bool Preemption = false;
+	size_t CheckpointCost = 0;
+	TCopyOnWrite<std::set<TPreemptionKey>> PreemptionIndex;
+
+	// Earliest deadline first, with the running programs indexed by the tick they end at and their processors (shared with forks until changed)
+	bool DeadlineScheduling = false;
+	TCopyOnWrite<std::multiset<std::pair<size_t, size_t>>> EndTimeIndex;
+
+	// Gang scheduling: programs are on their processors only while their row of the matrix is the active one. The active row
+	// changes every GangQuantum ticks, and its first ContextSwitchCost ticks are spent on the switch.
+	CGangMatrix GangMatrix;
+	size_t GangQuantum = 0;
+	size_t ContextSwitchCost = 0;
+	size_t ActiveSlice = 0;
+	size_t SliceStartTime = 0;
+	size_t SwitchEndTime = 0;
+
+	// Workflows with unfinished jobs by the job ID of their first job (shared with forks until changed)
+	TCopyOnWrite<std::map<size_t, TWorkflowState>> Workflows;
+
+	// Adaptive depth, with the measured time of scoring one waiting call
+	bool AdaptiveDepth = false;
+	TAdaptiveDepthSettings AdaptiveDepthSettings;
+	double ScoringTimePerCall = 0;
+
+	// Real-time pacing, disabled when TickDuration is zero
+	std::chrono::steady_clock::duration TickDuration = std::chrono::steady_clock::duration::zero();
+	ECatchUpPolicy CatchUpPolicy = ECatchUpPolicy::Skip;
+
+	// Real execution, the worker pool is created with the first real program and is destroyed first,
+	// so that no task can report its completion into an already destroyed list
+	std::mutex FinishedTasksMutex;
+	std::vector<std::pair<std::string, bool>> FinishedTasks;
+	std::unique_ptr<CWorkerPool> WorkerPool;
+	std::unique_ptr<CProcessLauncher> ProcessLauncher;
+
+	std::unique_ptr<CJournal> Journal;
+
 	void Update();
+	void WaitForNextTick(std::chrono::steady_clock::time_point& NextTickTime);
 
 	bool CanExecuteProgram(const TProgramCall& InProgramCall);
+	size_t GetDominantProcessors(const TProgramCall& InProgramCall) const;
+	void OccupyProcessor(unsigned InProcessor, const std::string& InProgramName);
+	void ReleaseProcessor(unsigned InProcessor);
+	std::vector<unsigned> ChooseProcessors(const TProgramCall& InProgramCall);
+	float GetSlowestSpeedFactor(const std::set<unsigned>& InProcessors) const;
+	void AdjustRunTime(TProgram& InOutProgram) const;
+	size_t GetRemainingRunTime(const TProgram& InProgram, size_t InElapsed) const;
 	size_t GetTopProgram();
+	size_t FindTopProgram();
+	void AdaptQueueAnalysisDepth();
+	void StartWaitingCall(size_t InIndex);
 	void StartProgramExecution(const TProgramCall& InProgramCall);
 	void FinishProgramExecution(std::string ProgramName);
+	void CountFinishedProgram(const TProgram& InProgram, size_t InTime);
+	void ReleaseProgramResources(const TProgram& InProgram);
+	void PutWaitingCall(TProgramCall& InOutProgramCall);
+	void PutWaitingFields(const TProgramCall& InProgramCall);
+	size_t PredictExecutionTime(const TProgramCall& InProgramCall) const;
+	void IndexRunningProgram(const TProgram& InProgram, bool InStarted);
+
+	size_t PredictStartTime(size_t InRequiredProcessors) const;
+
+	size_t GetStartableProcessors() const;
+	void RotateGangSlice();
+	void SwitchGangSlice(size_t InSlice);
+	void AdvanceGangPrograms();
+
+	const TWorkflowState* FindWorkflow(size_t InJobID) const;
+	void QueueWorkflowJob(const TWorkflowState& InState, size_t InJob);
+	void ReleaseWorkflowSuccessors(size_t InJobID);
+
+	CFairShare& MutateFairShare();
+	void ChargeUser(const TProgram& InProgram, bool InStarted, size_t InTime);
+	float GetUserPenalty(uint32_t InUserID);
+
+	size_t FindPreemptingProgram() const;
+	bool IsPreemptible(const TPreemptionKey& InKey, int32_t InPriority) const;
+	bool PreemptFor(const TProgramCall& InProgramCall);
+	void PreemptProgram(const std::string& InProgramName);
+
+	void ReplayJournal(const std::vector<TJournalRecord>& InRecords);
+	void ResetState(size_t InProcessorCount);
+
+	void DispatchTask(const TProgramCall& InProgramCall, const std::set<unsigned>& InProcessors);
+	void LaunchProcess(const TProgramCall& InProgramCall, const std::set<unsigned>& InProcessors);
+	void CollectFinishedTasks();
 
 
 public:
 	CCluster(size_t InMaxTime, size_t InProcessorCount, size_t InQueueAnalysisDepth = 5, size_t InMaxProgramsStartPerTick = 1);
+	~CCluster();
 
 	void Start(OnClasterUpdateFunction InUpdateEvent);
 
+	// Makes Start() return after the current tick (e.g. when called from the update callback), before MaxTime
+	void Stop() { StopRequested = true; }
+
+	// Makes Start() run one tick per InTickDuration seconds of wall-clock time, scheduled against a steady clock
+	// so that the time spent on the tick itself does not accumulate as drift. Zero duration disables pacing.
+	void SetRealTimePacing(float InTickDuration, ECatchUpPolicy InCatchUpPolicy = ECatchUpPolicy::Skip);
+
 	size_t GetCurrentTime() { return CurrentTime; }
+	size_t GetRunningProgramCount() const { return RunningPrograms->size(); }
+	size_t GetFinishedProgramCount() const { return ClusterReportData.TotalProgramsFinished; }
 
 	TClusterReportData& GetReportData();
 	float EvaluateWaitingCallScore(size_t Index);
 
 	// For Visualization
 	const std::vector<CProcessor>& GetProcessorData() { return Processors; }
-	const TQueue<TProgramCall>& GetWaitingProgramCalls() { return WaitingProgramCalls; }
-	const std::map<std::string, TProgram> GetRunningPrograms() { return RunningPrograms; }
+	const TPersistentQueue<TProgramCall>& GetWaitingProgramCalls() { return WaitingProgramCalls; }
+	const std::map<std::string, TProgram> GetRunningPrograms() { return RunningPrograms.Get(); }
 	const std::vector<std::string>& GetThisTickFinishedPrograms() { return ThisTickFinishedPrograms; }
 	
 
-	void CallProgramExecution(TProgramCall InProgramCall);
+	// Queues a program call, returns the job ID assigned to it (SIZE_MAX if it is rejected for its deadline).
+	// A job array gets ArrayCount job IDs from the returned one on, its tasks are all counted as calls now.
+	size_t CallProgramExecution(TProgramCall InProgramCall);
+
+	// Rebuilds the state recorded in the journal at InPath (if there is one) and journals the cluster from now on.
+	// Has to be called before Start. Tasks and commands of real programs are not journaled, restored programs are simulated.
+	void EnableJournal(const std::string& InPath);
+
+	// Writes the whole cluster state (processors, running programs, waiting calls, report counters and time) to a binary file.
+	// The cluster has no random state of its own, InUserState is stored as is for the caller's workload generator (e.g. its RNG).
+	// Real programs can not be captured, so they must not be running or waiting.
+	void SaveSnapshot(const std::string& InPath, const std::string& InUserState = "");
+
+	// Replaces the cluster state with the snapshot at InPath (memory mapped), returns the stored user state.
+	// MaxTime, pacing and submission sources of this cluster are kept, so Start continues the run up to the new MaxTime.
+	std::string LoadSnapshot(const std::string& InPath);
+
+	// Makes an independent copy of the simulated state to explore an alternative future up to InMaxTime (e.g. with another policy).
+	// Waiting calls and running programs are shared with this cluster until either of them changes them,
+	// so forking costs a pointer copy per CWaitingCallFields::ChunkSize waiting calls. Real programs, the journal, pacing and submission sources are not forked.
+	std::unique_ptr<CCluster> Fork(size_t InMaxTime) const;
+
+	// Fixes the depth, turning the adaptive depth off
+	void SetQueueAnalysisDepth(size_t InQueueAnalysisDepth) { QueueAnalysisDepth = InQueueAnalysisDepth; AdaptiveDepth = false; }
+	size_t GetQueueAnalysisDepth() const { return QueueAnalysisDepth; }
+
+	// Chooses the depth before every pick of the top call: the whole queue while processors are free (within the bounds),
+	// MinDepth when none are, and no more calls than fit into the decision budget at the measured scoring time
+	void SetAdaptiveQueueAnalysisDepth(const TAdaptiveDepthSettings& InSettings);
+	void SetMaxProgramsStartPerTick(size_t InMaxProgramsStartPerTick) { MaxProgramsStartPerTick = InMaxProgramsStartPerTick; }
+
+	// Called for every program call when it starts executing (at GetCurrentTime())
+	void SetProgramStartedCallback(OnProgramStartedFunction InCallback) { OnProgramStarted = InCallback; }
+
+	// The default weights are scored by a version of the scoring loop compiled for them
+	void SetScoreWeights(const TScoreWeights& InScoreWeights) { ScoreWeights = InScoreWeights; }
+	const TScoreWeights& GetScoreWeights() const { return ScoreWeights; }
+
+	// Schedules calls by their runtime predicted from the finished programs of the same kind (see CRuntimePredictor)
+	// instead of the requested ExecutionTime. Only calls made from now on are predicted.
+	void EnableRuntimePrediction(size_t InCapacity = 4096, float InSmoothing = 0.25f);
+	const CRuntimePredictor* GetRuntimePredictor() const { return RuntimePredictor.get(); }
+
+	// Keeps the decayed processor ticks used by each user (see CFairShare), scored by the FairShare weight.
+	// Has to be enabled before the calls are made (and before EnableJournal).
+	void EnableFairShare(size_t InHalfLife = 1000);
+	const CFairShare* GetFairShare() const { return FairShare.get(); }
+
+	// Memory and accelerator capacities of one or of all processors, licenses are ignored. Without any capacities
+	// programs are placed on the lowest free processors, otherwise on the fitting ones with the least capacity to spare.
+	// Has to be set before the calls that need it are made.
+	void SetNodeResources(unsigned InProcessor, const TResources& InCapacity);
+	void SetNodeResources(const TResources& InCapacity);
+	TResources GetNodeResources(unsigned InProcessor) const { return NodeResources.GetCapacity(InProcessor); }
+
+	// Places programs into the smallest socket, node or rack that has enough fitting free processors (see CTopology),
+	// simulated programs spread wider run longer by the communication penalty of their span. Has to be set before
+	// the programs start (and before EnableJournal, the journal does not keep it).
+	void SetTopology(const TTopologyShape& InShape);
+	const CTopology& GetTopology() const { return Topology; }
+
+	// A simulated program runs its run time divided by the speed factor of the slowest of its processors (up to its ExecutionTime).
+	// Unless placed by other resources, the topology or the buddy allocator, programs with a PredictedExecutionTime of at least
+	// InLongProgramTime take the fastest free processors and the others the slowest ones. Has to be set before the programs start.
+	void SetProcessorSpeed(unsigned InProcessor, float InSpeedFactor);
+	void SetLongProgramTime(size_t InLongProgramTime) { LongProgramTime = InLongProgramTime; }
+	float GetProcessorSpeed(unsigned InProcessor) const { return Processors.at(InProcessor).GetSpeedFactor(); }
+
+	// Places programs into aligned power of two blocks of processors (see CBuddyAllocator) instead of by the topology
+	// or the first free processors, a program waits until a block holds it. Can not be used with node resources.
+	void EnableBuddyAllocation();
+	const CBuddyAllocator& GetBuddyAllocator() const { return BuddyAllocator; }
+
+	// When the top call can not start, the highest priority call among the analysed ones stops running simulated programs
+	// of a lower priority until it can (only if they would free enough processors and licenses). A stopped program is queued
+	// again with its job ID, call time and the rest of its work (in ticks of a reference processor) plus InCheckpointCost ticks.
+	void EnablePreemption(size_t InCheckpointCost);
+	size_t GetCheckpointCost() const { return CheckpointCost; }
+
+	// Starts the waiting call with the earliest Deadline among the analysed ones first (the others are scored as usual),
+	// and rejects a call whose deadline can not be met even if it started as soon as the running programs, by their ends, free enough
+	// processors. The check is optimistic: it ignores the waiting calls and the resources other than processors. Rejected calls
+	// are not journaled, so their count does not survive a journal replay.
+	void EnableDeadlineScheduling();
+	bool IsDeadlineScheduling() const { return DeadlineScheduling; }
+
+	// Time slices the processors between InSliceCount rows of programs (an Ousterhout matrix, see CGangMatrix): a program
+	// takes the lowest free processors of the first row with enough of them, starting from the active one, and runs only
+	// while its row is active. The active row moves on to the next one with programs every InQuantum ticks (right away
+	// when it has none left), the first InContextSwitchCost ticks after a move nothing runs. With one slice programs run
+	// to completion as without it. Only for simulated programs, and not with preemption, deadline scheduling, buddy allocation,
+	// the topology, node resources or the journal. Has to be enabled before the programs start.
+	void EnableGangScheduling(size_t InSliceCount, size_t InQuantum, size_t InContextSwitchCost = 0);
+	const CGangMatrix& GetGangMatrix() const { return GangMatrix; }
+	size_t GetActiveSlice() const { return ActiveSlice; }
+
+	// Queues the jobs of the workflow as their dependencies allow (see CWorkflow, prepared here if it is not yet): the jobs without
+	// predecessors now, every other one at the tick the last of its predecessors finishes. Workflow jobs among the analysed calls start
+	// first, the one with the longest critical path ahead of the others. Returns the job ID of the first job, the others follow it
+	// (they are all counted as calls now). Not with the journal, and a cluster can not be snapshotted until its workflows finish.
+	size_t CallWorkflowExecution(CWorkflow InWorkflow);
+	size_t GetWorkflowCount() const { return Workflows->size(); }
+
+	void SetLicenseCount(uint32_t InLicenseCount);
+	uint32_t GetFreeLicenseCount() const { return FreeLicenses; }
+
+	// The source is not owned by the cluster and has to outlive it (or be removed)
+	void AddSubmissionSource(ISubmissionSource* InSource);
+	void RemoveSubmissionSource(ISubmissionSource* InSource);
 
 };
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "ClusterBatch.h"
+#include <algorithm>
+
+
+static uint32_t CountBits(uint32_t Mask)
+{
+	Mask = Mask - ((Mask >> 1) & 0x55555555);
+	Mask = (Mask & 0x33333333) + ((Mask >> 2) & 0x33333333);
+	return (((Mask + (Mask >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+
+CClusterBatch::CClusterBatch(size_t InMaxTime, size_t InClusterCount, size_t InProcessorCount, size_t InQueueAnalysisDepth, size_t InMaxProgramsStartPerTick)
+{
+	if (InProcessorCount == 0 || InProcessorCount > MaxProcessorCount)
+		throw(std::runtime_error("Batched clusters must have from 1 to 32 processors!"));
+
+	if (InMaxTime >= UINT32_MAX)
+		throw(std::runtime_error("Batched clusters can not run for that long!"));
+
+	ClusterCount = InClusterCount;
+	ProcessorCount = InProcessorCount;
+
+	CurrentTime = 0;
+	MaxTime = InMaxTime;
+
+	OnUpdateEvent = nullptr;
+
+	QueueAnalysisDepth.assign(ClusterCount, InQueueAnalysisDepth);
+	MaxProgramsStartPerTick.assign(ClusterCount, InMaxProgramsStartPerTick);
+
+	OccupiedMask.assign(ClusterCount, 0);
+	ProgramMask.assign(ClusterCount, 0);
+
+	WaitingCalls.resize(ClusterCount);
+	QueueHead.assign(ClusterCount, 0);
+
+	TotalProgramCalls.assign(ClusterCount, 0);
+	TotalProgramsRunning.assign(ClusterCount, 0);
+	TotalProgramsFinished.assign(ClusterCount, 0);
+	AllTicksProgramsRunning.assign(ClusterCount, 0);
+	PerJobClassProgramsFinished.resize(ClusterCount);
+	PerJobClassTotalResponseTime.resize(ClusterCount);
+
+	ProcessorEndTime.assign(ClusterCount * MaxProcessorCount, UINT32_MAX);
+	AllTicksPerProcessorProgramsRunning.assign(ClusterCount * MaxProcessorCount, 0);
+	PerProcessorTotalPrograms.assign(ClusterCount * MaxProcessorCount, 0);
+
+	ProgramTimeCalled.assign(ClusterCount * MaxProcessorCount, 0);
+	ProgramJobClass.assign(ClusterCount * MaxProcessorCount, 0);
+}
+
+
+void CClusterBatch::Start(OnClusterBatchUpdateFunction InUpdateEvent)
+{
+	OnUpdateEvent = InUpdateEvent;
+
+	while (CurrentTime <= MaxTime)
+		Update();
+}
+
+
+// Same order of steps as CCluster::Update, each step is done for all the clusters at once
+void CClusterBatch::Update()
+{
+	for (size_t Cluster = 0; Cluster < ClusterCount; Cluster++)
+		StartPrograms(Cluster);
+
+	FinishPrograms();
+	CountLoad();
+
+	if (OnUpdateEvent)
+		OnUpdateEvent(this);
+
+	CurrentTime++;
+}
+
+
+void CClusterBatch::StartPrograms(size_t Cluster)
+{
+	std::vector<TBatchCall>& Queue = WaitingCalls[Cluster];
+	size_t& Head = QueueHead[Cluster];
+
+	const uint32_t AllProcessors = ProcessorCount == 32 ? UINT32_MAX : (1u << ProcessorCount) - 1;
+
+	for (size_t i = 0; i < MaxProgramsStartPerTick[Cluster] && Head < Queue.size(); i++)
+	{
+		uint32_t FreeProcessors = CountBits(~OccupiedMask[Cluster] & AllProcessors);
+
+		size_t TopProgram = GetTopProgram(Cluster, FreeProcessors);
+		const TBatchCall Call = Queue[Head + TopProgram];
+
+		// Nothing changes until the next tick, so the following attempts would fail as well
+		if (FreeProcessors < Call.RequiredProcessors)
+			break;
+
+		// Lowest free processors first, as CCluster assigns them
+		uint32_t* EndTime = &ProcessorEndTime[Cluster * MaxProcessorCount];
+		uint32_t* TotalPrograms = &PerProcessorTotalPrograms[Cluster * MaxProcessorCount];
+		uint32_t EndTick = uint32_t(std::min<size_t>(CurrentTime + Call.ExecutionTime, UINT32_MAX));
+
+		uint32_t Assigned = 0;
+		size_t AssignedCount = 0;
+		for (unsigned Processor = 0; AssignedCount < Call.RequiredProcessors; Processor++)
+		{
+			if (OccupiedMask[Cluster] & (1u << Processor))
+				continue;
+
+			Assigned |= 1u << Processor;
+			EndTime[Processor] = EndTick;
+			TotalPrograms[Processor]++;
+			AssignedCount++;
+		}
+
+		uint32_t Lowest = Assigned & (~Assigned + 1);
+		unsigned LowestProcessor = CountBits(Lowest - 1);
+		ProgramTimeCalled[Cluster * MaxProcessorCount + LowestProcessor] = Call.TimeCalled;
+		ProgramJobClass[Cluster * MaxProcessorCount + LowestProcessor] = uint32_t(TClusterReportData::GetJobClass(Call.ExecutionTime));
+
+		OccupiedMask[Cluster] |= Assigned;
+		ProgramMask[Cluster] |= Lowest;
+		TotalProgramsRunning[Cluster]++;
+
+		for (size_t Position = TopProgram; Position > 0; Position--)
+			Queue[Head + Position] = Queue[Head + Position - 1];
+		Head++;
+	}
+
+	// Drops the popped calls once they take most of the queue
+	if (Head > 1024 && Head * 2 > Queue.size())
+	{
+		Queue.erase(Queue.begin(), Queue.begin() + Head);
+		Head = 0;
+	}
+}
+
+
+// Same score as CCluster::EvaluateWaitingCallScore, computed for the whole analysed part of the queue
+size_t CClusterBatch::GetTopProgram(size_t Cluster, uint32_t FreeProcessors)
+{
+	const TBatchCall* Calls = WaitingCalls[Cluster].data() + QueueHead[Cluster];
+	size_t Depth = QueueAnalysisDepth[Cluster];
+	size_t Count = std::min(Depth, GetWaitingCallCount(Cluster));
+
+	if (Scores.size() < Count)
+		Scores.resize(Count);
+
+	for (size_t Index = 0; Index < Count; Index++)
+	{
+		float Score = 0;
+		Score += (Depth - Index) * TDefaultScoreWeights::Position;
+		Score += (CurrentTime - Calls[Index].TimeCalled) * TDefaultScoreWeights::Waiting;
+		Score -= Calls[Index].ExecutionTime * TDefaultScoreWeights::ExecutionTime;
+		Score -= FreeProcessors < Calls[Index].RequiredProcessors ? Calls[Index].RequiredProcessors * TDefaultScoreWeights::Processors : 0;
+
+		Scores[Index] = Score;
+	}
+
+	size_t TopIndex = 0;
+	float MaxScore = LowestWaitingCallScore;
+
+	for (size_t Index = 0; Index < Count; Index++)
+	{
+		if (Scores[Index] > MaxScore)
+		{
+			TopIndex = Index;
+			MaxScore = Scores[Index];
+		}
+	}
+
+	return TopIndex;
+}
+
+
+void CClusterBatch::FinishPrograms()
+{
+	uint32_t Time = uint32_t(CurrentTime);
+
+	for (size_t Cluster = 0; Cluster < ClusterCount; Cluster++)
+	{
+		const uint32_t* EndTime = &ProcessorEndTime[Cluster * MaxProcessorCount];
+
+		uint32_t Due = 0;
+		for (unsigned Processor = 0; Processor < MaxProcessorCount; Processor++)
+			Due |= uint32_t(EndTime[Processor] <= Time) << Processor;
+
+		Due &= OccupiedMask[Cluster];
+
+		// Finished programs still count as running for this tick
+		AllTicksProgramsRunning[Cluster] += CountBits(ProgramMask[Cluster]);
+		uint32_t Finished = ProgramMask[Cluster] & Due;
+		TotalProgramsFinished[Cluster] += CountBits(Finished);
+
+		for (unsigned Processor = 0; Finished != 0; Processor++, Finished >>= 1)
+		{
+			if ((Finished & 1) == 0)
+				continue;
+
+			size_t JobClass = ProgramJobClass[Cluster * MaxProcessorCount + Processor];
+			PerJobClassProgramsFinished[Cluster][JobClass]++;
+			PerJobClassTotalResponseTime[Cluster][JobClass] += double(Time - ProgramTimeCalled[Cluster * MaxProcessorCount + Processor]);
+		}
+
+		ProgramMask[Cluster] &= ~Due;
+		OccupiedMask[Cluster] &= ~Due;
+	}
+}
+
+
+void CClusterBatch::CountLoad()
+{
+	for (size_t Cluster = 0; Cluster < ClusterCount; Cluster++)
+	{
+		uint32_t Occupied = OccupiedMask[Cluster];
+		uint32_t* Load = &AllTicksPerProcessorProgramsRunning[Cluster * MaxProcessorCount];
+
+		for (unsigned Processor = 0; Processor < MaxProcessorCount; Processor++)
+			Load[Processor] += (Occupied >> Processor) & 1;
+	}
+}
+
+
+void CClusterBatch::SetQueueAnalysisDepth(size_t Cluster, size_t InQueueAnalysisDepth)
+{
+	QueueAnalysisDepth.at(Cluster) = InQueueAnalysisDepth;
+}
+
+
+void CClusterBatch::SetMaxProgramsStartPerTick(size_t Cluster, size_t InMaxProgramsStartPerTick)
+{
+	MaxProgramsStartPerTick.at(Cluster) = InMaxProgramsStartPerTick;
+}
+
+
+size_t CClusterBatch::GetRunningProgramCount(size_t Cluster) const
+{
+	return CountBits(ProgramMask.at(Cluster));
+}
+
+
+TClusterReportData CClusterBatch::GetReportData(size_t Cluster) const
+{
+	TClusterReportData ReportData;
+
+	ReportData.Time = CurrentTime;
+	ReportData.TotalProgramCalls = TotalProgramCalls.at(Cluster);
+	ReportData.TotalProgramsRunning = TotalProgramsRunning[Cluster];
+	ReportData.TotalProgramsFinished = TotalProgramsFinished[Cluster];
+	ReportData.AllTicksProgramsRunning = AllTicksProgramsRunning[Cluster];
+	ReportData.AverageProgramsRunning = float(ReportData.AllTicksProgramsRunning) / CurrentTime;
+
+	for (unsigned i = 0; i < ProcessorCount; i++)
+	{
+		size_t Load = AllTicksPerProcessorProgramsRunning[Cluster * MaxProcessorCount + i];
+
+		ReportData.AllTicksPerProcessorProgramsRunning[i] = Load;
+		ReportData.PerProcessorTotalPrograms[i] = PerProcessorTotalPrograms[Cluster * MaxProcessorCount + i];
+		ReportData.PerProcessorAverageLoad[i] = float(Load) / CurrentTime;
+
+		// Batched processors are all of the reference speed
+		ReportData.PerSpeedClassAverageLoad[1.f] += ReportData.PerProcessorAverageLoad[i];
+	}
+
+	if (ProcessorCount != 0)
+		ReportData.PerSpeedClassAverageLoad[1.f] /= ProcessorCount;
+
+	ReportData.PerJobClassProgramsFinished = PerJobClassProgramsFinished[Cluster];
+	ReportData.PerJobClassTotalResponseTime = PerJobClassTotalResponseTime[Cluster];
+	for (auto& JobClass : ReportData.PerJobClassProgramsFinished)
+		ReportData.PerJobClassAverageResponseTime[JobClass.first] = float(ReportData.PerJobClassTotalResponseTime[JobClass.first] / JobClass.second);
+
+	return ReportData;
+}
+
+
+void CClusterBatch::CallProgramExecution(size_t Cluster, size_t RequiredProcessors, size_t ExecutionTime)
+{
+	if (Cluster >= ClusterCount)
+		throw(std::runtime_error("Calling a program on a cluster that is not in the batch!"));
+
+	if (RequiredProcessors > ProcessorCount)
+		throw(std::runtime_error("Calling a program with too many required processors!"));
+
+	if (RequiredProcessors == 0)
+		throw(std::runtime_error("Calling a program with zero required processors!"));
+
+	if (ExecutionTime == 0)
+		throw(std::runtime_error("Calling a program with or zero execution time!"));
+
+	if (ExecutionTime >= UINT32_MAX)
+		throw(std::runtime_error("Calling a program with too long execution time for a cluster batch!"));
+
+	TBatchCall Call;
+	Call.ExecutionTime = uint32_t(ExecutionTime);
+	Call.TimeCalled = uint32_t(CurrentTime);
+	Call.RequiredProcessors = uint32_t(RequiredProcessors);
+
+	WaitingCalls[Cluster].push_back(Call);
+	TotalProgramCalls[Cluster]++;
+}
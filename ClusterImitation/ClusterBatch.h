@@ -0,0 +1,97 @@
+#pragma once
+#include "Cluster.h"
+#include <cstdint>
+#include <map>
+#include <vector>
+
+class CClusterBatch;
+
+typedef void (*OnClusterBatchUpdateFunction)(CClusterBatch*);
+
+
+// Many small simulated clusters (up to 32 processors each) advanced one tick at a time in lockstep,
+// with the state of all of them kept in flat arrays. Each cluster behaves exactly like a CCluster
+// running only simulated programs with the same parameters and calls, and reports the same data.
+class CClusterBatch
+{
+public:
+	static const size_t MaxProcessorCount = 32;
+
+private:
+	struct TBatchCall
+	{
+		uint32_t ExecutionTime;
+		uint32_t TimeCalled;
+		uint32_t RequiredProcessors;
+	};
+
+	size_t ClusterCount;
+	size_t ProcessorCount;
+
+	size_t CurrentTime;
+	size_t MaxTime;
+
+	OnClusterBatchUpdateFunction OnUpdateEvent;
+
+	// Per cluster
+	std::vector<size_t> QueueAnalysisDepth;
+	std::vector<size_t> MaxProgramsStartPerTick;
+
+	// Bit per processor: occupied ones, and the lowest processor of every running program
+	std::vector<uint32_t> OccupiedMask;
+	std::vector<uint32_t> ProgramMask;
+
+	// Waiting calls of each cluster start at its QueueHead
+	std::vector<std::vector<TBatchCall>> WaitingCalls;
+	std::vector<size_t> QueueHead;
+
+	std::vector<uint64_t> TotalProgramCalls;
+	std::vector<uint64_t> TotalProgramsRunning;
+	std::vector<uint64_t> TotalProgramsFinished;
+	std::vector<uint64_t> AllTicksProgramsRunning;
+	std::vector<std::map<size_t, size_t>> PerJobClassProgramsFinished;
+	std::vector<std::map<size_t, double>> PerJobClassTotalResponseTime;
+
+	// Per processor, MaxProcessorCount entries per cluster
+	std::vector<uint32_t> ProcessorEndTime;
+	std::vector<uint32_t> AllTicksPerProcessorProgramsRunning;
+	std::vector<uint32_t> PerProcessorTotalPrograms;
+
+	// Set at the lowest processor of every running program
+	std::vector<uint32_t> ProgramTimeCalled;
+	std::vector<uint32_t> ProgramJobClass;
+
+	// Scores of the analysed part of the queue, reused between clusters
+	std::vector<float> Scores;
+
+	void Update();
+
+	void StartPrograms(size_t Cluster);
+	void FinishPrograms();
+	void CountLoad();
+
+	size_t GetTopProgram(size_t Cluster, uint32_t FreeProcessors);
+
+
+public:
+	CClusterBatch(size_t InMaxTime, size_t InClusterCount, size_t InProcessorCount, size_t InQueueAnalysisDepth = 5, size_t InMaxProgramsStartPerTick = 1);
+
+	void Start(OnClusterBatchUpdateFunction InUpdateEvent);
+
+	size_t GetCurrentTime() const { return CurrentTime; }
+	size_t GetClusterCount() const { return ClusterCount; }
+	size_t GetProcessorCount() const { return ProcessorCount; }
+
+	void SetQueueAnalysisDepth(size_t Cluster, size_t InQueueAnalysisDepth);
+	void SetMaxProgramsStartPerTick(size_t Cluster, size_t InMaxProgramsStartPerTick);
+
+	uint32_t GetOccupiedProcessors(size_t Cluster) const { return OccupiedMask.at(Cluster); }
+	size_t GetWaitingCallCount(size_t Cluster) const { return WaitingCalls.at(Cluster).size() - QueueHead[Cluster]; }
+	size_t GetRunningProgramCount(size_t Cluster) const;
+
+	TClusterReportData GetReportData(size_t Cluster) const;
+
+	// Queues a simulated program call on one of the clusters
+	void CallProgramExecution(size_t Cluster, size_t RequiredProcessors, size_t ExecutionTime);
+
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <memory>
+
+
+// Value shared between copies until one of them changes it
+
+template<class T>
+class TCopyOnWrite
+{
+	std::shared_ptr<T> Value;
+
+public:
+	TCopyOnWrite() : Value(std::make_shared<T>()) {}
+
+	const T& Get() const { return *Value; }
+	const T* operator->() const { return Value.get(); }
+
+	// Has to be called only when the value is actually changed, as it copies a shared value
+	T& Mutate()
+	{
+		if (Value.use_count() > 1)
+			Value = std::make_shared<T>(*Value);
+
+		return *Value;
+	}
+};
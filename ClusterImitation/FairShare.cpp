@@ -0,0 +1,79 @@
+#include "FairShare.h"
+#include <cmath>
+#include <stdexcept>
+
+
+CFairShare::CFairShare(size_t InHalfLife)
+{
+	HalfLife = InHalfLife;
+	Decay = InHalfLife == 0 ? 1 : pow(0.5, 1.0 / InHalfLife);
+
+	GetUserID("");
+}
+
+
+uint32_t CFairShare::GetUserID(const std::string& InUser)
+{
+	auto User = UserIDs.find(InUser);
+	if (User != UserIDs.end())
+		return User->second;
+
+	uint32_t UserID = uint32_t(UserNames.size());
+	UserIDs[InUser] = UserID;
+	UserNames.push_back(InUser);
+	Usages.push_back(TUserUsage());
+
+	return UserID;
+}
+
+
+uint32_t CFairShare::FindUserID(const std::string& InUser) const
+{
+	auto User = UserIDs.find(InUser);
+	if (User == UserIDs.end())
+		throw(std::runtime_error("Fair share has no such user!"));
+
+	return User->second;
+}
+
+
+CFairShare::TUserUsage CFairShare::Advance(const TUserUsage& InUsage, size_t InTime) const
+{
+	if (InTime <= InUsage.UpdateTime)
+		return InUsage;
+
+	TUserUsage Usage = InUsage;
+	size_t Ticks = InTime - InUsage.UpdateTime;
+
+	// Every tick decays the usage and adds the running processors: U * d^n + P * (1 + d + ... + d^(n-1))
+	if (Decay == 1)
+		Usage.Usage += double(Usage.RunningProcessors) * Ticks;
+
+	else
+	{
+		double Factor = pow(Decay, double(Ticks));
+		Usage.Usage = Usage.Usage * Factor + Usage.RunningProcessors * (1 - Factor) / (1 - Decay);
+	}
+
+	Usage.UpdateTime = InTime;
+	return Usage;
+}
+
+
+void CFairShare::Start(uint32_t InUserID, size_t InProcessors, size_t InTime)
+{
+	TUserUsage& Usage = Usages.at(InUserID);
+	Usage = Advance(Usage, InTime);
+	Usage.RunningProcessors += InProcessors;
+}
+
+
+void CFairShare::Finish(uint32_t InUserID, size_t InProcessors, size_t InTime)
+{
+	TUserUsage& Usage = Usages.at(InUserID);
+	if (Usage.RunningProcessors < InProcessors)
+		throw(std::runtime_error("Fair share user finishes more processors than they run!"));
+
+	Usage = Advance(Usage, InTime);
+	Usage.RunningProcessors -= InProcessors;
+}
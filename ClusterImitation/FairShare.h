@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// Processor ticks used by each user, decayed by half every HalfLife ticks (not decayed with a zero half-life).
+// A user's usage is only brought up to date when one of their programs starts or finishes, with the processors
+// they kept busy since then accounted in closed form, so every update and every query takes constant time.
+class CFairShare
+{
+public:
+	struct TUserUsage
+	{
+		// Decayed processor ticks at UpdateTime
+		double Usage = 0;
+		size_t RunningProcessors = 0;
+		size_t UpdateTime = 0;
+	};
+
+private:
+	size_t HalfLife;
+
+	// Per tick
+	double Decay;
+
+	// Users by ID, the empty user is 0
+	std::unordered_map<std::string, uint32_t> UserIDs;
+	std::vector<std::string> UserNames;
+	std::vector<TUserUsage> Usages;
+
+	TUserUsage Advance(const TUserUsage& InUsage, size_t InTime) const;
+
+public:
+	CFairShare(size_t InHalfLife = 0);
+
+	size_t GetHalfLife() const { return HalfLife; }
+
+	// Adds the user when they are not known yet
+	uint32_t GetUserID(const std::string& InUser);
+	uint32_t FindUserID(const std::string& InUser) const;
+
+	size_t GetUserCount() const { return UserNames.size(); }
+	const std::string& GetUserName(uint32_t InUserID) const { return UserNames.at(InUserID); }
+	const TUserUsage& GetUserState(uint32_t InUserID) const { return Usages.at(InUserID); }
+	void SetUserState(uint32_t InUserID, const TUserUsage& InUsage) { Usages.at(InUserID) = InUsage; }
+
+	// A program of the user takes or gives back InProcessors at the beginning of tick InTime
+	void Start(uint32_t InUserID, size_t InProcessors, size_t InTime);
+	void Finish(uint32_t InUserID, size_t InProcessors, size_t InTime);
+
+	// Decayed processor ticks of the user at the beginning of tick InTime
+	double GetUsage(uint32_t InUserID, size_t InTime) const { return Advance(Usages.at(InUserID), InTime).Usage; }
+};
@@ -0,0 +1,123 @@
+#include "GangMatrix.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+
+// Index of the only set bit, by a de Bruijn sequence (every 6 bit window of it is different)
+static unsigned GetBitIndex(uint64_t InBit)
+{
+	static const uint64_t DeBruijn = 0x03F79D71B4CB0A89;
+
+	static const std::vector<unsigned> Indices = []()
+	{
+		std::vector<unsigned> Table(64);
+		for (unsigned Bit = 0; Bit < 64; Bit++)
+			Table[((uint64_t(1) << Bit) * DeBruijn) >> 58] = Bit;
+
+		return Table;
+	}();
+
+	return Indices[(InBit * DeBruijn) >> 58];
+}
+
+
+void CGangMatrix::Reset(size_t InRowCount, size_t InColumnCount)
+{
+	RowCount = InRowCount;
+	ColumnCount = InColumnCount;
+	WordsPerRow = (InColumnCount + 63) / 64;
+
+	FreeCells.assign(RowCount * WordsPerRow, ~uint64_t(0));
+	FreeCounts.assign(RowCount, InColumnCount);
+
+	// Only the columns that exist are free
+	if (InColumnCount % 64 != 0)
+		for (size_t Row = 0; Row < RowCount; Row++)
+			FreeCells[Row * WordsPerRow + WordsPerRow - 1] = (uint64_t(1) << (InColumnCount % 64)) - 1;
+}
+
+
+size_t CGangMatrix::GetLargestFreeCount() const
+{
+	size_t Largest = 0;
+	for (size_t Count : FreeCounts)
+		Largest = std::max(Largest, Count);
+
+	return Largest;
+}
+
+
+size_t CGangMatrix::FindRow(size_t InCount, size_t InFirstRow) const
+{
+	for (size_t i = 0; i < RowCount; i++)
+	{
+		size_t Row = (InFirstRow + i) % RowCount;
+		if (FreeCounts[Row] >= InCount)
+			return Row;
+	}
+
+	return SIZE_MAX;
+}
+
+
+size_t CGangMatrix::FindNextBusyRow(size_t InRow) const
+{
+	for (size_t i = 1; i < RowCount; i++)
+	{
+		size_t Row = (InRow + i) % RowCount;
+		if (!IsRowEmpty(Row))
+			return Row;
+	}
+
+	return SIZE_MAX;
+}
+
+
+std::vector<unsigned> CGangMatrix::Allocate(size_t InRow, size_t InCount)
+{
+	std::vector<unsigned> Columns;
+	if (InRow >= RowCount || FreeCounts[InRow] < InCount)
+		return Columns;
+
+	Columns.reserve(InCount);
+
+	uint64_t* Words = FreeCells.data() + InRow * WordsPerRow;
+	for (size_t Word = 0; Columns.size() < InCount; Word++)
+	{
+		// Lowest set bits first, each one cleared as it is taken
+		while (Words[Word] != 0 && Columns.size() < InCount)
+		{
+			uint64_t Lowest = Words[Word] & (~Words[Word] + 1);
+
+			Columns.push_back(unsigned(Word * 64 + GetBitIndex(Lowest)));
+			Words[Word] &= ~Lowest;
+		}
+	}
+
+	FreeCounts[InRow] -= InCount;
+	return Columns;
+}
+
+
+void CGangMatrix::Mark(size_t InRow, const std::set<unsigned>& InColumns, bool InFree)
+{
+	if (InRow >= RowCount)
+		throw(std::runtime_error("Gang matrix row out of range!"));
+
+	for (unsigned Column : InColumns)
+	{
+		if (Column >= ColumnCount)
+			throw(std::runtime_error("Gang matrix column out of range!"));
+
+		if (IsFree(InRow, Column) == InFree)
+			throw(std::runtime_error(InFree ? "Releasing a free gang matrix cell!" : "Occupying a taken gang matrix cell!"));
+
+		FreeCells[InRow * WordsPerRow + Column / 64] ^= uint64_t(1) << (Column % 64);
+	}
+
+	if (InFree)
+		FreeCounts[InRow] += InColumns.size();
+	else
+		FreeCounts[InRow] -= InColumns.size();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+
+// Ousterhout matrix of gang scheduling: rows are time slices, columns are processors. A program takes its processors
+// in one row and runs only while that row is the active one. Free cells are kept as a row-major bit matrix,
+// so that a row is searched a 64 processor word at a time.
+class CGangMatrix
+{
+	size_t RowCount = 0;
+	size_t ColumnCount = 0;
+	size_t WordsPerRow = 0;
+
+	// Set bits are free cells, bits past ColumnCount are never set
+	std::vector<uint64_t> FreeCells;
+	std::vector<size_t> FreeCounts;
+
+	void Mark(size_t InRow, const std::set<unsigned>& InColumns, bool InFree);
+
+public:
+	void Reset(size_t InRowCount, size_t InColumnCount);
+	bool IsSet() const { return RowCount != 0; }
+
+	size_t GetRowCount() const { return RowCount; }
+	size_t GetColumnCount() const { return ColumnCount; }
+
+	size_t GetFreeCount(size_t InRow) const { return FreeCounts[InRow]; }
+	size_t GetLargestFreeCount() const;
+	bool IsRowEmpty(size_t InRow) const { return FreeCounts[InRow] == ColumnCount; }
+	bool IsFree(size_t InRow, unsigned InColumn) const { return (FreeCells[InRow * WordsPerRow + InColumn / 64] >> (InColumn % 64)) & 1; }
+
+	// First row from InFirstRow on (wrapping around) with InCount free cells, SIZE_MAX if there is none
+	size_t FindRow(size_t InCount, size_t InFirstRow = 0) const;
+
+	// Next row after InRow (wrapping around) with a program in it, SIZE_MAX if all the other rows are empty
+	size_t FindNextBusyRow(size_t InRow) const;
+
+	// Takes the lowest InCount free cells of the row, nothing if it does not have that many
+	std::vector<unsigned> Allocate(size_t InRow, size_t InCount);
+
+	// Cells taken or freed outside of Allocate (e.g. restored programs)
+	void Occupy(size_t InRow, const std::set<unsigned>& InColumns) { Mark(InRow, InColumns, false); }
+	void Release(size_t InRow, const std::set<unsigned>& InColumns) { Mark(InRow, InColumns, true); }
+};
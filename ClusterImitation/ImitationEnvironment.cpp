@@ -1,15 +1,19 @@
 #include "Cluster.h"
+#include "SubmissionServer.h"
+#include "WeightTuner.h"
 #include <random>
 #include <iostream>
 #include <ctime>
 #include <chrono>
 #include <thread>
 #include <iomanip>
+#include <csignal>
 
 using namespace std;
 
 
 float SimulationTactDuration = 0.2f;
+bool CatchUpAfterOverruns = false;
 
 size_t ProcessorCount = 32;
 size_t Time = 100;
@@ -21,11 +25,25 @@ float ProgramSpawnThreshold = 0.5;
 float ProgramRequiredProcessorsMultiplier = 1.f;
 float ProgramExecutionTimeMultiplier = 1.f;
 
+// Set by SIGINT / SIGTERM, the daemon stops at the end of the tick
+volatile std::sig_atomic_t DaemonStopRequested = 0;
+
 
 void OnClusterUpdated(CCluster* InCluster);
+void OnDaemonUpdated(CCluster* InCluster);
+int RunDaemon(const string& SocketPath);
+int RunTuning(const string& TracePath);
 
-int main()
+int main(int argc, char** argv)
 {
+	// Daemon mode: programs are only submitted through the socket, no random calls and no visualization
+	if (argc >= 3 && string(argv[1]) == "--listen")
+		return RunDaemon(argv[2]);
+
+	// Tuning mode: searches the score weights on random workloads of this environment or on an SWF trace
+	if (argc >= 2 && string(argv[1]) == "--tune")
+		return RunTuning(argc >= 3 ? argv[2] : "");
+
 	cout << "Do you want to customize settings ('y' - if yes): ";
 	string Input;
 	cin >> Input;
@@ -38,6 +56,9 @@ int main()
 		cin >> Time;
 		cout << "Simulation Tick Duration (seconds, positive float): ";
 		cin >> SimulationTactDuration;
+		cout << "Catch Up After Slow Ticks ('y' - if yes): ";
+		cin >> Input;
+		CatchUpAfterOverruns = Input == "y";
 		cout << "Processor Number (natural): ";
 		cin >> ProcessorCount;
 		cout << "Max New Program Starts Per Tick (natural): ";
@@ -57,6 +78,7 @@ int main()
 	}
 
 	CCluster Cluster(Time, ProcessorCount, QueueAnalyzisDepth, MaxNewProgramStartsPerTick);
+	Cluster.SetRealTimePacing(SimulationTactDuration, CatchUpAfterOverruns ? ECatchUpPolicy::CatchUp : ECatchUpPolicy::Skip);
 
 	srand(time(0));
 
@@ -74,13 +96,102 @@ int main()
 	return 0;
 }
 
+// Keeps a submission source registered for its own lifetime, so the cluster never keeps a destroyed one, even after a throw
+struct TScopedSubmissionSource
+{
+	CCluster& Cluster;
+	ISubmissionSource* Source;
+
+	TScopedSubmissionSource(CCluster& InCluster, ISubmissionSource* InSource) : Cluster(InCluster), Source(InSource) { Cluster.AddSubmissionSource(Source); }
+	~TScopedSubmissionSource() { Cluster.RemoveSubmissionSource(Source); }
+};
+
+void OnDaemonStopSignal(int)
+{
+	DaemonStopRequested = 1;
+}
+
+int RunDaemon(const string& SocketPath)
+{
+	// Runs until it is stopped, not for the simulation time of the interactive mode
+	CCluster Cluster(SIZE_MAX, ProcessorCount, QueueAnalyzisDepth, MaxNewProgramStartsPerTick);
+	Cluster.SetRealTimePacing(SimulationTactDuration);
+
+	std::signal(SIGINT, OnDaemonStopSignal);
+	std::signal(SIGTERM, OnDaemonStopSignal);
+
+	try
+	{
+		CSubmissionServer Server(SocketPath);
+		TScopedSubmissionSource Registration(Cluster, &Server);
+
+		cout << "Listening for program calls on " << SocketPath << endl;
+		Cluster.Start(OnDaemonUpdated);
+	}
+
+	catch (const std::exception& e)
+	{
+		std::cout << std::endl << "ERROR: " << e.what() << std::endl;
+	}
+
+	std::cout << std::endl << Cluster.GetReportData();
+	return 0;
+}
+
+void OnDaemonUpdated(CCluster* InCluster)
+{
+	if (DaemonStopRequested)
+		InCluster->Stop();
+}
+
+int RunTuning(const string& TracePath)
+{
+	TTuningSettings Settings;
+	Settings.ProcessorCount = ProcessorCount;
+	Settings.QueueAnalysisDepth = QueueAnalyzisDepth;
+	Settings.MaxProgramsStartPerTick = MaxNewProgramStartsPerTick;
+
+	try
+	{
+		std::vector<std::vector<TWorkloadJob>> Workloads;
+
+		if (!TracePath.empty())
+			Workloads.push_back(LoadSwfWorkload(TracePath, ProcessorCount));
+
+		else
+		{
+			TWorkloadParameters Parameters;
+			Parameters.Duration = Time;
+			Parameters.MaxNewProgramsPerTick = MaxNewProgramsPerTick;
+			Parameters.SpawnThreshold = ProgramSpawnThreshold;
+
+			for (uint32_t Seed = 1; Seed <= 27; Seed++)
+				Workloads.push_back(GenerateWorkload(Parameters, ProcessorCount, Seed));
+		}
+
+		for (ETuningMetric Metric : { ETuningMetric::MeanWait, ETuningMetric::P99Slowdown, ETuningMetric::Utilization })
+		{
+			Settings.Metric = Metric;
+			cout << CWeightTuner(Settings, Workloads).Tune() << endl;
+		}
+	}
+
+	catch (const std::exception& e)
+	{
+		std::cout << std::endl << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
 void VisualizeCurrentData(CCluster* InCluster)
 {
 	system("cls");
 
 	const TClusterReportData& ReportData = InCluster->GetReportData();
 	const std::vector<CProcessor>& ProcessorData = InCluster->GetProcessorData();
-	const TQueue<TProgramCall>& WaitingCalls = InCluster->GetWaitingProgramCalls();
+	const TPersistentQueue<TProgramCall>& WaitingCalls = InCluster->GetWaitingProgramCalls();
 	const std::map<std::string, TProgram> RunningPrograms = InCluster->GetRunningPrograms();
 	const std::vector<std::string>& FinishedPrograms = InCluster->GetThisTickFinishedPrograms();
 
@@ -135,7 +246,5 @@ void OnClusterUpdated(CCluster* InCluster)
 			InCluster->CallProgramExecution(ProgramCall);
 		}
 	}
-
-	std::this_thread::sleep_for(std::chrono::milliseconds(unsigned(SimulationTactDuration * 1000)));
 }
 
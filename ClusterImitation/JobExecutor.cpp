@@ -0,0 +1,141 @@
+#include "JobExecutor.h"
+#include <thread>
+#include <stdexcept>
+
+
+size_t CJobContext::GetSlotCount() const
+{
+	return Executor->GetSlotCount();
+}
+
+
+void CJobContext::Fork(JobTaskFunction InSubtask)
+{
+	if (!CurrentNode)
+		throw(std::runtime_error("Forking outside of a job task!"));
+
+	CurrentNode->PendingChildren++;
+	Executor->Deques[SlotIndex]->Push(new TJobTaskNode(std::move(InSubtask), CurrentNode));
+}
+
+
+void CJobContext::Sync()
+{
+	if (!CurrentNode)
+		return;
+
+	while (CurrentNode->PendingChildren.load() > 0)
+		if (!Executor->RunQueuedTask(*this))
+			std::this_thread::yield();
+}
+
+
+CJobExecutor::CJobExecutor(size_t InSlotCount) : Finished(false), Failed(false)
+{
+	if (InSlotCount == 0)
+		throw(std::runtime_error("Job executor needs at least one slot!"));
+
+	for (size_t i = 0; i < InSlotCount; i++)
+	{
+		Deques.push_back(std::make_unique<TWorkStealingDeque<TJobTaskNode*>>());
+		Contexts.push_back(CJobContext(this, i));
+	}
+}
+
+
+CJobExecutor::~CJobExecutor()
+{
+	// Only left over if the job was never launched
+	TJobTaskNode* Node;
+	for (auto& Deque : Deques)
+		while (Deque->Pop(Node))
+			delete Node;
+}
+
+
+void CJobExecutor::Execute(CJobContext& Context, TJobTaskNode* Node)
+{
+	TJobTaskNode* PreviousNode = Context.CurrentNode;
+	Context.CurrentNode = Node;
+
+	try
+	{
+		Node->Task(Context);
+	}
+
+	catch (...)
+	{
+		Failed = true;
+	}
+
+	Context.Sync();
+	Context.CurrentNode = PreviousNode;
+
+	if (Node->Parent)
+		Node->Parent->PendingChildren--;
+
+	delete Node;
+}
+
+
+bool CJobExecutor::RunQueuedTask(CJobContext& Context)
+{
+	TJobTaskNode* Node;
+
+	if (Deques[Context.SlotIndex]->Pop(Node))
+	{
+		Execute(Context, Node);
+		return true;
+	}
+
+	// Steal from the other slots, starting from the next one so the thieves spread over the victims
+	for (size_t i = 1; i < Deques.size(); i++)
+	{
+		if (Deques[(Context.SlotIndex + i) % Deques.size()]->Steal(Node))
+		{
+			Execute(Context, Node);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void CJobExecutor::HelperLoop(CJobContext& Context)
+{
+	while (!Finished.load())
+		if (!RunQueuedTask(Context))
+			std::this_thread::yield();
+}
+
+
+void CJobExecutor::Launch(CWorkerPool& Pool, const std::set<unsigned>& InSlots, JobTaskFunction InTask, std::function<void(bool)> OnFinished)
+{
+	std::shared_ptr<CJobExecutor> Executor = std::make_shared<CJobExecutor>(InSlots.size());
+
+	size_t SlotIndex = 0;
+	for (unsigned Slot : InSlots)
+	{
+		if (SlotIndex == 0)
+		{
+			TJobTaskNode* Root = new TJobTaskNode(std::move(InTask), nullptr);
+
+			Pool.Submit(Slot, [Executor, Root, OnFinished]()
+			{
+				// Returns only after the whole task tree is done, so the helpers have nothing left to run
+				Executor->Execute(Executor->Contexts[0], Root);
+				Executor->Finished = true;
+
+				OnFinished(!Executor->Failed);
+			});
+		}
+
+		else
+		{
+			Pool.Submit(Slot, [Executor, SlotIndex]() { Executor->HelperLoop(Executor->Contexts[SlotIndex]); });
+		}
+
+		SlotIndex++;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "WorkStealingDeque.h"
+#include "WorkerPool.h"
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <set>
+
+class CJobContext;
+class CJobExecutor;
+
+typedef std::function<void(CJobContext&)> JobTaskFunction;
+
+
+struct TJobTaskNode
+{
+	JobTaskFunction Task;
+
+	// The task that forked this one, it can not finish before all of its children did
+	TJobTaskNode* Parent;
+	std::atomic<size_t> PendingChildren;
+
+	TJobTaskNode(JobTaskFunction InTask, TJobTaskNode* InParent) : Task(std::move(InTask)), Parent(InParent), PendingChildren(0) {}
+};
+
+
+// Handle given to the tasks of a real program, one per processor slot of the program
+
+class CJobContext
+{
+	friend class CJobExecutor;
+
+	CJobExecutor* Executor;
+	size_t SlotIndex;
+	TJobTaskNode* CurrentNode;
+
+public:
+	CJobContext(CJobExecutor* InExecutor, size_t InSlotIndex) : Executor(InExecutor), SlotIndex(InSlotIndex), CurrentNode(nullptr) {}
+
+	// Number of processors reserved by the program and the index of the one running the current task
+	size_t GetSlotCount() const;
+	size_t GetSlotIndex() const { return SlotIndex; }
+
+	// Queues a subtask, idle slots of the same program can steal it
+	void Fork(JobTaskFunction InSubtask);
+
+	// Waits for all subtasks forked by the current task, executing queued tasks meanwhile.
+	// Is also done implicitly when a task returns.
+	void Sync();
+};
+
+
+// Work-stealing executor of one real program
+// Every processor slot reserved by the program gets a Chase-Lev deque: a slot pushes and pops its own forks
+// and, when it runs out of work, steals from the other slots of the same program (and only of that program).
+
+class CJobExecutor
+{
+	std::vector<std::unique_ptr<TWorkStealingDeque<TJobTaskNode*>>> Deques;
+	std::vector<CJobContext> Contexts;
+
+	std::atomic<bool> Finished;
+	std::atomic<bool> Failed;
+
+	void Execute(CJobContext& Context, TJobTaskNode* Node);
+	bool RunQueuedTask(CJobContext& Context);
+	void HelperLoop(CJobContext& Context);
+
+	friend class CJobContext;
+
+public:
+	CJobExecutor(size_t InSlotCount);
+	~CJobExecutor();
+
+	CJobExecutor(const CJobExecutor&) = delete;
+	CJobExecutor& operator=(const CJobExecutor&) = delete;
+
+	size_t GetSlotCount() const { return Deques.size(); }
+
+	// Runs InTask on the worker of the first slot, the workers of the other slots help with its subtasks.
+	// OnFinished is called (with false if any task has thrown) once the task and all of its subtasks are done.
+	static void Launch(CWorkerPool& Pool, const std::set<unsigned>& InSlots, JobTaskFunction InTask, std::function<void(bool)> OnFinished);
+};
@@ -0,0 +1,410 @@
+#include "Journal.h"
+#include <stdexcept>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+const uint64_t JournalMagic = 0x4C4E52554F4A4C43ULL;
+const size_t JournalHeaderSize = sizeof(uint64_t) + sizeof(uint32_t);
+
+
+// Size of the journal image of a name
+size_t GetJournalNameSize(const std::string& Name)
+{
+	if (Name.size() > UINT16_MAX)
+		throw(std::runtime_error("Program or user name is too long for the journal!"));
+
+	return sizeof(uint16_t) + Name.size();
+}
+
+
+// Writes one record into space grown for it at once, the buffer keeps its capacity between ticks
+class CJournalRecordWriter
+{
+	uint8_t* Cursor;
+
+public:
+	CJournalRecordWriter(std::vector<uint8_t>& Buffer, size_t RecordSize)
+	{
+		size_t Offset = Buffer.size();
+		Buffer.resize(Offset + RecordSize);
+		Cursor = Buffer.data() + Offset;
+	}
+
+	template<class T>
+	void Write(T Value)
+	{
+		memcpy(Cursor, &Value, sizeof(T));
+		Cursor += sizeof(T);
+	}
+
+	void WriteName(const std::string& Name)
+	{
+		Write<uint16_t>(uint16_t(Name.size()));
+		memcpy(Cursor, Name.data(), Name.size());
+		Cursor += Name.size();
+	}
+};
+
+const size_t JournalCallRecordSize = 1 + 8 * 6 + 4 * ResourceKindCount + 8 + 4 + 8 * 3;
+const size_t JournalStartRecordSize = 1 + 8 * 2 + 4;
+const size_t JournalNameRecordSize = 1 + 8;
+
+
+// Reads values from a journal image, fails instead of reading past its end (a torn record)
+class CJournalReader
+{
+	const std::vector<uint8_t>& Data;
+	size_t Offset;
+
+public:
+	CJournalReader(const std::vector<uint8_t>& InData) : Data(InData), Offset(0) {}
+
+	size_t GetOffset() const { return Offset; }
+	bool AtEnd() const { return Offset >= Data.size(); }
+
+	template<class T>
+	bool Read(T& OutValue)
+	{
+		if (Data.size() - Offset < sizeof(T))
+			return false;
+
+		memcpy(&OutValue, Data.data() + Offset, sizeof(T));
+		Offset += sizeof(T);
+		return true;
+	}
+
+	bool ReadName(std::string& OutName)
+	{
+		uint16_t Length;
+		if (!Read(Length) || Data.size() - Offset < Length)
+			return false;
+
+		OutName.assign(reinterpret_cast<const char*>(Data.data() + Offset), Length);
+		Offset += Length;
+		return true;
+	}
+};
+
+
+CJournal::CJournal(const std::string& InPath, std::vector<TJournalRecord>& OutCommittedRecords)
+{
+	Path = InPath;
+	CommitCount = 0;
+	SyncCount = 0;
+	PendingTicks = 0;
+	FlushRequests = 0;
+	Stopping = false;
+	WriteFailed = false;
+
+	bool Created = !ReadCommittedRecords(OutCommittedRecords);
+
+	File = std::fopen(Path.c_str(), "ab");
+	if (!File)
+		throw(std::runtime_error("Failed to open cluster journal!"));
+
+	if (Created)
+	{
+		std::vector<uint8_t> Header;
+		CJournalRecordWriter HeaderWriter(Header, JournalHeaderSize);
+		HeaderWriter.Write<uint64_t>(JournalMagic);
+		HeaderWriter.Write<uint32_t>(JournalVersion);
+
+		bool Written = std::fwrite(Header.data(), 1, Header.size(), File) == Header.size() && std::fflush(File) == 0;
+
+#ifdef _WIN32
+		Written = Written && _commit(_fileno(File)) == 0;
+#else
+		Written = Written && fsync(fileno(File)) == 0;
+#endif
+
+		if (!Written)
+		{
+			std::fclose(File);
+			throw(std::runtime_error("Failed to write cluster journal header!"));
+		}
+	}
+
+	Writer = std::thread(&CJournal::WriterLoop, this);
+}
+
+
+CJournal::~CJournal()
+{
+	{
+		std::lock_guard<std::mutex> Lock(WriterMutex);
+		Stopping = true;
+		WriterWakeUp.notify_one();
+	}
+
+	Writer.join();
+	std::fclose(File);
+}
+
+
+bool CJournal::ReadCommittedRecords(std::vector<TJournalRecord>& OutRecords)
+{
+	std::FILE* ExistingFile = std::fopen(Path.c_str(), "rb");
+	if (!ExistingFile)
+		return false;
+
+	std::vector<uint8_t> Data;
+	uint8_t Chunk[65536];
+	size_t ReadSize;
+	while ((ReadSize = std::fread(Chunk, 1, sizeof(Chunk), ExistingFile)) > 0)
+		Data.insert(Data.end(), Chunk, Chunk + ReadSize);
+	std::fclose(ExistingFile);
+
+	// An empty file is what a crash right after creating the journal leaves, anything else has to be a journal of this version
+	if (Data.empty())
+		return false;
+
+	CJournalReader Reader(Data);
+	uint64_t Magic = 0;
+	uint32_t Version = 0;
+
+	if (!Reader.Read(Magic) || Magic != JournalMagic)
+		throw(std::runtime_error("File is not a cluster journal!"));
+
+	if (!Reader.Read(Version) || Version != JournalVersion)
+		throw(std::runtime_error("Cluster journal was written by another version!"));
+
+	std::vector<TJournalRecord> TickRecords;
+	size_t CommittedSize = Reader.GetOffset();
+
+	while (!Reader.AtEnd())
+	{
+		TJournalRecord Record;
+		uint8_t Type = 0;
+		uint64_t Time = 0;
+
+		if (!Reader.Read(Type) || !Reader.Read(Time))
+			break;
+
+		Record.Type = EJournalRecord(Type);
+		Record.Time = size_t(Time);
+
+		bool Complete = false;
+
+		if (Record.Type == EJournalRecord::Call)
+		{
+			uint64_t JobID = 0, RequiredProcessors = 0, ExecutionTime = 0, ActualExecutionTime = 0, PredictedExecutionTime = 0;
+			uint64_t DominantProcessors = 0, Deadline = 0, ArrayCount = 0, ArrayIndex = 0;
+			int32_t Priority = 0;
+			Complete = Reader.Read(JobID) && Reader.Read(RequiredProcessors) && Reader.Read(ExecutionTime) && Reader.Read(ActualExecutionTime)
+				&& Reader.Read(PredictedExecutionTime);
+
+			for (size_t Kind = 0; Complete && Kind < ResourceKindCount; Kind++)
+				Complete = Reader.Read(Record.Call.Resources.Amounts[Kind]);
+
+			Complete = Complete && Reader.Read(DominantProcessors) && Reader.Read(Priority) && Reader.Read(Deadline) && Reader.Read(ArrayCount)
+				&& Reader.Read(ArrayIndex) && Reader.ReadName(Record.Call.Name) && Reader.ReadName(Record.Call.User);
+
+			Record.Call.JobID = size_t(JobID);
+			Record.Call.RequiredProcessors = size_t(RequiredProcessors);
+			Record.Call.ExecutionTime = size_t(ExecutionTime);
+			Record.Call.ActualExecutionTime = size_t(ActualExecutionTime);
+			Record.Call.PredictedExecutionTime = size_t(PredictedExecutionTime);
+			Record.Call.DominantProcessors = size_t(DominantProcessors);
+			Record.Call.Priority = Priority;
+			Record.Call.Deadline = size_t(Deadline);
+			Record.Call.ArrayCount = size_t(ArrayCount);
+			Record.Call.ArrayIndex = size_t(ArrayIndex);
+			Record.Call.TimeCalled = Record.Time;
+		}
+
+		else if (Record.Type == EJournalRecord::Start)
+		{
+			uint64_t JobID = 0;
+			uint32_t ProcessorCount = 0;
+			Complete = Reader.Read(JobID) && Reader.ReadName(Record.Call.Name) && Reader.Read(ProcessorCount);
+
+			Record.Call.JobID = size_t(JobID);
+
+			for (uint32_t i = 0; Complete && i < ProcessorCount; i++)
+			{
+				uint32_t Processor = 0;
+				Complete = Reader.Read(Processor);
+				Record.Processors.push_back(Processor);
+			}
+		}
+
+		else if (Record.Type == EJournalRecord::Finish || Record.Type == EJournalRecord::Preempt)
+			Complete = Reader.ReadName(Record.Call.Name);
+
+		else if (Record.Type == EJournalRecord::Tick)
+			Complete = true;
+
+		if (!Complete)
+			break;
+
+		TickRecords.push_back(std::move(Record));
+
+		if (TickRecords.back().Type == EJournalRecord::Tick)
+		{
+			OutRecords.insert(OutRecords.end(), TickRecords.begin(), TickRecords.end());
+			TickRecords.clear();
+
+			CommittedSize = Reader.GetOffset();
+		}
+	}
+
+	// New records have to follow the last committed tick, not the torn tail
+	if (CommittedSize != Data.size())
+		std::filesystem::resize_file(Path, CommittedSize);
+
+	return true;
+}
+
+
+void CJournal::LogCall(const TProgramCall& InProgramCall)
+{
+	CJournalRecordWriter Writer(Buffer, JournalCallRecordSize + GetJournalNameSize(InProgramCall.Name) + GetJournalNameSize(InProgramCall.User));
+
+	Writer.Write<uint8_t>(uint8_t(EJournalRecord::Call));
+	Writer.Write<uint64_t>(InProgramCall.TimeCalled);
+	Writer.Write<uint64_t>(InProgramCall.JobID);
+	Writer.Write<uint64_t>(InProgramCall.RequiredProcessors);
+	Writer.Write<uint64_t>(InProgramCall.ExecutionTime);
+	Writer.Write<uint64_t>(InProgramCall.ActualExecutionTime);
+	Writer.Write<uint64_t>(InProgramCall.PredictedExecutionTime);
+
+	for (uint32_t Amount : InProgramCall.Resources.Amounts)
+		Writer.Write<uint32_t>(Amount);
+	Writer.Write<uint64_t>(InProgramCall.DominantProcessors);
+	Writer.Write<int32_t>(InProgramCall.Priority);
+	Writer.Write<uint64_t>(InProgramCall.Deadline);
+	Writer.Write<uint64_t>(InProgramCall.ArrayCount);
+	Writer.Write<uint64_t>(InProgramCall.ArrayIndex);
+	Writer.WriteName(InProgramCall.Name);
+	Writer.WriteName(InProgramCall.User);
+}
+
+
+void CJournal::LogStart(const TProgram& InProgram)
+{
+	CJournalRecordWriter Writer(Buffer, JournalStartRecordSize + GetJournalNameSize(InProgram.Name) + 4 * InProgram.OccupiedProcessors.size());
+
+	Writer.Write<uint8_t>(uint8_t(EJournalRecord::Start));
+	Writer.Write<uint64_t>(InProgram.ExecutionStartTime);
+	Writer.Write<uint64_t>(InProgram.JobID);
+	Writer.WriteName(InProgram.Name);
+
+	Writer.Write<uint32_t>(uint32_t(InProgram.OccupiedProcessors.size()));
+	for (unsigned Processor : InProgram.OccupiedProcessors)
+		Writer.Write<uint32_t>(Processor);
+}
+
+
+void CJournal::LogFinish(const std::string& InProgramName, size_t Time)
+{
+	CJournalRecordWriter Writer(Buffer, JournalNameRecordSize + GetJournalNameSize(InProgramName));
+
+	Writer.Write<uint8_t>(uint8_t(EJournalRecord::Finish));
+	Writer.Write<uint64_t>(Time);
+	Writer.WriteName(InProgramName);
+}
+
+
+void CJournal::LogPreempt(const std::string& InProgramName, size_t Time)
+{
+	CJournalRecordWriter Writer(Buffer, JournalNameRecordSize + GetJournalNameSize(InProgramName));
+
+	Writer.Write<uint8_t>(uint8_t(EJournalRecord::Preempt));
+	Writer.Write<uint64_t>(Time);
+	Writer.WriteName(InProgramName);
+}
+
+
+void CJournal::Commit(size_t Time)
+{
+	CJournalRecordWriter Writer(Buffer, JournalNameRecordSize);
+	Writer.Write<uint8_t>(uint8_t(EJournalRecord::Tick));
+	Writer.Write<uint64_t>(Time);
+
+	std::lock_guard<std::mutex> Lock(WriterMutex);
+
+	if (WriteFailed)
+		throw(std::runtime_error("Failed to write cluster journal!"));
+
+	if (PendingBuffer.empty())
+		PendingBuffer.swap(Buffer);
+	else
+		PendingBuffer.insert(PendingBuffer.end(), Buffer.begin(), Buffer.end());
+
+	Buffer.clear();
+
+	// The writer is only woken for the first tick of a group and when the group is full, it waits out the window by itself
+	if (PendingTicks++ == 0)
+		GroupStartTime = std::chrono::steady_clock::now();
+
+	if (PendingTicks == 1 || PendingBuffer.size() >= GroupCommitSize)
+		WriterWakeUp.notify_one();
+}
+
+
+void CJournal::Flush()
+{
+	std::unique_lock<std::mutex> Lock(WriterMutex);
+
+	FlushRequests++;
+	WriterWakeUp.notify_one();
+
+	WriteFinished.wait(Lock, [&]() { return PendingTicks == 0 || WriteFailed; });
+	FlushRequests--;
+
+	if (WriteFailed)
+		throw(std::runtime_error("Failed to write cluster journal!"));
+}
+
+
+void CJournal::WriterLoop()
+{
+	std::vector<uint8_t> WriteBuffer;
+
+	while (true)
+	{
+		size_t Ticks;
+
+		{
+			std::unique_lock<std::mutex> Lock(WriterMutex);
+			WriterWakeUp.wait(Lock, [&]() { return Stopping || PendingTicks > 0; });
+
+			// Whatever was committed before stopping is still written
+			if (PendingTicks == 0)
+				return;
+
+			// Ticks committed within the window are written together
+			WriterWakeUp.wait_until(Lock, GroupStartTime + GroupCommitWindow,
+				[&]() { return Stopping || FlushRequests > 0 || PendingBuffer.size() >= GroupCommitSize; });
+
+			WriteBuffer.swap(PendingBuffer);
+			Ticks = PendingTicks;
+		}
+
+		bool Written = std::fwrite(WriteBuffer.data(), 1, WriteBuffer.size(), File) == WriteBuffer.size() && std::fflush(File) == 0;
+
+#ifdef _WIN32
+		Written = Written && _commit(_fileno(File)) == 0;
+#else
+		Written = Written && fsync(fileno(File)) == 0;
+#endif
+
+		WriteBuffer.clear();
+		SyncCount++;
+
+		if (Written)
+			CommitCount += Ticks;
+
+		std::lock_guard<std::mutex> Lock(WriterMutex);
+		PendingTicks -= Ticks;
+		WriteFailed = WriteFailed || !Written;
+		WriteFinished.notify_all();
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "Cluster.h"
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+
+// Write-ahead journal of the cluster: program calls and the scheduler's start / finish / preemption decisions.
+//
+// Records of a tick are collected in memory and closed with a tick record when the tick ends. Closed ticks are
+// handed to a writer thread, which writes them with one fsync per group (group commit): a group is the ticks
+// closed within GroupCommitWindow of its first one, or GroupCommitSize bytes of them, whichever comes first.
+// So the cluster never waits for the disk and is not switched to the writer every tick, and a tick is durable
+// at most the window (plus the fsync) after it ends, or as soon as Flush is called.
+// On opening, the committed records of an existing journal are read back for replay, and anything after the
+// last tick record (a torn write) is cut off. A file without the journal header, or with another version of it,
+// is never replayed or cut: opening it throws.
+//
+// File header, written when the journal is created: [u64 Magic = "CLJOURNL"][u32 Version = JournalVersion]
+//
+// Versions (every change of a record layout bumps it):
+//   1 - Call records with the execution time only
+//   2 - actual and predicted execution times in Call records
+//   3 - resource demands and dominant processors in Call records
+//   4 - priority in Call records, Preempt records
+//   5 - user in Call records
+//   6 - deadline in Call records
+//   7 - job array count and index in Call records
+//
+// Record layout (host byte order):
+//   Call:    [u8 Type = 1][u64 Time][u64 JobID][u64 RequiredProcessors][u64 ExecutionTime][u64 ActualExecutionTime]
+//            [u64 PredictedExecutionTime][u32 Memory][u32 Accelerators][u32 Licenses][u64 DominantProcessors][i32 Priority][u64 Deadline]
+//            [u64 ArrayCount][u64 ArrayIndex][u16 NameLength][Name][u16 UserLength][User]
+//   Start:   [u8 Type = 2][u64 Time][u64 JobID][u16 NameLength][Name][u32 ProcessorCount][u32 ProcessorID]...
+//   Finish:  [u8 Type = 3][u64 Time][u16 NameLength][Name]
+//   Tick:    [u8 Type = 4][u64 Time]
+//   Preempt: [u8 Type = 5][u64 Time][u16 NameLength][Name], followed by the Call record that queues the program again
+
+const uint32_t JournalVersion = 7;
+
+enum class EJournalRecord : uint8_t
+{
+	Call = 1,
+	Start = 2,
+	Finish = 3,
+	Tick = 4,
+	Preempt = 5
+};
+
+
+struct TJournalRecord
+{
+	EJournalRecord Type;
+	size_t Time;
+
+	// Full call for Call records, only the name (and the job ID for Start) otherwise
+	TProgramCall Call;
+
+	// Assigned processors for Start records
+	std::vector<unsigned> Processors;
+};
+
+
+class CJournal
+{
+	std::string Path;
+	std::FILE* File;
+
+	// Records of the current tick, only used by the cluster thread
+	std::vector<uint8_t> Buffer;
+
+	// Closed ticks waiting for the writer
+	std::mutex WriterMutex;
+	std::condition_variable WriterWakeUp;
+	std::condition_variable WriteFinished;
+	std::vector<uint8_t> PendingBuffer;
+	size_t PendingTicks;
+	std::chrono::steady_clock::time_point GroupStartTime;
+	size_t FlushRequests;
+	bool Stopping;
+	bool WriteFailed;
+
+	std::atomic<size_t> CommitCount;
+	std::atomic<size_t> SyncCount;
+
+	std::thread Writer;
+
+	// Returns false if there is no journal yet (no file or an empty one)
+	bool ReadCommittedRecords(std::vector<TJournalRecord>& OutRecords);
+	void WriterLoop();
+
+public:
+	static constexpr std::chrono::milliseconds GroupCommitWindow = std::chrono::milliseconds(5);
+	static constexpr size_t GroupCommitSize = 1 << 20;
+
+	CJournal(const std::string& InPath, std::vector<TJournalRecord>& OutCommittedRecords);
+	~CJournal();
+
+	CJournal(const CJournal&) = delete;
+	CJournal& operator=(const CJournal&) = delete;
+
+	// Ticks that are durable on disk, and the number of fsyncs it took
+	size_t GetCommitCount() const { return CommitCount; }
+	size_t GetSyncCount() const { return SyncCount; }
+
+	void LogCall(const TProgramCall& InProgramCall);
+	void LogStart(const TProgram& InProgram);
+	void LogFinish(const std::string& InProgramName, size_t Time);
+	void LogPreempt(const std::string& InProgramName, size_t Time);
+
+	// Closes the records of the tick and hands them to the writer
+	void Commit(size_t Time);
+
+	// Waits until every committed tick is durable on disk
+	void Flush();
+};
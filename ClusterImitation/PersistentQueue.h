@@ -0,0 +1,189 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
+
+// Queue with the TQueue interface whose copies share their nodes, so copying is O(1).
+// Kept as a front list and a reversed back list (|Back| <= |Front|), changing a queue copies only
+// the nodes on the changed path that are shared with other copies, nodes owned by one queue are relinked in place.
+
+template<class T>
+class TPersistentQueue
+{
+	struct TNode
+	{
+		T Data;
+		std::shared_ptr<TNode> pNext;
+
+		TNode(const T& InData, std::shared_ptr<TNode> InNext) : Data(InData), pNext(std::move(InNext)) {}
+
+		// Releases the owned tail iteratively, so that long lists do not overflow the stack
+		~TNode()
+		{
+			std::shared_ptr<TNode> Next = std::move(pNext);
+			while (Next && Next.use_count() == 1)
+				Next = std::move(Next->pNext);
+		}
+	};
+
+	std::shared_ptr<TNode> Front;
+	std::shared_ptr<TNode> Back;
+
+	size_t FrontLen;
+	size_t BackLen;
+
+	static const TNode* GetNode(const std::shared_ptr<TNode>& List, size_t Pos)
+	{
+		const TNode* Node = List.get();
+		for (size_t i = 0; i < Pos; i++)
+			Node = Node->pNext.get();
+
+		return Node;
+	}
+
+	// Makes List its first Count nodes followed by Tail
+	static void Relink(std::shared_ptr<TNode>& List, size_t Count, std::shared_ptr<TNode> Tail)
+	{
+		// The prefix owned by this queue only is relinked in place
+		std::shared_ptr<TNode>* Link = &List;
+		size_t i = 0;
+		while (i < Count && Link->use_count() == 1)
+		{
+			Link = &(*Link)->pNext;
+			i++;
+		}
+
+		// The rest of it is shared with other queues and has to be copied
+		std::vector<const TNode*> SharedPrefix;
+		for (const TNode* Node = Link->get(); i < Count; i++, Node = Node->pNext.get())
+			SharedPrefix.push_back(Node);
+
+		for (auto Node = SharedPrefix.rbegin(); Node != SharedPrefix.rend(); Node++)
+			Tail = std::make_shared<TNode>((*Node)->Data, std::move(Tail));
+
+		*Link = std::move(Tail);
+	}
+
+	// Moves the back list to the end of the front list once it gets longer
+	void Rebalance()
+	{
+		if (BackLen <= FrontLen)
+			return;
+
+		std::shared_ptr<TNode> Reversed;
+		bool Shared = false;
+
+		while (Back)
+		{
+			Shared = Shared || Back.use_count() > 1;
+
+			if (Shared)
+			{
+				Reversed = std::make_shared<TNode>(Back->Data, std::move(Reversed));
+				Back = Back->pNext;
+			}
+			else
+			{
+				std::shared_ptr<TNode> Next = std::move(Back->pNext);
+				Back->pNext = std::move(Reversed);
+				Reversed = std::move(Back);
+				Back = std::move(Next);
+			}
+		}
+
+		Relink(Front, FrontLen, std::move(Reversed));
+
+		FrontLen += BackLen;
+		BackLen = 0;
+	}
+
+public:
+
+	// Construction / Destruction
+	TPersistentQueue() : FrontLen(0), BackLen(0) {}
+
+	// Utility
+	bool empty() const { return FrontLen == 0; }
+	size_t size() const { return FrontLen + BackLen; }
+
+	// Methods
+	// Puts a new element to the end of the queue
+	void Put(const T& InData)
+	{
+		Back = std::make_shared<TNode>(InData, std::move(Back));
+		BackLen++;
+
+		Rebalance();
+	}
+
+	// Returns the value of the queue element at position Pos (starting from the head of the queue)
+	const T& Check(size_t Pos = 0) const
+	{
+		if (size() <= Pos)
+			throw(std::runtime_error("Queue check index out of range!"));
+
+		if (Pos < FrontLen)
+			return GetNode(Front, Pos)->Data;
+
+		return GetNode(Back, BackLen - 1 - (Pos - FrontLen))->Data;
+	}
+
+	// Calls InVisit for every element from the head of the queue, O(size) in total (Check is O(Pos) for each element)
+	template<class TVisit>
+	void ForEach(TVisit InVisit) const
+	{
+		const TNode* Node = Front.get();
+		for (size_t i = 0; i < FrontLen; i++, Node = Node->pNext.get())
+			InVisit(Node->Data);
+
+		// The back list is reversed
+		std::vector<const TNode*> BackNodes;
+		BackNodes.reserve(BackLen);
+		for (Node = Back.get(); Node; Node = Node->pNext.get())
+			BackNodes.push_back(Node);
+
+		for (auto BackNode = BackNodes.rbegin(); BackNode != BackNodes.rend(); BackNode++)
+			InVisit((*BackNode)->Data);
+	}
+
+	// Replaces the value of the queue element at position Pos, the element keeps its place
+	void Replace(size_t Pos, const T& InData)
+	{
+		if (size() <= Pos)
+			throw(std::runtime_error("Queue replace index out of range!"));
+
+		if (Pos < FrontLen)
+			Relink(Front, Pos, std::make_shared<TNode>(InData, GetNode(Front, Pos)->pNext));
+		else
+		{
+			size_t BackPos = BackLen - 1 - (Pos - FrontLen);
+			Relink(Back, BackPos, std::make_shared<TNode>(InData, GetNode(Back, BackPos)->pNext));
+		}
+	}
+
+	// Deletes an element of the queue at position Pos (starting from the head of the queue)
+	void Pop(size_t Pos = 0)
+	{
+		if (empty())
+			throw(std::runtime_error("Popping empty queue"));
+
+		if (size() <= Pos)
+			throw(std::runtime_error("Queue pop index out of range!"));
+
+		if (Pos < FrontLen)
+		{
+			Relink(Front, Pos, GetNode(Front, Pos)->pNext);
+			FrontLen--;
+		}
+		else
+		{
+			size_t BackPos = BackLen - 1 - (Pos - FrontLen);
+			Relink(Back, BackPos, GetNode(Back, BackPos)->pNext);
+			BackLen--;
+		}
+
+		Rebalance();
+	}
+
+};
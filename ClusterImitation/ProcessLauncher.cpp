@@ -0,0 +1,131 @@
+#include "ProcessLauncher.h"
+#include <stdexcept>
+
+#ifdef __linux__
+
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+
+CProcessLauncher::CProcessLauncher()
+{
+	EpollFD = epoll_create1(EPOLL_CLOEXEC);
+	if (EpollFD < 0)
+		throw(std::runtime_error("Failed to create epoll instance for process launcher!"));
+
+	cpu_set_t CPUSet;
+	if (sched_getaffinity(0, sizeof(CPUSet), &CPUSet) == 0)
+		for (int CPU = 0; CPU < CPU_SETSIZE; CPU++)
+			if (CPU_ISSET(CPU, &CPUSet))
+				AvailableCPUs.push_back(CPU);
+
+	if (AvailableCPUs.empty())
+		AvailableCPUs.push_back(0);
+}
+
+
+CProcessLauncher::~CProcessLauncher()
+{
+	// Processes still running when the cluster is destroyed are killed, so that none is left unreaped
+	for (auto& Process : Processes)
+	{
+		kill(Process.second.ProcessID, SIGKILL);
+		waitpid(Process.second.ProcessID, nullptr, 0);
+		close(Process.first);
+	}
+
+	close(EpollFD);
+}
+
+
+void CProcessLauncher::Launch(const std::string& InProgramName, const std::vector<std::string>& InCommand, const std::set<unsigned>& InProcessors)
+{
+	if (InCommand.empty())
+		throw(std::runtime_error("Launching a process with an empty command!"));
+
+	// Everything the child needs is prepared before fork, since only async-signal-safe calls are allowed after it
+	std::vector<char*> Arguments;
+	for (auto& Argument : InCommand)
+		Arguments.push_back(const_cast<char*>(Argument.c_str()));
+	Arguments.push_back(nullptr);
+
+	cpu_set_t CPUSet;
+	CPU_ZERO(&CPUSet);
+	for (unsigned Processor : InProcessors)
+		CPU_SET(AvailableCPUs[Processor % AvailableCPUs.size()], &CPUSet);
+
+	pid_t ProcessID = fork();
+	if (ProcessID < 0)
+		throw(std::runtime_error("Failed to fork a program process!"));
+
+	if (ProcessID == 0)
+	{
+		sched_setaffinity(0, sizeof(CPUSet), &CPUSet);
+		execvp(Arguments[0], Arguments.data());
+		_exit(127);
+	}
+
+	int PidFD = int(syscall(SYS_pidfd_open, ProcessID, 0));
+	if (PidFD < 0)
+	{
+		kill(ProcessID, SIGKILL);
+		waitpid(ProcessID, nullptr, 0);
+		throw(std::runtime_error("Failed to open pidfd for a program process!"));
+	}
+
+	epoll_event Event = {};
+	Event.events = EPOLLIN;
+	Event.data.fd = PidFD;
+	epoll_ctl(EpollFD, EPOLL_CTL_ADD, PidFD, &Event);
+
+	Processes[PidFD] = { ProcessID, InProgramName };
+}
+
+
+void CProcessLauncher::CollectFinished(std::vector<std::pair<std::string, bool>>& OutFinished, int TimeoutMs)
+{
+	if (Processes.empty())
+		return;
+
+	epoll_event Events[64];
+	int EventCount = epoll_wait(EpollFD, Events, 64, TimeoutMs);
+
+	for (int i = 0; i < EventCount; i++)
+	{
+		auto Process = Processes.find(Events[i].data.fd);
+		if (Process == Processes.end())
+			continue;
+
+		int Status = 0;
+		waitpid(Process->second.ProcessID, &Status, 0);
+
+		OutFinished.push_back({ Process->second.ProgramName, WIFEXITED(Status) && WEXITSTATUS(Status) == 0 });
+
+		epoll_ctl(EpollFD, EPOLL_CTL_DEL, Process->first, nullptr);
+		close(Process->first);
+		Processes.erase(Process);
+	}
+}
+
+#else
+
+CProcessLauncher::CProcessLauncher()
+{
+	throw(std::runtime_error("Process execution is only supported on Linux!"));
+}
+
+CProcessLauncher::~CProcessLauncher() {}
+
+void CProcessLauncher::Launch(const std::string& InProgramName, const std::vector<std::string>& InCommand, const std::set<unsigned>& InProcessors) {}
+
+void CProcessLauncher::CollectFinished(std::vector<std::pair<std::string, bool>>& OutFinished, int TimeoutMs) {}
+
+#endif
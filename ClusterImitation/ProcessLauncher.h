@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <utility>
+
+
+// Runs real programs as local processes, pinned to the CPUs matching the processors they were assigned.
+// Completion is detected through a pidfd per process registered in one epoll instance, so polling
+// for finished processes costs one system call no matter how many of them are running.
+// Only supported on Linux, on other platforms the constructor throws.
+
+class CProcessLauncher
+{
+	struct TRunningProcess
+	{
+		int ProcessID;
+		std::string ProgramName;
+	};
+
+	int EpollFD;
+
+	// CPUs this process is allowed to run on, processor IDs are mapped onto them
+	std::vector<int> AvailableCPUs;
+
+	// Running processes by their pidfd
+	std::map<int, TRunningProcess> Processes;
+
+public:
+	CProcessLauncher();
+	~CProcessLauncher();
+
+	CProcessLauncher(const CProcessLauncher&) = delete;
+	CProcessLauncher& operator=(const CProcessLauncher&) = delete;
+
+	size_t GetRunningCount() const { return Processes.size(); }
+
+	// Starts InCommand (program and its arguments, looked up in PATH). Processor IDs are mapped onto the available
+	// CPUs of this machine modulo their count, so a simulated cluster larger than the box still runs, with contention.
+	void Launch(const std::string& InProgramName, const std::vector<std::string>& InCommand, const std::set<unsigned>& InProcessors);
+
+	// Appends (program name, exited with zero status) for every process that has exited.
+	// Waits up to TimeoutMs milliseconds for the first one, 0 does not block.
+	void CollectFinished(std::vector<std::pair<std::string, bool>>& OutFinished, int TimeoutMs = 0);
+};
@@ -0,0 +1,100 @@
+#include "Resources.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+void CNodeResources::Reset(size_t InNodeCount)
+{
+	Occupied.assign(InNodeCount, 0);
+
+	for (size_t Kind = 0; Kind < NodeResourceKindCount; Kind++)
+	{
+		Capacity[Kind].assign(InNodeCount, 0);
+		TotalCapacity[Kind] = 0;
+	}
+}
+
+
+void CNodeResources::SetCapacity(unsigned InNode, const TResources& InCapacity)
+{
+	if (InNode >= Occupied.size())
+		throw(std::runtime_error("Setting resources of a processor that does not exist!"));
+
+	for (size_t Kind = 0; Kind < NodeResourceKindCount; Kind++)
+	{
+		TotalCapacity[Kind] += InCapacity.Amounts[Kind];
+		TotalCapacity[Kind] -= Capacity[Kind][InNode];
+		Capacity[Kind][InNode] = InCapacity.Amounts[Kind];
+	}
+}
+
+
+TResources CNodeResources::GetCapacity(unsigned InNode) const
+{
+	TResources Resources;
+	for (size_t Kind = 0; Kind < NodeResourceKindCount; Kind++)
+		Resources.Amounts[Kind] = Capacity[Kind].at(InNode);
+
+	return Resources;
+}
+
+
+size_t CNodeResources::CountFitting(const TResources& InDemand, bool InFreeOnly) const
+{
+	const uint32_t* Busy = Occupied.data();
+	const uint32_t* Memory = Capacity[size_t(EResource::Memory)].data();
+	const uint32_t* Accelerators = Capacity[size_t(EResource::Accelerators)].data();
+
+	const uint32_t MemoryDemand = InDemand[EResource::Memory];
+	const uint32_t AcceleratorDemand = InDemand[EResource::Accelerators];
+
+	// Occupied is 0 or 1, busy nodes are counted unless only free ones are
+	const uint32_t BusyLimit = InFreeOnly ? 0 : 1;
+
+	// Comparisons combined by multiplication, not by branches or by '&', so that the loop is vectorized
+	uint32_t Fitting = 0;
+	int32_t Count = int32_t(Occupied.size());
+	for (int32_t i = 0; i < Count; i++)
+		Fitting += uint32_t(Busy[i] <= BusyLimit) * uint32_t(Memory[i] >= MemoryDemand) * uint32_t(Accelerators[i] >= AcceleratorDemand);
+
+	return Fitting;
+}
+
+
+std::vector<unsigned> CNodeResources::ChooseNodes(const TResources& InDemand, size_t InCount) const
+{
+	std::vector<std::pair<double, unsigned>> Candidates;
+
+	for (unsigned Node = 0; Node < Occupied.size(); Node++)
+	{
+		if (Occupied[Node])
+			continue;
+
+		// Spare capacity as shares of the cluster totals
+		double Spare = 0;
+		bool Fits = true;
+
+		for (size_t Kind = 0; Kind < NodeResourceKindCount; Kind++)
+		{
+			if (Capacity[Kind][Node] < InDemand.Amounts[Kind])
+				Fits = false;
+
+			else if (TotalCapacity[Kind] != 0)
+				Spare += double(Capacity[Kind][Node] - InDemand.Amounts[Kind]) / TotalCapacity[Kind];
+		}
+
+		if (Fits)
+			Candidates.push_back({ Spare, Node });
+	}
+
+	if (Candidates.size() < InCount)
+		return {};
+
+	std::partial_sort(Candidates.begin(), Candidates.begin() + InCount, Candidates.end());
+
+	std::vector<unsigned> Nodes;
+	for (size_t i = 0; i < InCount; i++)
+		Nodes.push_back(Candidates[i].second);
+
+	return Nodes;
+}
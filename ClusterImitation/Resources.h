@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Resources besides processors
+enum class EResource
+{
+	// On every node (processor), a call needs its amount on each of its nodes
+	Memory,
+	Accelerators,
+
+	// Shared by the whole cluster, a call needs its amount once
+	Licenses
+};
+
+const size_t ResourceKindCount = 3;
+const size_t NodeResourceKindCount = 2;
+
+
+struct TResources
+{
+	std::array<uint32_t, ResourceKindCount> Amounts = {};
+
+	uint32_t& operator[](EResource InKind) { return Amounts[size_t(InKind)]; }
+	uint32_t operator[](EResource InKind) const { return Amounts[size_t(InKind)]; }
+
+	bool HasNodeDemand() const { return Amounts[size_t(EResource::Memory)] != 0 || Amounts[size_t(EResource::Accelerators)] != 0; }
+};
+
+
+// Resource capacities and occupancy of the nodes kept as arrays, so that the free nodes meeting a demand are counted in one pass
+class CNodeResources
+{
+	std::vector<uint32_t> Occupied;
+	std::vector<uint32_t> Capacity[NodeResourceKindCount];
+
+	uint64_t TotalCapacity[NodeResourceKindCount] = {};
+
+public:
+	void Reset(size_t InNodeCount);
+
+	void SetCapacity(unsigned InNode, const TResources& InCapacity);
+	TResources GetCapacity(unsigned InNode) const;
+	uint64_t GetTotalCapacity(EResource InKind) const { return TotalCapacity[size_t(InKind)]; }
+
+	// Without capacities nodes only differ by being free
+	bool HasCapacities() const { return TotalCapacity[0] != 0 || TotalCapacity[1] != 0; }
+
+	void SetOccupied(unsigned InNode, bool InOccupied) { Occupied[InNode] = InOccupied; }
+
+	bool IsFree(unsigned InNode) const { return Occupied[InNode] == 0; }
+	bool Fits(unsigned InNode, const TResources& InDemand) const
+	{
+		return Occupied[InNode] == 0 && Capacity[0][InNode] >= InDemand.Amounts[0] && Capacity[1][InNode] >= InDemand.Amounts[1];
+	}
+
+	// Nodes meeting the demand, free ones only or all of them
+	size_t CountFitting(const TResources& InDemand, bool InFreeOnly = true) const;
+
+	// InCount free nodes meeting the demand, the ones with the least capacity to spare first (lower IDs among equal ones),
+	// so that large nodes are kept for the calls that need them. Empty when there are not enough.
+	std::vector<unsigned> ChooseNodes(const TResources& InDemand, size_t InCount) const;
+};
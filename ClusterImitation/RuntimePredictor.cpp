@@ -0,0 +1,109 @@
+#include "RuntimePredictor.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+
+CRuntimePredictor::CRuntimePredictor(size_t InCapacity, float InSmoothing)
+{
+	if (InCapacity < ProbeLength)
+		throw(std::runtime_error("Runtime predictor capacity is too small!"));
+
+	if (!(InSmoothing > 0 && InSmoothing <= 1))
+		throw(std::runtime_error("Runtime predictor smoothing must be in (0, 1]!"));
+
+	size_t Capacity = 1;
+	while (Capacity < InCapacity)
+		Capacity *= 2;
+
+	Entries.resize(Capacity);
+	Mask = Capacity - 1;
+	Smoothing = InSmoothing;
+}
+
+
+uint64_t CRuntimePredictor::GetProgramKey(const std::string& InName)
+{
+	size_t Length = InName.size();
+	while (Length > 0 && (isdigit((unsigned char)InName[Length - 1]) || InName[Length - 1] == '_' || InName[Length - 1] == '-' || InName[Length - 1] == '.'))
+		Length--;
+
+	// FNV-1a
+	uint64_t Hash = 14695981039346656037ull;
+	for (size_t i = 0; i < Length; i++)
+	{
+		Hash ^= (unsigned char)InName[i];
+		Hash *= 1099511628211ull;
+	}
+
+	return Hash != 0 ? Hash : 1;
+}
+
+
+const CRuntimePredictor::TEntry* CRuntimePredictor::Find(uint64_t InKey) const
+{
+	for (size_t i = 0; i < ProbeLength; i++)
+	{
+		const TEntry& Entry = Entries[(InKey + i) & Mask];
+
+		if (Entry.Key == InKey)
+			return &Entry;
+
+		if (Entry.Key == 0)
+			return nullptr;
+	}
+
+	return nullptr;
+}
+
+
+size_t CRuntimePredictor::Predict(uint64_t InKey, size_t InRequestedTime) const
+{
+	const TEntry* Entry = Find(InKey);
+	if (!Entry)
+		return InRequestedTime;
+
+	size_t Predicted = size_t(std::lround(double(InRequestedTime) * Entry->Ratio));
+	return std::max(size_t(1), std::min(Predicted, InRequestedTime));
+}
+
+
+void CRuntimePredictor::Observe(uint64_t InKey, size_t InRequestedTime, size_t InActualTime)
+{
+	if (InRequestedTime == 0)
+		return;
+
+	double Error = double(Predict(InKey, InRequestedTime)) - double(InActualTime);
+	TotalAbsoluteError += Error < 0 ? -Error : Error;
+	Observations++;
+
+	float Ratio = std::min(1.f, float(double(InActualTime) / InRequestedTime));
+
+	// The key's slot, or the first free one, or the least observed kind in its probe range
+	TEntry* Target = nullptr;
+	for (size_t i = 0; i < ProbeLength; i++)
+	{
+		TEntry& Entry = Entries[(InKey + i) & Mask];
+
+		if (Entry.Key == InKey || Entry.Key == 0)
+		{
+			Target = &Entry;
+			break;
+		}
+
+		if (!Target || Entry.Observations < Target->Observations)
+			Target = &Entry;
+	}
+
+	if (Target->Key != InKey)
+	{
+		Target->Key = InKey;
+		Target->Ratio = Ratio;
+		Target->Observations = 1;
+		return;
+	}
+
+	Target->Ratio += Smoothing * (Ratio - Target->Ratio);
+	Target->Observations++;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Online prediction of how long programs really run, as a share of their requested execution time.
+// The history of each program kind is one exponentially weighted ratio in a fixed size open addressing table,
+// so both a prediction and an update take constant time. A kind is the program name without its trailing
+// numbers and separators ("Render_12" and "Render_13" are both "Render").
+class CRuntimePredictor
+{
+public:
+	struct TEntry
+	{
+		// 0 - empty
+		uint64_t Key = 0;
+		float Ratio = 1;
+		uint32_t Observations = 0;
+	};
+
+private:
+	// Slots looked at for a key, when all of them are taken the least observed kind is replaced
+	static const size_t ProbeLength = 8;
+
+	std::vector<TEntry> Entries;
+	size_t Mask;
+	float Smoothing;
+
+	size_t Observations = 0;
+	double TotalAbsoluteError = 0;
+
+	const TEntry* Find(uint64_t InKey) const;
+
+public:
+	// Capacity is rounded up to a power of two, Smoothing is the weight of the newest observation
+	CRuntimePredictor(size_t InCapacity = 4096, float InSmoothing = 0.25f);
+
+	size_t GetCapacity() const { return Entries.size(); }
+	float GetSmoothing() const { return Smoothing; }
+
+	// Kinds are kept in the slot they were put into, which is not always the first one probed for their key
+	const TEntry& GetEntry(size_t InSlot) const { return Entries.at(InSlot); }
+	void SetEntry(size_t InSlot, const TEntry& InEntry) { Entries.at(InSlot) = InEntry; }
+
+	static uint64_t GetProgramKey(const std::string& InName);
+
+	// Predicted ticks from 1 to InRequestedTime, the request itself for kinds without history
+	size_t Predict(uint64_t InKey, size_t InRequestedTime) const;
+	void Observe(uint64_t InKey, size_t InRequestedTime, size_t InActualTime);
+
+	size_t GetObservationCount() const { return Observations; }
+	double GetTotalAbsoluteError() const { return TotalAbsoluteError; }
+	void SetObservationTotals(size_t InObservations, double InTotalAbsoluteError) { Observations = InObservations; TotalAbsoluteError = InTotalAbsoluteError; }
+
+	// Error of the predictions made right before each observation, in ticks
+	double GetMeanAbsoluteError() const { return Observations ? TotalAbsoluteError / Observations : 0; }
+};
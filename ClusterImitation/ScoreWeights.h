@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+
+
+// Weights of the waiting call score:
+// Position * (QueueAnalysisDepth - Index) + Waiting * (CurrentTime - TimeCalled) - ExecutionTime * ExecutionTime
+// - Processors * RequiredProcessors (the last one only when there are not enough free processors)
+// + Priority * Priority - FairShare * (decayed processor ticks of the call's user / processor count, see CFairShare)
+
+// Set at runtime, e.g. for parameter sweeps
+struct TScoreWeights
+{
+	size_t Position = 15;
+	size_t Waiting = 5;
+	size_t ExecutionTime = 4;
+	size_t Processors = 8;
+	size_t Priority = 0;
+	size_t FairShare = 0;
+
+	bool operator==(const TScoreWeights& Other) const
+	{
+		return Position == Other.Position && Waiting == Other.Waiting && ExecutionTime == Other.ExecutionTime && Processors == Other.Processors
+			&& Priority == Other.Priority && FairShare == Other.FairShare;
+	}
+};
+
+// Known at compile time, so that the compiler folds them into the scoring loop
+template<size_t InPosition, size_t InWaiting, size_t InExecutionTime, size_t InProcessors>
+struct TStaticScoreWeights
+{
+	static constexpr size_t Position = InPosition;
+	static constexpr size_t Waiting = InWaiting;
+	static constexpr size_t ExecutionTime = InExecutionTime;
+	static constexpr size_t Processors = InProcessors;
+	static constexpr size_t Priority = 0;
+	static constexpr size_t FairShare = 0;
+
+	operator TScoreWeights() const
+	{
+		TScoreWeights Weights;
+		Weights.Position = Position;
+		Weights.Waiting = Waiting;
+		Weights.ExecutionTime = ExecutionTime;
+		Weights.Processors = Processors;
+		return Weights;
+	}
+};
+
+typedef TStaticScoreWeights<15, 5, 4, 8> TDefaultScoreWeights;
+
+// Below any score, the search for the top call starts from it
+constexpr float LowestWaitingCallScore = -1000000000000000000000000000000000.0f;
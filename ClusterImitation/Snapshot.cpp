@@ -0,0 +1,106 @@
+#include "Snapshot.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+#ifdef _WIN32
+
+CMappedFile::CMappedFile(const std::string& InPath) : Data(nullptr), Size(0), FileHandle(INVALID_HANDLE_VALUE), MappingHandle(nullptr)
+{
+	FileHandle = CreateFileA(InPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (FileHandle == INVALID_HANDLE_VALUE)
+		throw(std::runtime_error("Failed to open cluster snapshot!"));
+
+	LARGE_INTEGER FileSize;
+	GetFileSizeEx(FileHandle, &FileSize);
+	Size = size_t(FileSize.QuadPart);
+
+	if (Size == 0)
+		return;
+
+	MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	Data = MappingHandle ? static_cast<const uint8_t*>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+	if (!Data)
+	{
+		if (MappingHandle)
+			CloseHandle(MappingHandle);
+		CloseHandle(FileHandle);
+		throw(std::runtime_error("Failed to map cluster snapshot!"));
+	}
+}
+
+
+CMappedFile::~CMappedFile()
+{
+	if (Data)
+		UnmapViewOfFile(Data);
+	if (MappingHandle)
+		CloseHandle(MappingHandle);
+
+	CloseHandle(FileHandle);
+}
+
+#else
+
+CMappedFile::CMappedFile(const std::string& InPath) : Data(nullptr), Size(0)
+{
+	int FD = open(InPath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (FD < 0)
+		throw(std::runtime_error("Failed to open cluster snapshot!"));
+
+	struct stat Stat;
+	if (fstat(FD, &Stat) < 0)
+	{
+		close(FD);
+		throw(std::runtime_error("Failed to open cluster snapshot!"));
+	}
+
+	Size = size_t(Stat.st_size);
+
+	if (Size > 0)
+	{
+		void* Memory = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, FD, 0);
+		if (Memory == MAP_FAILED)
+		{
+			close(FD);
+			throw(std::runtime_error("Failed to map cluster snapshot!"));
+		}
+
+		Data = static_cast<const uint8_t*>(Memory);
+	}
+
+	close(FD);
+}
+
+
+CMappedFile::~CMappedFile()
+{
+	if (Data)
+		munmap(const_cast<uint8_t*>(Data), Size);
+}
+
+#endif
+
+
+void CSnapshotWriter::SaveToFile(const std::string& InPath) const
+{
+	std::FILE* File = std::fopen(InPath.c_str(), "wb");
+	if (!File)
+		throw(std::runtime_error("Failed to create cluster snapshot!"));
+
+	bool Written = std::fwrite(Buffer.data(), 1, Buffer.size(), File) == Buffer.size();
+
+	if (std::fclose(File) != 0 || !Written)
+		throw(std::runtime_error("Failed to write cluster snapshot!"));
+}
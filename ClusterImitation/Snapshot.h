@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+
+// Read-only memory mapping of a whole file
+
+class CMappedFile
+{
+	const uint8_t* Data;
+	size_t Size;
+
+#ifdef _WIN32
+	void* FileHandle;
+	void* MappingHandle;
+#endif
+
+public:
+	CMappedFile(const std::string& InPath);
+	~CMappedFile();
+
+	CMappedFile(const CMappedFile&) = delete;
+	CMappedFile& operator=(const CMappedFile&) = delete;
+
+	const uint8_t* GetData() const { return Data; }
+	size_t GetSize() const { return Size; }
+};
+
+
+// Building blocks of the binary cluster snapshot (host byte order)
+
+class CSnapshotWriter
+{
+	std::vector<uint8_t> Buffer;
+
+public:
+	template<class T>
+	void Write(T Value)
+	{
+		const uint8_t* Bytes = reinterpret_cast<const uint8_t*>(&Value);
+		Buffer.insert(Buffer.end(), Bytes, Bytes + sizeof(T));
+	}
+
+	void WriteString(const std::string& Value)
+	{
+		Write<uint64_t>(Value.size());
+		Buffer.insert(Buffer.end(), Value.begin(), Value.end());
+	}
+
+	const std::vector<uint8_t>& GetBuffer() const { return Buffer; }
+
+	void SaveToFile(const std::string& InPath) const;
+};
+
+
+class CSnapshotReader
+{
+	const uint8_t* Data;
+	size_t Size;
+	size_t Offset;
+
+public:
+	CSnapshotReader(const uint8_t* InData, size_t InSize) : Data(InData), Size(InSize), Offset(0) {}
+
+	template<class T>
+	T Read()
+	{
+		if (Size - Offset < sizeof(T))
+			throw(std::runtime_error("Cluster snapshot is truncated!"));
+
+		T Value;
+		memcpy(&Value, Data + Offset, sizeof(T));
+		Offset += sizeof(T);
+		return Value;
+	}
+
+	std::string ReadString()
+	{
+		uint64_t Length = Read<uint64_t>();
+		if (Size - Offset < Length)
+			throw(std::runtime_error("Cluster snapshot is truncated!"));
+
+		std::string Value(reinterpret_cast<const char*>(Data + Offset), size_t(Length));
+		Offset += size_t(Length);
+		return Value;
+	}
+};
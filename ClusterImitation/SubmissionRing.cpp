@@ -0,0 +1,243 @@
+#include "SubmissionRing.h"
+#include <stdexcept>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const uint64_t SubmissionRingMagic = 0x474E495242555343ULL;
+
+
+void CSubmissionRingMapping::Map(bool Create, size_t InCapacity)
+{
+	int FD = shm_open(Name.c_str(), O_RDWR | (Create ? O_CREAT | O_EXCL : 0), 0600);
+	if (FD < 0)
+		throw(std::runtime_error("Failed to open submission ring shared memory!"));
+
+	if (Create)
+	{
+		MemorySize = sizeof(TSubmissionRingHeader) + InCapacity * (sizeof(TSubmissionRingRecord) + sizeof(TSubmissionRingAcknowledgement));
+
+		if (ftruncate(FD, MemorySize) < 0)
+		{
+			close(FD);
+			shm_unlink(Name.c_str());
+			throw(std::runtime_error("Failed to size submission ring shared memory!"));
+		}
+	}
+
+	else
+	{
+		struct stat Stat;
+		if (fstat(FD, &Stat) < 0 || size_t(Stat.st_size) < sizeof(TSubmissionRingHeader))
+		{
+			close(FD);
+			throw(std::runtime_error("Shared memory object is not a submission ring!"));
+		}
+
+		// The capacity is only known after the header is mapped
+		TSubmissionRingHeader* MappedHeader = static_cast<TSubmissionRingHeader*>(mmap(nullptr, sizeof(TSubmissionRingHeader), PROT_READ, MAP_SHARED, FD, 0));
+		if (MappedHeader == MAP_FAILED)
+		{
+			close(FD);
+			throw(std::runtime_error("Failed to map submission ring shared memory!"));
+		}
+
+		bool Valid = MappedHeader->Magic == SubmissionRingMagic;
+		InCapacity = MappedHeader->Capacity;
+		munmap(MappedHeader, sizeof(TSubmissionRingHeader));
+
+		MemorySize = sizeof(TSubmissionRingHeader) + InCapacity * (sizeof(TSubmissionRingRecord) + sizeof(TSubmissionRingAcknowledgement));
+		Valid = Valid && InCapacity != 0 && (InCapacity & (InCapacity - 1)) == 0 && MemorySize <= size_t(Stat.st_size);
+
+		if (!Valid)
+		{
+			close(FD);
+			throw(std::runtime_error("Shared memory object is not a submission ring!"));
+		}
+	}
+
+	Memory = mmap(nullptr, MemorySize, PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0);
+	close(FD);
+
+	if (Memory == MAP_FAILED)
+	{
+		Memory = nullptr;
+		if (Create)
+			shm_unlink(Name.c_str());
+
+		throw(std::runtime_error("Failed to map submission ring shared memory!"));
+	}
+
+	uint8_t* Bytes = static_cast<uint8_t*>(Memory);
+	Header = reinterpret_cast<TSubmissionRingHeader*>(Bytes);
+	Records = reinterpret_cast<TSubmissionRingRecord*>(Bytes + sizeof(TSubmissionRingHeader));
+	Acknowledgements = reinterpret_cast<TSubmissionRingAcknowledgement*>(Bytes + sizeof(TSubmissionRingHeader) + InCapacity * sizeof(TSubmissionRingRecord));
+	Capacity = InCapacity;
+}
+
+
+CSubmissionRingMapping::~CSubmissionRingMapping()
+{
+	if (Memory)
+		munmap(Memory, MemorySize);
+}
+
+
+CSubmissionRing::CSubmissionRing(const std::string& InName, size_t InCapacity)
+{
+	if (InCapacity == 0 || (InCapacity & (InCapacity - 1)) != 0)
+		throw(std::runtime_error("Submission ring capacity has to be a power of two!"));
+
+	Name = InName;
+	Map(true, InCapacity);
+
+	new (Header) TSubmissionRingHeader();
+	Header->Capacity = InCapacity;
+	Header->EnqueuePosition.store(0);
+	Header->DequeuePosition.store(0);
+
+	for (size_t i = 0; i < InCapacity; i++)
+	{
+		new (&Records[i]) TSubmissionRingRecord();
+		Records[i].Sequence.store(i);
+
+		new (&Acknowledgements[i]) TSubmissionRingAcknowledgement();
+		Acknowledgements[i].Ticket.store(0);
+		Acknowledgements[i].JobID.store(0);
+	}
+
+	// Producers check the magic number, so it is written last
+	std::atomic_thread_fence(std::memory_order_release);
+	Header->Magic = SubmissionRingMagic;
+}
+
+
+CSubmissionRing::~CSubmissionRing()
+{
+	shm_unlink(Name.c_str());
+}
+
+
+void CSubmissionRing::DrainSubmissions(CCluster& Cluster)
+{
+	uint64_t Mask = Capacity - 1;
+	uint64_t Position = Header->DequeuePosition.load(std::memory_order_relaxed);
+
+	for (size_t Drained = 0; Drained < Capacity; Drained++)
+	{
+		TSubmissionRingRecord& Record = Records[Position & Mask];
+
+		if (Record.Sequence.load(std::memory_order_acquire) != Position + 1)
+			break;
+
+		// Copied once, a producer may still write the record
+		uint16_t NameLength = Record.NameLength;
+		bool Valid = NameLength <= SubmissionRingMaxNameLength;
+
+		TProgramCall Call(Valid ? std::string(Record.Name, NameLength) : "", Record.RequiredProcessors, Record.ExecutionTime);
+
+		// The record can be reused by producers as soon as its data is copied
+		Record.Sequence.store(Position + Capacity, std::memory_order_release);
+
+		uint64_t JobID = RejectedJobID;
+		try
+		{
+			if (Valid)
+				JobID = Cluster.CallProgramExecution(Call);
+		}
+
+		catch (std::runtime_error&) {}
+
+		TSubmissionRingAcknowledgement& Acknowledgement = Acknowledgements[Position & Mask];
+		Acknowledgement.JobID.store(JobID, std::memory_order_relaxed);
+		Acknowledgement.Ticket.store(Position + 1, std::memory_order_release);
+
+		Position++;
+	}
+
+	Header->DequeuePosition.store(Position, std::memory_order_relaxed);
+}
+
+
+CSubmissionRingProducer::CSubmissionRingProducer(const std::string& InName)
+{
+	Name = InName;
+	Map(false, 0);
+}
+
+
+bool CSubmissionRingProducer::TrySubmit(const std::string& InName, uint32_t InRequiredProcessors, uint32_t InExecutionTime, uint64_t& OutTicket)
+{
+	if (InName.size() > SubmissionRingMaxNameLength)
+		throw(std::runtime_error("Program name is too long for the submission ring!"));
+
+	uint64_t Mask = Capacity - 1;
+	uint64_t Position = Header->EnqueuePosition.load(std::memory_order_relaxed);
+	TSubmissionRingRecord* Record;
+
+	while (true)
+	{
+		Record = &Records[Position & Mask];
+		int64_t Difference = int64_t(Record->Sequence.load(std::memory_order_acquire)) - int64_t(Position);
+
+		if (Difference == 0)
+		{
+			if (Header->EnqueuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+				break;
+		}
+
+		// The record still holds a call the cluster has not drained yet
+		else if (Difference < 0)
+			return false;
+
+		else
+			Position = Header->EnqueuePosition.load(std::memory_order_relaxed);
+	}
+
+	Record->RequiredProcessors = InRequiredProcessors;
+	Record->ExecutionTime = InExecutionTime;
+	Record->NameLength = uint16_t(InName.size());
+	memcpy(Record->Name, InName.data(), InName.size());
+
+	Record->Sequence.store(Position + 1, std::memory_order_release);
+
+	OutTicket = Position;
+	return true;
+}
+
+
+bool CSubmissionRingProducer::PollAcknowledgement(uint64_t InTicket, uint64_t& OutJobID) const
+{
+	const TSubmissionRingAcknowledgement& Acknowledgement = Acknowledgements[InTicket & (Capacity - 1)];
+
+	if (Acknowledgement.Ticket.load(std::memory_order_acquire) != InTicket + 1)
+		return false;
+
+	OutJobID = Acknowledgement.JobID.load(std::memory_order_relaxed);
+	return true;
+}
+
+#else
+
+void CSubmissionRingMapping::Map(bool Create, size_t InCapacity)
+{
+	throw(std::runtime_error("Submission ring is only supported on Linux!"));
+}
+
+CSubmissionRingMapping::~CSubmissionRingMapping() {}
+
+CSubmissionRing::CSubmissionRing(const std::string& InName, size_t InCapacity) { Map(true, InCapacity); }
+CSubmissionRing::~CSubmissionRing() {}
+void CSubmissionRing::DrainSubmissions(CCluster& Cluster) {}
+
+CSubmissionRingProducer::CSubmissionRingProducer(const std::string& InName) { Map(false, 0); }
+bool CSubmissionRingProducer::TrySubmit(const std::string& InName, uint32_t InRequiredProcessors, uint32_t InExecutionTime, uint64_t& OutTicket) { return false; }
+bool CSubmissionRingProducer::PollAcknowledgement(uint64_t InTicket, uint64_t& OutJobID) const { return false; }
+
+#endif
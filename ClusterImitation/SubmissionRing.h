@@ -0,0 +1,112 @@
+#pragma once
+#include "Cluster.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+// Shared-memory ring of program calls for producers running on the same machine as the cluster.
+//
+// The cluster side (CSubmissionRing) creates a named POSIX shared memory object, producers
+// (CSubmissionRingProducer) map the same object. Records have a fixed size with the program name stored
+// inline, and every record carries a sequence number (bounded MPMC queue by D. Vyukov), so producers only
+// do one compare-exchange per submission and the cluster drains the ring every tick without system calls.
+//
+// Every submission gets a ticket. Once the call is passed to the cluster, the acknowledgement slot of the ticket
+// receives the assigned job ID. Acknowledgement slots are reused after Capacity submissions, so a producer
+// has to read its acknowledgement before that. Only supported on Linux, on other platforms the constructors throw.
+//
+// Producers are other processes, so the cluster side trusts nothing it reads from the shared memory: it keeps
+// its own copy of the capacity, rejects records with a name longer than the record holds and drains at most
+// one ring of records per tick, even while producers keep refilling it.
+
+const size_t SubmissionRingMaxNameLength = 46;
+
+// Job ID acknowledged for calls the cluster has rejected
+const uint64_t RejectedJobID = UINT64_MAX;
+
+
+struct TSubmissionRingHeader
+{
+	uint64_t Magic;
+	uint64_t Capacity;
+
+	alignas(64) std::atomic<uint64_t> EnqueuePosition;
+	alignas(64) std::atomic<uint64_t> DequeuePosition;
+};
+
+
+// One cache line per record
+struct alignas(64) TSubmissionRingRecord
+{
+	std::atomic<uint64_t> Sequence;
+
+	uint32_t RequiredProcessors;
+	uint32_t ExecutionTime;
+	uint16_t NameLength;
+	char Name[SubmissionRingMaxNameLength];
+};
+
+
+struct TSubmissionRingAcknowledgement
+{
+	// Ticket + 1 once the acknowledgement for the ticket is written
+	std::atomic<uint64_t> Ticket;
+	std::atomic<uint64_t> JobID;
+};
+
+
+// Mapping of the shared ring, common for both sides
+class CSubmissionRingMapping
+{
+protected:
+	std::string Name;
+	void* Memory;
+	size_t MemorySize;
+
+	// Read from the header only once, when mapping
+	size_t Capacity;
+
+	TSubmissionRingHeader* Header;
+	TSubmissionRingRecord* Records;
+	TSubmissionRingAcknowledgement* Acknowledgements;
+
+	void Map(bool Create, size_t InCapacity);
+
+public:
+	CSubmissionRingMapping() : Memory(nullptr), MemorySize(0), Capacity(0), Header(nullptr), Records(nullptr), Acknowledgements(nullptr) {}
+	virtual ~CSubmissionRingMapping();
+
+	CSubmissionRingMapping(const CSubmissionRingMapping&) = delete;
+	CSubmissionRingMapping& operator=(const CSubmissionRingMapping&) = delete;
+
+	size_t GetCapacity() const { return Capacity; }
+};
+
+
+// Cluster side, owns the shared memory object
+class CSubmissionRing : public CSubmissionRingMapping, public ISubmissionSource
+{
+public:
+	// Name of the shared memory object ("/name"), capacity has to be a power of two
+	CSubmissionRing(const std::string& InName, size_t InCapacity = 4096);
+	~CSubmissionRing();
+
+	// Passes the calls in the ring to the cluster (up to the capacity) and acknowledges them
+	void DrainSubmissions(CCluster& Cluster) override;
+};
+
+
+// Producer side
+class CSubmissionRingProducer : public CSubmissionRingMapping
+{
+public:
+	CSubmissionRingProducer(const std::string& InName);
+
+	// Puts a call into the ring, returns false if the ring is full
+	bool TrySubmit(const std::string& InName, uint32_t InRequiredProcessors, uint32_t InExecutionTime, uint64_t& OutTicket);
+
+	// Returns true once the call with the given ticket has been passed to the cluster
+	// (OutJobID is RejectedJobID if the cluster rejected it)
+	bool PollAcknowledgement(uint64_t InTicket, uint64_t& OutJobID) const;
+};
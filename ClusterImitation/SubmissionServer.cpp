@@ -0,0 +1,532 @@
+#include "SubmissionServer.h"
+#include <stdexcept>
+#include <cstring>
+
+#ifdef __linux__
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Sizes of the fixed parts of the messages
+const size_t SubmitRequestHeaderSize = 1 + 4 + 4 + 2;
+const size_t SubmitReplySize = 1 + 1 + 8;
+const size_t StatusReplySize = 1 + 8 * 4;
+
+// Epoll user data of the listening socket and of the poller's wake-up event, connection IDs start from 1
+const uint64_t ListenSocketID = 0;
+const uint64_t WakeUpID = UINT64_MAX;
+
+
+template<class T>
+void AppendValue(std::vector<uint8_t>& Buffer, T Value)
+{
+	const uint8_t* Bytes = reinterpret_cast<const uint8_t*>(&Value);
+	Buffer.insert(Buffer.end(), Bytes, Bytes + sizeof(T));
+}
+
+template<class T>
+T ReadValue(const uint8_t* Data)
+{
+	T Value;
+	memcpy(&Value, Data, sizeof(T));
+	return Value;
+}
+
+
+sockaddr_un MakeSocketAddress(const std::string& InSocketPath)
+{
+	sockaddr_un Address = {};
+	Address.sun_family = AF_UNIX;
+
+	if (InSocketPath.size() >= sizeof(Address.sun_path))
+		throw(std::runtime_error("Submission socket path is too long!"));
+
+	memcpy(Address.sun_path, InSocketPath.c_str(), InSocketPath.size() + 1);
+	return Address;
+}
+
+
+CSubmissionServer::CSubmissionServer(const std::string& InSocketPath)
+{
+	SocketPath = InSocketPath;
+	NextConnectionID = ListenSocketID + 1;
+
+	sockaddr_un Address = MakeSocketAddress(SocketPath);
+
+	ListenFD = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (ListenFD < 0)
+		throw(std::runtime_error("Failed to create submission socket!"));
+
+	unlink(SocketPath.c_str());
+
+	if (bind(ListenFD, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) < 0 || listen(ListenFD, SOMAXCONN) < 0)
+	{
+		close(ListenFD);
+		throw(std::runtime_error("Failed to listen on submission socket!"));
+	}
+
+	EpollFD = epoll_create1(EPOLL_CLOEXEC);
+	WakeUpFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	epoll_event Event = {};
+	Event.events = EPOLLIN;
+	Event.data.u64 = ListenSocketID;
+	epoll_ctl(EpollFD, EPOLL_CTL_ADD, ListenFD, &Event);
+
+	Event.data.u64 = WakeUpID;
+	epoll_ctl(EpollFD, EPOLL_CTL_ADD, WakeUpFD, &Event);
+
+	Poller = std::thread(&CSubmissionServer::PollLoop, this);
+}
+
+
+CSubmissionServer::~CSubmissionServer()
+{
+	uint64_t WakeUp = 1;
+	write(WakeUpFD, &WakeUp, sizeof(WakeUp));
+	Poller.join();
+
+	for (auto& Connection : Connections)
+		close(Connection.second.FD);
+
+	close(WakeUpFD);
+	close(EpollFD);
+	close(ListenFD);
+	unlink(SocketPath.c_str());
+}
+
+
+size_t CSubmissionServer::GetConnectionCount() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return Connections.size();
+}
+
+
+size_t CSubmissionServer::GetPendingRequestCount() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return PendingRequests.size();
+}
+
+
+void CSubmissionServer::PollLoop()
+{
+	epoll_event Events[256];
+
+	while (true)
+	{
+		int EventCount = epoll_wait(EpollFD, Events, 256, -1);
+		if (EventCount < 0 && errno != EINTR)
+			return;
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		for (int i = 0; i < EventCount; i++)
+		{
+			uint64_t ConnectionID = Events[i].data.u64;
+
+			if (ConnectionID == WakeUpID)
+				return;
+
+			if (ConnectionID == ListenSocketID)
+			{
+				AcceptConnections();
+				continue;
+			}
+
+			auto Connection = Connections.find(ConnectionID);
+			if (Connection == Connections.end())
+				continue;
+
+			bool Alive = true;
+
+			if (Events[i].events & EPOLLOUT)
+				Alive = WriteConnection(ConnectionID, Connection->second);
+
+			if (Alive && (Events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+				Alive = ReadConnection(ConnectionID, Connection->second, Events[i].events & (EPOLLHUP | EPOLLERR));
+
+			if (Alive)
+				UpdateEvents(ConnectionID, Connection->second);
+			else
+				CloseConnection(ConnectionID);
+		}
+	}
+}
+
+
+void CSubmissionServer::DrainSubmissions(CCluster& Cluster)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	AnswerRequests(Cluster);
+
+	// Connections paused by a full backlog are parsed and read from again
+	std::vector<uint64_t> ClosedConnections;
+	for (auto& Connection : Connections)
+	{
+		bool Alive = ParseRequests(Connection.first, Connection.second, false);
+
+		if (Alive && !Connection.second.OutBuffer.empty())
+			Alive = WriteConnection(Connection.first, Connection.second);
+
+		if (Alive)
+			UpdateEvents(Connection.first, Connection.second);
+		else
+			ClosedConnections.push_back(Connection.first);
+	}
+
+	for (uint64_t ConnectionID : ClosedConnections)
+		CloseConnection(ConnectionID);
+}
+
+
+void CSubmissionServer::AcceptConnections()
+{
+	while (true)
+	{
+		int FD = accept4(ListenFD, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (FD < 0)
+			return;
+
+		uint64_t ConnectionID = NextConnectionID++;
+		Connections[ConnectionID].FD = FD;
+		UpdateEvents(ConnectionID, Connections[ConnectionID]);
+	}
+}
+
+
+bool CSubmissionServer::CanRead(const TConnection& Connection) const
+{
+	return PendingRequests.size() < MaxPendingRequests && Connection.OutBuffer.size() < MaxOutBufferSize;
+}
+
+
+bool CSubmissionServer::ReadConnection(uint64_t ConnectionID, TConnection& Connection, bool Closing)
+{
+	uint8_t Chunk[65536];
+
+	// Every chunk is parsed before the next one is read, so the buffer keeps at most a chunk and a partial request.
+	// What a closing connection has left is read in full, it is bounded by the socket buffer.
+	while (Closing || CanRead(Connection))
+	{
+		ssize_t Received = read(Connection.FD, Chunk, sizeof(Chunk));
+
+		if (Received > 0)
+		{
+			Connection.InBuffer.insert(Connection.InBuffer.end(), Chunk, Chunk + Received);
+
+			if (!ParseRequests(ConnectionID, Connection, Closing))
+				return false;
+
+			continue;
+		}
+
+		// Requests sent right before the client disconnected are still served
+		if (Received == 0)
+		{
+			ParseRequests(ConnectionID, Connection, true);
+			return false;
+		}
+
+		if (errno == EINTR)
+			continue;
+
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+
+		return false;
+	}
+
+	return true;
+}
+
+
+bool CSubmissionServer::ParseRequests(uint64_t ConnectionID, TConnection& Connection, bool Closing)
+{
+	const uint8_t* Data = Connection.InBuffer.data();
+	size_t Size = Connection.InBuffer.size();
+	size_t Offset = 0;
+
+	while (Offset < Size && (Closing || PendingRequests.size() < MaxPendingRequests))
+	{
+		ESubmissionMessage Type = ESubmissionMessage(Data[Offset]);
+
+		if (Type == ESubmissionMessage::Status)
+		{
+			PendingRequests.push_back({ ConnectionID, Type, TProgramCall() });
+			Offset += 1;
+		}
+
+		else if (Type == ESubmissionMessage::Submit)
+		{
+			if (Size - Offset < SubmitRequestHeaderSize)
+				break;
+
+			uint16_t NameLength = ReadValue<uint16_t>(Data + Offset + 9);
+			if (Size - Offset < SubmitRequestHeaderSize + NameLength)
+				break;
+
+			TProgramCall Call(std::string(reinterpret_cast<const char*>(Data + Offset + SubmitRequestHeaderSize), NameLength),
+				ReadValue<uint32_t>(Data + Offset + 1), ReadValue<uint32_t>(Data + Offset + 5));
+
+			PendingRequests.push_back({ ConnectionID, Type, std::move(Call) });
+			Offset += SubmitRequestHeaderSize + NameLength;
+		}
+
+		// Unknown message, the stream can not be resynchronized
+		else
+			return false;
+	}
+
+	Connection.InBuffer.erase(Connection.InBuffer.begin(), Connection.InBuffer.begin() + Offset);
+	return true;
+}
+
+
+void CSubmissionServer::AnswerRequests(CCluster& Cluster)
+{
+	for (auto& Request : PendingRequests)
+	{
+		auto Connection = Connections.find(Request.ConnectionID);
+
+		if (Request.Type == ESubmissionMessage::Submit)
+		{
+			uint8_t Accepted = 1;
+			uint64_t JobID = 0;
+
+			try
+			{
+				JobID = Cluster.CallProgramExecution(Request.Call);
+			}
+
+			catch (std::runtime_error&)
+			{
+				Accepted = 0;
+			}
+
+			// The call is kept even if its client has disconnected meanwhile
+			if (Connection == Connections.end())
+				continue;
+
+			AppendValue<uint8_t>(Connection->second.OutBuffer, uint8_t(ESubmissionMessage::Submit));
+			AppendValue<uint8_t>(Connection->second.OutBuffer, Accepted);
+			AppendValue<uint64_t>(Connection->second.OutBuffer, JobID);
+		}
+
+		else if (Connection != Connections.end())
+		{
+			AppendValue<uint8_t>(Connection->second.OutBuffer, uint8_t(ESubmissionMessage::Status));
+			AppendValue<uint64_t>(Connection->second.OutBuffer, Cluster.GetCurrentTime());
+			AppendValue<uint64_t>(Connection->second.OutBuffer, Cluster.GetWaitingProgramCalls().size());
+			AppendValue<uint64_t>(Connection->second.OutBuffer, Cluster.GetRunningProgramCount());
+			AppendValue<uint64_t>(Connection->second.OutBuffer, Cluster.GetFinishedProgramCount());
+		}
+	}
+
+	PendingRequests.clear();
+}
+
+
+bool CSubmissionServer::WriteConnection(uint64_t ConnectionID, TConnection& Connection)
+{
+	size_t Sent = 0;
+
+	while (Sent < Connection.OutBuffer.size())
+	{
+		ssize_t Written = send(Connection.FD, Connection.OutBuffer.data() + Sent, Connection.OutBuffer.size() - Sent, MSG_NOSIGNAL);
+
+		if (Written > 0)
+		{
+			Sent += Written;
+			continue;
+		}
+
+		if (Written < 0 && errno == EINTR)
+			continue;
+
+		if (Written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		return false;
+	}
+
+	Connection.OutBuffer.erase(Connection.OutBuffer.begin(), Connection.OutBuffer.begin() + Sent);
+	return true;
+}
+
+
+void CSubmissionServer::UpdateEvents(uint64_t ConnectionID, TConnection& Connection)
+{
+	// Only wait for the socket to become writable while there is something left to send, and for it to become readable
+	// while there is room for what it brings. A connection waiting for neither is taken out of epoll, so that its hang-up
+	// is not reported over and over while it is paused.
+	uint32_t Events = (CanRead(Connection) ? EPOLLIN : 0) | (Connection.OutBuffer.empty() ? 0 : EPOLLOUT);
+	if (Events == Connection.Events)
+		return;
+
+	epoll_event Event = {};
+	Event.events = Events;
+	Event.data.u64 = ConnectionID;
+
+	if (Events == 0)
+		epoll_ctl(EpollFD, EPOLL_CTL_DEL, Connection.FD, nullptr);
+	else
+		epoll_ctl(EpollFD, Connection.Events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, Connection.FD, &Event);
+
+	Connection.Events = Events;
+}
+
+
+void CSubmissionServer::CloseConnection(uint64_t ConnectionID)
+{
+	auto Connection = Connections.find(ConnectionID);
+	if (Connection == Connections.end())
+		return;
+
+	if (Connection->second.Events != 0)
+		epoll_ctl(EpollFD, EPOLL_CTL_DEL, Connection->second.FD, nullptr);
+
+	close(Connection->second.FD);
+	Connections.erase(Connection);
+}
+
+
+CSubmissionClient::CSubmissionClient(const std::string& InSocketPath)
+{
+	sockaddr_un Address = MakeSocketAddress(InSocketPath);
+
+	FD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (FD < 0 || connect(FD, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) < 0)
+	{
+		if (FD >= 0)
+			close(FD);
+
+		throw(std::runtime_error("Failed to connect to submission server!"));
+	}
+}
+
+
+CSubmissionClient::~CSubmissionClient()
+{
+	close(FD);
+}
+
+
+void CSubmissionClient::Submit(const std::string& InName, uint32_t InRequiredProcessors, uint32_t InExecutionTime)
+{
+	if (InName.size() > UINT16_MAX)
+		throw(std::runtime_error("Program name is too long for submission!"));
+
+	AppendValue<uint8_t>(OutBuffer, uint8_t(ESubmissionMessage::Submit));
+	AppendValue<uint32_t>(OutBuffer, InRequiredProcessors);
+	AppendValue<uint32_t>(OutBuffer, InExecutionTime);
+	AppendValue<uint16_t>(OutBuffer, uint16_t(InName.size()));
+	OutBuffer.insert(OutBuffer.end(), InName.begin(), InName.end());
+}
+
+
+void CSubmissionClient::Flush()
+{
+	size_t Sent = 0;
+
+	while (Sent < OutBuffer.size())
+	{
+		ssize_t Written = send(FD, OutBuffer.data() + Sent, OutBuffer.size() - Sent, MSG_NOSIGNAL);
+
+		if (Written < 0 && errno == EINTR)
+			continue;
+
+		if (Written <= 0)
+			throw(std::runtime_error("Failed to send to submission server!"));
+
+		Sent += Written;
+	}
+
+	OutBuffer.clear();
+}
+
+
+void CSubmissionClient::ReadExactly(void* OutData, size_t Size)
+{
+	uint8_t* Data = static_cast<uint8_t*>(OutData);
+
+	while (Size > 0)
+	{
+		ssize_t Received = read(FD, Data, Size);
+
+		if (Received < 0 && errno == EINTR)
+			continue;
+
+		if (Received <= 0)
+			throw(std::runtime_error("Submission server closed the connection!"));
+
+		Data += Received;
+		Size -= Received;
+	}
+}
+
+
+bool CSubmissionClient::ReadAcknowledgement(uint64_t& OutJobID)
+{
+	uint8_t Reply[SubmitReplySize];
+	ReadExactly(Reply, SubmitReplySize);
+
+	if (Reply[0] != uint8_t(ESubmissionMessage::Submit))
+		throw(std::runtime_error("Unexpected reply from submission server!"));
+
+	OutJobID = ReadValue<uint64_t>(Reply + 2);
+	return Reply[1] != 0;
+}
+
+
+TSubmissionStatus CSubmissionClient::QueryStatus()
+{
+	AppendValue<uint8_t>(OutBuffer, uint8_t(ESubmissionMessage::Status));
+	Flush();
+
+	uint8_t Reply[StatusReplySize];
+	ReadExactly(Reply, StatusReplySize);
+
+	if (Reply[0] != uint8_t(ESubmissionMessage::Status))
+		throw(std::runtime_error("Unexpected reply from submission server!"));
+
+	TSubmissionStatus Status;
+	Status.Time = ReadValue<uint64_t>(Reply + 1);
+	Status.Waiting = ReadValue<uint64_t>(Reply + 9);
+	Status.Running = ReadValue<uint64_t>(Reply + 17);
+	Status.Finished = ReadValue<uint64_t>(Reply + 25);
+
+	return Status;
+}
+
+#else
+
+CSubmissionServer::CSubmissionServer(const std::string& InSocketPath)
+{
+	throw(std::runtime_error("Submission server is only supported on Linux!"));
+}
+
+CSubmissionServer::~CSubmissionServer() {}
+size_t CSubmissionServer::GetConnectionCount() const { return 0; }
+size_t CSubmissionServer::GetPendingRequestCount() const { return 0; }
+void CSubmissionServer::DrainSubmissions(CCluster& Cluster) {}
+
+CSubmissionClient::CSubmissionClient(const std::string& InSocketPath)
+{
+	throw(std::runtime_error("Submission client is only supported on Linux!"));
+}
+
+CSubmissionClient::~CSubmissionClient() {}
+void CSubmissionClient::Submit(const std::string& InName, uint32_t InRequiredProcessors, uint32_t InExecutionTime) {}
+void CSubmissionClient::Flush() {}
+bool CSubmissionClient::ReadAcknowledgement(uint64_t& OutJobID) { return false; }
+TSubmissionStatus CSubmissionClient::QueryStatus() { return TSubmissionStatus(); }
+
+#endif
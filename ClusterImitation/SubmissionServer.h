@@ -0,0 +1,131 @@
+#pragma once
+#include "Cluster.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+// Local submission server: accepts program calls and status queries over a Unix-domain socket.
+//
+// Binary protocol (host byte order, the peers always share a machine):
+//   Submit request:  [u8 Type = 1][u32 RequiredProcessors][u32 ExecutionTime][u16 NameLength][Name]
+//   Status request:  [u8 Type = 2]
+//   Submit reply:    [u8 Type = 1][u8 Accepted][u64 JobID]
+//   Status reply:    [u8 Type = 2][u64 Time][u64 Waiting][u64 Running][u64 Finished]
+// Requests can be pipelined, replies come in request order.
+//
+// All sockets are non-blocking and served from one epoll instance by a poller thread of the server, which reads
+// and parses requests as they arrive, also while a paced cluster sleeps between ticks. The batch is passed to the
+// cluster and answered once per tick, when the cluster drains its submission sources.
+// A client that sends faster than the cluster drains, or does not read its replies, is not read from until the
+// backlog is drained (MaxPendingRequests, MaxOutBufferSize), so its writes block instead of growing the server's memory.
+// Only supported on Linux, on other platforms the constructor throws.
+
+enum class ESubmissionMessage : uint8_t
+{
+	Submit = 1,
+	Status = 2
+};
+
+
+struct TSubmissionStatus
+{
+	uint64_t Time = 0;
+	uint64_t Waiting = 0;
+	uint64_t Running = 0;
+	uint64_t Finished = 0;
+};
+
+
+class CSubmissionServer : public ISubmissionSource
+{
+	struct TConnection
+	{
+		int FD;
+		std::vector<uint8_t> InBuffer;
+		std::vector<uint8_t> OutBuffer;
+
+		// Epoll events the connection is registered for, 0 - not registered (paused without anything to send)
+		uint32_t Events = 0;
+	};
+
+	struct TRequest
+	{
+		uint64_t ConnectionID;
+		ESubmissionMessage Type;
+		TProgramCall Call;
+	};
+
+	std::string SocketPath;
+	int ListenFD;
+	int EpollFD;
+	int WakeUpFD;
+
+	// Guards everything below, the poller thread only holds it while handling events
+	mutable std::mutex Mutex;
+	std::thread Poller;
+
+	// Connections by ID, IDs are never reused so a reply can not reach a connection that replaced a closed one
+	std::map<uint64_t, TConnection> Connections;
+	uint64_t NextConnectionID;
+
+	std::vector<TRequest> PendingRequests;
+
+	void PollLoop();
+	void AcceptConnections();
+	bool CanRead(const TConnection& Connection) const;
+	bool ReadConnection(uint64_t ConnectionID, TConnection& Connection, bool Closing);
+	bool ParseRequests(uint64_t ConnectionID, TConnection& Connection, bool Closing);
+	void AnswerRequests(CCluster& Cluster);
+	bool WriteConnection(uint64_t ConnectionID, TConnection& Connection);
+	void UpdateEvents(uint64_t ConnectionID, TConnection& Connection);
+	void CloseConnection(uint64_t ConnectionID);
+
+public:
+	// Parsed requests waiting for the next drain, and unsent reply bytes of a connection, beyond which nothing more is read
+	static constexpr size_t MaxPendingRequests = 65536;
+	static constexpr size_t MaxOutBufferSize = 1 << 20;
+
+	CSubmissionServer(const std::string& InSocketPath);
+	~CSubmissionServer();
+
+	CSubmissionServer(const CSubmissionServer&) = delete;
+	CSubmissionServer& operator=(const CSubmissionServer&) = delete;
+
+	size_t GetConnectionCount() const;
+	size_t GetPendingRequestCount() const;
+
+	// Called by the cluster once per tick: passes the gathered submissions to the cluster and replies
+	void DrainSubmissions(CCluster& Cluster) override;
+};
+
+
+// Blocking client of CSubmissionServer
+
+class CSubmissionClient
+{
+	int FD;
+	std::vector<uint8_t> OutBuffer;
+
+	void ReadExactly(void* OutData, size_t Size);
+
+public:
+	CSubmissionClient(const std::string& InSocketPath);
+	~CSubmissionClient();
+
+	CSubmissionClient(const CSubmissionClient&) = delete;
+	CSubmissionClient& operator=(const CSubmissionClient&) = delete;
+
+	// Queues a submission, it is sent with the next Flush
+	void Submit(const std::string& InName, uint32_t InRequiredProcessors, uint32_t InExecutionTime);
+	void Flush();
+
+	// Waits for the reply to the oldest unanswered submission, returns false if the cluster rejected the call
+	bool ReadAcknowledgement(uint64_t& OutJobID);
+
+	// Sends a status query and waits for its reply, replies to earlier submissions have to be read first
+	TSubmissionStatus QueryStatus();
+};
@@ -0,0 +1,140 @@
+#include "Topology.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+CTopology::CTopology(size_t InProcessorCount, const TTopologyShape& InShape) : ProcessorCount(InProcessorCount), Shape(InShape)
+{
+	if (InProcessorCount == 0 || InShape.ProcessorsPerSocket == 0 || InShape.SocketsPerNode == 0 || InShape.NodesPerRack == 0)
+		throw(std::runtime_error("Topology groups can not be empty!"));
+
+	GroupSizes[size_t(ETopologyLevel::Processor)] = 1;
+	GroupSizes[size_t(ETopologyLevel::Socket)] = InShape.ProcessorsPerSocket;
+	GroupSizes[size_t(ETopologyLevel::Node)] = InShape.ProcessorsPerSocket * InShape.SocketsPerNode;
+	GroupSizes[size_t(ETopologyLevel::Rack)] = GroupSizes[size_t(ETopologyLevel::Node)] * InShape.NodesPerRack;
+
+	// The cluster group is a whole number of racks
+	size_t RackCount = (InProcessorCount + GroupSizes[size_t(ETopologyLevel::Rack)] - 1) / GroupSizes[size_t(ETopologyLevel::Rack)];
+	GroupSizes[size_t(ETopologyLevel::Cluster)] = RackCount * GroupSizes[size_t(ETopologyLevel::Rack)];
+
+	for (size_t Level = 0; Level < TopologyLevelCount; Level++)
+		Eligible[Level].resize(GetGroupCount(Level));
+}
+
+
+ETopologyLevel CTopology::GetSpan(const std::set<unsigned>& InProcessors) const
+{
+	if (InProcessors.size() <= 1)
+		return ETopologyLevel::Processor;
+
+	// Processors of a group are consecutive, so the first and the last ones are enough
+	for (size_t Level = size_t(ETopologyLevel::Socket); Level < TopologyLevelCount; Level++)
+		if (*InProcessors.begin() / GroupSizes[Level] == *InProcessors.rbegin() / GroupSizes[Level])
+			return ETopologyLevel(Level);
+
+	return ETopologyLevel::Cluster;
+}
+
+
+size_t CTopology::ApplyCommunicationPenalty(size_t InRunTime, size_t InMaxRunTime, ETopologyLevel InSpan) const
+{
+	// Rounded up, with some room for the error of the multiplication
+	size_t RunTime = size_t(ceil(InRunTime * (1 + Shape.CommunicationPenalty[size_t(InSpan)]) - 1e-9));
+	return std::min(std::max(RunTime, InRunTime), InMaxRunTime);
+}
+
+
+std::vector<unsigned> CTopology::ChooseProcessors(const std::vector<uint8_t>& InEligible, size_t InCount)
+{
+	if (InEligible.size() != ProcessorCount)
+		throw(std::runtime_error("Eligible processors do not match the topology!"));
+
+	for (size_t Processor = 0; Processor < ProcessorCount; Processor++)
+		Eligible[0][Processor] = InEligible[Processor] != 0;
+
+	for (size_t Level = 1; Level < TopologyLevelCount; Level++)
+	{
+		size_t Ratio = GroupSizes[Level] / GroupSizes[Level - 1];
+		const std::vector<uint32_t>& Children = Eligible[Level - 1];
+
+		for (size_t Group = 0; Group < Eligible[Level].size(); Group++)
+		{
+			size_t End = std::min((Group + 1) * Ratio, Children.size());
+
+			uint32_t Count = 0;
+			for (size_t Child = Group * Ratio; Child < End; Child++)
+				Count += Children[Child];
+
+			Eligible[Level][Group] = Count;
+		}
+	}
+
+	std::vector<unsigned> Processors;
+	if (InCount == 0 || Eligible[size_t(ETopologyLevel::Cluster)][0] < InCount)
+		return Processors;
+
+	// The smallest level that has a group with enough processors, the fullest of its groups that do
+	for (size_t Level = size_t(ETopologyLevel::Socket); Level < TopologyLevelCount; Level++)
+	{
+		size_t Best = Eligible[Level].size();
+		for (size_t Group = 0; Group < Eligible[Level].size(); Group++)
+			if (Eligible[Level][Group] >= InCount && (Best == Eligible[Level].size() || Eligible[Level][Group] < Eligible[Level][Best]))
+				Best = Group;
+
+		if (Best != Eligible[Level].size())
+		{
+			Take(Level, Best, InCount, Processors);
+			break;
+		}
+	}
+
+	std::sort(Processors.begin(), Processors.end());
+	return Processors;
+}
+
+
+void CTopology::Take(size_t InLevel, size_t InGroup, size_t InCount, std::vector<unsigned>& OutProcessors) const
+{
+	if (InLevel == 0)
+	{
+		OutProcessors.push_back(unsigned(InGroup));
+		return;
+	}
+
+	size_t Ratio = GroupSizes[InLevel] / GroupSizes[InLevel - 1];
+	const std::vector<uint32_t>& Children = Eligible[InLevel - 1];
+
+	size_t Begin = InGroup * Ratio;
+	size_t End = std::min(Begin + Ratio, Children.size());
+
+	// A single child when one fits, the fullest of them
+	size_t Best = End;
+	for (size_t Child = Begin; Child < End; Child++)
+		if (Children[Child] >= InCount && (Best == End || Children[Child] < Children[Best]))
+			Best = Child;
+
+	if (Best != End)
+	{
+		Take(InLevel - 1, Best, InCount, OutProcessors);
+		return;
+	}
+
+	// Otherwise as few children as possible, the emptiest first
+	std::vector<size_t> Order;
+	for (size_t Child = Begin; Child < End; Child++)
+		if (Children[Child] != 0)
+			Order.push_back(Child);
+
+	std::stable_sort(Order.begin(), Order.end(), [&](size_t A, size_t B) { return Children[A] > Children[B]; });
+
+	for (size_t Child : Order)
+	{
+		size_t Count = std::min<size_t>(Children[Child], InCount);
+		Take(InLevel - 1, Child, Count, OutProcessors);
+
+		InCount -= Count;
+		if (InCount == 0)
+			break;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+
+// Groups of processors, from the smallest one up. Processors of a group have consecutive IDs.
+enum class ETopologyLevel
+{
+	Processor,
+	Socket,
+	Node,
+	Rack,
+	Cluster
+};
+
+const size_t TopologyLevelCount = 5;
+
+
+struct TTopologyShape
+{
+	size_t ProcessorsPerSocket = 1;
+	size_t SocketsPerNode = 1;
+	size_t NodesPerRack = 1;
+
+	// Extra run time of a simulated program, as a share of its run time, by its span (the smallest group holding all of its processors)
+	std::array<double, TopologyLevelCount> CommunicationPenalty = { 0, 0, 0.05, 0.2, 0.5 };
+};
+
+
+// Processor tree of the cluster. Places programs into the smallest group that fits them,
+// the fullest one of its level, so that the emptier groups are kept whole for wider programs.
+class CTopology
+{
+	size_t ProcessorCount = 0;
+	TTopologyShape Shape;
+
+	// Processors in one group of each level, the cluster group holds all of them
+	std::array<size_t, TopologyLevelCount> GroupSizes = {};
+
+	// Eligible processors per group of each level, recounted for every placement
+	std::array<std::vector<uint32_t>, TopologyLevelCount> Eligible;
+
+	size_t GetGroupCount(size_t InLevel) const { return (ProcessorCount + GroupSizes[InLevel] - 1) / GroupSizes[InLevel]; }
+	void Take(size_t InLevel, size_t InGroup, size_t InCount, std::vector<unsigned>& OutProcessors) const;
+
+public:
+	CTopology() {}
+	CTopology(size_t InProcessorCount, const TTopologyShape& InShape);
+
+	// Without a shape every processor is its own socket, node and rack
+	bool IsSet() const { return ProcessorCount != 0; }
+
+	const TTopologyShape& GetShape() const { return Shape; }
+
+	size_t GetGroup(unsigned InProcessor, ETopologyLevel InLevel) const { return InProcessor / GroupSizes[size_t(InLevel)]; }
+	ETopologyLevel GetSpan(const std::set<unsigned>& InProcessors) const;
+
+	// Run time of a simulated program with the given span, up to InMaxRunTime
+	size_t ApplyCommunicationPenalty(size_t InRunTime, size_t InMaxRunTime, ETopologyLevel InSpan) const;
+
+	// InCount of the processors marked in InEligible (one flag per processor), empty when there are not enough
+	std::vector<unsigned> ChooseProcessors(const std::vector<uint8_t>& InEligible, size_t InCount);
+};
@@ -0,0 +1,183 @@
+#include "WaitingCallFields.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+CWaitingCallFields::TChunk& CWaitingCallFields::GetMutableChunk(size_t Index)
+{
+	std::shared_ptr<TChunk>& Chunk = Chunks[Index];
+	if (Chunk.use_count() > 1)
+		Chunk = std::make_shared<TChunk>(*Chunk);
+
+	return *Chunk;
+}
+
+
+void CWaitingCallFields::Put(size_t TimeCalled, size_t ExecutionTime, size_t RequiredProcessors, uint32_t UserID, int32_t Priority, size_t Deadline,
+	size_t CriticalPath)
+{
+	size_t Position = Head + Size;
+	if (Position / ChunkSize == Chunks.size())
+		Chunks.push_back(std::make_shared<TChunk>());
+
+	TChunk& Chunk = GetMutableChunk(Position / ChunkSize);
+	size_t Slot = Position % ChunkSize;
+
+	Chunk.TimeCalled[Slot] = TimeCalled;
+	Chunk.ExecutionTime[Slot] = ExecutionTime;
+	Chunk.TimeCalled32[Slot] = uint32_t(std::min<size_t>(TimeCalled, UINT32_MAX));
+	Chunk.ExecutionTime32[Slot] = uint32_t(std::min<size_t>(ExecutionTime, UINT32_MAX));
+
+	// Processor IDs are unsigned, so no cluster can have more processors than fit here
+	Chunk.RequiredProcessors[Slot] = uint32_t(std::min<size_t>(RequiredProcessors, UINT32_MAX));
+	Chunk.UserID[Slot] = UserID;
+	Chunk.Priority[Slot] = Priority;
+	Chunk.Deadline[Slot] = Deadline;
+	Chunk.CriticalPath[Slot] = CriticalPath;
+
+	MaxExecutionTime = std::max(MaxExecutionTime, ExecutionTime);
+	MaxRequiredProcessors = std::max(MaxRequiredProcessors, size_t(Chunk.RequiredProcessors[Slot]));
+
+	Size++;
+}
+
+
+// Copies one entry between physical positions
+void CWaitingCallFields::CopyEntry(size_t From, size_t To)
+{
+	const TChunk& Source = *Chunks[From / ChunkSize];
+	TChunk& Target = GetMutableChunk(To / ChunkSize);
+
+	size_t FromSlot = From % ChunkSize;
+	size_t ToSlot = To % ChunkSize;
+
+	Target.TimeCalled[ToSlot] = Source.TimeCalled[FromSlot];
+	Target.ExecutionTime[ToSlot] = Source.ExecutionTime[FromSlot];
+	Target.RequiredProcessors[ToSlot] = Source.RequiredProcessors[FromSlot];
+	Target.UserID[ToSlot] = Source.UserID[FromSlot];
+	Target.Priority[ToSlot] = Source.Priority[FromSlot];
+	Target.Deadline[ToSlot] = Source.Deadline[FromSlot];
+	Target.CriticalPath[ToSlot] = Source.CriticalPath[FromSlot];
+	Target.TimeCalled32[ToSlot] = Source.TimeCalled32[FromSlot];
+	Target.ExecutionTime32[ToSlot] = Source.ExecutionTime32[FromSlot];
+}
+
+
+void CWaitingCallFields::Pop(size_t Pos)
+{
+	if (Size <= Pos)
+		throw(std::runtime_error("Queue pop index out of range!"));
+
+	// Calls in front of the popped one move one place back, the queue then starts one place later
+	size_t Target = Head + Pos;
+	while (Target > Head)
+	{
+		size_t Slot = Target % ChunkSize;
+
+		if (Slot == 0)
+		{
+			CopyEntry(Target - 1, Target);
+			Target--;
+			continue;
+		}
+
+		size_t Count = std::min(Slot, Target - Head);
+		TChunk& Chunk = GetMutableChunk(Target / ChunkSize);
+
+		memmove(Chunk.TimeCalled + Slot - Count + 1, Chunk.TimeCalled + Slot - Count, Count * sizeof(uint64_t));
+		memmove(Chunk.ExecutionTime + Slot - Count + 1, Chunk.ExecutionTime + Slot - Count, Count * sizeof(uint64_t));
+		memmove(Chunk.RequiredProcessors + Slot - Count + 1, Chunk.RequiredProcessors + Slot - Count, Count * sizeof(uint32_t));
+		memmove(Chunk.UserID + Slot - Count + 1, Chunk.UserID + Slot - Count, Count * sizeof(uint32_t));
+		memmove(Chunk.Priority + Slot - Count + 1, Chunk.Priority + Slot - Count, Count * sizeof(int32_t));
+		memmove(Chunk.Deadline + Slot - Count + 1, Chunk.Deadline + Slot - Count, Count * sizeof(uint64_t));
+		memmove(Chunk.CriticalPath + Slot - Count + 1, Chunk.CriticalPath + Slot - Count, Count * sizeof(uint64_t));
+		memmove(Chunk.TimeCalled32 + Slot - Count + 1, Chunk.TimeCalled32 + Slot - Count, Count * sizeof(uint32_t));
+		memmove(Chunk.ExecutionTime32 + Slot - Count + 1, Chunk.ExecutionTime32 + Slot - Count, Count * sizeof(uint32_t));
+
+		Target -= Count;
+	}
+
+	Head++;
+	Size--;
+
+	if (Size == 0)
+		Clear();
+
+	else if (Head == ChunkSize)
+	{
+		Chunks.erase(Chunks.begin());
+		Head = 0;
+	}
+}
+
+
+void CWaitingCallFields::Clear()
+{
+	Chunks.clear();
+	Head = 0;
+	Size = 0;
+
+	MaxExecutionTime = 0;
+	MaxRequiredProcessors = 0;
+}
+
+
+size_t CWaitingCallFields::FindEarliestDeadline(size_t Count) const
+{
+	Count = std::min(Count, Size);
+
+	size_t Index = SIZE_MAX;
+	uint64_t Earliest = UINT64_MAX;
+
+	for (size_t Begin = 0; Begin < Count;)
+	{
+		const TChunk& Chunk = *Chunks[(Head + Begin) / ChunkSize];
+		size_t First = (Head + Begin) % ChunkSize;
+		size_t End = std::min(Count, Begin + ChunkSize - First);
+
+		for (size_t i = Begin; i < End; i++)
+		{
+			uint64_t Deadline = Chunk.Deadline[First + i - Begin];
+			if (Deadline != 0 && Deadline < Earliest)
+			{
+				Index = i;
+				Earliest = Deadline;
+			}
+		}
+
+		Begin = End;
+	}
+
+	return Index;
+}
+
+
+size_t CWaitingCallFields::FindLongestCriticalPath(size_t Count) const
+{
+	Count = std::min(Count, Size);
+
+	size_t Index = SIZE_MAX;
+	uint64_t Longest = 0;
+
+	for (size_t Begin = 0; Begin < Count;)
+	{
+		const TChunk& Chunk = *Chunks[(Head + Begin) / ChunkSize];
+		size_t First = (Head + Begin) % ChunkSize;
+		size_t End = std::min(Count, Begin + ChunkSize - First);
+
+		for (size_t i = Begin; i < End; i++)
+		{
+			uint64_t CriticalPath = Chunk.CriticalPath[First + i - Begin];
+			if (CriticalPath > Longest)
+			{
+				Index = i;
+				Longest = CriticalPath;
+			}
+		}
+
+		Begin = End;
+	}
+
+	return Index;
+}
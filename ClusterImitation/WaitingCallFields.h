@@ -0,0 +1,227 @@
+#pragma once
+#include "ScoreWeights.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// Scratch buffers of the window scoring
+struct TWaitingCallScores
+{
+	std::vector<int32_t> IntegerScores;
+	std::vector<float> Scores;
+};
+
+
+// Numeric fields of the waiting calls in queue order, kept next to the call queue as arrays,
+// so that a whole analysis window is scored in one pass. Stored in chunks shared between copies until changed.
+class CWaitingCallFields
+{
+public:
+	static const size_t ChunkSize = 256;
+
+private:
+	struct TChunk
+	{
+		uint64_t TimeCalled[ChunkSize];
+		uint64_t ExecutionTime[ChunkSize];
+		uint32_t RequiredProcessors[ChunkSize];
+		uint32_t UserID[ChunkSize];
+		int32_t Priority[ChunkSize];
+
+		// Absolute tick, 0 - none
+		uint64_t Deadline[ChunkSize];
+
+		// Critical path of a workflow job (see CWorkflow), 0 - not a workflow job
+		uint64_t CriticalPath[ChunkSize];
+
+		// Narrow copies for the integer scores (saturated, exact whenever integer scores are used)
+		uint32_t TimeCalled32[ChunkSize];
+		uint32_t ExecutionTime32[ChunkSize];
+	};
+
+	std::vector<std::shared_ptr<TChunk>> Chunks;
+
+	// Position of the first call in the first chunk
+	size_t Head;
+	size_t Size;
+
+	// Largest values put since the queue was last empty, they bound the scores
+	size_t MaxExecutionTime;
+	size_t MaxRequiredProcessors;
+
+	TChunk& GetMutableChunk(size_t Index);
+	void CopyEntry(size_t From, size_t To);
+
+	// Scores below 2^24 are exact both as floats and as integers, so then the float score can be computed with integers
+	template<class TWeights>
+	bool HasExactIntegerScores(const TWeights& Weights, size_t Depth, size_t CurrentTime) const
+	{
+		const size_t Limit = size_t(1) << 24;
+
+		const size_t Values[] = { Depth, CurrentTime, MaxExecutionTime, MaxRequiredProcessors };
+		const size_t Factors[] = { Weights.Position, Weights.Waiting, Weights.ExecutionTime, Weights.Processors };
+
+		size_t Bound = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (Values[i] > Limit || (Factors[i] != 0 && Values[i] > Limit / Factors[i]))
+				return false;
+
+			Bound += Values[i] * Factors[i];
+			if (Bound > Limit)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Scores the calls at positions [Begin, End) that lie in one chunk
+	template<class TWeights>
+	void ScoreRangeInteger(const TWeights& Weights, size_t Begin, size_t End, size_t Depth, size_t CurrentTime, size_t FreeProcessors, int32_t* OutScores) const
+	{
+		const TChunk& Chunk = *Chunks[(Head + Begin) / ChunkSize];
+		size_t First = (Head + Begin) % ChunkSize;
+
+		const uint32_t* TimeCalled = Chunk.TimeCalled32 + First;
+		const uint32_t* ExecutionTime = Chunk.ExecutionTime32 + First;
+		const uint32_t* RequiredProcessors = Chunk.RequiredProcessors + First;
+
+		const int32_t PositionWeight = int32_t(Weights.Position);
+		const int32_t WaitingWeight = int32_t(Weights.Waiting);
+		const int32_t ExecutionTimeWeight = int32_t(Weights.ExecutionTime);
+		const int32_t ProcessorsWeight = int32_t(Weights.Processors);
+
+		const int32_t Position = int32_t(Depth - Begin);
+		const int32_t Time = int32_t(CurrentTime);
+
+		// No call requires more than MaxRequiredProcessors, so the comparison keeps its result
+		const int32_t Free = int32_t(std::min(FreeProcessors, MaxRequiredProcessors));
+
+		int32_t Count = int32_t(End - Begin);
+		for (int32_t i = 0; i < Count; i++)
+		{
+			int32_t Required = int32_t(RequiredProcessors[i]);
+
+			int32_t Score = (Position - i) * PositionWeight;
+			Score += (Time - int32_t(TimeCalled[i])) * WaitingWeight;
+			Score -= int32_t(ExecutionTime[i]) * ExecutionTimeWeight;
+			Score -= Free < Required ? Required * ProcessorsWeight : 0;
+
+			OutScores[i] = Score;
+		}
+	}
+
+	// Same float operations as CCluster::EvaluateWaitingCallScore
+	template<class TWeights>
+	void ScoreRangeFloat(const TWeights& Weights, size_t Begin, size_t End, size_t Depth, size_t CurrentTime, size_t FreeProcessors,
+		const float* UserPenalties, float* OutScores) const
+	{
+		const TChunk& Chunk = *Chunks[(Head + Begin) / ChunkSize];
+		size_t First = (Head + Begin) % ChunkSize;
+
+		const uint64_t* TimeCalled = Chunk.TimeCalled + First;
+		const uint64_t* ExecutionTime = Chunk.ExecutionTime + First;
+		const uint32_t* RequiredProcessors = Chunk.RequiredProcessors + First;
+		const uint32_t* UserID = Chunk.UserID + First;
+		const int32_t* Priority = Chunk.Priority + First;
+
+		size_t Count = End - Begin;
+		for (size_t i = 0; i < Count; i++)
+		{
+			float Score = 0;
+			Score += (Depth - Begin - i) * Weights.Position;
+			Score += (CurrentTime - TimeCalled[i]) * Weights.Waiting;
+			Score -= ExecutionTime[i] * Weights.ExecutionTime;
+			if (FreeProcessors < RequiredProcessors[i])
+				Score -= RequiredProcessors[i] * Weights.Processors;
+
+			if (Weights.Priority != 0)
+				Score += float(Priority[i]) * Weights.Priority;
+			if (Weights.FairShare != 0 && UserPenalties)
+				Score -= UserPenalties[UserID[i]] * Weights.FairShare;
+
+			OutScores[i] = Score;
+		}
+	}
+
+public:
+	CWaitingCallFields() : Head(0), Size(0), MaxExecutionTime(0), MaxRequiredProcessors(0) {}
+
+	bool empty() const { return Size == 0; }
+	size_t size() const { return Size; }
+
+	void Put(size_t TimeCalled, size_t ExecutionTime, size_t RequiredProcessors, uint32_t UserID = 0, int32_t Priority = 0, size_t Deadline = 0,
+		size_t CriticalPath = 0);
+	void Pop(size_t Pos = 0);
+	void Clear();
+
+	uint32_t GetUserID(size_t Pos) const { return Chunks[(Head + Pos) / ChunkSize]->UserID[(Head + Pos) % ChunkSize]; }
+
+	// Position of the first of the earliest deadlines among the first Count calls, SIZE_MAX if none of them has one
+	size_t FindEarliestDeadline(size_t Count) const;
+
+	// Position of the first of the longest critical paths among the first Count calls, SIZE_MAX if none of them is a workflow job
+	size_t FindLongestCriticalPath(size_t Count) const;
+
+	// Scores the first Count calls like CCluster::EvaluateWaitingCallScore with the given weights
+	// and returns the position of the first one with the highest score. The fair share term needs the penalties by user ID.
+	template<class TWeights>
+	size_t FindTop(const TWeights& Weights, size_t Count, size_t Depth, size_t CurrentTime, size_t FreeProcessors, TWaitingCallScores& Scratch,
+		const float* UserPenalties = nullptr) const
+	{
+		Count = std::min(Count, Size);
+
+		if (Weights.Priority == 0 && Weights.FairShare == 0 && HasExactIntegerScores(Weights, Depth, CurrentTime))
+		{
+			if (Scratch.IntegerScores.size() < Count)
+				Scratch.IntegerScores.resize(Count);
+
+			for (size_t Begin = 0; Begin < Count;)
+			{
+				size_t End = std::min(Count, Begin + ChunkSize - (Head + Begin) % ChunkSize);
+				ScoreRangeInteger(Weights, Begin, End, Depth, CurrentTime, FreeProcessors, Scratch.IntegerScores.data() + Begin);
+				Begin = End;
+			}
+
+			// Maximum first, as a reduction without branches, then its first position
+			const int32_t* Scores = Scratch.IntegerScores.data();
+			int32_t MaxScore = INT32_MIN;
+			for (size_t i = 0; i < Count; i++)
+				MaxScore = std::max(MaxScore, Scores[i]);
+
+			for (size_t i = 0; i < Count; i++)
+				if (Scores[i] == MaxScore)
+					return i;
+
+			return 0;
+		}
+
+		if (Scratch.Scores.size() < Count)
+			Scratch.Scores.resize(Count);
+
+		for (size_t Begin = 0; Begin < Count;)
+		{
+			size_t End = std::min(Count, Begin + ChunkSize - (Head + Begin) % ChunkSize);
+			ScoreRangeFloat(Weights, Begin, End, Depth, CurrentTime, FreeProcessors, UserPenalties, Scratch.Scores.data() + Begin);
+			Begin = End;
+		}
+
+		// The first of the highest scores, as the scalar search that only replaces its pick on a strictly higher score
+		size_t Index = 0;
+		float MaxScore = LowestWaitingCallScore;
+
+		for (size_t i = 0; i < Count; i++)
+		{
+			if (Scratch.Scores[i] > MaxScore)
+			{
+				Index = i;
+				MaxScore = Scratch.Scores[i];
+			}
+		}
+
+		return Index;
+	}
+};
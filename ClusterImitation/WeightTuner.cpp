@@ -0,0 +1,425 @@
+#include "WeightTuner.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <random>
+#include <sstream>
+#include <thread>
+
+
+std::vector<TWorkloadJob> GenerateWorkload(const TWorkloadParameters& InParameters, size_t InProcessorCount, uint32_t InSeed)
+{
+	std::mt19937 Random(InSeed);
+	std::vector<TWorkloadJob> Jobs;
+
+	for (size_t Time = 0; Time < InParameters.Duration; Time++)
+	{
+		for (size_t i = 0; i < InParameters.MaxNewProgramsPerTick; i++)
+		{
+			float Rand = float(Random() % 100) / 100.f;
+
+			if (Rand > InParameters.SpawnThreshold)
+			{
+				TWorkloadJob Job;
+				Job.SubmitTime = Time;
+				Job.RequiredProcessors = std::min(InProcessorCount, size_t(1 + size_t(9 * pow(Rand, 3)) * InParameters.RequiredProcessorsMultiplier));
+				Job.ExecutionTime = size_t(1 + 25 * pow(Rand, 4) * InParameters.ExecutionTimeMultiplier);
+
+				Jobs.push_back(Job);
+			}
+		}
+	}
+
+	return Jobs;
+}
+
+
+std::vector<TWorkloadJob> ParseSwfWorkload(std::istream& InStream, size_t InProcessorCount, double InSecondsPerTick)
+{
+	if (InSecondsPerTick <= 0)
+		throw(std::runtime_error("Seconds per tick must be positive!"));
+
+	struct TRecord
+	{
+		double SubmitTime;
+		double RunTime;
+		double RequestedTime;
+		long long Processors;
+	};
+
+	std::vector<TRecord> Records;
+	std::string Line;
+
+	while (std::getline(InStream, Line))
+	{
+		size_t First = Line.find_first_not_of(" \t\r");
+		if (First == std::string::npos || Line[First] == ';')
+			continue;
+
+		std::istringstream Fields(Line);
+		double Values[9];
+
+		int Count = 0;
+		while (Count < 9 && Fields >> Values[Count])
+			Count++;
+
+		if (Count < 9)
+			throw(std::runtime_error("SWF record has less than 9 fields!"));
+
+		// -1 marks a missing value
+		long long Processors = Values[7] > 0 ? (long long)Values[7] : (long long)Values[4];
+		if (Values[1] < 0 || Values[3] <= 0 || Processors <= 0 || size_t(Processors) > InProcessorCount)
+			continue;
+
+		Records.push_back({ Values[1], Values[3], Values[8] > 0 ? Values[8] : Values[3], Processors });
+	}
+
+	std::vector<TWorkloadJob> Jobs;
+	if (Records.empty())
+		return Jobs;
+
+	// Traces start at an arbitrary time, the workload starts with its first job
+	double StartTime = std::min_element(Records.begin(), Records.end(), [](const TRecord& A, const TRecord& B) { return A.SubmitTime < B.SubmitTime; })->SubmitTime;
+
+	for (auto& Record : Records)
+	{
+		TWorkloadJob Job;
+		Job.SubmitTime = size_t((Record.SubmitTime - StartTime) / InSecondsPerTick);
+		Job.ActualExecutionTime = std::max(size_t(1), size_t(ceil(Record.RunTime / InSecondsPerTick)));
+		Job.ExecutionTime = std::max(size_t(1), size_t(ceil(Record.RequestedTime / InSecondsPerTick)));
+		Job.RequiredProcessors = size_t(Record.Processors);
+
+		Jobs.push_back(Job);
+	}
+
+	std::stable_sort(Jobs.begin(), Jobs.end(), [](const TWorkloadJob& A, const TWorkloadJob& B) { return A.SubmitTime < B.SubmitTime; });
+	return Jobs;
+}
+
+
+std::vector<TWorkloadJob> LoadSwfWorkload(const std::string& InPath, size_t InProcessorCount, double InSecondsPerTick)
+{
+	std::ifstream Stream(InPath);
+	if (!Stream)
+		throw(std::runtime_error("Can not open workload trace " + InPath + "!"));
+
+	return ParseSwfWorkload(Stream, InProcessorCount, InSecondsPerTick);
+}
+
+
+void CWorkloadSource::DrainSubmissions(CCluster& Cluster)
+{
+	for (; NextJob < Jobs.size() && Jobs[NextJob].SubmitTime <= Cluster.GetCurrentTime(); NextJob++)
+	{
+		TProgramCall Call("Job" + std::to_string(NextJob), Jobs[NextJob].RequiredProcessors, Jobs[NextJob].ExecutionTime, Jobs[NextJob].ActualExecutionTime);
+		Call.Priority = Jobs[NextJob].Priority;
+		Call.User = Jobs[NextJob].User;
+		Call.Deadline = Jobs[NextJob].Deadline;
+
+		Cluster.CallProgramExecution(Call);
+	}
+}
+
+
+static const char* GetMetricName(ETuningMetric InMetric)
+{
+	switch (InMetric)
+	{
+	case ETuningMetric::MeanWait: return "mean wait";
+	case ETuningMetric::P99Slowdown: return "p99 slowdown";
+	case ETuningMetric::Utilization: return "utilization";
+	}
+
+	return "";
+}
+
+
+// Scores are minimized, utilization is reported as it is
+static double GetMetricValue(ETuningMetric InMetric, double InScore)
+{
+	return InMetric == ETuningMetric::Utilization ? -InScore : InScore;
+}
+
+
+static std::ostream& PrintWeights(std::ostream& OutStream, const TScoreWeights& InWeights)
+{
+	return OutStream << "Position " << InWeights.Position << ", Waiting " << InWeights.Waiting
+		<< ", Execution Time " << InWeights.ExecutionTime << ", Processors " << InWeights.Processors;
+}
+
+
+std::ostream& operator<<(std::ostream& OutStream, const TTuningResult& InResult)
+{
+	OutStream << "Metric: " << GetMetricName(InResult.Metric) << ";" << std::endl
+		<< "Workloads: " << InResult.WorkloadCount << ", Simulations: " << InResult.Evaluations << ";" << std::endl
+		<< "Best Weights: ";
+	PrintWeights(OutStream, InResult.BestWeights) << ";" << std::endl;
+
+	OutStream << "Best: " << GetMetricValue(InResult.Metric, InResult.BestScore)
+		<< ", Default: " << GetMetricValue(InResult.Metric, InResult.DefaultScore) << ";" << std::endl
+		<< std::endl << "Finalists: " << std::endl << std::endl;
+
+	for (auto& Candidate : InResult.Finalists)
+	{
+		PrintWeights(OutStream, Candidate.Weights) << " : " << GetMetricValue(InResult.Metric, Candidate.Score)
+			<< " on " << Candidate.WorkloadCount << " workloads;" << std::endl;
+	}
+
+	return OutStream;
+}
+
+
+CWeightTuner::CWeightTuner(const TTuningSettings& InSettings, std::vector<std::vector<TWorkloadJob>> InWorkloads)
+{
+	if (InWorkloads.empty())
+		throw(std::runtime_error("Tuning needs at least one workload!"));
+
+	if (InSettings.ProcessorCount == 0)
+		throw(std::runtime_error("Tuning cluster must have processors!"));
+
+	if (InSettings.Reduction < 2)
+		throw(std::runtime_error("Successive halving must drop candidates each round!"));
+
+	for (auto& Workload : InWorkloads)
+	{
+		std::stable_sort(Workload.begin(), Workload.end(), [](const TWorkloadJob& A, const TWorkloadJob& B) { return A.SubmitTime < B.SubmitTime; });
+
+		for (auto& Job : Workload)
+			if (Job.RequiredProcessors == 0 || Job.RequiredProcessors > InSettings.ProcessorCount || Job.ExecutionTime == 0)
+				throw(std::runtime_error("Workload job can not run on the tuning cluster!"));
+	}
+
+	Settings = InSettings;
+	Workloads = std::move(InWorkloads);
+}
+
+
+size_t CWeightTuner::GetRunTime(const std::vector<TWorkloadJob>& InJobs) const
+{
+	if (InJobs.empty())
+		return 0;
+
+	if (Settings.DrainTicks != 0)
+		return InJobs.back().SubmitTime + Settings.DrainTicks;
+
+	size_t Work = 0;
+	size_t LongestJob = 0;
+
+	for (auto& Job : InJobs)
+	{
+		Work += Job.RequiredProcessors * Job.ExecutionTime;
+		LongestJob = std::max(LongestJob, Job.ExecutionTime);
+	}
+
+	return InJobs.back().SubmitTime + 2 * (Work / Settings.ProcessorCount + 1) + LongestJob;
+}
+
+
+static void OnTuningClusterUpdated(CCluster*) {}
+
+
+double CWeightTuner::Evaluate(const TScoreWeights& InWeights, size_t InWorkload) const
+{
+	const std::vector<TWorkloadJob>& Jobs = Workloads.at(InWorkload);
+	if (Jobs.empty())
+		return 0;
+
+	CCluster Cluster(GetRunTime(Jobs), Settings.ProcessorCount, Settings.QueueAnalysisDepth, Settings.MaxProgramsStartPerTick);
+	Cluster.SetScoreWeights(InWeights);
+
+	if (Settings.PredictRuntime)
+		Cluster.EnableRuntimePrediction();
+
+	CWorkloadSource Source(Jobs);
+	Cluster.AddSubmissionSource(&Source);
+
+	double TotalWait = 0;
+	std::vector<double> Slowdowns;
+	Slowdowns.reserve(Jobs.size());
+
+	size_t UsedProcessorTime = 0;
+	size_t LastFinish = 0;
+
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+	{
+		size_t Wait = InCluster->GetCurrentTime() - InCall.TimeCalled;
+
+		TotalWait += Wait;
+		Slowdowns.push_back(double(Wait + InCall.GetRunTime()) / InCall.GetRunTime());
+
+		UsedProcessorTime += InCall.RequiredProcessors * InCall.GetRunTime();
+		LastFinish = std::max(LastFinish, InCluster->GetCurrentTime() + InCall.GetRunTime());
+	});
+
+	Cluster.Start(OnTuningClusterUpdated);
+	Cluster.RemoveSubmissionSource(&Source);
+
+	// Jobs that never started count with the time they have waited so far
+	size_t EndTime = Cluster.GetCurrentTime();
+	const TPersistentQueue<TProgramCall>& Waiting = Cluster.GetWaitingProgramCalls();
+
+	Waiting.ForEach([&](const TProgramCall& Call)
+	{
+		size_t Wait = EndTime - Call.TimeCalled;
+
+		TotalWait += Wait;
+		Slowdowns.push_back(double(Wait + Call.GetRunTime()) / Call.GetRunTime());
+	});
+
+	switch (Settings.Metric)
+	{
+	case ETuningMetric::MeanWait:
+		return TotalWait / Jobs.size();
+
+	case ETuningMetric::P99Slowdown:
+	{
+		size_t Rank = std::min(Slowdowns.size() - 1, size_t(ceil(0.99 * Slowdowns.size())) - 1);
+		std::nth_element(Slowdowns.begin(), Slowdowns.begin() + Rank, Slowdowns.end());
+		return Slowdowns[Rank];
+	}
+
+	case ETuningMetric::Utilization:
+	{
+		size_t Span = Waiting.empty() ? LastFinish : std::max(LastFinish, EndTime);
+		return -double(UsedProcessorTime) / (double(Span) * Settings.ProcessorCount);
+	}
+	}
+
+	return 0;
+}
+
+
+size_t CWeightTuner::EvaluateMissing(const std::vector<TScoreWeights>& InCandidates, const std::vector<size_t>& InActive, size_t InWorkloadCount,
+	std::vector<std::vector<double>>& InOutScores) const
+{
+	std::vector<std::pair<size_t, size_t>> Runs;
+	for (size_t Candidate : InActive)
+		for (size_t Workload = 0; Workload < InWorkloadCount; Workload++)
+			if (std::isnan(InOutScores[Candidate][Workload]))
+				Runs.push_back({ Candidate, Workload });
+
+	if (Runs.empty())
+		return 0;
+
+	size_t ThreadCount = Settings.ThreadCount != 0 ? Settings.ThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	ThreadCount = std::min(ThreadCount, Runs.size());
+
+	// Every worker takes the next run until none are left, each run writes only its own score
+	std::atomic<size_t> NextRun(0);
+	std::vector<std::promise<void>> Done(ThreadCount);
+	std::vector<std::future<void>> Results;
+
+	{
+		CWorkerPool Pool(ThreadCount);
+
+		for (size_t Slot = 0; Slot < ThreadCount; Slot++)
+		{
+			Results.push_back(Done[Slot].get_future());
+
+			Pool.Submit(Slot, [&, Slot]()
+			{
+				try
+				{
+					for (size_t Run = NextRun++; Run < Runs.size(); Run = NextRun++)
+						InOutScores[Runs[Run].first][Runs[Run].second] = Evaluate(InCandidates[Runs[Run].first], Runs[Run].second);
+
+					Done[Slot].set_value();
+				}
+
+				catch (...)
+				{
+					NextRun = Runs.size();
+					Done[Slot].set_exception(std::current_exception());
+				}
+			});
+		}
+
+		for (auto& Result : Results)
+			Result.wait();
+	}
+
+	for (auto& Result : Results)
+		Result.get();
+
+	return Runs.size();
+}
+
+
+TTuningResult CWeightTuner::Tune() const
+{
+	// The default weights are the first candidate, the others are drawn uniformly
+	std::vector<TScoreWeights> Candidates(1, TDefaultScoreWeights());
+
+	std::mt19937 Random(Settings.SearchSeed);
+	std::uniform_int_distribution<size_t> Weight(0, Settings.MaxWeight);
+
+	while (Candidates.size() < std::max(Settings.CandidateCount, size_t(1)))
+	{
+		TScoreWeights Candidate;
+		Candidate.Position = Weight(Random);
+		Candidate.Waiting = Weight(Random);
+		Candidate.ExecutionTime = Weight(Random);
+		Candidate.Processors = Weight(Random);
+
+		Candidates.push_back(Candidate);
+	}
+
+	std::vector<std::vector<double>> Scores(Candidates.size(), std::vector<double>(Workloads.size(), NAN));
+
+	auto MeanScore = [&](size_t Candidate, size_t WorkloadCount)
+	{
+		double Sum = 0;
+		for (size_t Workload = 0; Workload < WorkloadCount; Workload++)
+			Sum += Scores[Candidate][Workload];
+
+		return Sum / WorkloadCount;
+	};
+
+	TTuningResult Result;
+	Result.Metric = Settings.Metric;
+	Result.WorkloadCount = Workloads.size();
+
+	std::vector<size_t> Active(Candidates.size());
+	for (size_t i = 0; i < Active.size(); i++)
+		Active[i] = i;
+
+	// Each round ranks the remaining candidates on more workloads and keeps the best of them, ties keep the earlier candidate
+	size_t WorkloadCount = 1;
+	while (true)
+	{
+		Result.Evaluations += EvaluateMissing(Candidates, Active, WorkloadCount, Scores);
+
+		std::stable_sort(Active.begin(), Active.end(), [&](size_t A, size_t B) { return MeanScore(A, WorkloadCount) < MeanScore(B, WorkloadCount); });
+
+		if (Active.size() > 1 || Result.Finalists.empty())
+		{
+			Result.Finalists.clear();
+			for (size_t Candidate : Active)
+				Result.Finalists.push_back({ Candidates[Candidate], MeanScore(Candidate, WorkloadCount), WorkloadCount });
+		}
+
+		if (Active.size() == 1)
+			break;
+
+		Active.resize((Active.size() + Settings.Reduction - 1) / Settings.Reduction);
+		WorkloadCount = std::min(Workloads.size(), WorkloadCount * Settings.Reduction);
+	}
+
+	// The winner and the default weights are compared on all workloads, so tuning never ends up worse than the defaults
+	std::vector<size_t> Final = { Active[0], 0 };
+	Result.Evaluations += EvaluateMissing(Candidates, Final, Workloads.size(), Scores);
+
+	Result.DefaultScore = MeanScore(0, Workloads.size());
+	Result.BestScore = MeanScore(Active[0], Workloads.size());
+	Result.BestWeights = Candidates[Active[0]];
+
+	if (Result.DefaultScore <= Result.BestScore)
+	{
+		Result.BestScore = Result.DefaultScore;
+		Result.BestWeights = Candidates[0];
+	}
+
+	return Result;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include "Cluster.h"
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+
+// Program call of a recorded or generated workload, made at SubmitTime
+struct TWorkloadJob
+{
+	size_t SubmitTime = 0;
+	size_t RequiredProcessors = 1;
+	size_t ExecutionTime = 1;
+
+	// 0 - the job runs for the whole requested ExecutionTime
+	size_t ActualExecutionTime = 0;
+
+	int32_t Priority = 0;
+	std::string User;
+
+	// Absolute tick, 0 - none
+	size_t Deadline = 0;
+};
+
+
+// Random workload of the imitation environment (see OnClusterUpdated in ImitationEnvironment.cpp)
+struct TWorkloadParameters
+{
+	size_t Duration = 100;
+	size_t MaxNewProgramsPerTick = 10;
+
+	float SpawnThreshold = 0.5f;
+	float RequiredProcessorsMultiplier = 1.f;
+	float ExecutionTimeMultiplier = 1.f;
+};
+
+// Same seed gives the same jobs, required processors are capped by InProcessorCount
+std::vector<TWorkloadJob> GenerateWorkload(const TWorkloadParameters& InParameters, size_t InProcessorCount, uint32_t InSeed);
+
+// Standard Workload Format trace: submit time (field 2), run time (field 4, the actual execution time), requested processors
+// (field 8, or allocated ones, field 5, when not requested) and requested time (field 9, the run time when not requested).
+// Times are divided by InSecondsPerTick, jobs that can not run are skipped.
+std::vector<TWorkloadJob> ParseSwfWorkload(std::istream& InStream, size_t InProcessorCount, double InSecondsPerTick = 1);
+std::vector<TWorkloadJob> LoadSwfWorkload(const std::string& InPath, size_t InProcessorCount, double InSecondsPerTick = 1);
+
+
+// Calls the jobs of a workload (sorted by submit time) when the cluster reaches their submit time
+class CWorkloadSource : public ISubmissionSource
+{
+	const std::vector<TWorkloadJob>& Jobs;
+	size_t NextJob = 0;
+
+public:
+	CWorkloadSource(const std::vector<TWorkloadJob>& InJobs) : Jobs(InJobs) {}
+
+	void DrainSubmissions(CCluster& Cluster) override;
+};
+
+
+// Metric the tuner minimizes
+enum class ETuningMetric
+{
+	// Ticks from the call to the start, averaged over all jobs
+	MeanWait,
+
+	// 99th percentile of (wait + actual execution time) / actual execution time
+	P99Slowdown,
+
+	// Processor time used by the jobs over the time until the last of them finishes, maximized (the score is its negation)
+	Utilization
+};
+
+
+struct TTuningSettings
+{
+	size_t ProcessorCount = 32;
+	size_t QueueAnalysisDepth = 5;
+	size_t MaxProgramsStartPerTick = 5;
+
+	ETuningMetric Metric = ETuningMetric::MeanWait;
+
+	// Schedule by predicted instead of requested execution times (see CCluster::EnableRuntimePrediction)
+	bool PredictRuntime = false;
+
+	// Each weight is searched in [0, MaxWeight]
+	size_t CandidateCount = 81;
+	size_t MaxWeight = 32;
+	uint32_t SearchSeed = 1;
+
+	// Successive halving keeps 1 / Reduction of the candidates per round and evaluates them on Reduction times more workloads
+	size_t Reduction = 3;
+
+	// Ticks the cluster runs after the last submission, 0 - twice the ticks the workload needs on fully used processors plus its longest job
+	size_t DrainTicks = 0;
+
+	// 0 - one per hardware thread
+	size_t ThreadCount = 0;
+};
+
+
+struct TTuningCandidate
+{
+	TScoreWeights Weights;
+
+	// Mean score over the first WorkloadCount workloads
+	double Score = 0;
+	size_t WorkloadCount = 0;
+};
+
+
+struct TTuningResult
+{
+	ETuningMetric Metric = ETuningMetric::MeanWait;
+
+	// Schedule by predicted instead of requested execution times (see CCluster::EnableRuntimePrediction)
+	bool PredictRuntime = false;
+
+	TScoreWeights BestWeights;
+	double BestScore = 0;
+	double DefaultScore = 0;
+
+	size_t WorkloadCount = 0;
+	size_t Evaluations = 0;
+
+	// Candidates of the last round, best first
+	std::vector<TTuningCandidate> Finalists;
+
+	friend std::ostream& operator<<(std::ostream& OutStream, const TTuningResult& InResult);
+};
+
+
+// Searches the score weights of CCluster for the lowest metric on a fixed set of workloads:
+// random candidates (the default weights among them) go through successive halving, the simulations run on a worker pool
+class CWeightTuner
+{
+	TTuningSettings Settings;
+	std::vector<std::vector<TWorkloadJob>> Workloads;
+
+	size_t GetRunTime(const std::vector<TWorkloadJob>& InJobs) const;
+
+	// Fills the missing scores of the given candidates on the first InWorkloadCount workloads, returns the number of simulations run
+	size_t EvaluateMissing(const std::vector<TScoreWeights>& InCandidates, const std::vector<size_t>& InActive, size_t InWorkloadCount,
+		std::vector<std::vector<double>>& InOutScores) const;
+
+public:
+	CWeightTuner(const TTuningSettings& InSettings, std::vector<std::vector<TWorkloadJob>> InWorkloads);
+
+	// Runs one workload with the given weights and returns its metric (lower is better)
+	double Evaluate(const TScoreWeights& InWeights, size_t InWorkload) const;
+
+	TTuningResult Tune() const;
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+
+// Chase-Lev work-stealing deque
+// The owner thread pushes and pops at the bottom, any other thread can steal from the top.
+// T has to be trivially copyable (normally a pointer), since items are stored in atomics.
+
+template<class T>
+class TWorkStealingDeque
+{
+	struct TBuffer
+	{
+		int64_t Capacity;
+		std::unique_ptr<std::atomic<T>[]> Items;
+
+		TBuffer(int64_t InCapacity) : Capacity(InCapacity), Items(new std::atomic<T>[InCapacity]) {}
+
+		T Get(int64_t Index) const { return Items[Index & (Capacity - 1)].load(std::memory_order_relaxed); }
+		void Put(int64_t Index, T InItem) { Items[Index & (Capacity - 1)].store(InItem, std::memory_order_relaxed); }
+	};
+
+	std::atomic<int64_t> Top;
+	std::atomic<int64_t> Bottom;
+	std::atomic<TBuffer*> Buffer;
+
+	// Buffers are only freed with the deque, because a thief may still be reading from an old one after a resize
+	std::vector<std::unique_ptr<TBuffer>> Buffers;
+
+public:
+
+	// Construction / Destruction
+	// Capacity has to be a power of two, the deque grows when it is exceeded
+	TWorkStealingDeque(size_t InCapacity = 64) : Top(0), Bottom(0)
+	{
+		if (InCapacity == 0 || (InCapacity & (InCapacity - 1)) != 0)
+			throw(std::runtime_error("Deque capacity has to be a power of two!"));
+
+		Buffers.push_back(std::make_unique<TBuffer>(int64_t(InCapacity)));
+		Buffer.store(Buffers.back().get());
+	}
+
+	TWorkStealingDeque(const TWorkStealingDeque&) = delete;
+	TWorkStealingDeque& operator=(const TWorkStealingDeque&) = delete;
+
+	// Utility (exact only when no other thread is using the deque)
+	size_t size() const
+	{
+		int64_t Size = Bottom.load(std::memory_order_relaxed) - Top.load(std::memory_order_relaxed);
+		return Size > 0 ? size_t(Size) : 0;
+	}
+
+	bool empty() const { return size() == 0; }
+
+	// Methods
+	// Owner only: puts a new item to the bottom of the deque
+	void Push(T InItem)
+	{
+		int64_t BottomIndex = Bottom.load(std::memory_order_relaxed);
+		int64_t TopIndex = Top.load(std::memory_order_acquire);
+		TBuffer* CurrentBuffer = Buffer.load(std::memory_order_relaxed);
+
+		if (BottomIndex - TopIndex > CurrentBuffer->Capacity - 1)
+		{
+			Buffers.push_back(std::make_unique<TBuffer>(CurrentBuffer->Capacity * 2));
+			TBuffer* NewBuffer = Buffers.back().get();
+
+			for (int64_t i = TopIndex; i < BottomIndex; i++)
+				NewBuffer->Put(i, CurrentBuffer->Get(i));
+
+			Buffer.store(NewBuffer, std::memory_order_release);
+			CurrentBuffer = NewBuffer;
+		}
+
+		CurrentBuffer->Put(BottomIndex, InItem);
+		Bottom.store(BottomIndex + 1, std::memory_order_release);
+	}
+
+	// Owner only: takes the most recently pushed item, returns false if the deque is empty
+	bool Pop(T& OutItem)
+	{
+		int64_t BottomIndex = Bottom.load(std::memory_order_relaxed) - 1;
+		TBuffer* CurrentBuffer = Buffer.load(std::memory_order_relaxed);
+
+		Bottom.store(BottomIndex, std::memory_order_seq_cst);
+		int64_t TopIndex = Top.load(std::memory_order_seq_cst);
+
+		if (TopIndex > BottomIndex)
+		{
+			Bottom.store(BottomIndex + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		OutItem = CurrentBuffer->Get(BottomIndex);
+
+		// The last item can be raced for by a thief, the winner is decided on Top
+		if (TopIndex == BottomIndex)
+		{
+			bool Won = Top.compare_exchange_strong(TopIndex, TopIndex + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			Bottom.store(BottomIndex + 1, std::memory_order_relaxed);
+			return Won;
+		}
+
+		return true;
+	}
+
+	// Any thread: takes the oldest item, returns false if the deque is empty or the race for the item was lost
+	bool Steal(T& OutItem)
+	{
+		int64_t TopIndex = Top.load(std::memory_order_seq_cst);
+		int64_t BottomIndex = Bottom.load(std::memory_order_seq_cst);
+
+		if (TopIndex >= BottomIndex)
+			return false;
+
+		TBuffer* CurrentBuffer = Buffer.load(std::memory_order_acquire);
+		T Item = CurrentBuffer->Get(TopIndex);
+
+		if (!Top.compare_exchange_strong(TopIndex, TopIndex + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return false;
+
+		OutItem = Item;
+		return true;
+	}
+};
@@ -0,0 +1,62 @@
+#include "WorkerPool.h"
+#include <stdexcept>
+
+
+CWorkerPool::CWorkerPool(size_t InSlotCount)
+{
+	for (size_t i = 0; i < InSlotCount; i++)
+		Slots.push_back(std::make_unique<TWorkerSlot>());
+
+	for (auto& Slot : Slots)
+		Slot->Thread = std::thread(&CWorkerPool::WorkerLoop, this, std::ref(*Slot));
+}
+
+
+CWorkerPool::~CWorkerPool()
+{
+	for (auto& Slot : Slots)
+	{
+		std::lock_guard<std::mutex> Lock(Slot->Mutex);
+		Slot->Stopping = true;
+		Slot->TaskAdded.notify_one();
+	}
+
+	for (auto& Slot : Slots)
+		Slot->Thread.join();
+}
+
+
+void CWorkerPool::Submit(size_t SlotID, std::function<void()> InTask)
+{
+	if (SlotID >= Slots.size())
+		throw(std::runtime_error("Worker slot index out of range!"));
+
+	TWorkerSlot& Slot = *Slots[SlotID];
+
+	std::lock_guard<std::mutex> Lock(Slot.Mutex);
+	Slot.Tasks.push_back(std::move(InTask));
+	Slot.TaskAdded.notify_one();
+}
+
+
+void CWorkerPool::WorkerLoop(TWorkerSlot& Slot)
+{
+	while (true)
+	{
+		std::function<void()> Task;
+
+		{
+			std::unique_lock<std::mutex> Lock(Slot.Mutex);
+			Slot.TaskAdded.wait(Lock, [&]() { return Slot.Stopping || !Slot.Tasks.empty(); });
+
+			// Already queued tasks are still executed when the pool is stopping
+			if (Slot.Tasks.empty())
+				return;
+
+			Task = std::move(Slot.Tasks.front());
+			Slot.Tasks.pop_front();
+		}
+
+		Task();
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <deque>
+#include <vector>
+
+
+// Pool of worker threads with one worker per cluster processor (slot).
+// A task is always executed by the worker of the slot it was submitted to, so the cluster
+// decides which workers are busy the same way it decides which processors are occupied.
+
+class CWorkerPool
+{
+	struct TWorkerSlot
+	{
+		std::thread Thread;
+
+		std::mutex Mutex;
+		std::condition_variable TaskAdded;
+		std::deque<std::function<void()>> Tasks;
+
+		bool Stopping = false;
+	};
+
+	std::vector<std::unique_ptr<TWorkerSlot>> Slots;
+
+	void WorkerLoop(TWorkerSlot& Slot);
+
+public:
+	CWorkerPool(size_t InSlotCount);
+	~CWorkerPool();
+
+	CWorkerPool(const CWorkerPool&) = delete;
+	CWorkerPool& operator=(const CWorkerPool&) = delete;
+
+	size_t GetSlotCount() const { return Slots.size(); }
+
+	// Queues a task for the worker of the given slot
+	void Submit(size_t SlotID, std::function<void()> InTask);
+};
@@ -0,0 +1,128 @@
+#include "Workflow.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+CWorkflow::CWorkflow(std::string InName, std::string InUser, int32_t InPriority) : Name(InName), User(InUser), Priority(InPriority)
+{
+	if (InName == "")
+		throw(std::runtime_error("Workflow needs a name!"));
+}
+
+
+void CWorkflow::Reserve(size_t InJobCount, size_t InDependencyCount)
+{
+	RequiredProcessors.reserve(InJobCount);
+	ExecutionTimes.reserve(InJobCount);
+	ActualExecutionTimes.reserve(InJobCount);
+
+	DependencyJobs.reserve(InDependencyCount);
+	DependencyPredecessors.reserve(InDependencyCount);
+}
+
+
+size_t CWorkflow::AddJob(size_t InRequiredProcessors, size_t InExecutionTime, size_t InActualExecutionTime)
+{
+	if (Prepared)
+		throw(std::runtime_error("Adding a job to a prepared workflow!"));
+
+	if (InRequiredProcessors == 0)
+		throw(std::runtime_error("Workflow job with zero required processors!"));
+
+	if (InExecutionTime == 0)
+		throw(std::runtime_error("Workflow job with zero execution time!"));
+
+	if (RequiredProcessors.size() == UINT32_MAX || InRequiredProcessors > UINT32_MAX || InExecutionTime > UINT32_MAX || InActualExecutionTime > UINT32_MAX)
+		throw(std::runtime_error("Workflow job does not fit into the workflow arrays!"));
+
+	RequiredProcessors.push_back(uint32_t(InRequiredProcessors));
+	ExecutionTimes.push_back(uint32_t(InExecutionTime));
+	ActualExecutionTimes.push_back(uint32_t(InActualExecutionTime));
+
+	return RequiredProcessors.size() - 1;
+}
+
+
+void CWorkflow::AddDependency(size_t InJob, size_t InPredecessor)
+{
+	if (Prepared)
+		throw(std::runtime_error("Adding a dependency to a prepared workflow!"));
+
+	if (InJob >= GetJobCount() || InPredecessor >= GetJobCount())
+		throw(std::runtime_error("Workflow dependency on a job that is not in it!"));
+
+	if (InJob == InPredecessor)
+		throw(std::runtime_error("Workflow job can not depend on itself!"));
+
+	if (DependencyJobs.size() == UINT32_MAX)
+		throw(std::runtime_error("Workflow has too many dependencies!"));
+
+	DependencyJobs.push_back(uint32_t(InJob));
+	DependencyPredecessors.push_back(uint32_t(InPredecessor));
+}
+
+
+void CWorkflow::Prepare()
+{
+	if (Prepared)
+		return;
+
+	size_t JobCount = GetJobCount();
+
+	// Counting sort of the dependencies by predecessor
+	SuccessorOffsets.assign(JobCount + 1, 0);
+	Indegrees.assign(JobCount, 0);
+
+	for (size_t i = 0; i < DependencyJobs.size(); i++)
+	{
+		SuccessorOffsets[DependencyPredecessors[i] + 1]++;
+		Indegrees[DependencyJobs[i]]++;
+	}
+
+	for (size_t Job = 0; Job < JobCount; Job++)
+		SuccessorOffsets[Job + 1] += SuccessorOffsets[Job];
+
+	std::vector<uint32_t> Ends(SuccessorOffsets.begin(), SuccessorOffsets.end() - 1);
+	Successors.resize(DependencyJobs.size());
+
+	for (size_t i = 0; i < DependencyJobs.size(); i++)
+		Successors[Ends[DependencyPredecessors[i]]++] = DependencyJobs[i];
+
+	std::vector<uint32_t>().swap(DependencyJobs);
+	std::vector<uint32_t>().swap(DependencyPredecessors);
+
+	// Topological order, by the same indegree counting the cluster does as the jobs finish
+	std::vector<uint32_t> Order;
+	Order.reserve(JobCount);
+
+	std::vector<uint32_t>& Remaining = Ends;
+	Remaining.assign(Indegrees.begin(), Indegrees.end());
+
+	for (size_t Job = 0; Job < JobCount; Job++)
+		if (Remaining[Job] == 0)
+			Order.push_back(uint32_t(Job));
+
+	for (size_t i = 0; i < Order.size(); i++)
+		for (size_t Edge = SuccessorOffsets[Order[i]]; Edge < SuccessorOffsets[Order[i] + 1]; Edge++)
+			if (--Remaining[Successors[Edge]] == 0)
+				Order.push_back(Successors[Edge]);
+
+	if (Order.size() != JobCount)
+		throw(std::runtime_error("Workflow dependencies have a cycle!"));
+
+	// Successors come later in the order, so walking it backwards they are all done before the job
+	CriticalPaths.assign(JobCount, 0);
+
+	for (size_t i = JobCount; i > 0; i--)
+	{
+		uint32_t Job = Order[i - 1];
+
+		uint64_t Longest = 0;
+		for (size_t Edge = SuccessorOffsets[Job]; Edge < SuccessorOffsets[Job + 1]; Edge++)
+			Longest = std::max(Longest, CriticalPaths[Successors[Edge]]);
+
+		CriticalPaths[Job] = ExecutionTimes[Job] + Longest;
+	}
+
+	Prepared = true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Simulated jobs and the dependencies between them (a DAG), submitted together with CCluster::CallWorkflowExecution.
+// Everything is kept in flat arrays, with the successors of all the jobs in one array of compressed rows,
+// so that a job or a dependency takes a few words and nothing is allocated per dependency.
+// Jobs are named "<Name>.<index of the job>" when they are queued.
+class CWorkflow
+{
+	std::string Name;
+	std::string User;
+	int32_t Priority;
+
+	// Per job
+	std::vector<uint32_t> RequiredProcessors;
+	std::vector<uint32_t> ExecutionTimes;
+	std::vector<uint32_t> ActualExecutionTimes;
+
+	// Dependencies as they are added, turned into the rows below by Prepare
+	std::vector<uint32_t> DependencyJobs;
+	std::vector<uint32_t> DependencyPredecessors;
+
+	// Successors of job i are Successors[SuccessorOffsets[i], SuccessorOffsets[i + 1])
+	std::vector<uint32_t> SuccessorOffsets;
+	std::vector<uint32_t> Successors;
+	std::vector<uint32_t> Indegrees;
+
+	// Longest sum of execution times on a path from the job (including it) to the end of the workflow
+	std::vector<uint64_t> CriticalPaths;
+
+	bool Prepared = false;
+
+public:
+	CWorkflow(std::string InName, std::string InUser = "", int32_t InPriority = 0);
+
+	void Reserve(size_t InJobCount, size_t InDependencyCount);
+
+	// Returns the index of the job
+	size_t AddJob(size_t InRequiredProcessors, size_t InExecutionTime, size_t InActualExecutionTime = 0);
+
+	// InJob is queued only after InPredecessor finishes
+	void AddDependency(size_t InJob, size_t InPredecessor);
+
+	// Builds the successor rows, the indegrees and the critical paths, throws on a cycle. Nothing can be added after it.
+	void Prepare();
+	bool IsPrepared() const { return Prepared; }
+
+	const std::string& GetName() const { return Name; }
+	const std::string& GetUser() const { return User; }
+	int32_t GetPriority() const { return Priority; }
+
+	size_t GetJobCount() const { return RequiredProcessors.size(); }
+	size_t GetDependencyCount() const { return Prepared ? Successors.size() : DependencyJobs.size(); }
+	std::string GetJobName(size_t InJob) const { return Name + "." + std::to_string(InJob); }
+
+	size_t GetRequiredProcessors(size_t InJob) const { return RequiredProcessors[InJob]; }
+	size_t GetExecutionTime(size_t InJob) const { return ExecutionTimes[InJob]; }
+	size_t GetActualExecutionTime(size_t InJob) const { return ActualExecutionTimes[InJob]; }
+
+	// Only after Prepare
+	const uint32_t* GetSuccessors(size_t InJob) const { return Successors.data() + SuccessorOffsets[InJob]; }
+	size_t GetSuccessorCount(size_t InJob) const { return SuccessorOffsets[InJob + 1] - SuccessorOffsets[InJob]; }
+	const std::vector<uint32_t>& GetIndegrees() const { return Indegrees; }
+	uint64_t GetCriticalPath(size_t InJob) const { return CriticalPaths[InJob]; }
+};
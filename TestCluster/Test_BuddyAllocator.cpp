@@ -0,0 +1,230 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "BuddyAllocator.h"
+#include "Cluster.h"
+#include "WeightTuner.h"
+#include <gtest.h>
+#include <chrono>
+#include <iostream>
+
+TEST(CBuddyAllocator, rounds_blocks_up_to_power_of_two)
+{
+	EXPECT_EQ(1, CBuddyAllocator::GetBlockSize(1));
+	EXPECT_EQ(4, CBuddyAllocator::GetBlockSize(3));
+	EXPECT_EQ(8, CBuddyAllocator::GetBlockSize(8));
+	EXPECT_EQ(16, CBuddyAllocator::GetBlockSize(9));
+}
+
+TEST(CBuddyAllocator, keeps_rest_of_block_free)
+{
+	CBuddyAllocator Allocator;
+	Allocator.Reset(8);
+
+	EXPECT_EQ(0, Allocator.Allocate(3));
+	EXPECT_EQ(5, Allocator.GetFreeCount());
+	EXPECT_EQ(4, Allocator.GetLargestFreeBlock());
+
+	// The smallest block that fits, not the first one
+	EXPECT_EQ(3, Allocator.Allocate(1));
+	EXPECT_EQ(4, Allocator.Allocate(4));
+	EXPECT_EQ(SIZE_MAX, Allocator.Allocate(1));
+}
+
+TEST(CBuddyAllocator, merges_freed_buddies)
+{
+	CBuddyAllocator Allocator;
+	Allocator.Reset(8);
+
+	Allocator.Allocate(2);
+	Allocator.Allocate(2);
+	Allocator.Allocate(4);
+	EXPECT_EQ(0, Allocator.GetLargestFreeBlock());
+
+	Allocator.Free(0, 2);
+	EXPECT_EQ(2, Allocator.GetLargestFreeBlock());
+
+	Allocator.Release({ 2, 3 });
+	EXPECT_EQ(4, Allocator.GetLargestFreeBlock());
+
+	Allocator.Release({ 4, 5, 6, 7 });
+	EXPECT_EQ(8, Allocator.GetLargestFreeBlock());
+	EXPECT_EQ(8, Allocator.GetFreeCount());
+}
+
+TEST(CBuddyAllocator, never_allocates_past_processor_count)
+{
+	CBuddyAllocator Allocator;
+	Allocator.Reset(6);
+
+	EXPECT_EQ(4, Allocator.GetLargestFreeBlock());
+	EXPECT_FALSE(Allocator.CanAllocate(5));
+
+	// Processors 4 and 5 are the smaller block, the first four stay whole
+	EXPECT_EQ(4, Allocator.Allocate(2));
+	EXPECT_EQ(0, Allocator.Allocate(4));
+	EXPECT_FALSE(Allocator.CanAllocate(1));
+}
+
+TEST(CBuddyAllocator, measures_external_fragmentation)
+{
+	CBuddyAllocator Allocator;
+	Allocator.Reset(8);
+
+	Allocator.Occupy({ 1, 5 });
+	EXPECT_EQ(6, Allocator.GetFreeCount());
+	EXPECT_EQ(2, Allocator.GetLargestFreeBlock());
+	EXPECT_FLOAT_EQ(1 - 2.f / 6, Allocator.GetExternalFragmentation());
+	EXPECT_FALSE(Allocator.CanAllocate(4));
+
+	Allocator.Release({ 1 });
+	EXPECT_EQ(4, Allocator.GetLargestFreeBlock());
+	EXPECT_FLOAT_EQ(1 - 4.f / 7, Allocator.GetExternalFragmentation());
+}
+
+TEST(CBuddyAllocator, throws_on_unknown_processor)
+{
+	CBuddyAllocator Allocator;
+	Allocator.Reset(6);
+
+	ASSERT_ANY_THROW(Allocator.Occupy({ 6 }));
+	ASSERT_ANY_THROW(Allocator.Free(4, 3));
+}
+
+TEST(TCluster, wide_program_waits_for_buddy_block)
+{
+	CCluster Cluster(22, 8, 8, 6);
+	Cluster.EnableBuddyAllocation();
+
+	// Processors 1 and 5 stay taken after the others finish at tick 2
+	for (int i = 0; i < 6; i++)
+		Cluster.CallProgramExecution(TProgramCall("Narrow_" + std::to_string(i), 1, 20, i == 1 || i == 5 ? 20 : 2));
+
+	size_t WideStart = 0;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+	{
+		if (InCall.Name == "Wide")
+			WideStart = InCluster->GetCurrentTime();
+	});
+
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 2)
+			InCluster->CallProgramExecution(TProgramCall("Wide", 4, 5));
+
+		if (InCluster->GetCurrentTime() == 5)
+		{
+			EXPECT_EQ(6, InCluster->GetBuddyAllocator().GetFreeCount());
+			EXPECT_EQ(2, InCluster->GetBuddyAllocator().GetLargestFreeBlock());
+		}
+	});
+
+	// Blocked from tick 3 until the long programs finish at tick 20
+	EXPECT_EQ(21, WideStart);
+	EXPECT_EQ(18, Cluster.GetReportData().FragmentationBlockedTicks);
+	EXPECT_EQ(4, Cluster.GetReportData().LargestFreeBlock);
+	EXPECT_FLOAT_EQ(2.f / 3, Cluster.GetReportData().MaxExternalFragmentation);
+}
+
+TEST(TCluster, throws_on_buddy_allocation_with_node_resources)
+{
+	CCluster Cluster(10, 4);
+	Cluster.EnableBuddyAllocation();
+
+	TResources Capacity;
+	Capacity[EResource::Memory] = 16;
+	ASSERT_ANY_THROW(Cluster.SetNodeResources(Capacity));
+
+	CCluster Other(10, 4);
+	Other.SetNodeResources(Capacity);
+	ASSERT_ANY_THROW(Other.EnableBuddyAllocation());
+}
+
+TEST(TCluster, fork_keeps_buddy_allocation)
+{
+	CCluster Cluster(1, 8);
+	Cluster.EnableBuddyAllocation();
+	Cluster.CallProgramExecution(TProgramCall("Running", 3, 5));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::unique_ptr<CCluster> Forked = Cluster.Fork(10);
+	Forked->Start([](CCluster* InCluster) {});
+
+	EXPECT_EQ(8, Forked->GetBuddyAllocator().GetLargestFreeBlock());
+	EXPECT_EQ(4, Cluster.GetBuddyAllocator().GetLargestFreeBlock());
+}
+
+TEST(CBuddyAllocator, DISABLED_benchmark_allocation)
+{
+	const size_t ProcessorCounts[] = { 1024, 16384, 262144 };
+
+	for (size_t ProcessorCount : ProcessorCounts)
+	{
+		CBuddyAllocator Allocator;
+		Allocator.Reset(ProcessorCount);
+
+		// Keeps the allocator half full with blocks of varying width
+		std::vector<std::pair<size_t, size_t>> Allocated;
+		const size_t Operations = 200000;
+		size_t Failed = 0;
+
+		auto Begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < Operations; i++)
+		{
+			if (Allocator.GetFreeCount() > ProcessorCount / 2)
+			{
+				size_t Count = 1 + (i * 7919) % 64;
+				size_t First = Allocator.Allocate(Count);
+				if (First == SIZE_MAX)
+				{
+					Failed++;
+					continue;
+				}
+
+				Allocated.push_back({ First, Count });
+			}
+
+			else
+			{
+				size_t Index = (i * 104729) % Allocated.size();
+				Allocator.Free(Allocated[Index].first, Allocated[Index].second);
+				Allocated[Index] = Allocated.back();
+				Allocated.pop_back();
+			}
+		}
+		auto End = std::chrono::steady_clock::now();
+
+		std::cout << ProcessorCount << " processors: " << std::chrono::duration<double, std::nano>(End - Begin).count() / Operations
+			<< " ns per operation, " << Failed << " failed, fragmentation " << Allocator.GetExternalFragmentation() << std::endl;
+	}
+}
+
+TEST(TCluster, DISABLED_benchmark_buddy_placement)
+{
+	const size_t ProcessorCount = 256;
+
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 2000;
+	Parameters.RequiredProcessorsMultiplier = 8;
+	std::vector<TWorkloadJob> Jobs = GenerateWorkload(Parameters, ProcessorCount, 1);
+
+	for (bool Buddy : { false, true })
+	{
+		CCluster Cluster(Parameters.Duration, ProcessorCount, 5, 5);
+		if (Buddy)
+			Cluster.EnableBuddyAllocation();
+
+		CWorkloadSource Source(Jobs);
+		Cluster.AddSubmissionSource(&Source);
+
+		auto Begin = std::chrono::steady_clock::now();
+		Cluster.Start([](CCluster* InCluster) {});
+		std::chrono::duration<double, std::milli> Elapsed = std::chrono::steady_clock::now() - Begin;
+
+		Cluster.RemoveSubmissionSource(&Source);
+
+		TClusterReportData& Report = Cluster.GetReportData();
+		std::cout << (Buddy ? "Buddy allocation: " : "First free processors: ") << Report.TotalProgramsFinished << " finished, "
+			<< Report.AverageProgramsRunning << " running on average, fragmentation " << Report.AverageExternalFragmentation
+			<< ", " << Report.FragmentationBlockedTicks << " ticks blocked by fragmentation, " << Elapsed.count() << " ms" << std::endl;
+	}
+}
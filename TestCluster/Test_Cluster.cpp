@@ -2,6 +2,12 @@
 
 #include "Cluster.h"
 #include <gtest.h>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
 
 void Update(CCluster* InCluster)
 {
@@ -10,6 +16,74 @@ void Update(CCluster* InCluster)
 	InCluster->CallProgramExecution(Call);
 }
 
+void EmptyUpdate(CCluster* InCluster) {}
+
+void SlowUpdate(CCluster* InCluster)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(15));
+}
+
+void SlowFirstUpdate(CCluster* InCluster)
+{
+	if (InCluster->GetCurrentTime() == 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+std::atomic<int> RealTasksExecuted(0);
+
+void RealTaskUpdate(CCluster* InCluster)
+{
+	if (InCluster->GetCurrentTime() != 0)
+		return;
+
+	// Estimated execution time is longer than the whole run, only the task itself can finish the programs
+	TProgramCall Call("RealProgram", 4, 1000);
+	Call.Task = [](CJobContext&) { RealTasksExecuted++; };
+	InCluster->CallProgramExecution(Call);
+
+	TProgramCall FailingCall("FailingProgram", 4, 1000);
+	FailingCall.Task = [](CJobContext&) { throw(std::runtime_error("Task failed")); };
+	InCluster->CallProgramExecution(FailingCall);
+}
+
+void ProcessUpdate(CCluster* InCluster)
+{
+	if (InCluster->GetCurrentTime() != 0)
+		return;
+
+	TProgramCall Call("ProcessProgram", 2, 1000);
+	Call.Command = { "true" };
+	InCluster->CallProgramExecution(Call);
+}
+
+// Deterministic workload depending only on the time, oversubscribing the cluster so that calls queue up
+void ForkUpdate(CCluster* InCluster)
+{
+	size_t Time = InCluster->GetCurrentTime();
+
+	InCluster->CallProgramExecution(TProgramCall("Program" + std::to_string(Time), 1 + Time % 5, 1 + Time % 4));
+
+	if (Time % 2 == 0)
+		InCluster->CallProgramExecution(TProgramCall("Extra" + std::to_string(Time), 1, 3));
+}
+
+std::unique_ptr<CCluster> ForkedFromCallback;
+
+void ForkingUpdate(CCluster* InCluster)
+{
+	ForkUpdate(InCluster);
+
+	if (InCluster->GetCurrentTime() == 50)
+		ForkedFromCallback = InCluster->Fork(100);
+}
+
+std::string ForkReport(CCluster& InCluster)
+{
+	std::stringstream Stream;
+	Stream << InCluster.GetReportData();
+	return Stream.str();
+}
+
 
 TEST(TCluster, can_call_valid_program)
 {
@@ -60,3 +134,350 @@ TEST(TCluster, can_start_and_work)
 	ASSERT_NO_THROW(Cluster.Start(Update));
 }
 
+
+TEST(TCluster, throws_when_setting_negative_tick_duration)
+{
+	CCluster Cluster(100, 32);
+
+	ASSERT_ANY_THROW(Cluster.SetRealTimePacing(-1.f));
+}
+
+TEST(TCluster, paced_run_keeps_wall_clock_schedule)
+{
+	CCluster Cluster(9, 32);
+	Cluster.SetRealTimePacing(0.01f);
+
+	std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+	Cluster.Start(EmptyUpdate);
+	float Elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - StartTime).count();
+
+	EXPECT_GE(Elapsed, 0.1f);
+	EXPECT_LT(Elapsed, 0.5f);
+}
+
+TEST(TCluster, paced_run_reports_overruns)
+{
+	CCluster Cluster(4, 32);
+	Cluster.SetRealTimePacing(0.005f);
+
+	Cluster.Start(SlowUpdate);
+
+	EXPECT_EQ(5, Cluster.GetReportData().TickOverruns);
+	EXPECT_GT(Cluster.GetReportData().MaxTickOverrun, 0.f);
+}
+
+TEST(TCluster, skip_policy_re_anchors_schedule_after_overrun)
+{
+	CCluster Cluster(4, 32);
+	Cluster.SetRealTimePacing(0.02f, ECatchUpPolicy::Skip);
+
+	Cluster.Start(SlowFirstUpdate);
+
+	EXPECT_EQ(1, Cluster.GetReportData().TickOverruns);
+}
+
+TEST(TCluster, catch_up_policy_keeps_original_schedule)
+{
+	CCluster Cluster(4, 32);
+	Cluster.SetRealTimePacing(0.02f, ECatchUpPolicy::CatchUp);
+
+	Cluster.Start(SlowFirstUpdate);
+
+	// The first tick takes 2.5 slots, so the second one still starts late and has to run back to back
+	EXPECT_EQ(2, Cluster.GetReportData().TickOverruns);
+}
+
+TEST(TCluster, stop_ends_run_after_current_tick)
+{
+	CCluster Cluster(SIZE_MAX, 32);
+	Cluster.SetRealTimePacing(0.001f);
+
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 10)
+			InCluster->Stop();
+	});
+
+	EXPECT_EQ(11, Cluster.GetCurrentTime());
+}
+
+TEST(TCluster, throws_when_calling_program_with_task_and_command)
+{
+	CCluster Cluster(100, 32);
+
+	TProgramCall Call("Program", 5, 25);
+	Call.Task = [](CJobContext&) {};
+	Call.Command = { "true" };
+
+	ASSERT_ANY_THROW(Cluster.CallProgramExecution(Call));
+}
+
+TEST(TCluster, real_programs_finish_with_their_tasks)
+{
+	RealTasksExecuted = 0;
+
+	CCluster Cluster(100, 8);
+	Cluster.SetRealTimePacing(0.002f);
+
+	ASSERT_NO_THROW(Cluster.Start(RealTaskUpdate));
+
+	EXPECT_EQ(1, RealTasksExecuted);
+	EXPECT_EQ(2, Cluster.GetReportData().TotalProgramsFinished);
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramsFailed);
+}
+
+#ifdef __linux__
+
+TEST(TCluster, process_programs_finish_when_process_exits)
+{
+	CCluster Cluster(100, 8);
+	Cluster.SetRealTimePacing(0.002f);
+
+	ASSERT_NO_THROW(Cluster.Start(ProcessUpdate));
+
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramsFinished);
+	EXPECT_EQ(0, Cluster.GetReportData().TotalProgramsFailed);
+}
+
+#endif
+
+
+TEST(TCluster, forked_run_matches_uninterrupted_run)
+{
+	CCluster Uninterrupted(100, 8, 3);
+	Uninterrupted.Start(ForkUpdate);
+
+	CCluster Cluster(50, 8, 3);
+	Cluster.Start(ForkUpdate);
+
+	std::string ReportBeforeFork = ForkReport(Cluster);
+	size_t WaitingBeforeFork = Cluster.GetWaitingProgramCalls().size();
+
+	std::unique_ptr<CCluster> Forked = Cluster.Fork(100);
+	Forked->Start(ForkUpdate);
+
+	EXPECT_EQ(ForkReport(Uninterrupted), ForkReport(*Forked));
+
+	EXPECT_EQ(ReportBeforeFork, ForkReport(Cluster));
+	EXPECT_EQ(WaitingBeforeFork, Cluster.GetWaitingProgramCalls().size());
+}
+
+TEST(TCluster, fork_from_update_callback_starts_at_next_tick)
+{
+	CCluster Uninterrupted(100, 8, 3);
+	Uninterrupted.Start(ForkUpdate);
+
+	CCluster Cluster(60, 8, 3);
+	Cluster.Start(ForkingUpdate);
+
+	ASSERT_NE(nullptr, ForkedFromCallback);
+	EXPECT_EQ(51, ForkedFromCallback->GetCurrentTime());
+
+	ForkedFromCallback->Start(ForkUpdate);
+
+	EXPECT_EQ(ForkReport(Uninterrupted), ForkReport(*ForkedFromCallback));
+
+	ForkedFromCallback.reset();
+}
+
+TEST(TCluster, forks_with_different_policies_are_independent)
+{
+	CCluster Cluster(50, 8, 3);
+	Cluster.Start(ForkUpdate);
+
+	std::unique_ptr<CCluster> Shallow = Cluster.Fork(60);
+	std::unique_ptr<CCluster> Deep = Cluster.Fork(60);
+
+	Shallow->SetQueueAnalysisDepth(1);
+	Deep->SetQueueAnalysisDepth(20);
+	Deep->SetMaxProgramsStartPerTick(3);
+
+	Shallow->Start(EmptyUpdate);
+	Deep->Start(EmptyUpdate);
+
+	EXPECT_EQ(Cluster.GetReportData().TotalProgramCalls, Shallow->GetReportData().TotalProgramCalls);
+	EXPECT_EQ(Cluster.GetReportData().TotalProgramCalls, Deep->GetReportData().TotalProgramCalls);
+	EXPECT_LT(Shallow->GetReportData().TotalProgramsFinished, Deep->GetReportData().TotalProgramsFinished);
+
+	EXPECT_EQ(51, Cluster.GetCurrentTime());
+	EXPECT_LT(0, Cluster.GetWaitingProgramCalls().size());
+}
+
+TEST(TCluster, throws_when_forking_real_programs)
+{
+	CCluster Cluster(5, 4);
+
+	TProgramCall Call("Real", 1, 1);
+	Call.Task = [](CJobContext&) {};
+	Cluster.CallProgramExecution(Call);
+
+	ASSERT_ANY_THROW(Cluster.Fork(10));
+}
+
+TEST(TCluster, scores_with_custom_weights)
+{
+	CCluster Cluster(10, 8, 5);
+
+	Cluster.CallProgramExecution(TProgramCall("Long", 1, 50));
+	Cluster.CallProgramExecution(TProgramCall("Short", 1, 2));
+
+	EXPECT_GT(Cluster.EvaluateWaitingCallScore(1), Cluster.EvaluateWaitingCallScore(0));
+
+	TScoreWeights Weights;
+	Weights.ExecutionTime = 0;
+	Cluster.SetScoreWeights(Weights);
+
+	EXPECT_LT(Cluster.EvaluateWaitingCallScore(1), Cluster.EvaluateWaitingCallScore(0));
+	EXPECT_EQ(0, Cluster.GetScoreWeights().ExecutionTime);
+}
+
+TEST(TCluster, DISABLED_benchmark_fork)
+{
+	const size_t QueueLengths[] = { 1000, 10000, 100000 };
+
+	for (size_t QueueLength : QueueLengths)
+	{
+		CCluster Cluster(0, 64);
+		for (size_t i = 0; i < QueueLength; i++)
+			Cluster.CallProgramExecution(TProgramCall("Program" + std::to_string(i), 1 + i % 16, 1 + i % 10));
+
+		const int Forks = 100;
+
+		auto Begin = std::chrono::steady_clock::now();
+		std::vector<std::unique_ptr<CCluster>> Futures;
+		for (int i = 0; i < Forks; i++)
+			Futures.push_back(Cluster.Fork(100));
+		auto Forked = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < Forks; i++)
+		{
+			Futures[i]->SetQueueAnalysisDepth(1 + i % 10);
+			Futures[i]->Start(EmptyUpdate);
+		}
+		auto Finished = std::chrono::steady_clock::now();
+
+		std::cout << "Waiting calls: " << QueueLength
+			<< ", fork: " << std::chrono::duration<double, std::micro>(Forked - Begin).count() / Forks << " us"
+			<< ", 100 ticks of a fork: " << std::chrono::duration<double, std::micro>(Finished - Forked).count() / Forks << " us" << std::endl;
+	}
+}
+
+std::vector<size_t> AdaptiveDepths;
+
+void AdaptiveDepthUpdate(CCluster* InCluster)
+{
+	ForkUpdate(InCluster);
+	AdaptiveDepths.push_back(InCluster->GetQueueAnalysisDepth());
+}
+
+TEST(TCluster, throws_on_invalid_adaptive_depth_settings)
+{
+	CCluster Cluster(10, 8);
+	TAdaptiveDepthSettings Settings;
+
+	Settings.MinDepth = 0;
+	ASSERT_ANY_THROW(Cluster.SetAdaptiveQueueAnalysisDepth(Settings));
+
+	Settings.MinDepth = 10;
+	Settings.MaxDepth = 5;
+	ASSERT_ANY_THROW(Cluster.SetAdaptiveQueueAnalysisDepth(Settings));
+
+	Settings.MaxDepth = 10;
+	Settings.DecisionBudget = -1;
+	ASSERT_ANY_THROW(Cluster.SetAdaptiveQueueAnalysisDepth(Settings));
+}
+
+TEST(TCluster, adaptive_depth_follows_queue_and_free_processors)
+{
+	CCluster Cluster(10, 4, 5, 1);
+
+	TAdaptiveDepthSettings Settings;
+	Settings.MinDepth = 2;
+	Settings.MaxDepth = 6;
+	Cluster.SetAdaptiveQueueAnalysisDepth(Settings);
+
+	// Each call takes the whole cluster, so the following picks find no free processors
+	for (int i = 0; i < 10; i++)
+		Cluster.CallProgramExecution(TProgramCall("Program" + std::to_string(i), 4, 3));
+
+	AdaptiveDepths.clear();
+	Cluster.Start([](CCluster* InCluster) { AdaptiveDepths.push_back(InCluster->GetQueueAnalysisDepth()); });
+
+	// The first pick sees all 10 calls (capped by MaxDepth), while the program runs the window is MinDepth
+	ASSERT_LE(3, AdaptiveDepths.size());
+	EXPECT_EQ(6, AdaptiveDepths[0]);
+	EXPECT_EQ(2, AdaptiveDepths[1]);
+	EXPECT_EQ(2, AdaptiveDepths[2]);
+}
+
+TEST(TCluster, adaptive_depth_without_budget_matches_scoring_whole_queue)
+{
+	CCluster Fixed(200, 8, 100000, 3);
+	Fixed.Start(ForkUpdate);
+
+	CCluster Adaptive(200, 8, 5, 3);
+	Adaptive.SetAdaptiveQueueAnalysisDepth(TAdaptiveDepthSettings());
+
+	AdaptiveDepths.clear();
+	Adaptive.Start(AdaptiveDepthUpdate);
+
+	EXPECT_EQ(ForkReport(Fixed), ForkReport(Adaptive));
+	EXPECT_LT(5, *std::max_element(AdaptiveDepths.begin(), AdaptiveDepths.end()));
+}
+
+TEST(TCluster, decision_budget_limits_adaptive_depth)
+{
+	CCluster Cluster(200, 8, 5, 3);
+
+	TAdaptiveDepthSettings Settings;
+	Settings.MinDepth = 3;
+	Settings.DecisionBudget = 1e-12f;
+	Cluster.SetAdaptiveQueueAnalysisDepth(Settings);
+
+	AdaptiveDepths.clear();
+	Cluster.Start(AdaptiveDepthUpdate);
+
+	EXPECT_LT(20, Cluster.GetWaitingProgramCalls().size());
+	EXPECT_EQ(3, AdaptiveDepths.back());
+}
+
+TEST(TCluster, fixed_depth_turns_adaptive_depth_off)
+{
+	CCluster Cluster(50, 8, 5, 3);
+	Cluster.SetAdaptiveQueueAnalysisDepth(TAdaptiveDepthSettings());
+	Cluster.SetQueueAnalysisDepth(4);
+
+	AdaptiveDepths.clear();
+	Cluster.Start(AdaptiveDepthUpdate);
+
+	for (size_t Depth : AdaptiveDepths)
+		EXPECT_EQ(4, Depth);
+}
+
+TEST(TCluster, DISABLED_benchmark_adaptive_depth)
+{
+	const size_t QueueLength = 100000;
+
+	for (int Mode = 0; Mode < 3; Mode++)
+	{
+		CCluster Cluster(1000, 64, Mode == 0 ? 5 : QueueLength, 5);
+		if (Mode == 2)
+		{
+			TAdaptiveDepthSettings Settings;
+			Settings.MaxDepth = QueueLength;
+			Settings.DecisionBudget = 20e-6f;
+			Cluster.SetAdaptiveQueueAnalysisDepth(Settings);
+		}
+
+		for (size_t i = 0; i < QueueLength; i++)
+			Cluster.CallProgramExecution(TProgramCall("Program" + std::to_string(i), 1 + i * 7 % 64, 1 + i % 10));
+
+		auto Begin = std::chrono::steady_clock::now();
+		Cluster.Start(EmptyUpdate);
+		auto End = std::chrono::steady_clock::now();
+
+		const char* Names[] = { "fixed 5", "fixed whole queue", "adaptive, 20 us budget" };
+		std::cout << Names[Mode] << ": " << std::chrono::duration<double, std::milli>(End - Begin).count() << " ms, finished "
+			<< Cluster.GetFinishedProgramCount() << ", depth at the end " << Cluster.GetQueueAnalysisDepth() << std::endl;
+	}
+}
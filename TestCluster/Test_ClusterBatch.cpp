@@ -0,0 +1,139 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "ClusterBatch.h"
+#include <gtest.h>
+#include <sstream>
+#include <chrono>
+#include <iostream>
+
+// Deterministic workload of every cluster of a batch, depending on its index and the time
+size_t BatchCallCount(size_t Cluster, size_t Time)
+{
+	return (Cluster * 7 + Time * 3) % 4 == 0 ? 2 : 1;
+}
+
+size_t BatchRequiredProcessors(size_t Cluster, size_t Time, size_t Call, size_t ProcessorCount)
+{
+	return 1 + (Cluster * 13 + Time * 5 + Call * 11) % ProcessorCount;
+}
+
+size_t BatchExecutionTime(size_t Cluster, size_t Time, size_t Call)
+{
+	return 1 + (Cluster * 3 + Time * 7 + Call) % 9;
+}
+
+void BatchUpdate(CClusterBatch* InBatch)
+{
+	for (size_t Cluster = 0; Cluster < InBatch->GetClusterCount(); Cluster++)
+		for (size_t Call = 0; Call < BatchCallCount(Cluster, InBatch->GetCurrentTime()); Call++)
+			InBatch->CallProgramExecution(Cluster, BatchRequiredProcessors(Cluster, InBatch->GetCurrentTime(), Call, InBatch->GetProcessorCount()),
+				BatchExecutionTime(Cluster, InBatch->GetCurrentTime(), Call));
+}
+
+size_t BatchReferenceCluster = 0;
+
+void BatchReferenceUpdate(CCluster* InCluster)
+{
+	size_t Time = InCluster->GetCurrentTime();
+
+	for (size_t Call = 0; Call < BatchCallCount(BatchReferenceCluster, Time); Call++)
+		InCluster->CallProgramExecution(TProgramCall("Program" + std::to_string(Time) + "_" + std::to_string(Call),
+			BatchRequiredProcessors(BatchReferenceCluster, Time, Call, InCluster->GetProcessorData().size()), BatchExecutionTime(BatchReferenceCluster, Time, Call)));
+}
+
+std::string BatchReport(TClusterReportData InReportData)
+{
+	std::stringstream Stream;
+	Stream << InReportData;
+	return Stream.str();
+}
+
+void ExpectBatchMatchesClusters(size_t ProcessorCount)
+{
+	const size_t ClusterCount = 24;
+	const size_t MaxTime = 300;
+
+	CClusterBatch Batch(MaxTime, ClusterCount, ProcessorCount);
+	for (size_t Cluster = 0; Cluster < ClusterCount; Cluster++)
+	{
+		Batch.SetQueueAnalysisDepth(Cluster, Cluster % 7);
+		Batch.SetMaxProgramsStartPerTick(Cluster, 1 + Cluster % 3);
+	}
+
+	Batch.Start(BatchUpdate);
+
+	for (size_t Cluster = 0; Cluster < ClusterCount; Cluster++)
+	{
+		BatchReferenceCluster = Cluster;
+
+		CCluster Reference(MaxTime, ProcessorCount, Cluster % 7, 1 + Cluster % 3);
+		Reference.Start(BatchReferenceUpdate);
+
+		EXPECT_EQ(BatchReport(Reference.GetReportData()), BatchReport(Batch.GetReportData(Cluster)));
+		EXPECT_EQ(Reference.GetRunningProgramCount(), Batch.GetRunningProgramCount(Cluster));
+		EXPECT_EQ(Reference.GetWaitingProgramCalls().size(), Batch.GetWaitingCallCount(Cluster));
+
+		uint32_t Occupied = 0;
+		for (auto& Processor : Reference.GetProcessorData())
+			Occupied |= uint32_t(Processor.IsOccupied()) << Processor.GetID();
+
+		EXPECT_EQ(Occupied, Batch.GetOccupiedProcessors(Cluster));
+	}
+}
+
+TEST(CClusterBatch, throws_when_created_with_too_many_processors)
+{
+	ASSERT_ANY_THROW(CClusterBatch Batch(10, 4, 33));
+	ASSERT_ANY_THROW(CClusterBatch Batch(10, 4, 0));
+}
+
+TEST(CClusterBatch, throws_when_calling_invalid_program)
+{
+	CClusterBatch Batch(10, 4, 8);
+
+	ASSERT_ANY_THROW(Batch.CallProgramExecution(4, 1, 1));
+	ASSERT_ANY_THROW(Batch.CallProgramExecution(0, 9, 1));
+	ASSERT_ANY_THROW(Batch.CallProgramExecution(0, 0, 1));
+	ASSERT_ANY_THROW(Batch.CallProgramExecution(0, 1, 0));
+	ASSERT_NO_THROW(Batch.CallProgramExecution(3, 8, 1));
+}
+
+TEST(CClusterBatch, matches_separate_clusters_with_32_processors)
+{
+	ExpectBatchMatchesClusters(32);
+}
+
+TEST(CClusterBatch, matches_separate_clusters_with_12_processors)
+{
+	ExpectBatchMatchesClusters(12);
+}
+
+TEST(CClusterBatch, DISABLED_benchmark_batch_against_separate_clusters)
+{
+	const size_t ClusterCount = 2000;
+	const size_t MaxTime = 1000;
+
+	auto Begin = std::chrono::steady_clock::now();
+
+	CClusterBatch Batch(MaxTime, ClusterCount, 32);
+	Batch.Start(BatchUpdate);
+
+	auto BatchFinished = std::chrono::steady_clock::now();
+
+	for (size_t Cluster = 0; Cluster < ClusterCount; Cluster++)
+	{
+		BatchReferenceCluster = Cluster;
+
+		CCluster Reference(MaxTime, 32);
+		Reference.Start(BatchReferenceUpdate);
+	}
+
+	auto SeparateFinished = std::chrono::steady_clock::now();
+
+	double BatchTime = std::chrono::duration<double>(BatchFinished - Begin).count();
+	double SeparateTime = std::chrono::duration<double>(SeparateFinished - BatchFinished).count();
+
+	std::cout << ClusterCount << " clusters x " << MaxTime << " ticks" << std::endl;
+	std::cout << "Batch: " << BatchTime << " s, " << ClusterCount * MaxTime / BatchTime / 1e6 << " M cluster-ticks/s" << std::endl;
+	std::cout << "Separate: " << SeparateTime << " s, " << ClusterCount * MaxTime / SeparateTime / 1e6 << " M cluster-ticks/s" << std::endl;
+}
@@ -0,0 +1,234 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Cluster.h"
+#include "Journal.h"
+#include "WaitingCallFields.h"
+#include "WeightTuner.h"
+#include <gtest.h>
+#include <cstdio>
+#include <iostream>
+
+TProgramCall DeadlineCall(std::string InName, size_t InRequiredProcessors, size_t InExecutionTime, size_t InDeadline)
+{
+	TProgramCall Call(InName, InRequiredProcessors, InExecutionTime);
+	Call.Deadline = InDeadline;
+
+	return Call;
+}
+
+// Batch takes the whole cluster from tick 0 to tick 10, its processors are free from tick 11
+void CallTightAtTickTwo(CCluster* InCluster)
+{
+	if (InCluster->GetCurrentTime() != 2)
+		return;
+
+	EXPECT_EQ(SIZE_MAX, InCluster->CallProgramExecution(DeadlineCall("TooTight", 1, 5, 15)));
+	EXPECT_EQ(1, InCluster->CallProgramExecution(DeadlineCall("Tight", 1, 5, 16)));
+}
+
+TEST(CWaitingCallFields, finds_earliest_deadline)
+{
+	const size_t ChunkSize = CWaitingCallFields::ChunkSize;
+	CWaitingCallFields Fields;
+
+	EXPECT_EQ(SIZE_MAX, Fields.FindEarliestDeadline(5));
+
+	for (size_t i = 0; i < ChunkSize; i++)
+		Fields.Put(0, 1, 1);
+
+	Fields.Put(0, 1, 1, 0, 0, 40);
+	Fields.Put(0, 1, 1, 0, 0, 30);
+	Fields.Put(0, 1, 1, 0, 0, 30);
+
+	EXPECT_EQ(SIZE_MAX, Fields.FindEarliestDeadline(ChunkSize));
+	EXPECT_EQ(ChunkSize, Fields.FindEarliestDeadline(ChunkSize + 1));
+	EXPECT_EQ(ChunkSize + 1, Fields.FindEarliestDeadline(1000));
+
+	// Moves with the calls in front of a popped one
+	Fields.Pop(ChunkSize + 1);
+	Fields.Pop(3);
+	EXPECT_EQ(ChunkSize, Fields.FindEarliestDeadline(1000));
+}
+
+TEST(TCluster, reports_deadline_hits_and_misses)
+{
+	CCluster Cluster(20, 2);
+	Cluster.CallProgramExecution(DeadlineCall("First", 2, 5, 5));
+	Cluster.CallProgramExecution(DeadlineCall("Second", 2, 5, 8));
+	Cluster.CallProgramExecution(TProgramCall("Third", 2, 5));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	// First finishes at tick 5, Second at tick 11
+	TClusterReportData& Report = Cluster.GetReportData();
+	EXPECT_EQ(3, Report.TotalProgramsFinished);
+	EXPECT_EQ(1, Report.DeadlinesMet);
+	EXPECT_EQ(1, Report.DeadlinesMissed);
+	EXPECT_FLOAT_EQ(0.5f, Report.DeadlineHitRate);
+	EXPECT_FLOAT_EQ(0.5f, Report.DeadlineMissRate);
+	EXPECT_EQ(0, Report.DeadlineCallsRejected);
+}
+
+TEST(TCluster, earliest_deadline_starts_first)
+{
+	CCluster Cluster(30, 1);
+	Cluster.EnableDeadlineScheduling();
+	Cluster.CallProgramExecution(TProgramCall("None", 1, 2));
+	Cluster.CallProgramExecution(DeadlineCall("Late", 1, 2, 20));
+	Cluster.CallProgramExecution(DeadlineCall("Early", 1, 2, 10));
+
+	std::vector<std::string> Starts;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall) { Starts.push_back(InCall.Name); });
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::vector<std::string> Expected = { "Early", "Late", "None" };
+	EXPECT_EQ(Expected, Starts);
+	EXPECT_EQ(2, Cluster.GetReportData().DeadlinesMet);
+}
+
+TEST(TCluster, rejects_call_that_can_not_meet_its_deadline)
+{
+	CCluster Cluster(20, 2);
+	Cluster.EnableDeadlineScheduling();
+	Cluster.CallProgramExecution(TProgramCall("Batch", 2, 10));
+	Cluster.Start(CallTightAtTickTwo);
+
+	// Tight starts at tick 11 and finishes at tick 16
+	TClusterReportData& Report = Cluster.GetReportData();
+	EXPECT_EQ(2, Report.TotalProgramCalls);
+	EXPECT_EQ(1, Report.DeadlineCallsRejected);
+	EXPECT_EQ(1, Report.DeadlinesMet);
+	EXPECT_EQ(0, Report.DeadlinesMissed);
+}
+
+TEST(TCluster, rejects_call_past_its_deadline_with_free_processors)
+{
+	CCluster Cluster(5, 4);
+	Cluster.EnableDeadlineScheduling();
+
+	EXPECT_EQ(SIZE_MAX, Cluster.CallProgramExecution(DeadlineCall("TooLong", 1, 10, 9)));
+	EXPECT_EQ(0, Cluster.CallProgramExecution(DeadlineCall("Fits", 1, 10, 10)));
+	EXPECT_EQ(1, Cluster.GetWaitingProgramCalls().size());
+}
+
+TEST(TCluster, no_deadline_rejection_unless_enabled)
+{
+	CCluster Cluster(20, 2);
+	Cluster.CallProgramExecution(TProgramCall("Batch", 2, 10));
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 2)
+		{
+			EXPECT_EQ(1, InCluster->CallProgramExecution(DeadlineCall("TooTight", 1, 5, 15)));
+		}
+	});
+
+	EXPECT_EQ(0, Cluster.GetReportData().DeadlineCallsRejected);
+	EXPECT_EQ(1, Cluster.GetReportData().DeadlinesMissed);
+}
+
+TEST(TCluster, deadline_scheduling_counts_programs_already_running)
+{
+	CCluster Cluster(0, 2);
+	Cluster.CallProgramExecution(TProgramCall("Batch", 2, 10));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	Cluster.EnableDeadlineScheduling();
+	EXPECT_EQ(SIZE_MAX, Cluster.CallProgramExecution(DeadlineCall("TooTight", 1, 5, 15)));
+	EXPECT_EQ(1, Cluster.CallProgramExecution(DeadlineCall("Tight", 1, 5, 16)));
+}
+
+TEST(TCluster, preempted_program_keeps_deadline)
+{
+	CCluster Cluster(30, 2);
+	Cluster.EnablePreemption(0);
+	Cluster.CallProgramExecution(DeadlineCall("Batch", 2, 10, 25));
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 2)
+		{
+			TProgramCall Urgent("Urgent", 2, 3);
+			Urgent.Priority = 1;
+			InCluster->CallProgramExecution(Urgent);
+		}
+	});
+
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(1, Cluster.GetReportData().DeadlinesMet);
+}
+
+TEST(TCluster, deadlines_are_restored_from_journal)
+{
+	std::string Path = "cluster_test_deadline_journal.bin";
+	std::remove(Path.c_str());
+
+	{
+		CCluster Cluster(7, 2);
+		Cluster.EnableDeadlineScheduling();
+		Cluster.EnableJournal(Path);
+		Cluster.CallProgramExecution(DeadlineCall("Met", 2, 3, 5));
+		Cluster.CallProgramExecution(DeadlineCall("Waiting", 2, 10, 30));
+		Cluster.Start([](CCluster* InCluster) {});
+	}
+
+	CCluster Restored(30, 2);
+	Restored.EnableDeadlineScheduling();
+	Restored.EnableJournal(Path);
+
+	EXPECT_EQ(1, Restored.GetReportData().DeadlinesMet);
+	EXPECT_EQ(30, Restored.GetRunningPrograms().at("Waiting").Deadline);
+
+	// Waiting runs from tick 4 to 14
+	EXPECT_EQ(SIZE_MAX, Restored.CallProgramExecution(DeadlineCall("TooTight", 1, 5, 19)));
+
+	Restored.Start([](CCluster* InCluster) {});
+	EXPECT_EQ(2, Restored.GetReportData().DeadlinesMet);
+
+	std::remove(Path.c_str());
+}
+
+TEST(TCluster, fork_keeps_deadline_scheduling)
+{
+	CCluster Cluster(0, 2);
+	Cluster.EnableDeadlineScheduling();
+	Cluster.CallProgramExecution(TProgramCall("Batch", 2, 10));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::unique_ptr<CCluster> Forked = Cluster.Fork(20);
+	EXPECT_EQ(true, Forked->IsDeadlineScheduling());
+	EXPECT_EQ(SIZE_MAX, Forked->CallProgramExecution(DeadlineCall("TooTight", 1, 5, 15)));
+
+	EXPECT_EQ(1, Forked->GetReportData().DeadlineCallsRejected);
+	EXPECT_EQ(0, Cluster.GetReportData().DeadlineCallsRejected);
+}
+
+TEST(TCluster, DISABLED_benchmark_deadline_scheduling)
+{
+	const size_t ProcessorCount = 64;
+
+	// Every job has to finish within twice its run time of being called
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 5000;
+	Parameters.MaxNewProgramsPerTick = 1;
+	Parameters.SpawnThreshold = 0.8f;
+	Parameters.RequiredProcessorsMultiplier = 2;
+	std::vector<TWorkloadJob> Jobs = GenerateWorkload(Parameters, ProcessorCount, 1);
+
+	for (auto& Job : Jobs)
+		Job.Deadline = Job.SubmitTime + 2 * Job.ExecutionTime;
+
+	for (bool DeadlineScheduling : { false, true })
+	{
+		CCluster Cluster(Parameters.Duration * 2, ProcessorCount, 5, 5);
+		if (DeadlineScheduling)
+			Cluster.EnableDeadlineScheduling();
+
+		CWorkloadSource Source(Jobs);
+		Cluster.AddSubmissionSource(&Source);
+		Cluster.Start([](CCluster* InCluster) {});
+		Cluster.RemoveSubmissionSource(&Source);
+
+		TClusterReportData& Report = Cluster.GetReportData();
+		std::cout << (DeadlineScheduling ? "Earliest deadline first: " : "Scored: ") << Report.DeadlinesMet << " of " << Jobs.size() << " deadlines met, hit rate "
+			<< Report.DeadlineHitRate << ", " << Report.DeadlinesMissed << " missed, " << Report.DeadlineCallsRejected << " rejected" << std::endl;
+	}
+}
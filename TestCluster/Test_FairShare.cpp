@@ -0,0 +1,223 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "FairShare.h"
+#include "Cluster.h"
+#include "Journal.h"
+#include "WeightTuner.h"
+#include <gtest.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+TEST(CFairShare, accumulates_processor_ticks_without_decay)
+{
+	CFairShare FairShare;
+	uint32_t User = FairShare.GetUserID("User");
+
+	FairShare.Start(User, 4, 0);
+	EXPECT_DOUBLE_EQ(20, FairShare.GetUsage(User, 5));
+
+	FairShare.Finish(User, 4, 10);
+	EXPECT_DOUBLE_EQ(40, FairShare.GetUsage(User, 20));
+	EXPECT_DOUBLE_EQ(0, FairShare.GetUsage(FairShare.GetUserID(""), 20));
+}
+
+TEST(CFairShare, decays_by_half_every_half_life)
+{
+	CFairShare FairShare(10);
+	uint32_t User = FairShare.GetUserID("User");
+
+	FairShare.Start(User, 1, 0);
+	FairShare.Finish(User, 1, 1);
+
+	EXPECT_DOUBLE_EQ(1, FairShare.GetUsage(User, 1));
+	EXPECT_NEAR(0.5, FairShare.GetUsage(User, 11), 1e-12);
+	EXPECT_NEAR(0.25, FairShare.GetUsage(User, 21), 1e-12);
+}
+
+TEST(CFairShare, running_processors_match_tick_by_tick_decay)
+{
+	CFairShare FairShare(5);
+	uint32_t User = FairShare.GetUserID("User");
+
+	FairShare.Start(User, 3, 2);
+	FairShare.Start(User, 2, 6);
+
+	double Decay = pow(0.5, 1.0 / 5);
+	double Usage = 0;
+	for (size_t Time = 2; Time < 15; Time++)
+		Usage = Usage * Decay + (Time < 6 ? 3 : 5);
+
+	EXPECT_NEAR(Usage, FairShare.GetUsage(User, 15), 1e-9);
+}
+
+TEST(CFairShare, throws_on_finishing_more_than_running)
+{
+	CFairShare FairShare;
+	uint32_t User = FairShare.GetUserID("User");
+	FairShare.Start(User, 2, 0);
+
+	ASSERT_ANY_THROW(FairShare.Finish(User, 3, 1));
+	ASSERT_ANY_THROW(FairShare.FindUserID("Unknown"));
+	EXPECT_EQ(User, FairShare.FindUserID("User"));
+}
+
+TEST(CWaitingCallFields, scores_priority_and_user_penalty)
+{
+	CWaitingCallFields Fields;
+	Fields.Put(0, 10, 1, 1, 0);
+	Fields.Put(0, 10, 1, 2, 0);
+	Fields.Put(0, 10, 1, 2, 3);
+
+	TScoreWeights Weights;
+	TWaitingCallScores Scores;
+	const float Penalties[] = { 0, 4, 0 };
+
+	EXPECT_EQ(0, Fields.FindTop(Weights, 3, 3, 0, 8, Scores, Penalties));
+
+	Weights.FairShare = 5;
+	EXPECT_EQ(1, Fields.FindTop(Weights, 3, 3, 0, 8, Scores, Penalties));
+
+	Weights.Priority = 6;
+	EXPECT_EQ(2, Fields.FindTop(Weights, 3, 3, 0, 8, Scores, Penalties));
+}
+
+TProgramCall UserCall(std::string InName, std::string InUser)
+{
+	TProgramCall Call(InName, 4, 5);
+	Call.User = InUser;
+
+	return Call;
+}
+
+// Heavy calls twenty programs at tick 0, Light one at tick 1, each of them takes the whole cluster
+size_t GetLightStart(bool InFairShare)
+{
+	CCluster Cluster(20, 4, 25);
+
+	TScoreWeights Weights;
+	Weights.Position = 1;
+	Weights.FairShare = InFairShare ? 20 : 0;
+	Cluster.SetScoreWeights(Weights);
+	Cluster.EnableFairShare(100);
+
+	for (int i = 0; i < 20; i++)
+		Cluster.CallProgramExecution(UserCall("Heavy_" + std::to_string(i), "Heavy"));
+
+	size_t LightStart = SIZE_MAX;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+	{
+		if (InCall.User == "Light")
+			LightStart = InCluster->GetCurrentTime();
+	});
+
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 1)
+			InCluster->CallProgramExecution(UserCall("Light", "Light"));
+	});
+
+	return LightStart;
+}
+
+TEST(TCluster, fair_share_lets_light_user_pass_heavy_one)
+{
+	EXPECT_EQ(SIZE_MAX, GetLightStart(false));
+
+	// Right after the first program of Heavy finishes
+	EXPECT_EQ(6, GetLightStart(true));
+}
+
+TEST(TCluster, fair_share_charges_programs_when_they_finish)
+{
+	CCluster Cluster(12, 4);
+	Cluster.EnableFairShare(0);
+	Cluster.CallProgramExecution(UserCall("First", "User"));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	const CFairShare* FairShare = Cluster.GetFairShare();
+	uint32_t User = FairShare->FindUserID("User");
+	EXPECT_DOUBLE_EQ(20, FairShare->GetUsage(User, Cluster.GetCurrentTime()));
+	EXPECT_EQ(0, FairShare->GetUserState(User).RunningProcessors);
+}
+
+TEST(TCluster, fair_share_is_restored_from_journal_and_snapshot)
+{
+	std::string JournalPath = "cluster_test_fair_share_journal.bin";
+	std::string SnapshotPath = "cluster_test_fair_share_snapshot.bin";
+	std::remove(JournalPath.c_str());
+
+	{
+		CCluster Cluster(7, 4);
+		Cluster.EnableFairShare(0);
+		Cluster.EnableJournal(JournalPath);
+		Cluster.CallProgramExecution(UserCall("First", "User"));
+		Cluster.CallProgramExecution(UserCall("Second", "User"));
+		Cluster.Start([](CCluster* InCluster) {});
+	}
+
+	CCluster Restored(7, 4);
+	Restored.EnableFairShare(0);
+	Restored.EnableJournal(JournalPath);
+
+	// First ran for ticks 0 to 4, Second from tick 6
+	uint32_t User = Restored.GetFairShare()->FindUserID("User");
+	EXPECT_DOUBLE_EQ(28, Restored.GetFairShare()->GetUsage(User, 8));
+	EXPECT_EQ("User", Restored.GetRunningPrograms().at("Second").User);
+
+	Restored.SaveSnapshot(SnapshotPath);
+
+	CCluster Loaded(7, 1);
+	Loaded.LoadSnapshot(SnapshotPath);
+	EXPECT_DOUBLE_EQ(28, Loaded.GetFairShare()->GetUsage(Loaded.GetFairShare()->FindUserID("User"), 8));
+
+	std::remove(JournalPath.c_str());
+	std::remove(SnapshotPath.c_str());
+}
+
+TEST(TCluster, DISABLED_benchmark_fair_share)
+{
+	const size_t ProcessorCount = 32;
+
+	// One user submits seven of every ten jobs, nine others share the rest
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 5000;
+	Parameters.MaxNewProgramsPerTick = 1;
+	Parameters.SpawnThreshold = 0.7f;
+	std::vector<TWorkloadJob> Jobs = GenerateWorkload(Parameters, ProcessorCount, 1);
+
+	for (size_t i = 0; i < Jobs.size(); i++)
+		Jobs[i].User = i % 10 < 7 ? "Heavy" : "Light" + std::to_string(i % 9);
+
+	for (size_t FairShareWeight : { 0, 2, 5 })
+	{
+		CCluster Cluster(Parameters.Duration, ProcessorCount, 64, 5);
+
+		TScoreWeights Weights;
+		Weights.FairShare = FairShareWeight;
+		Cluster.SetScoreWeights(Weights);
+		Cluster.EnableFairShare(200);
+
+		double Wait[2] = { 0, 0 };
+		size_t Started[2] = { 0, 0 };
+		Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+		{
+			int Heavy = InCall.User == "Heavy";
+			Wait[Heavy] += double(InCluster->GetCurrentTime() - InCall.TimeCalled);
+			Started[Heavy]++;
+		});
+
+		CWorkloadSource Source(Jobs);
+		Cluster.AddSubmissionSource(&Source);
+
+		auto Begin = std::chrono::steady_clock::now();
+		Cluster.Start([](CCluster* InCluster) {});
+		std::chrono::duration<double, std::milli> Elapsed = std::chrono::steady_clock::now() - Begin;
+
+		Cluster.RemoveSubmissionSource(&Source);
+
+		std::cout << "Fair share weight " << FairShareWeight << ": mean wait " << Wait[0] / Started[0] << " ticks for the light users, "
+			<< Wait[1] / Started[1] << " for the heavy one, " << Started[0] + Started[1] << " started, " << Elapsed.count() << " ms" << std::endl;
+	}
+}
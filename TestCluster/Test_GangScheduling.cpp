@@ -0,0 +1,242 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "GangMatrix.h"
+#include "Cluster.h"
+#include "WeightTuner.h"
+#include <gtest.h>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+
+// Deterministic workload of short and long programs
+void GangUpdate(CCluster* InCluster)
+{
+	size_t Time = InCluster->GetCurrentTime();
+
+	if (Time % 3 != 2)
+		InCluster->CallProgramExecution(TProgramCall("Program" + std::to_string(Time), 1 + Time % 7, Time % 4 == 0 ? 30 : 1 + Time % 5));
+}
+
+std::string GangReportToString(CCluster& InCluster)
+{
+	std::stringstream Stream;
+	Stream << InCluster.GetReportData();
+	return Stream.str();
+}
+
+// Long takes the whole cluster at tick 0, Short is called after it and gets the second row at tick 1
+void CallShortAtTickZero(CCluster* InCluster)
+{
+	if (InCluster->GetCurrentTime() == 0)
+		InCluster->CallProgramExecution(TProgramCall("Short", 2, 2));
+}
+
+TEST(CGangMatrix, allocates_lowest_free_cells_of_row)
+{
+	CGangMatrix Matrix;
+	Matrix.Reset(2, 130);
+
+	EXPECT_EQ(130, Matrix.GetFreeCount(1));
+	EXPECT_EQ(std::vector<unsigned>({ 0, 1, 2 }), Matrix.Allocate(1, 3));
+
+	Matrix.Occupy(1, { 3, 63, 64 });
+	Matrix.Release(1, { 1 });
+
+	std::vector<unsigned> Expected = { 1 };
+	for (unsigned Column = 4; Column < 63; Column++)
+		Expected.push_back(Column);
+	Expected.push_back(65);
+
+	EXPECT_EQ(Expected, Matrix.Allocate(1, 61));
+	EXPECT_EQ(64, Matrix.GetFreeCount(1));
+	EXPECT_EQ(130, Matrix.GetFreeCount(0));
+
+	// Never past the last column
+	EXPECT_TRUE(Matrix.Allocate(1, 65).empty());
+	EXPECT_EQ(129, Matrix.Allocate(1, 64).back());
+	EXPECT_EQ(129, Matrix.Allocate(0, 130).back());
+	EXPECT_TRUE(Matrix.Allocate(0, 1).empty());
+}
+
+TEST(CGangMatrix, finds_rows_from_given_one)
+{
+	CGangMatrix Matrix;
+	Matrix.Reset(3, 4);
+	Matrix.Allocate(0, 3);
+	Matrix.Allocate(2, 1);
+
+	EXPECT_EQ(2, Matrix.FindRow(3, 2));
+	EXPECT_EQ(1, Matrix.FindRow(4, 2));
+	EXPECT_EQ(SIZE_MAX, Matrix.FindRow(5));
+	EXPECT_EQ(4, Matrix.GetLargestFreeCount());
+
+	EXPECT_EQ(2, Matrix.FindNextBusyRow(0));
+	EXPECT_EQ(0, Matrix.FindNextBusyRow(2));
+	EXPECT_EQ(2, Matrix.FindNextBusyRow(1));
+
+	Matrix.Release(2, { 0 });
+	EXPECT_EQ(SIZE_MAX, Matrix.FindNextBusyRow(0));
+}
+
+TEST(CGangMatrix, throws_on_wrong_cells)
+{
+	CGangMatrix Matrix;
+	Matrix.Reset(2, 4);
+	Matrix.Occupy(0, { 1 });
+
+	ASSERT_ANY_THROW(Matrix.Occupy(0, { 1 }));
+	ASSERT_ANY_THROW(Matrix.Release(0, { 2 }));
+	ASSERT_ANY_THROW(Matrix.Occupy(0, { 4 }));
+	ASSERT_ANY_THROW(Matrix.Occupy(2, { 0 }));
+	ASSERT_NO_THROW(Matrix.Occupy(1, { 1 }));
+}
+
+TEST(TCluster, throws_on_wrong_gang_scheduling)
+{
+	CCluster Cluster(10, 4);
+
+	ASSERT_ANY_THROW(Cluster.EnableGangScheduling(0, 5));
+	ASSERT_ANY_THROW(Cluster.EnableGangScheduling(2, 5, 5));
+
+	CCluster Preempting(10, 4);
+	Preempting.EnablePreemption(1);
+	ASSERT_ANY_THROW(Preempting.EnableGangScheduling(2, 5));
+
+	ASSERT_NO_THROW(Cluster.EnableGangScheduling(2, 5, 1));
+	ASSERT_ANY_THROW(Cluster.EnableBuddyAllocation());
+	ASSERT_ANY_THROW(Cluster.EnableDeadlineScheduling());
+	ASSERT_ANY_THROW(Cluster.EnableJournal("cluster_test_gang_journal.bin"));
+
+	TProgramCall Real("Real", 1, 5);
+	Real.Task = [](CJobContext& InContext) {};
+	ASSERT_ANY_THROW(Cluster.CallProgramExecution(Real));
+}
+
+TEST(TCluster, single_slice_runs_to_completion)
+{
+	CCluster RunToCompletion(150, 12, 4, 2);
+	RunToCompletion.Start(GangUpdate);
+
+	CCluster Gang(150, 12, 4, 2);
+	Gang.EnableGangScheduling(1, 5, 2);
+	Gang.Start(GangUpdate);
+
+	EXPECT_EQ(GangReportToString(RunToCompletion), GangReportToString(Gang));
+}
+
+TEST(TCluster, short_program_runs_between_slices_of_long_one)
+{
+	CCluster RunToCompletion(30, 2);
+	RunToCompletion.CallProgramExecution(TProgramCall("Long", 2, 20));
+	RunToCompletion.Start(CallShortAtTickZero);
+
+	CCluster Gang(30, 2);
+	Gang.EnableGangScheduling(2, 2);
+	Gang.CallProgramExecution(TProgramCall("Long", 2, 20));
+	Gang.Start(CallShortAtTickZero);
+
+	// Short runs on ticks 2 and 3 instead of after Long, Long is paused for them
+	TClusterReportData& Report = Gang.GetReportData();
+	EXPECT_FLOAT_EQ(4, Report.PerJobClassAverageResponseTime[2]);
+	EXPECT_FLOAT_EQ(22, Report.PerJobClassAverageResponseTime[32]);
+	EXPECT_EQ(2, Report.ContextSwitches);
+
+	EXPECT_FLOAT_EQ(23, RunToCompletion.GetReportData().PerJobClassAverageResponseTime[2]);
+	EXPECT_FLOAT_EQ(20, RunToCompletion.GetReportData().PerJobClassAverageResponseTime[32]);
+}
+
+TEST(TCluster, context_switch_takes_time)
+{
+	CCluster Cluster(30, 2);
+	Cluster.EnableGangScheduling(2, 2, 1);
+	Cluster.CallProgramExecution(TProgramCall("Long", 2, 20));
+	Cluster.Start(CallShortAtTickZero);
+
+	// Every other tick after the first switch is spent switching
+	TClusterReportData& Report = Cluster.GetReportData();
+	EXPECT_FLOAT_EQ(8, Report.PerJobClassAverageResponseTime[2]);
+	EXPECT_FLOAT_EQ(26, Report.PerJobClassAverageResponseTime[32]);
+	EXPECT_EQ(4, Report.ContextSwitches);
+}
+
+TEST(TCluster, empty_slice_is_left_right_away)
+{
+	CCluster Cluster(8, 2);
+	Cluster.EnableGangScheduling(2, 10);
+	Cluster.CallProgramExecution(TProgramCall("First", 2, 2));
+	Cluster.CallProgramExecution(TProgramCall("Second", 2, 5));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	// First finishes at tick 2, Second runs from tick 3 instead of waiting for the quantum to end
+	EXPECT_EQ(2, Cluster.GetFinishedProgramCount());
+	EXPECT_EQ(1, Cluster.GetActiveSlice());
+}
+
+TEST(TCluster, only_active_slice_is_on_processors)
+{
+	CCluster Cluster(2, 4);
+	Cluster.EnableGangScheduling(2, 5);
+	Cluster.CallProgramExecution(TProgramCall("Wide", 3, 20));
+	Cluster.CallProgramExecution(TProgramCall("Narrow", 2, 20));
+	Cluster.CallProgramExecution(TProgramCall("Fits", 1, 20));
+	Cluster.SetMaxProgramsStartPerTick(3);
+	Cluster.Start([](CCluster* InCluster) {});
+
+	EXPECT_EQ(3, Cluster.GetRunningProgramCount());
+	EXPECT_EQ("Wide", Cluster.GetProcessorData()[0].GetAssignedProgram());
+	EXPECT_EQ("Fits", Cluster.GetProcessorData()[3].GetAssignedProgram());
+	EXPECT_EQ(std::set<unsigned>({ 0, 1 }), Cluster.GetRunningPrograms().at("Narrow").OccupiedProcessors);
+	EXPECT_EQ(2, Cluster.GetGangMatrix().GetFreeCount(1));
+}
+
+TEST(TCluster, fork_keeps_gang_scheduling)
+{
+	CCluster Uninterrupted(200, 12, 4, 2);
+	Uninterrupted.EnableGangScheduling(3, 4, 1);
+	Uninterrupted.Start(GangUpdate);
+
+	CCluster FirstHalf(97, 12, 4, 2);
+	FirstHalf.EnableGangScheduling(3, 4, 1);
+	FirstHalf.Start(GangUpdate);
+
+	std::unique_ptr<CCluster> Forked = FirstHalf.Fork(200);
+	Forked->Start(GangUpdate);
+
+	EXPECT_EQ(GangReportToString(Uninterrupted), GangReportToString(*Forked));
+}
+
+TEST(TCluster, DISABLED_benchmark_gang_scheduling)
+{
+	const size_t ProcessorCount = 1024;
+
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 2000;
+	Parameters.MaxNewProgramsPerTick = 8;
+	Parameters.SpawnThreshold = 0.8f;
+	Parameters.RequiredProcessorsMultiplier = 16;
+	std::vector<TWorkloadJob> Jobs = GenerateWorkload(Parameters, ProcessorCount, 1);
+
+	// Run to completion, then time slicing between 4 rows with a context switch of 1 tick per 10
+	for (size_t SliceCount : { 0, 4 })
+	{
+		CCluster Cluster(Parameters.Duration * 4, ProcessorCount, 16, 16);
+		if (SliceCount != 0)
+			Cluster.EnableGangScheduling(SliceCount, 10, 1);
+
+		CWorkloadSource Source(Jobs);
+		Cluster.AddSubmissionSource(&Source);
+
+		auto Begin = std::chrono::steady_clock::now();
+		Cluster.Start([](CCluster* InCluster) {});
+		std::chrono::duration<double, std::milli> Elapsed = std::chrono::steady_clock::now() - Begin;
+
+		Cluster.RemoveSubmissionSource(&Source);
+
+		TClusterReportData& Report = Cluster.GetReportData();
+		std::cout << (SliceCount == 0 ? "Run to completion: " : "Gang scheduling: ") << Report.TotalProgramsFinished << " finished, "
+			<< Report.ContextSwitches << " context switches, " << Elapsed.count() << " ms" << std::endl;
+
+		for (auto& JobClass : Report.PerJobClassAverageResponseTime)
+			std::cout << "  up to " << JobClass.first << " ticks: mean response " << JobClass.second << std::endl;
+	}
+}
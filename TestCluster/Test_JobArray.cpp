@@ -0,0 +1,193 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Cluster.h"
+#include <gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <iostream>
+
+TProgramCall ArrayCall(std::string InName, size_t InRequiredProcessors, size_t InExecutionTime, size_t InArrayCount)
+{
+	TProgramCall Call(InName, InRequiredProcessors, InExecutionTime);
+	Call.ArrayCount = InArrayCount;
+
+	return Call;
+}
+
+// Sweeps of 5 tasks between single calls, depending only on the time
+void JobArrayUpdate(CCluster* InCluster)
+{
+	size_t Time = InCluster->GetCurrentTime();
+
+	if (Time % 7 == 0)
+		InCluster->CallProgramExecution(ArrayCall("Sweep" + std::to_string(Time), 1 + Time % 3, 1 + Time % 4, 5));
+	else if (Time % 3 == 0)
+		InCluster->CallProgramExecution(TProgramCall("Program" + std::to_string(Time), 1 + Time % 5, 1 + Time % 6));
+}
+
+std::string JobArrayReportToString(CCluster& InCluster)
+{
+	std::stringstream Stream;
+	Stream << InCluster.GetReportData();
+	return Stream.str();
+}
+
+TEST(TCluster, job_array_takes_one_queue_entry)
+{
+	CCluster Cluster(0, 4);
+
+	EXPECT_EQ(0, Cluster.CallProgramExecution(ArrayCall("Sweep", 1, 5, 10000)));
+	EXPECT_EQ(10000, Cluster.CallProgramExecution(TProgramCall("Single", 1, 5)));
+
+	EXPECT_EQ(2, Cluster.GetWaitingProgramCalls().size());
+	EXPECT_EQ(10001, Cluster.GetReportData().TotalProgramCalls);
+}
+
+TEST(TCluster, job_array_starts_tasks_lazily)
+{
+	CCluster Cluster(40, 4, 5, 4);
+	Cluster.CallProgramExecution(TProgramCall("Before", 1, 30));
+	Cluster.CallProgramExecution(ArrayCall("Sweep", 1, 3, 5));
+
+	std::vector<std::pair<std::string, size_t>> Starts;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+	{
+		Starts.push_back({ InCall.Name, InCall.JobID });
+		EXPECT_EQ(0, InCall.ArrayCount);
+	});
+
+	Cluster.Start([](CCluster* InCluster)
+	{
+		// The rest of the array keeps one entry until its last task starts
+		if (InCluster->GetCurrentTime() == 0)
+		{
+			ASSERT_EQ(2, InCluster->GetWaitingProgramCalls().size());
+			EXPECT_EQ(1, InCluster->GetWaitingProgramCalls().Check(1).ArrayCount);
+			EXPECT_EQ(4, InCluster->GetWaitingProgramCalls().Check(1).ArrayIndex);
+			EXPECT_EQ(5, InCluster->GetWaitingProgramCalls().Check(1).JobID);
+		}
+	});
+
+	std::vector<std::pair<std::string, size_t>> Expected = { { "Sweep.0", 1 }, { "Sweep.1", 2 }, { "Sweep.2", 3 }, { "Sweep.3", 4 }, { "Sweep.4", 5 }, { "Before", 0 } };
+	EXPECT_EQ(Expected, Starts);
+	EXPECT_EQ(0, Cluster.GetWaitingProgramCalls().size());
+	EXPECT_EQ(6, Cluster.GetFinishedProgramCount());
+}
+
+TEST(TCluster, job_array_keeps_its_place_in_queue)
+{
+	CCluster Cluster(20, 1);
+	Cluster.CallProgramExecution(ArrayCall("Sweep", 1, 2, 3));
+	Cluster.CallProgramExecution(TProgramCall("After", 1, 2));
+
+	std::vector<std::string> Starts;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall) { Starts.push_back(InCall.Name); });
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::vector<std::string> Expected = { "Sweep.0", "Sweep.1", "Sweep.2", "After" };
+	EXPECT_EQ(Expected, Starts);
+}
+
+TEST(TCluster, preempted_array_task_is_queued_alone)
+{
+	CCluster Cluster(3, 2, 5, 2);
+	Cluster.EnablePreemption(0);
+	Cluster.CallProgramExecution(ArrayCall("Sweep", 1, 10, 3));
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 2)
+		{
+			TProgramCall Urgent("Urgent", 1, 1);
+			Urgent.Priority = 1;
+			InCluster->CallProgramExecution(Urgent);
+		}
+	});
+
+	ASSERT_EQ(2, Cluster.GetWaitingProgramCalls().size());
+	EXPECT_EQ("Sweep", Cluster.GetWaitingProgramCalls().Check(0).Name);
+	EXPECT_EQ(1, Cluster.GetWaitingProgramCalls().Check(0).ArrayCount);
+
+	const TProgramCall& Preempted = Cluster.GetWaitingProgramCalls().Check(1);
+	EXPECT_EQ(0, Preempted.ArrayCount);
+	EXPECT_EQ("Sweep." + std::to_string(Preempted.JobID), Preempted.Name);
+	EXPECT_EQ(1, Cluster.GetRunningPrograms().count("Urgent"));
+}
+
+TEST(TCluster, job_arrays_are_restored_from_journal)
+{
+	std::string Path = "cluster_test_job_array_journal.bin";
+	std::remove(Path.c_str());
+
+	CCluster Uninterrupted(150, 8, 4, 2);
+	Uninterrupted.Start(JobArrayUpdate);
+
+	{
+		CCluster FirstHalf(71, 8, 4, 2);
+		FirstHalf.EnableJournal(Path);
+		FirstHalf.Start(JobArrayUpdate);
+	}
+
+	CCluster Restored(150, 8, 4, 2);
+	Restored.EnableJournal(Path);
+	Restored.Start(JobArrayUpdate);
+
+	// The journal keeps the calls and the programs, not the load counters
+	TClusterReportData& Expected = Uninterrupted.GetReportData();
+	TClusterReportData& Report = Restored.GetReportData();
+	EXPECT_EQ(Expected.TotalProgramCalls, Report.TotalProgramCalls);
+	EXPECT_EQ(Expected.TotalProgramsRunning, Report.TotalProgramsRunning);
+	EXPECT_EQ(Expected.PerProcessorTotalPrograms, Report.PerProcessorTotalPrograms);
+	EXPECT_EQ(Expected.PerJobClassTotalResponseTime, Report.PerJobClassTotalResponseTime);
+	EXPECT_EQ(Uninterrupted.GetWaitingProgramCalls().size(), Restored.GetWaitingProgramCalls().size());
+
+	std::remove(Path.c_str());
+}
+
+TEST(TCluster, fork_keeps_job_arrays)
+{
+	CCluster Uninterrupted(150, 8, 4, 2);
+	Uninterrupted.Start(JobArrayUpdate);
+
+	CCluster FirstHalf(71, 8, 4, 2);
+	FirstHalf.Start(JobArrayUpdate);
+
+	std::vector<size_t> ArrayCounts;
+	for (size_t i = 0; i < FirstHalf.GetWaitingProgramCalls().size(); i++)
+		ArrayCounts.push_back(FirstHalf.GetWaitingProgramCalls().Check(i).ArrayCount);
+
+	std::unique_ptr<CCluster> Forked = FirstHalf.Fork(150);
+	Forked->Start(JobArrayUpdate);
+
+	EXPECT_EQ(JobArrayReportToString(Uninterrupted), JobArrayReportToString(*Forked));
+
+	// Tasks started by the fork do not change the arrays waiting in this cluster
+	ASSERT_EQ(ArrayCounts.size(), FirstHalf.GetWaitingProgramCalls().size());
+	for (size_t i = 0; i < ArrayCounts.size(); i++)
+		EXPECT_EQ(ArrayCounts[i], FirstHalf.GetWaitingProgramCalls().Check(i).ArrayCount);
+}
+
+TEST(TCluster, DISABLED_benchmark_job_array)
+{
+	const size_t TaskCount = 10000;
+
+	// The same sweep as separate calls and as one job array
+	for (bool Array : { false, true })
+	{
+		CCluster Cluster(2000, 256, 64, 64);
+
+		auto Begin = std::chrono::steady_clock::now();
+		if (Array)
+			Cluster.CallProgramExecution(ArrayCall("Sweep", 4, 10, TaskCount));
+		else
+			for (size_t i = 0; i < TaskCount; i++)
+				Cluster.CallProgramExecution(TProgramCall("Sweep." + std::to_string(i), 4, 10));
+
+		size_t QueueEntries = Cluster.GetWaitingProgramCalls().size();
+		Cluster.Start([](CCluster* InCluster) {});
+		std::chrono::duration<double, std::milli> Elapsed = std::chrono::steady_clock::now() - Begin;
+
+		std::cout << (Array ? "Job array: " : "Separate calls: ") << QueueEntries << " queue entries, " << Cluster.GetFinishedProgramCount()
+			<< " finished, " << Elapsed.count() << " ms" << std::endl;
+	}
+}
@@ -0,0 +1,170 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "JobExecutor.h"
+#include <gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+
+// Runs a job on the given slots of a pool and waits for it to finish, returns whether it succeeded
+bool RunJob(CWorkerPool& Pool, const std::set<unsigned>& Slots, JobTaskFunction Task)
+{
+	std::promise<bool> Result;
+	CJobExecutor::Launch(Pool, Slots, Task, [&](bool Succeeded) { Result.set_value(Succeeded); });
+	return Result.get_future().get();
+}
+
+// Sums [Begin, End) by recursive splitting
+void ForkSum(CJobContext& Context, long long Begin, long long End, std::atomic<long long>& Sum)
+{
+	if (End - Begin <= 16)
+	{
+		long long LocalSum = 0;
+		for (long long i = Begin; i < End; i++)
+			LocalSum += i;
+
+		Sum += LocalSum;
+		return;
+	}
+
+	long long Middle = (Begin + End) / 2;
+	Context.Fork([=, &Sum](CJobContext& SubContext) { ForkSum(SubContext, Begin, Middle, Sum); });
+	ForkSum(Context, Middle, End, Sum);
+}
+
+TEST(CJobExecutor, throws_when_created_without_slots)
+{
+	ASSERT_ANY_THROW(CJobExecutor Executor(0));
+}
+
+TEST(CJobExecutor, runs_single_slot_job)
+{
+	CWorkerPool Pool(2);
+	std::atomic<int> Counter(0);
+
+	EXPECT_TRUE(RunJob(Pool, { 1 }, [&](CJobContext& Context) { Counter++; }));
+	EXPECT_EQ(1, Counter);
+}
+
+TEST(CJobExecutor, context_knows_reserved_slot_count)
+{
+	CWorkerPool Pool(8);
+	size_t SlotCount = 0;
+
+	RunJob(Pool, { 1, 3, 5 }, [&](CJobContext& Context) { SlotCount = Context.GetSlotCount(); });
+
+	EXPECT_EQ(3, SlotCount);
+}
+
+TEST(CJobExecutor, finishes_after_all_forked_subtasks)
+{
+	CWorkerPool Pool(4);
+	std::atomic<long long> Sum(0);
+
+	EXPECT_TRUE(RunJob(Pool, { 0, 1, 2, 3 }, [&](CJobContext& Context) { ForkSum(Context, 0, 100000, Sum); }));
+	EXPECT_EQ(100000LL * 99999 / 2, Sum);
+}
+
+TEST(CJobExecutor, idle_slots_steal_subtasks)
+{
+	CWorkerPool Pool(4);
+	std::atomic<int> UsedSlots[4] = {};
+
+	RunJob(Pool, { 0, 1, 2, 3 }, [&](CJobContext& Context)
+	{
+		for (int i = 0; i < 64; i++)
+			Context.Fork([&](CJobContext& SubContext)
+			{
+				UsedSlots[SubContext.GetSlotIndex()] = 1;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			});
+	});
+
+	EXPECT_GT(UsedSlots[0] + UsedSlots[1] + UsedSlots[2] + UsedSlots[3], 1);
+}
+
+TEST(CJobExecutor, sync_waits_only_for_own_subtasks)
+{
+	CWorkerPool Pool(2);
+	std::atomic<int> Counter(0);
+	int CounterAfterSync = 0;
+
+	RunJob(Pool, { 0, 1 }, [&](CJobContext& Context)
+	{
+		for (int i = 0; i < 10; i++)
+			Context.Fork([&](CJobContext&) { Counter++; });
+
+		Context.Sync();
+		CounterAfterSync = Counter;
+	});
+
+	EXPECT_EQ(10, CounterAfterSync);
+}
+
+TEST(CJobExecutor, reports_failure_when_subtask_throws)
+{
+	CWorkerPool Pool(2);
+
+	EXPECT_FALSE(RunJob(Pool, { 0, 1 }, [](CJobContext& Context)
+	{
+		Context.Fork([](CJobContext&) { throw(std::runtime_error("Subtask failed")); });
+	}));
+}
+
+
+// Benchmark, run with --gtest_also_run_disabled_tests
+// Irregular workload: the first items are two orders of magnitude more expensive than the rest, so a static split
+// gives one slot most of the work while work stealing spreads it over the whole allocation
+
+volatile unsigned long long BenchmarkSink;
+
+void ProcessIrregularItem(size_t Item)
+{
+	size_t Cost = Item < 512 ? 200000 : 2000;
+
+	unsigned long long Value = Item;
+	for (size_t i = 0; i < Cost; i++)
+		Value = Value * 6364136223846793005ULL + 1442695040888963407ULL;
+
+	BenchmarkSink = Value;
+}
+
+void ForkIrregular(CJobContext& Context, size_t Begin, size_t End)
+{
+	if (End - Begin <= 4)
+	{
+		for (size_t i = Begin; i < End; i++)
+			ProcessIrregularItem(i);
+		return;
+	}
+
+	size_t Middle = (Begin + End) / 2;
+	Context.Fork([=](CJobContext& SubContext) { ForkIrregular(SubContext, Begin, Middle); });
+	ForkIrregular(Context, Middle, End);
+}
+
+TEST(CJobExecutor, DISABLED_benchmark_work_stealing_against_static_partitioning)
+{
+	const size_t ItemCount = 8192;
+	const std::set<unsigned> Slots = { 0, 1, 2, 3 };
+
+	CWorkerPool Pool(Slots.size());
+
+	std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+	RunJob(Pool, Slots, [&](CJobContext& Context)
+	{
+		// One contiguous part per slot, each idle slot steals exactly one part and then has nothing left to balance
+		size_t PartSize = ItemCount / Context.GetSlotCount();
+
+		for (size_t Part = 0; Part < Context.GetSlotCount(); Part++)
+			Context.Fork([=](CJobContext&) { for (size_t i = Part * PartSize; i < (Part + 1) * PartSize; i++) ProcessIrregularItem(i); });
+	});
+	float StaticTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - StartTime).count();
+
+	StartTime = std::chrono::steady_clock::now();
+	RunJob(Pool, Slots, [&](CJobContext& Context) { ForkIrregular(Context, 0, ItemCount); });
+	float StealingTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - StartTime).count();
+
+	std::cout << "Static partitioning: " << StaticTime << " s; Work stealing: " << StealingTime << " s;" << std::endl;
+}
@@ -0,0 +1,279 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Journal.h"
+#include <gtest.h>
+#include <cstdio>
+#include <chrono>
+#include <iostream>
+
+std::string TestJournalPath()
+{
+	return "cluster_test_journal.bin";
+}
+
+// Calls a program every tick, with varying sizes so that some of them have to wait
+void JournaledUpdate(CCluster* InCluster)
+{
+	size_t Time = InCluster->GetCurrentTime();
+
+	TProgramCall Call("Program" + std::to_string(Time), 1 + Time % 7, 1 + Time % 5);
+	InCluster->CallProgramExecution(Call);
+}
+
+TEST(CJournal, creates_empty_journal)
+{
+	std::remove(TestJournalPath().c_str());
+
+	std::vector<TJournalRecord> Records;
+	CJournal Journal(TestJournalPath(), Records);
+
+	EXPECT_EQ(0, Records.size());
+	EXPECT_EQ(0, Journal.GetCommitCount());
+
+	std::remove(TestJournalPath().c_str());
+}
+
+TEST(CJournal, reads_back_committed_records)
+{
+	std::remove(TestJournalPath().c_str());
+
+	{
+		std::vector<TJournalRecord> Records;
+		CJournal Journal(TestJournalPath(), Records);
+
+		TProgramCall Call("Program", 2, 10, 4);
+		Call.JobID = 7;
+		Call.PredictedExecutionTime = 6;
+		Journal.LogCall(Call);
+
+		TProgram Program(Call, 0);
+		Program.AssignProcessor(3);
+		Program.AssignProcessor(5);
+		Journal.LogStart(Program);
+
+		Journal.Commit(0);
+	}
+
+	std::vector<TJournalRecord> Records;
+	CJournal Journal(TestJournalPath(), Records);
+
+	ASSERT_EQ(3, Records.size());
+	EXPECT_EQ(EJournalRecord::Call, Records[0].Type);
+	EXPECT_EQ(7, Records[0].Call.JobID);
+	EXPECT_EQ("Program", Records[0].Call.Name);
+	EXPECT_EQ(10, Records[0].Call.ExecutionTime);
+	EXPECT_EQ(4, Records[0].Call.ActualExecutionTime);
+	EXPECT_EQ(6, Records[0].Call.PredictedExecutionTime);
+	EXPECT_EQ(EJournalRecord::Start, Records[1].Type);
+	EXPECT_EQ(std::vector<unsigned>({ 3, 5 }), Records[1].Processors);
+	EXPECT_EQ(EJournalRecord::Tick, Records[2].Type);
+
+	std::remove(TestJournalPath().c_str());
+}
+
+TEST(CJournal, flush_makes_committed_ticks_durable)
+{
+	std::remove(TestJournalPath().c_str());
+
+	std::vector<TJournalRecord> Records;
+	CJournal Journal(TestJournalPath(), Records);
+
+	for (size_t Time = 0; Time < 100; Time++)
+	{
+		Journal.LogCall(TProgramCall("Program" + std::to_string(Time), 1, 1));
+		Journal.Commit(Time);
+	}
+
+	Journal.Flush();
+
+	EXPECT_EQ(100, Journal.GetCommitCount());
+	EXPECT_LE(Journal.GetSyncCount(), 100);
+
+	std::remove(TestJournalPath().c_str());
+}
+
+TEST(CJournal, ticks_of_a_group_share_one_sync)
+{
+	std::remove(TestJournalPath().c_str());
+
+	std::vector<TJournalRecord> Records;
+	CJournal Journal(TestJournalPath(), Records);
+
+	// All of them end well within one group commit window
+	for (size_t Time = 0; Time < 100; Time++)
+		Journal.Commit(Time);
+
+	Journal.Flush();
+
+	EXPECT_EQ(100, Journal.GetCommitCount());
+	EXPECT_LE(Journal.GetSyncCount(), 3);
+
+	std::remove(TestJournalPath().c_str());
+}
+
+TEST(CJournal, drops_uncommitted_and_torn_records)
+{
+	std::remove(TestJournalPath().c_str());
+
+	{
+		std::vector<TJournalRecord> Records;
+		CJournal Journal(TestJournalPath(), Records);
+
+		Journal.LogCall(TProgramCall("Committed", 1, 1));
+		Journal.Commit(0);
+
+		// Never committed
+		Journal.LogCall(TProgramCall("Lost", 1, 1));
+	}
+
+	std::FILE* File = std::fopen(TestJournalPath().c_str(), "ab");
+	std::fputc(int(EJournalRecord::Call), File);
+	std::fputc(42, File);
+	std::fclose(File);
+
+	{
+		std::vector<TJournalRecord> Records;
+		CJournal Journal(TestJournalPath(), Records);
+
+		ASSERT_EQ(2, Records.size());
+		EXPECT_EQ("Committed", Records[0].Call.Name);
+
+		Journal.LogCall(TProgramCall("Next", 1, 1));
+		Journal.Commit(1);
+	}
+
+	std::vector<TJournalRecord> Records;
+	CJournal Journal(TestJournalPath(), Records);
+
+	ASSERT_EQ(4, Records.size());
+	EXPECT_EQ("Next", Records[2].Call.Name);
+
+	std::remove(TestJournalPath().c_str());
+}
+
+TEST(CJournal, refuses_file_without_journal_header)
+{
+	std::string Contents = "not a cluster journal, it must not be cut";
+
+	std::FILE* File = std::fopen(TestJournalPath().c_str(), "wb");
+	std::fwrite(Contents.data(), 1, Contents.size(), File);
+	std::fclose(File);
+
+	std::vector<TJournalRecord> Records;
+	ASSERT_ANY_THROW(CJournal Journal(TestJournalPath(), Records));
+
+	CCluster Cluster(10, 4);
+	ASSERT_ANY_THROW(Cluster.EnableJournal(TestJournalPath()));
+
+	File = std::fopen(TestJournalPath().c_str(), "rb");
+	std::string ReadBack(Contents.size() + 1, 0);
+	ReadBack.resize(std::fread(&ReadBack[0], 1, ReadBack.size(), File));
+	std::fclose(File);
+
+	EXPECT_EQ(Contents, ReadBack);
+
+	std::remove(TestJournalPath().c_str());
+}
+
+TEST(CJournal, refuses_journal_of_another_version)
+{
+	std::remove(TestJournalPath().c_str());
+
+	{
+		std::vector<TJournalRecord> Records;
+		CJournal Journal(TestJournalPath(), Records);
+	}
+
+	// The version follows the 8 byte magic
+	std::FILE* File = std::fopen(TestJournalPath().c_str(), "r+b");
+	std::fseek(File, 8, SEEK_SET);
+	uint32_t OldVersion = JournalVersion - 1;
+	std::fwrite(&OldVersion, sizeof(OldVersion), 1, File);
+	std::fclose(File);
+
+	std::vector<TJournalRecord> Records;
+	ASSERT_ANY_THROW(CJournal Journal(TestJournalPath(), Records));
+
+	std::remove(TestJournalPath().c_str());
+}
+
+TEST(CJournal, cluster_state_is_rebuilt_from_journal)
+{
+	std::remove(TestJournalPath().c_str());
+
+	size_t Waiting, Running, Finished, Calls;
+
+	{
+		CCluster Cluster(20, 16);
+		Cluster.EnableJournal(TestJournalPath());
+		Cluster.Start(JournaledUpdate);
+
+		Waiting = Cluster.GetWaitingProgramCalls().size();
+		Running = Cluster.GetRunningProgramCount();
+		Finished = Cluster.GetFinishedProgramCount();
+		Calls = Cluster.GetReportData().TotalProgramCalls;
+	}
+
+	CCluster Restored(40, 16);
+	Restored.EnableJournal(TestJournalPath());
+
+	EXPECT_EQ(21, Restored.GetCurrentTime());
+	EXPECT_EQ(Waiting, Restored.GetWaitingProgramCalls().size());
+	EXPECT_EQ(Running, Restored.GetRunningProgramCount());
+	EXPECT_EQ(Finished, Restored.GetFinishedProgramCount());
+	EXPECT_EQ(Calls, Restored.GetReportData().TotalProgramCalls);
+
+	// Job IDs continue where the journaled run stopped
+	EXPECT_EQ(Calls, Restored.CallProgramExecution(TProgramCall("Next", 1, 1)));
+
+	ASSERT_NO_THROW(Restored.Start(JournaledUpdate));
+
+	std::remove(TestJournalPath().c_str());
+}
+
+TEST(CJournal, throws_when_enabled_twice)
+{
+	std::remove(TestJournalPath().c_str());
+
+	CCluster Cluster(20, 16);
+	Cluster.EnableJournal(TestJournalPath());
+
+	ASSERT_ANY_THROW(Cluster.EnableJournal(TestJournalPath()));
+
+	std::remove(TestJournalPath().c_str());
+}
+
+
+// Benchmark, run with --gtest_also_run_disabled_tests
+
+void BusyUpdate(CCluster* InCluster)
+{
+	for (int i = 0; i < 10; i++)
+		InCluster->CallProgramExecution(TProgramCall("Program" + std::to_string(InCluster->GetCurrentTime()) + "_" + std::to_string(i), 1 + i % 4, 1 + i % 5));
+}
+
+TEST(CJournal, DISABLED_benchmark_journal_overhead)
+{
+	const size_t Ticks = 2000;
+
+	std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+	{
+		CCluster Cluster(Ticks, 64, 5, 10);
+		Cluster.Start(BusyUpdate);
+	}
+	float PlainTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - StartTime).count();
+
+	std::remove(TestJournalPath().c_str());
+
+	StartTime = std::chrono::steady_clock::now();
+	{
+		CCluster Cluster(Ticks, 64, 5, 10);
+		Cluster.EnableJournal(TestJournalPath());
+		Cluster.Start(BusyUpdate);
+	}
+	float JournaledTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - StartTime).count();
+
+	std::remove(TestJournalPath().c_str());
+
+	std::cout << "Without journal: " << PlainTime << " s; With journal: " << JournaledTime << " s (" << Ticks << " ticks);" << std::endl;
+}
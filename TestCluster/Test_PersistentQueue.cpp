@@ -0,0 +1,187 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "PersistentQueue.h"
+#include <gtest.h>
+#include <deque>
+#include <random>
+#include <string>
+
+TEST(TPersistentQueue, empty_by_default)
+{
+	TPersistentQueue<int> Queue;
+
+	EXPECT_EQ(true, Queue.empty());
+	EXPECT_EQ(0, Queue.size());
+}
+
+TEST(TPersistentQueue, first_in_first_out)
+{
+	TPersistentQueue<int> Queue;
+
+	for (int i = 0; i < 10; i++)
+		Queue.Put(i);
+
+	for (int i = 0; i < 10; i++)
+	{
+		EXPECT_EQ(i, Queue.Check());
+		Queue.Pop();
+	}
+
+	EXPECT_EQ(true, Queue.empty());
+}
+
+TEST(TPersistentQueue, can_check_and_pop_at_position)
+{
+	TPersistentQueue<int> Queue;
+
+	for (int i = 0; i < 7; i++)
+		Queue.Put(i);
+
+	EXPECT_EQ(5, Queue.Check(5));
+
+	Queue.Pop(3);
+	Queue.Pop(5);
+
+	ASSERT_EQ(5, Queue.size());
+	EXPECT_EQ(0, Queue.Check(0));
+	EXPECT_EQ(2, Queue.Check(2));
+	EXPECT_EQ(4, Queue.Check(3));
+	EXPECT_EQ(5, Queue.Check(4));
+}
+
+TEST(TPersistentQueue, throws_when_out_of_range)
+{
+	TPersistentQueue<int> Queue;
+
+	ASSERT_ANY_THROW(Queue.Pop());
+	ASSERT_ANY_THROW(Queue.Check());
+
+	Queue.Put(1);
+
+	ASSERT_ANY_THROW(Queue.Check(1));
+	ASSERT_ANY_THROW(Queue.Pop(1));
+}
+
+TEST(TPersistentQueue, copies_are_independent)
+{
+	TPersistentQueue<std::string> Queue;
+
+	for (int i = 0; i < 6; i++)
+		Queue.Put(std::to_string(i));
+
+	TPersistentQueue<std::string> Copy = Queue;
+
+	Copy.Pop(2);
+	Copy.Put("New");
+	Queue.Pop(0);
+
+	ASSERT_EQ(5, Queue.size());
+	for (int i = 0; i < 5; i++)
+		EXPECT_EQ(std::to_string(i + 1), Queue.Check(i));
+
+	ASSERT_EQ(6, Copy.size());
+	EXPECT_EQ("1", Copy.Check(1));
+	EXPECT_EQ("3", Copy.Check(2));
+	EXPECT_EQ("New", Copy.Check(5));
+}
+
+TEST(TPersistentQueue, replaces_element_in_place)
+{
+	TPersistentQueue<std::string> Queue;
+
+	for (int i = 0; i < 6; i++)
+		Queue.Put(std::to_string(i));
+
+	ASSERT_ANY_THROW(Queue.Replace(6, "Out"));
+
+	TPersistentQueue<std::string> Copy = Queue;
+	Copy.Replace(1, "Front");
+	Copy.Replace(5, "Back");
+
+	ASSERT_EQ(6, Copy.size());
+	EXPECT_EQ("0", Copy.Check(0));
+	EXPECT_EQ("Front", Copy.Check(1));
+	EXPECT_EQ("4", Copy.Check(4));
+	EXPECT_EQ("Back", Copy.Check(5));
+
+	for (int i = 0; i < 6; i++)
+		EXPECT_EQ(std::to_string(i), Queue.Check(i));
+}
+
+TEST(TPersistentQueue, for_each_visits_elements_in_queue_order)
+{
+	TPersistentQueue<int> Queue;
+
+	// Both the front and the reversed back list hold elements
+	for (int i = 0; i < 11; i++)
+		Queue.Put(i);
+	Queue.Pop(0);
+	Queue.Pop(4);
+
+	TPersistentQueue<int> Copy = Queue;
+	Copy.Put(11);
+
+	std::vector<int> Expected, Visited;
+	for (size_t i = 0; i < Copy.size(); i++)
+		Expected.push_back(Copy.Check(i));
+
+	Copy.ForEach([&](int Element) { Visited.push_back(Element); });
+
+	EXPECT_EQ(std::vector<int>({ 1, 2, 3, 4, 6, 7, 8, 9, 10, 11 }), Expected);
+	EXPECT_EQ(Expected, Visited);
+}
+
+TEST(TPersistentQueue, matches_deque_across_copies)
+{
+	std::mt19937 Random(7);
+
+	std::vector<TPersistentQueue<int>> Queues(1);
+	std::vector<std::deque<int>> Expected(1);
+
+	for (int Step = 0; Step < 20000; Step++)
+	{
+		size_t Index = Random() % Queues.size();
+		int Action = Random() % 10;
+
+		if (Action == 0 && Queues.size() < 16)
+		{
+			Queues.push_back(Queues[Index]);
+			Expected.push_back(Expected[Index]);
+		}
+		else if (Action < 5 || Expected[Index].empty())
+		{
+			Queues[Index].Put(Step);
+			Expected[Index].push_back(Step);
+		}
+		else
+		{
+			size_t Pos = Random() % std::min<size_t>(Expected[Index].size(), 6);
+			if (Random() % 8 == 0)
+				Pos = Random() % Expected[Index].size();
+
+			Queues[Index].Pop(Pos);
+			Expected[Index].erase(Expected[Index].begin() + Pos);
+		}
+	}
+
+	for (size_t i = 0; i < Queues.size(); i++)
+	{
+		ASSERT_EQ(Expected[i].size(), Queues[i].size());
+		for (size_t j = 0; j < Expected[i].size(); j++)
+			EXPECT_EQ(Expected[i][j], Queues[i].Check(j));
+	}
+}
+
+TEST(TPersistentQueue, can_release_long_queue)
+{
+	TPersistentQueue<int> Queue;
+
+	for (int i = 0; i < 1000000; i++)
+		Queue.Put(i);
+
+	TPersistentQueue<int> Copy = Queue;
+	Copy.Pop(1);
+
+	ASSERT_NO_THROW(Queue = TPersistentQueue<int>());
+	EXPECT_EQ(999999, Copy.size());
+}
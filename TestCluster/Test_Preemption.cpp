@@ -0,0 +1,241 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Cluster.h"
+#include "Journal.h"
+#include "WeightTuner.h"
+#include <gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+TProgramCall PriorityCall(std::string InName, size_t InRequiredProcessors, size_t InExecutionTime, int32_t InPriority)
+{
+	TProgramCall Call(InName, InRequiredProcessors, InExecutionTime);
+	Call.Priority = InPriority;
+
+	return Call;
+}
+
+// Batch takes the whole cluster at tick 0, Urgent is called at tick 5
+void CallUrgentAtTickFive(CCluster* InCluster)
+{
+	if (InCluster->GetCurrentTime() == 5)
+		InCluster->CallProgramExecution(PriorityCall("Urgent", 1, 3, 1));
+}
+
+TEST(TCluster, high_priority_call_preempts_running_program)
+{
+	CCluster Cluster(30, 2);
+	Cluster.EnablePreemption(2);
+	Cluster.CallProgramExecution(PriorityCall("Batch", 2, 20, 0));
+
+	std::vector<std::pair<std::string, size_t>> Starts;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+	{
+		Starts.push_back({ InCall.Name, InCluster->GetCurrentTime() });
+
+		// Queued again with its job ID, the 14 ticks it has left and the checkpoint cost
+		if (InCall.Name == "Batch" && Starts.size() > 1)
+		{
+			EXPECT_EQ(0, InCall.JobID);
+			EXPECT_EQ(16, InCall.ExecutionTime);
+			EXPECT_EQ(16, InCluster->GetRunningPrograms().at("Batch").ActualExecutionTime);
+		}
+	});
+
+	Cluster.Start(CallUrgentAtTickFive);
+
+	std::vector<std::pair<std::string, size_t>> Expected = { { "Batch", 0 }, { "Urgent", 6 }, { "Batch", 10 } };
+	EXPECT_EQ(Expected, Starts);
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(2, Cluster.GetFinishedProgramCount());
+}
+
+TEST(TCluster, preempted_program_keeps_its_work_on_slow_processors)
+{
+	CCluster Cluster(24, 2);
+	Cluster.EnablePreemption(0);
+	Cluster.SetProcessorSpeed(0, 0.5f);
+	Cluster.SetProcessorSpeed(1, 0.5f);
+
+	// 10 ticks of work take 20 ticks at half speed
+	Cluster.CallProgramExecution(TProgramCall("Batch", 2, 40, 10));
+
+	std::vector<std::pair<std::string, size_t>> Starts;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+	{
+		Starts.push_back({ InCall.Name, InCluster->GetCurrentTime() });
+
+		// 6 of its 20 ticks are done, what is left is 7 ticks of work, not 14
+		if (InCall.Name == "Batch" && Starts.size() > 1)
+		{
+			EXPECT_EQ(7, InCall.ActualExecutionTime);
+			EXPECT_EQ(14, InCluster->GetRunningPrograms().at("Batch").ActualExecutionTime);
+		}
+	});
+
+	Cluster.Start(CallUrgentAtTickFive);
+
+	ASSERT_EQ(3, Starts.size());
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(10, Starts[2].second);
+
+	// Restarted at tick 10, it finishes at 24 instead of 38
+	EXPECT_EQ(2, Cluster.GetFinishedProgramCount());
+}
+
+TEST(TCluster, equal_priority_call_waits)
+{
+	CCluster Cluster(22, 2);
+	Cluster.EnablePreemption(2);
+	Cluster.CallProgramExecution(PriorityCall("Batch", 2, 20, 1));
+	Cluster.Start(CallUrgentAtTickFive);
+
+	// Urgent starts after Batch finishes at tick 20
+	EXPECT_EQ(0, Cluster.GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(1, Cluster.GetFinishedProgramCount());
+	EXPECT_EQ(1, Cluster.GetRunningPrograms().count("Urgent"));
+}
+
+TEST(TCluster, no_preemption_unless_enabled)
+{
+	CCluster Cluster(10, 2);
+	Cluster.CallProgramExecution(PriorityCall("Batch", 2, 20, 0));
+	Cluster.Start(CallUrgentAtTickFive);
+
+	EXPECT_EQ(0, Cluster.GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(1, Cluster.GetRunningPrograms().count("Batch"));
+}
+
+TEST(TCluster, preempts_lowest_priority_first)
+{
+	CCluster Cluster(5, 4, 5, 3);
+	Cluster.EnablePreemption(0);
+	Cluster.CallProgramExecution(PriorityCall("Middle", 2, 20, 1));
+	Cluster.CallProgramExecution(PriorityCall("Lowest", 1, 20, 0));
+	Cluster.CallProgramExecution(PriorityCall("Low", 1, 20, 1));
+
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 2)
+			InCluster->CallProgramExecution(PriorityCall("Urgent", 2, 3, 2));
+	});
+
+	// Lowest alone is not enough, the wider of the two of priority 1 goes next, Lowest starts again on the processor left over
+	std::map<std::string, TProgram> Running = Cluster.GetRunningPrograms();
+	EXPECT_EQ(2, Cluster.GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(1, Running.count("Low"));
+	EXPECT_EQ(1, Running.count("Lowest"));
+	EXPECT_EQ(0, Running.count("Middle"));
+}
+
+TEST(TCluster, does_not_preempt_when_not_enough_would_be_freed)
+{
+	CCluster Cluster(10, 4, 5, 2);
+	Cluster.EnablePreemption(1);
+	Cluster.CallProgramExecution(PriorityCall("Low", 1, 20, 0));
+	Cluster.CallProgramExecution(PriorityCall("High", 3, 20, 5));
+
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 2)
+			InCluster->CallProgramExecution(PriorityCall("Wide", 4, 3, 3));
+	});
+
+	EXPECT_EQ(0, Cluster.GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(2, Cluster.GetRunningProgramCount());
+}
+
+TEST(TCluster, preempted_program_is_restored_from_journal)
+{
+	std::string Path = "cluster_test_preemption_journal.bin";
+	std::remove(Path.c_str());
+
+	{
+		CCluster Cluster(7, 2);
+		Cluster.EnablePreemption(2);
+		Cluster.EnableJournal(Path);
+		Cluster.CallProgramExecution(PriorityCall("Batch", 2, 20, 0));
+		Cluster.Start(CallUrgentAtTickFive);
+	}
+
+	CCluster Restored(30, 2);
+	Restored.EnablePreemption(2);
+	Restored.EnableJournal(Path);
+
+	ASSERT_EQ(1, Restored.GetWaitingProgramCalls().size());
+	EXPECT_EQ("Batch", Restored.GetWaitingProgramCalls().Check(0).Name);
+	EXPECT_EQ(16, Restored.GetWaitingProgramCalls().Check(0).ActualExecutionTime);
+	EXPECT_EQ(1, Restored.GetRunningPrograms().at("Urgent").Priority);
+	EXPECT_EQ(1, Restored.GetReportData().TotalProgramsPreempted);
+
+	Restored.Start([](CCluster* InCluster) {});
+	EXPECT_EQ(2, Restored.GetFinishedProgramCount());
+
+	std::remove(Path.c_str());
+}
+
+TEST(TCluster, fork_keeps_preemption)
+{
+	CCluster Cluster(4, 2);
+	Cluster.EnablePreemption(2);
+	Cluster.CallProgramExecution(PriorityCall("Batch", 2, 20, 0));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::unique_ptr<CCluster> Forked = Cluster.Fork(10);
+	Forked->CallProgramExecution(PriorityCall("Urgent", 1, 3, 1));
+	Forked->Start([](CCluster* InCluster) {});
+
+	EXPECT_EQ(1, Forked->GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(0, Cluster.GetReportData().TotalProgramsPreempted);
+	EXPECT_EQ(1, Cluster.GetRunningPrograms().count("Batch"));
+}
+
+TEST(TCluster, DISABLED_benchmark_preemption)
+{
+	const size_t ProcessorCount = 64;
+
+	// Heavy batch load, with every tenth job latency sensitive
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 5000;
+	Parameters.MaxNewProgramsPerTick = 1;
+	Parameters.SpawnThreshold = 0.8f;
+	Parameters.RequiredProcessorsMultiplier = 2;
+	std::vector<TWorkloadJob> Jobs = GenerateWorkload(Parameters, ProcessorCount, 1);
+
+	for (size_t i = 0; i < Jobs.size(); i++)
+		Jobs[i].Priority = i % 10 == 0 ? 1 : 0;
+
+	for (bool Preemption : { false, true })
+	{
+		CCluster Cluster(Parameters.Duration, ProcessorCount, 5, 5);
+		if (Preemption)
+			Cluster.EnablePreemption(2);
+
+		double Response[2] = { 0, 0 };
+		size_t Started[2] = { 0, 0 };
+		std::map<size_t, size_t> FirstStarts;
+		Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+		{
+			if (!FirstStarts.insert({ InCall.JobID, InCluster->GetCurrentTime() }).second)
+				return;
+
+			Response[InCall.Priority] += double(InCluster->GetCurrentTime() - InCall.TimeCalled);
+			Started[InCall.Priority]++;
+		});
+
+		CWorkloadSource Source(Jobs);
+		Cluster.AddSubmissionSource(&Source);
+
+		auto Begin = std::chrono::steady_clock::now();
+		Cluster.Start([](CCluster* InCluster) {});
+		std::chrono::duration<double, std::milli> Elapsed = std::chrono::steady_clock::now() - Begin;
+
+		Cluster.RemoveSubmissionSource(&Source);
+
+		TClusterReportData& Report = Cluster.GetReportData();
+		std::cout << (Preemption ? "Preemption: " : "No preemption: ") << "mean wait " << Response[1] / Started[1] << " ticks for priority 1, "
+			<< Response[0] / Started[0] << " for priority 0, " << Report.TotalProgramsPreempted << " preempted, "
+			<< Report.TotalProgramsFinished << " finished, " << Elapsed.count() << " ms" << std::endl;
+	}
+}
@@ -0,0 +1,84 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "ProcessLauncher.h"
+#include <gtest.h>
+#include <chrono>
+
+#ifdef __linux__
+
+// Collects finished processes until Count of them are found or a second passes
+std::vector<std::pair<std::string, bool>> WaitForProcesses(CProcessLauncher& Launcher, size_t Count)
+{
+	std::vector<std::pair<std::string, bool>> Finished;
+	std::chrono::steady_clock::time_point Deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+	while (Finished.size() < Count && std::chrono::steady_clock::now() < Deadline)
+		Launcher.CollectFinished(Finished, 10);
+
+	return Finished;
+}
+
+TEST(CProcessLauncher, can_create_launcher)
+{
+	ASSERT_NO_THROW(CProcessLauncher Launcher);
+}
+
+TEST(CProcessLauncher, throws_when_launching_empty_command)
+{
+	CProcessLauncher Launcher;
+
+	ASSERT_ANY_THROW(Launcher.Launch("Program", {}, { 0 }));
+}
+
+TEST(CProcessLauncher, collects_successful_process)
+{
+	CProcessLauncher Launcher;
+	Launcher.Launch("Program", { "true" }, { 0 });
+
+	auto Finished = WaitForProcesses(Launcher, 1);
+
+	ASSERT_EQ(1, Finished.size());
+	EXPECT_EQ("Program", Finished[0].first);
+	EXPECT_TRUE(Finished[0].second);
+	EXPECT_EQ(0, Launcher.GetRunningCount());
+}
+
+TEST(CProcessLauncher, reports_failed_and_missing_programs)
+{
+	CProcessLauncher Launcher;
+	Launcher.Launch("Failing", { "false" }, { 0 });
+	Launcher.Launch("Missing", { "/nonexistent/program" }, { 0 });
+
+	auto Finished = WaitForProcesses(Launcher, 2);
+
+	ASSERT_EQ(2, Finished.size());
+	EXPECT_FALSE(Finished[0].second);
+	EXPECT_FALSE(Finished[1].second);
+}
+
+TEST(CProcessLauncher, pins_process_to_assigned_processors)
+{
+	CProcessLauncher Launcher;
+
+	// nproc reports the number of CPUs the process is allowed to run on
+	Launcher.Launch("Program", { "sh", "-c", "test \"$(nproc)\" -eq 1" }, { 3 });
+
+	auto Finished = WaitForProcesses(Launcher, 1);
+
+	ASSERT_EQ(1, Finished.size());
+	EXPECT_TRUE(Finished[0].second);
+}
+
+TEST(CProcessLauncher, does_not_block_without_timeout)
+{
+	CProcessLauncher Launcher;
+	Launcher.Launch("Program", { "sleep", "1" }, { 0 });
+
+	std::vector<std::pair<std::string, bool>> Finished;
+	Launcher.CollectFinished(Finished);
+
+	EXPECT_EQ(0, Finished.size());
+	EXPECT_EQ(1, Launcher.GetRunningCount());
+}
+
+#endif
@@ -0,0 +1,158 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Cluster.h"
+#include "WeightTuner.h"
+#include <gtest.h>
+#include <iostream>
+
+// Processors 0 and 1 of the reference speed, 2 half as fast, 3 twice as fast
+void SetMixedSpeeds(CCluster& Cluster)
+{
+	Cluster.SetProcessorSpeed(2, 0.5f);
+	Cluster.SetProcessorSpeed(3, 2.f);
+}
+
+TEST(TCluster, throws_on_non_positive_processor_speed)
+{
+	CCluster Cluster(10, 4);
+
+	ASSERT_ANY_THROW(Cluster.SetProcessorSpeed(0, 0.f));
+	ASSERT_ANY_THROW(Cluster.SetProcessorSpeed(0, -1.f));
+	ASSERT_ANY_THROW(Cluster.SetProcessorSpeed(4, 1.f));
+	ASSERT_NO_THROW(Cluster.SetProcessorSpeed(0, 1.5f));
+}
+
+TEST(TCluster, slowest_processor_sets_run_time)
+{
+	CCluster Cluster(1, 4, 5, 2);
+	SetMixedSpeeds(Cluster);
+
+	Cluster.CallProgramExecution(TProgramCall("First", 2, 100, 10));
+	Cluster.CallProgramExecution(TProgramCall("Second", 2, 100, 10));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	// The first program gets the fastest processors, 3 and 0, the second one runs at the speed of processor 2
+	std::map<std::string, TProgram> Running = Cluster.GetRunningPrograms();
+	EXPECT_EQ(std::set<unsigned>({ 0, 3 }), Running.at("First").OccupiedProcessors);
+	EXPECT_EQ(10, Running.at("First").ActualExecutionTime);
+	EXPECT_EQ(20, Running.at("Second").ActualExecutionTime);
+}
+
+TEST(TCluster, fast_processor_shortens_run_time)
+{
+	CCluster Cluster(10, 4);
+	SetMixedSpeeds(Cluster);
+
+	Cluster.CallProgramExecution(TProgramCall("Fast", 1, 3));
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 0)
+		{
+			EXPECT_EQ(2, InCluster->GetRunningPrograms().at("Fast").ActualExecutionTime);
+		}
+	});
+
+	EXPECT_EQ(1, Cluster.GetFinishedProgramCount());
+	EXPECT_EQ(1, Cluster.GetReportData().PerProcessorTotalPrograms[3]);
+}
+
+TEST(TCluster, short_programs_take_slow_processors)
+{
+	CCluster Cluster(1, 4, 5, 2);
+	SetMixedSpeeds(Cluster);
+	Cluster.SetLongProgramTime(10);
+
+	Cluster.CallProgramExecution(TProgramCall("Short", 1, 5, 2));
+	Cluster.CallProgramExecution(TProgramCall("Long", 1, 50));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::map<std::string, TProgram> Running = Cluster.GetRunningPrograms();
+	EXPECT_EQ(std::set<unsigned>({ 2 }), Running.at("Short").OccupiedProcessors);
+	EXPECT_EQ(4, Running.at("Short").ActualExecutionTime);
+	EXPECT_EQ(std::set<unsigned>({ 3 }), Running.at("Long").OccupiedProcessors);
+	EXPECT_EQ(25, Running.at("Long").ActualExecutionTime);
+}
+
+TEST(TCluster, run_time_on_slow_processors_is_limited_by_execution_time)
+{
+	CCluster Cluster(1, 4);
+	Cluster.SetProcessorSpeed(0, 0.25f);
+	Cluster.SetLongProgramTime(SIZE_MAX);
+
+	Cluster.CallProgramExecution(TProgramCall("Limited", 1, 10, 5));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	EXPECT_EQ(10, Cluster.GetRunningPrograms().at("Limited").ActualExecutionTime);
+}
+
+TEST(TCluster, reports_load_per_speed_class)
+{
+	CCluster Cluster(10, 4);
+	Cluster.SetProcessorSpeed(2, 2.f);
+	Cluster.SetProcessorSpeed(3, 2.f);
+
+	// Runs 11 ticks on the fast processors, as long as the cluster
+	Cluster.CallProgramExecution(TProgramCall("Long", 2, 22));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	TClusterReportData& Report = Cluster.GetReportData();
+	ASSERT_EQ(2, Report.PerSpeedClassAverageLoad.size());
+	EXPECT_FLOAT_EQ(0.f, Report.PerSpeedClassAverageLoad[1.f]);
+	EXPECT_FLOAT_EQ(1.f, Report.PerSpeedClassAverageLoad[2.f]);
+}
+
+TEST(TCluster, fork_keeps_processor_speeds)
+{
+	CCluster Cluster(1, 4);
+	SetMixedSpeeds(Cluster);
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::unique_ptr<CCluster> Forked = Cluster.Fork(2);
+	Forked->CallProgramExecution(TProgramCall("Forked", 1, 10));
+	Forked->Start([](CCluster* InCluster) {});
+
+	EXPECT_EQ(0.5f, Forked->GetProcessorSpeed(2));
+	EXPECT_EQ(5, Forked->GetRunningPrograms().at("Forked").ActualExecutionTime);
+}
+
+TEST(TCluster, DISABLED_benchmark_speed_matching)
+{
+	const size_t ProcessorCount = 32;
+
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 2000;
+	Parameters.MaxNewProgramsPerTick = 1;
+	Parameters.SpawnThreshold = 0.8f;
+	std::vector<TWorkloadJob> Jobs = GenerateWorkload(Parameters, ProcessorCount, 1);
+
+	// Everything on the slowest processors, everything on the fastest ones, long programs on the fastest ones
+	const size_t LongProgramTimes[] = { SIZE_MAX, 0, 18 };
+
+	for (size_t LongProgramTime : LongProgramTimes)
+	{
+		CCluster Cluster(Parameters.Duration, ProcessorCount, 5, 5);
+		for (unsigned Processor = 0; Processor < ProcessorCount; Processor++)
+			Cluster.SetProcessorSpeed(Processor, Processor % 2 == 0 ? 1.f : 2.f);
+
+		Cluster.SetLongProgramTime(LongProgramTime);
+
+		// Ticks from the call to the end of the run, known at the start
+		double Response = 0;
+		size_t Started = 0;
+		Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+		{
+			Response += double(InCluster->GetCurrentTime() + InCluster->GetRunningPrograms().at(InCall.Name).ActualExecutionTime - InCall.TimeCalled);
+			Started++;
+		});
+
+		CWorkloadSource Source(Jobs);
+		Cluster.AddSubmissionSource(&Source);
+		Cluster.Start([](CCluster* InCluster) {});
+		Cluster.RemoveSubmissionSource(&Source);
+
+		TClusterReportData& Report = Cluster.GetReportData();
+		std::cout << "Long program time " << (LongProgramTime == SIZE_MAX ? std::string("none") : std::to_string(LongProgramTime)) << ": " << Started
+			<< " started, mean response " << Response / Started << " ticks, load at speed 1: " << Report.PerSpeedClassAverageLoad[1.f]
+			<< ", at speed 2: " << Report.PerSpeedClassAverageLoad[2.f] << std::endl;
+	}
+}
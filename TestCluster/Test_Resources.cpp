@@ -0,0 +1,212 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Cluster.h"
+#include "Resources.h"
+#include <gtest.h>
+#include <chrono>
+#include <iostream>
+
+TResources MakeResources(uint32_t Memory, uint32_t Accelerators = 0, uint32_t Licenses = 0)
+{
+	TResources Resources;
+	Resources[EResource::Memory] = Memory;
+	Resources[EResource::Accelerators] = Accelerators;
+	Resources[EResource::Licenses] = Licenses;
+	return Resources;
+}
+
+TProgramCall MakeResourceCall(const std::string& InName, size_t InProcessors, size_t InExecutionTime, const TResources& InResources)
+{
+	TProgramCall Call(InName, InProcessors, InExecutionTime);
+	Call.Resources = InResources;
+	return Call;
+}
+
+TEST(CNodeResources, counts_free_fitting_nodes)
+{
+	CNodeResources Nodes;
+	Nodes.Reset(4);
+
+	Nodes.SetCapacity(0, MakeResources(16, 0));
+	Nodes.SetCapacity(1, MakeResources(64, 1));
+	Nodes.SetCapacity(2, MakeResources(64, 0));
+	Nodes.SetCapacity(3, MakeResources(128, 2));
+
+	EXPECT_EQ(3, Nodes.CountFitting(MakeResources(32)));
+	EXPECT_EQ(2, Nodes.CountFitting(MakeResources(32, 1)));
+
+	Nodes.SetOccupied(3, true);
+	EXPECT_EQ(1, Nodes.CountFitting(MakeResources(32, 1)));
+	EXPECT_EQ(2, Nodes.CountFitting(MakeResources(32, 1), false));
+}
+
+TEST(CNodeResources, keeps_total_capacity)
+{
+	CNodeResources Nodes;
+	Nodes.Reset(2);
+	EXPECT_FALSE(Nodes.HasCapacities());
+
+	Nodes.SetCapacity(0, MakeResources(16, 1));
+	Nodes.SetCapacity(1, MakeResources(32));
+	Nodes.SetCapacity(0, MakeResources(8));
+
+	EXPECT_TRUE(Nodes.HasCapacities());
+	EXPECT_EQ(40, Nodes.GetTotalCapacity(EResource::Memory));
+	EXPECT_EQ(0, Nodes.GetTotalCapacity(EResource::Accelerators));
+}
+
+TEST(CNodeResources, chooses_nodes_with_least_spare_capacity)
+{
+	CNodeResources Nodes;
+	Nodes.Reset(4);
+
+	Nodes.SetCapacity(0, MakeResources(128));
+	Nodes.SetCapacity(1, MakeResources(32));
+	Nodes.SetCapacity(2, MakeResources(16));
+	Nodes.SetCapacity(3, MakeResources(32));
+
+	EXPECT_EQ(std::vector<unsigned>({ 1, 3 }), Nodes.ChooseNodes(MakeResources(20), 2));
+	EXPECT_EQ(std::vector<unsigned>({ 2, 1 }), Nodes.ChooseNodes(MakeResources(0), 2));
+	EXPECT_TRUE(Nodes.ChooseNodes(MakeResources(64), 2).empty());
+}
+
+TEST(TCluster, throws_when_calling_program_with_unavailable_resources)
+{
+	CCluster Cluster(10, 4);
+	Cluster.SetNodeResources(MakeResources(32));
+	Cluster.SetNodeResources(0, MakeResources(64, 1));
+	Cluster.SetLicenseCount(2);
+
+	ASSERT_NO_THROW(Cluster.CallProgramExecution(MakeResourceCall("Fits", 1, 5, MakeResources(64, 1, 2))));
+	ASSERT_ANY_THROW(Cluster.CallProgramExecution(MakeResourceCall("TooMuchMemory", 2, 5, MakeResources(64))));
+	ASSERT_ANY_THROW(Cluster.CallProgramExecution(MakeResourceCall("NoAccelerator", 1, 5, MakeResources(0, 2))));
+	ASSERT_ANY_THROW(Cluster.CallProgramExecution(MakeResourceCall("TooManyLicenses", 1, 5, MakeResources(0, 0, 3))));
+}
+
+TEST(TCluster, memory_bound_program_waits_for_fitting_node)
+{
+	CCluster Cluster(20, 4, 5, 4);
+	Cluster.SetNodeResources(MakeResources(16));
+	Cluster.SetNodeResources(3, MakeResources(64));
+
+	Cluster.CallProgramExecution(MakeResourceCall("Large_0", 1, 5, MakeResources(48)));
+	Cluster.CallProgramExecution(MakeResourceCall("Large_1", 1, 5, MakeResources(48)));
+
+	Cluster.Start([](CCluster* InCluster) {});
+
+	// Only one processor has enough memory, so the programs run one after the other although three processors stay free
+	EXPECT_EQ(2, Cluster.GetFinishedProgramCount());
+	EXPECT_EQ(2, Cluster.GetReportData().PerProcessorTotalPrograms[3]);
+	EXPECT_EQ(0, Cluster.GetReportData().PerProcessorTotalPrograms[0]);
+}
+
+TEST(TCluster, small_programs_leave_large_nodes_free)
+{
+	CCluster Cluster(10, 4, 5, 4);
+	Cluster.SetNodeResources(MakeResources(16));
+	Cluster.SetNodeResources(0, MakeResources(64));
+
+	Cluster.CallProgramExecution(MakeResourceCall("Small", 2, 8, MakeResources(8)));
+	Cluster.CallProgramExecution(MakeResourceCall("Large", 1, 8, MakeResources(48)));
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 0)
+		{
+			EXPECT_EQ(2, InCluster->GetRunningProgramCount());
+		}
+	});
+
+	EXPECT_EQ(1, Cluster.GetReportData().PerProcessorTotalPrograms[0]);
+	EXPECT_EQ(2, Cluster.GetFinishedProgramCount());
+}
+
+TEST(TCluster, licenses_limit_concurrent_programs)
+{
+	CCluster Cluster(4, 8, 5, 8);
+	Cluster.SetLicenseCount(3);
+
+	for (int i = 0; i < 4; i++)
+		Cluster.CallProgramExecution(MakeResourceCall("Licensed_" + std::to_string(i), 1, 10, MakeResources(0, 0, 1)));
+
+	Cluster.Start([](CCluster* InCluster) {});
+
+	EXPECT_EQ(3, Cluster.GetRunningProgramCount());
+	EXPECT_EQ(0, Cluster.GetFreeLicenseCount());
+	EXPECT_ANY_THROW(Cluster.SetLicenseCount(2));
+}
+
+TEST(TCluster, scores_calls_by_dominant_resource)
+{
+	CCluster Cluster(10, 8);
+	Cluster.SetNodeResources(MakeResources(16));
+	Cluster.SetLicenseCount(4);
+
+	Cluster.CallProgramExecution(MakeResourceCall("Plain", 2, 5, MakeResources(0)));
+	Cluster.CallProgramExecution(MakeResourceCall("MemoryBound", 2, 5, MakeResources(16)));
+	Cluster.CallProgramExecution(MakeResourceCall("LicenseBound", 1, 5, MakeResources(0, 0, 2)));
+
+	// 2 of 8 processors, 2 * 16 of 128 memory (2 of 8 nodes), half of the licenses (4 of 8 processors)
+	EXPECT_EQ(2, Cluster.GetWaitingProgramCalls().Check(0).DominantProcessors);
+	EXPECT_EQ(2, Cluster.GetWaitingProgramCalls().Check(1).DominantProcessors);
+	EXPECT_EQ(4, Cluster.GetWaitingProgramCalls().Check(2).DominantProcessors);
+}
+
+TEST(TCluster, fork_keeps_resources)
+{
+	CCluster Cluster(2, 4);
+	Cluster.SetNodeResources(MakeResources(32, 1));
+	Cluster.SetLicenseCount(2);
+	Cluster.CallProgramExecution(MakeResourceCall("Licensed", 2, 10, MakeResources(16, 1, 1)));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::unique_ptr<CCluster> Forked = Cluster.Fork(30);
+	EXPECT_EQ(1, Forked->GetFreeLicenseCount());
+	EXPECT_EQ(32, Forked->GetNodeResources(3)[EResource::Memory]);
+
+	Forked->Start([](CCluster* InCluster) {});
+	EXPECT_EQ(2, Forked->GetFreeLicenseCount());
+	EXPECT_EQ(1, Cluster.GetFreeLicenseCount());
+}
+
+TEST(CNodeResources, DISABLED_benchmark_fit_check)
+{
+	const size_t NodeCounts[] = { 64, 1024, 16384 };
+
+	for (size_t NodeCount : NodeCounts)
+	{
+		CCluster Cluster(0, NodeCount);
+		CNodeResources Nodes;
+		Nodes.Reset(NodeCount);
+
+		for (unsigned Node = 0; Node < NodeCount; Node++)
+		{
+			Nodes.SetCapacity(Node, MakeResources(16 << (Node % 4), Node % 3));
+			Nodes.SetOccupied(Node, Node % 5 == 0);
+			Cluster.SetNodeResources(Node, MakeResources(16 << (Node % 4), Node % 3));
+		}
+
+		const int Checks = 20000;
+		size_t Fitting = 0;
+
+		// The same check over the processor objects, one at a time
+		auto Begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < Checks; i++)
+		{
+			TResources Demand = MakeResources(16 << (i % 4), i % 3);
+			for (unsigned Node = 0; Node < NodeCount; Node++)
+			{
+				TResources Capacity = Cluster.GetNodeResources(Node);
+				if (Node % 5 != 0 && Capacity[EResource::Memory] >= Demand[EResource::Memory] && Capacity[EResource::Accelerators] >= Demand[EResource::Accelerators])
+					Fitting++;
+			}
+		}
+		auto Scalar = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < Checks; i++)
+			Fitting -= Nodes.CountFitting(MakeResources(16 << (i % 4), i % 3));
+		auto Vectorized = std::chrono::steady_clock::now();
+
+		std::cout << NodeCount << " nodes: per node lookups " << std::chrono::duration<double, std::nano>(Scalar - Begin).count() / Checks
+			<< " ns, arrays " << std::chrono::duration<double, std::nano>(Vectorized - Scalar).count() / Checks << " ns per check (difference " << Fitting << ")" << std::endl;
+	}
+}
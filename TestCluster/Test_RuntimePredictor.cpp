@@ -0,0 +1,173 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Cluster.h"
+#include "RuntimePredictor.h"
+#include <gtest.h>
+#include <chrono>
+#include <iostream>
+
+TEST(CRuntimePredictor, throws_on_invalid_settings)
+{
+	ASSERT_ANY_THROW(CRuntimePredictor(4));
+	ASSERT_ANY_THROW(CRuntimePredictor(64, 0));
+	ASSERT_ANY_THROW(CRuntimePredictor(64, 1.5f));
+}
+
+TEST(CRuntimePredictor, program_kind_ignores_trailing_numbers)
+{
+	EXPECT_EQ(CRuntimePredictor::GetProgramKey("Render_12"), CRuntimePredictor::GetProgramKey("Render_13"));
+	EXPECT_EQ(CRuntimePredictor::GetProgramKey("Program5_2"), CRuntimePredictor::GetProgramKey("Program"));
+	EXPECT_NE(CRuntimePredictor::GetProgramKey("Render_12"), CRuntimePredictor::GetProgramKey("Encode_12"));
+}
+
+TEST(CRuntimePredictor, predicts_request_without_history)
+{
+	CRuntimePredictor Predictor;
+
+	EXPECT_EQ(40, Predictor.Predict(CRuntimePredictor::GetProgramKey("Unknown"), 40));
+}
+
+TEST(CRuntimePredictor, learns_ratio_of_actual_to_requested_time)
+{
+	CRuntimePredictor Predictor(64, 0.5f);
+	uint64_t Key = CRuntimePredictor::GetProgramKey("Render");
+
+	Predictor.Observe(Key, 100, 25);
+	EXPECT_EQ(10, Predictor.Predict(Key, 40));
+
+	// Weighted with the older history
+	Predictor.Observe(Key, 100, 75);
+	EXPECT_EQ(50, Predictor.Predict(Key, 100));
+
+	// Predicted 100 and 25 right before the observations
+	EXPECT_EQ(2, Predictor.GetObservationCount());
+	EXPECT_DOUBLE_EQ((75.0 + 50.0) / 2, Predictor.GetMeanAbsoluteError());
+}
+
+TEST(CRuntimePredictor, prediction_stays_within_request)
+{
+	CRuntimePredictor Predictor(64);
+	uint64_t Key = CRuntimePredictor::GetProgramKey("Tiny");
+
+	Predictor.Observe(Key, 1000, 1);
+	EXPECT_EQ(1, Predictor.Predict(Key, 10));
+
+	// Programs are stopped at their limit, so they can not take longer than requested
+	Predictor.Observe(Key, 10, 50);
+	EXPECT_GE(10, Predictor.Predict(Key, 10));
+}
+
+TEST(CRuntimePredictor, full_table_replaces_least_observed_kind)
+{
+	CRuntimePredictor Predictor(8);
+
+	for (int i = 0; i < 8; i++)
+		for (int j = 0; j <= i; j++)
+			Predictor.Observe(100 + i, 10, 5);
+
+	// Every key probes the whole table, the one observed once is replaced
+	Predictor.Observe(1000, 10, 2);
+
+	EXPECT_EQ(2, Predictor.Predict(1000, 10));
+	EXPECT_EQ(10, Predictor.Predict(100, 10));
+	EXPECT_EQ(5, Predictor.Predict(107, 10));
+}
+
+TEST(TCluster, simulated_program_finishes_after_actual_time)
+{
+	CCluster Cluster(20, 4);
+
+	Cluster.CallProgramExecution(TProgramCall("Short", 4, 100, 3));
+	Cluster.CallProgramExecution(TProgramCall("Capped", 4, 5, 50));
+
+	Cluster.Start([](CCluster* InCluster) {});
+
+	// Running on ticks 0-3 and 4-9, the second one is stopped at its limit
+	EXPECT_EQ(2, Cluster.GetFinishedProgramCount());
+	EXPECT_EQ(10, Cluster.GetReportData().AllTicksProgramsRunning);
+}
+
+TEST(TCluster, cluster_learns_runtimes_of_finished_programs)
+{
+	CCluster Cluster(50, 4);
+	Cluster.EnableRuntimePrediction();
+
+	Cluster.CallProgramExecution(TProgramCall("Render_0", 4, 40, 10));
+	Cluster.Start([](CCluster* InCluster)
+	{
+		if (InCluster->GetCurrentTime() == 20)
+			InCluster->CallProgramExecution(TProgramCall("Render_1", 4, 80, 20));
+	});
+
+	ASSERT_NE(nullptr, Cluster.GetRuntimePredictor());
+	EXPECT_EQ(2, Cluster.GetRuntimePredictor()->GetObservationCount());
+	EXPECT_EQ(20, Cluster.GetRuntimePredictor()->Predict(CRuntimePredictor::GetProgramKey("Render_2"), 80));
+}
+
+TEST(TCluster, scores_calls_by_predicted_runtime)
+{
+	CCluster Cluster(30, 4, 5);
+	Cluster.EnableRuntimePrediction();
+
+	// Both kinds request the same time, but one of them always ends early
+	Cluster.CallProgramExecution(TProgramCall("Quick_0", 4, 20, 2));
+	Cluster.CallProgramExecution(TProgramCall("Slow_0", 4, 20, 20));
+	Cluster.Start([](CCluster*) {});
+
+	Cluster.CallProgramExecution(TProgramCall("Slow_1", 1, 20, 20));
+	Cluster.CallProgramExecution(TProgramCall("Quick_1", 1, 20, 2));
+
+	EXPECT_EQ(20, Cluster.GetWaitingProgramCalls().Check(0).PredictedExecutionTime);
+	EXPECT_EQ(2, Cluster.GetWaitingProgramCalls().Check(1).PredictedExecutionTime);
+	EXPECT_GT(Cluster.EvaluateWaitingCallScore(1), Cluster.EvaluateWaitingCallScore(0));
+}
+
+TEST(TCluster, fork_learns_independently)
+{
+	CCluster Cluster(10, 4);
+	Cluster.EnableRuntimePrediction();
+	Cluster.CallProgramExecution(TProgramCall("Job_0", 4, 10, 5));
+	Cluster.Start([](CCluster*) {});
+
+	std::unique_ptr<CCluster> Forked = Cluster.Fork(20);
+	Forked->CallProgramExecution(TProgramCall("Job_1", 4, 10, 1));
+	Forked->Start([](CCluster*) {});
+
+	EXPECT_EQ(1, Cluster.GetRuntimePredictor()->GetObservationCount());
+	EXPECT_EQ(2, Forked->GetRuntimePredictor()->GetObservationCount());
+	EXPECT_EQ(5, Cluster.GetRuntimePredictor()->Predict(CRuntimePredictor::GetProgramKey("Job"), 10));
+}
+
+TEST(CRuntimePredictor, DISABLED_benchmark_prediction)
+{
+	// Kinds with very different accuracy of the requested time
+	const size_t Kinds = 16;
+	const size_t Ticks = 5000;
+
+	for (int Predict = 0; Predict < 2; Predict++)
+	{
+		CCluster Cluster(Ticks, 32, 16, 5);
+		if (Predict)
+			Cluster.EnableRuntimePrediction();
+
+		auto Begin = std::chrono::steady_clock::now();
+		Cluster.Start([](CCluster* InCluster)
+		{
+			size_t Time = InCluster->GetCurrentTime();
+			for (size_t i = 0; i < 2; i++)
+			{
+				size_t Kind = (Time * 7 + i * 3) % Kinds;
+				size_t Requested = 10 + Time % 20;
+				InCluster->CallProgramExecution(TProgramCall("Kind" + std::to_string(Kind) + "_" + std::to_string(Time * 2 + i),
+					1 + Kind % 8, Requested, 1 + Requested * (Kind + 1) / (Kinds * 2)));
+			}
+		});
+		auto End = std::chrono::steady_clock::now();
+
+		std::cout << (Predict ? "predicted" : "requested") << " runtimes: finished " << Cluster.GetFinishedProgramCount()
+			<< ", waiting " << Cluster.GetWaitingProgramCalls().size() << ", " << std::chrono::duration<double, std::milli>(End - Begin).count() << " ms";
+		if (Predict)
+			std::cout << ", mean absolute error " << Cluster.GetRuntimePredictor()->GetMeanAbsoluteError() << " ticks";
+		std::cout << std::endl;
+	}
+}
@@ -0,0 +1,421 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Cluster.h"
+#include "Snapshot.h"
+#include <gtest.h>
+#include <cstdio>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+
+std::string TestSnapshotPath()
+{
+	return "cluster_test_snapshot.bin";
+}
+
+// Deterministic workload depending only on the time, so that a resumed run sees the same calls
+void SnapshotUpdate(CCluster* InCluster)
+{
+	size_t Time = InCluster->GetCurrentTime();
+
+	if (Time % 3 != 2)
+		InCluster->CallProgramExecution(TProgramCall("Program" + std::to_string(Time), 1 + Time % 7, 1 + Time % 5));
+}
+
+void EmptySnapshotUpdate(CCluster* InCluster) {}
+
+std::string ReportToString(CCluster& InCluster)
+{
+	std::stringstream Stream;
+	Stream << InCluster.GetReportData();
+	return Stream.str();
+}
+
+// Two program kinds that finish well before their requested time, for the runtime predictor to learn
+void PredictedSnapshotUpdate(CCluster* InCluster)
+{
+	size_t Time = InCluster->GetCurrentTime();
+
+	if (Time % 3 != 2)
+		InCluster->CallProgramExecution(TProgramCall((Time % 2 ? "Render" : "Encode") + std::to_string(Time), 1 + Time % 7, 4 + Time % 5, 1 + Time % (2 + Time % 2)));
+}
+
+void ExpectResumedRunReportsTheSame(bool InPrediction)
+{
+	void (*Update)(CCluster*) = InPrediction ? PredictedSnapshotUpdate : SnapshotUpdate;
+
+	CCluster Uninterrupted(200, 12, 4, 2);
+	if (InPrediction)
+		Uninterrupted.EnableRuntimePrediction(64, 0.5f);
+	Uninterrupted.Start(Update);
+
+	{
+		CCluster FirstHalf(97, 12, 4, 2);
+		if (InPrediction)
+			FirstHalf.EnableRuntimePrediction(64, 0.5f);
+		FirstHalf.Start(Update);
+		FirstHalf.SaveSnapshot(TestSnapshotPath());
+	}
+
+	CCluster Resumed(200, 1);
+	Resumed.LoadSnapshot(TestSnapshotPath());
+
+	EXPECT_EQ(98, Resumed.GetCurrentTime());
+	Resumed.Start(Update);
+
+	EXPECT_EQ(ReportToString(Uninterrupted), ReportToString(Resumed));
+
+	ASSERT_EQ(InPrediction, Resumed.GetRuntimePredictor() != nullptr);
+	if (InPrediction)
+	{
+		EXPECT_EQ(Uninterrupted.GetRuntimePredictor()->GetObservationCount(), Resumed.GetRuntimePredictor()->GetObservationCount());
+		EXPECT_EQ(Uninterrupted.GetRuntimePredictor()->GetMeanAbsoluteError(), Resumed.GetRuntimePredictor()->GetMeanAbsoluteError());
+		EXPECT_EQ(0.5f, Resumed.GetRuntimePredictor()->GetSmoothing());
+	}
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, resumed_run_reports_the_same_as_uninterrupted)
+{
+	ExpectResumedRunReportsTheSame(false);
+}
+
+TEST(TCluster, resumed_run_with_prediction_reports_the_same_as_uninterrupted)
+{
+	ExpectResumedRunReportsTheSame(true);
+}
+
+TEST(TCluster, snapshot_restores_programs_and_queue)
+{
+	CCluster Cluster(40, 8, 3);
+	Cluster.Start(SnapshotUpdate);
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(40, 2);
+	Restored.LoadSnapshot(TestSnapshotPath());
+
+	ASSERT_EQ(Cluster.GetWaitingProgramCalls().size(), Restored.GetWaitingProgramCalls().size());
+	for (size_t i = 0; i < Cluster.GetWaitingProgramCalls().size(); i++)
+	{
+		EXPECT_EQ(Cluster.GetWaitingProgramCalls().Check(i).Name, Restored.GetWaitingProgramCalls().Check(i).Name);
+		EXPECT_EQ(Cluster.GetWaitingProgramCalls().Check(i).JobID, Restored.GetWaitingProgramCalls().Check(i).JobID);
+		EXPECT_EQ(Cluster.GetWaitingProgramCalls().Check(i).TimeCalled, Restored.GetWaitingProgramCalls().Check(i).TimeCalled);
+	}
+
+	ASSERT_EQ(Cluster.GetProcessorData().size(), Restored.GetProcessorData().size());
+	for (size_t i = 0; i < Cluster.GetProcessorData().size(); i++)
+		EXPECT_EQ(Cluster.GetProcessorData()[i].GetAssignedProgram(), Restored.GetProcessorData()[i].GetAssignedProgram());
+
+	EXPECT_EQ(Cluster.GetRunningProgramCount(), Restored.GetRunningProgramCount());
+	EXPECT_EQ(Cluster.GetFinishedProgramCount(), Restored.GetFinishedProgramCount());
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_actual_and_predicted_times)
+{
+	CCluster Cluster(10, 4);
+	Cluster.EnableRuntimePrediction();
+
+	Cluster.CallProgramExecution(TProgramCall("Running", 4, 20, 12));
+	Cluster.Start(EmptySnapshotUpdate);
+	Cluster.CallProgramExecution(TProgramCall("Waiting", 2, 30, 5));
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(40, 1);
+	Restored.LoadSnapshot(TestSnapshotPath());
+
+	ASSERT_EQ(1, Restored.GetWaitingProgramCalls().size());
+	EXPECT_EQ(5, Restored.GetWaitingProgramCalls().Check(0).ActualExecutionTime);
+	EXPECT_EQ(30, Restored.GetWaitingProgramCalls().Check(0).PredictedExecutionTime);
+	EXPECT_EQ(12, Restored.GetRunningPrograms().at("Running").ActualExecutionTime);
+
+	// The running program finishes after its actual time, the waiting one right after it
+	Restored.Start(EmptySnapshotUpdate);
+	EXPECT_EQ(2, Restored.GetFinishedProgramCount());
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_resources)
+{
+	CCluster Cluster(3, 4);
+	Cluster.SetNodeResources(2, TResources());
+	Cluster.SetLicenseCount(3);
+
+	TProgramCall Running("Running", 2, 10);
+	Running.Resources[EResource::Licenses] = 2;
+	Cluster.CallProgramExecution(Running);
+	Cluster.Start(EmptySnapshotUpdate);
+
+	TProgramCall Waiting("Waiting", 1, 10);
+	Waiting.Resources[EResource::Licenses] = 2;
+	Cluster.CallProgramExecution(Waiting);
+
+	TResources Capacity;
+	Capacity[EResource::Memory] = 48;
+	Cluster.SetNodeResources(3, Capacity);
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(40, 1);
+	Restored.LoadSnapshot(TestSnapshotPath());
+
+	EXPECT_EQ(1, Restored.GetFreeLicenseCount());
+	EXPECT_EQ(48, Restored.GetNodeResources(3)[EResource::Memory]);
+	EXPECT_EQ(2, Restored.GetWaitingProgramCalls().Check(0).Resources[EResource::Licenses]);
+	// Two of three licenses are two thirds of the four processors, rounded up
+	EXPECT_EQ(3, Restored.GetWaitingProgramCalls().Check(0).DominantProcessors);
+
+	// The waiting program gets the licenses once the running one finishes
+	Restored.Start(EmptySnapshotUpdate);
+	EXPECT_EQ(2, Restored.GetFinishedProgramCount());
+	EXPECT_EQ(3, Restored.GetFreeLicenseCount());
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_topology)
+{
+	CCluster Cluster(1, 8);
+
+	TTopologyShape Shape;
+	Shape.ProcessorsPerSocket = 2;
+	Shape.SocketsPerNode = 2;
+	Shape.CommunicationPenalty[size_t(ETopologyLevel::Node)] = 1;
+	Cluster.SetTopology(Shape);
+
+	Cluster.CallProgramExecution(TProgramCall("First", 3, 10, 4));
+	Cluster.Start(EmptySnapshotUpdate);
+	Cluster.CallProgramExecution(TProgramCall("Second", 2, 10));
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(2, 1);
+	Restored.LoadSnapshot(TestSnapshotPath());
+	Restored.Start(EmptySnapshotUpdate);
+
+	EXPECT_EQ(1, Restored.GetTopology().GetShape().CommunicationPenalty[size_t(ETopologyLevel::Node)]);
+	EXPECT_EQ(8, Restored.GetRunningPrograms().at("First").ActualExecutionTime);
+	EXPECT_EQ(std::set<unsigned>({ 4, 5 }), Restored.GetRunningPrograms().at("Second").OccupiedProcessors);
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_buddy_allocation)
+{
+	CCluster Cluster(1, 8);
+	Cluster.EnableBuddyAllocation();
+	Cluster.CallProgramExecution(TProgramCall("Running", 3, 10));
+	Cluster.Start(EmptySnapshotUpdate);
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(2, 1);
+	Restored.LoadSnapshot(TestSnapshotPath());
+
+	EXPECT_TRUE(Restored.GetBuddyAllocator().IsSet());
+	EXPECT_EQ(5, Restored.GetBuddyAllocator().GetFreeCount());
+	EXPECT_EQ(4, Restored.GetBuddyAllocator().GetLargestFreeBlock());
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_processor_speeds)
+{
+	CCluster Cluster(1, 4);
+	Cluster.SetProcessorSpeed(1, 0.5f);
+	Cluster.SetLongProgramTime(20);
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(2, 1);
+	Restored.LoadSnapshot(TestSnapshotPath());
+	Restored.CallProgramExecution(TProgramCall("Short", 1, 10, 4));
+	Restored.Start(EmptySnapshotUpdate);
+
+	EXPECT_EQ(0.5f, Restored.GetProcessorSpeed(1));
+	EXPECT_EQ(8, Restored.GetRunningPrograms().at("Short").ActualExecutionTime);
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_preemption_and_priorities)
+{
+	CCluster Cluster(1, 2);
+	Cluster.EnablePreemption(3);
+
+	TProgramCall Queued("Queued", 2, 50);
+	Queued.Priority = -1;
+	Cluster.CallProgramExecution(TProgramCall("Low", 2, 20));
+	Cluster.CallProgramExecution(Queued);
+	Cluster.Start(EmptySnapshotUpdate);
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(2, 1);
+	Restored.LoadSnapshot(TestSnapshotPath());
+	EXPECT_EQ(3, Restored.GetCheckpointCost());
+	EXPECT_EQ(-1, Restored.GetWaitingProgramCalls().Check(0).Priority);
+
+	TProgramCall Urgent("Urgent", 1, 5);
+	Urgent.Priority = 1;
+	Restored.CallProgramExecution(Urgent);
+	Restored.Start(EmptySnapshotUpdate);
+
+	// Low ran for ticks 0 and 1, it is queued again behind Queued
+	EXPECT_EQ(1, Restored.GetReportData().TotalProgramsPreempted);
+	ASSERT_EQ(2, Restored.GetWaitingProgramCalls().size());
+	EXPECT_EQ(21, Restored.GetWaitingProgramCalls().Check(1).ActualExecutionTime);
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_deadlines)
+{
+	CCluster Cluster(1, 2);
+	Cluster.EnableDeadlineScheduling();
+
+	TProgramCall Running("Running", 2, 10);
+	Running.Deadline = 12;
+	TProgramCall Queued("Queued", 2, 5);
+	Queued.Deadline = 40;
+	Cluster.CallProgramExecution(Running);
+	Cluster.CallProgramExecution(Queued);
+	Cluster.Start(EmptySnapshotUpdate);
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(30, 1);
+	Restored.LoadSnapshot(TestSnapshotPath());
+	EXPECT_EQ(true, Restored.IsDeadlineScheduling());
+	EXPECT_EQ(12, Restored.GetRunningPrograms().at("Running").Deadline);
+	EXPECT_EQ(40, Restored.GetWaitingProgramCalls().Check(0).Deadline);
+
+	// Running ends at tick 10, the restored end time index rejects a call that could only start after it
+	TProgramCall Tight("Tight", 2, 5);
+	Tight.Deadline = 15;
+	EXPECT_EQ(SIZE_MAX, Restored.CallProgramExecution(Tight));
+
+	Restored.Start(EmptySnapshotUpdate);
+	EXPECT_EQ(2, Restored.GetReportData().DeadlinesMet);
+	EXPECT_EQ(1, Restored.GetReportData().DeadlineCallsRejected);
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, resumed_gang_scheduled_run_reports_the_same)
+{
+	CCluster Uninterrupted(200, 12, 4, 2);
+	Uninterrupted.EnableGangScheduling(3, 4, 1);
+	Uninterrupted.Start(SnapshotUpdate);
+
+	{
+		CCluster FirstHalf(97, 12, 4, 2);
+		FirstHalf.EnableGangScheduling(3, 4, 1);
+		FirstHalf.Start(SnapshotUpdate);
+		FirstHalf.SaveSnapshot(TestSnapshotPath());
+	}
+
+	CCluster Resumed(200, 1);
+	Resumed.LoadSnapshot(TestSnapshotPath());
+	EXPECT_EQ(3, Resumed.GetGangMatrix().GetRowCount());
+
+	Resumed.Start(SnapshotUpdate);
+	EXPECT_EQ(ReportToString(Uninterrupted), ReportToString(Resumed));
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_job_arrays)
+{
+	CCluster Cluster(0, 2, 5, 2);
+	TProgramCall Sweep("Sweep", 1, 10);
+	Sweep.ArrayCount = 5;
+	Cluster.CallProgramExecution(Sweep);
+	Cluster.Start(EmptySnapshotUpdate);
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	CCluster Restored(40, 1);
+	Restored.LoadSnapshot(TestSnapshotPath());
+
+	ASSERT_EQ(1, Restored.GetWaitingProgramCalls().size());
+	EXPECT_EQ(3, Restored.GetWaitingProgramCalls().Check(0).ArrayCount);
+	EXPECT_EQ(2, Restored.GetWaitingProgramCalls().Check(0).ArrayIndex);
+	EXPECT_EQ(2, Restored.GetWaitingProgramCalls().Check(0).JobID);
+
+	Restored.Start(EmptySnapshotUpdate);
+	EXPECT_EQ(5, Restored.GetFinishedProgramCount());
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, snapshot_keeps_user_state)
+{
+	CCluster Cluster(5, 4);
+	Cluster.SaveSnapshot(TestSnapshotPath(), std::string("rng\0state", 9));
+
+	CCluster Restored(5, 4);
+	EXPECT_EQ(std::string("rng\0state", 9), Restored.LoadSnapshot(TestSnapshotPath()));
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, throws_when_snapshotting_real_programs)
+{
+	CCluster Cluster(5, 4);
+
+	TProgramCall Call("Real", 1, 1);
+	Call.Task = [](CJobContext&) {};
+	Cluster.CallProgramExecution(Call);
+
+	ASSERT_ANY_THROW(Cluster.SaveSnapshot(TestSnapshotPath()));
+}
+
+TEST(TCluster, throws_when_loading_damaged_snapshot)
+{
+	CCluster Cluster(40, 8);
+	Cluster.Start(SnapshotUpdate);
+	Cluster.SaveSnapshot(TestSnapshotPath());
+
+	std::vector<char> Content;
+	{
+		std::FILE* File = std::fopen(TestSnapshotPath().c_str(), "rb");
+		char Buffer[4096];
+		size_t Read;
+		while ((Read = std::fread(Buffer, 1, sizeof(Buffer), File)) > 0)
+			Content.insert(Content.end(), Buffer, Buffer + Read);
+		std::fclose(File);
+	}
+
+	{
+		std::FILE* File = std::fopen(TestSnapshotPath().c_str(), "wb");
+		std::fwrite(Content.data(), 1, Content.size() / 2, File);
+		std::fclose(File);
+	}
+
+	CCluster Restored(40, 8);
+	ASSERT_ANY_THROW(Restored.LoadSnapshot(TestSnapshotPath()));
+	ASSERT_ANY_THROW(Restored.LoadSnapshot("missing_cluster_snapshot.bin"));
+
+	std::remove(TestSnapshotPath().c_str());
+}
+
+TEST(TCluster, DISABLED_benchmark_snapshot)
+{
+	CCluster Cluster(20000, 8, 5, 1);
+	Cluster.Start(SnapshotUpdate);
+
+	const int Rounds = 100;
+
+	auto Begin = std::chrono::steady_clock::now();
+	for (int i = 0; i < Rounds; i++)
+		Cluster.SaveSnapshot(TestSnapshotPath());
+	auto Saved = std::chrono::steady_clock::now();
+
+	CCluster Restored(20000, 1);
+	for (int i = 0; i < Rounds; i++)
+		Restored.LoadSnapshot(TestSnapshotPath());
+	auto Loaded = std::chrono::steady_clock::now();
+
+	std::cout << "Waiting calls: " << Cluster.GetWaitingProgramCalls().size() << ", running programs: " << Cluster.GetRunningProgramCount() << std::endl;
+	std::cout << "Save: " << std::chrono::duration<double, std::micro>(Saved - Begin).count() / Rounds << " us" << std::endl;
+	std::cout << "Load: " << std::chrono::duration<double, std::micro>(Loaded - Saved).count() / Rounds << " us" << std::endl;
+
+	std::remove(TestSnapshotPath().c_str());
+}
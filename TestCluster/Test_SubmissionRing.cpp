@@ -0,0 +1,230 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "SubmissionRing.h"
+#include <gtest.h>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+
+#ifdef __linux__
+
+#include <unistd.h>
+
+std::string TestRingName()
+{
+	return "/cluster_test_ring_" + std::to_string(getpid());
+}
+
+TEST(CSubmissionRing, can_create_ring)
+{
+	ASSERT_NO_THROW(CSubmissionRing Ring(TestRingName(), 16));
+}
+
+TEST(CSubmissionRing, throws_when_capacity_is_not_power_of_two)
+{
+	ASSERT_ANY_THROW(CSubmissionRing Ring(TestRingName(), 10));
+}
+
+TEST(CSubmissionRing, producer_throws_without_ring)
+{
+	ASSERT_ANY_THROW(CSubmissionRingProducer Producer("/cluster_test_missing_ring"));
+}
+
+TEST(CSubmissionRing, producer_sees_ring_capacity)
+{
+	CSubmissionRing Ring(TestRingName(), 16);
+	CSubmissionRingProducer Producer(TestRingName());
+
+	EXPECT_EQ(16, Producer.GetCapacity());
+}
+
+TEST(CSubmissionRing, throws_when_name_is_too_long)
+{
+	CSubmissionRing Ring(TestRingName(), 16);
+	CSubmissionRingProducer Producer(TestRingName());
+	uint64_t Ticket;
+
+	ASSERT_ANY_THROW(Producer.TrySubmit(std::string(SubmissionRingMaxNameLength + 1, 'a'), 1, 1, Ticket));
+}
+
+TEST(CSubmissionRing, drained_calls_reach_the_cluster_in_order)
+{
+	CCluster Cluster(100, 32);
+	CSubmissionRing Ring(TestRingName(), 16);
+	CSubmissionRingProducer Producer(TestRingName());
+
+	uint64_t Ticket;
+	ASSERT_TRUE(Producer.TrySubmit("First", 2, 10, Ticket));
+	ASSERT_TRUE(Producer.TrySubmit("Second", 4, 20, Ticket));
+
+	Ring.DrainSubmissions(Cluster);
+
+	ASSERT_EQ(2, Cluster.GetWaitingProgramCalls().size());
+	EXPECT_EQ("First", Cluster.GetWaitingProgramCalls().Check(0).Name);
+	EXPECT_EQ(4, Cluster.GetWaitingProgramCalls().Check(1).RequiredProcessors);
+	EXPECT_EQ(20, Cluster.GetWaitingProgramCalls().Check(1).ExecutionTime);
+}
+
+TEST(CSubmissionRing, acknowledges_job_ids)
+{
+	CCluster Cluster(100, 32);
+	CSubmissionRing Ring(TestRingName(), 16);
+	CSubmissionRingProducer Producer(TestRingName());
+
+	uint64_t FirstTicket, SecondTicket, JobID = 0;
+	Producer.TrySubmit("First", 2, 10, FirstTicket);
+	Producer.TrySubmit("Rejected", 64, 10, SecondTicket);
+
+	EXPECT_FALSE(Producer.PollAcknowledgement(FirstTicket, JobID));
+
+	Ring.DrainSubmissions(Cluster);
+
+	ASSERT_TRUE(Producer.PollAcknowledgement(FirstTicket, JobID));
+	EXPECT_EQ(0, JobID);
+	ASSERT_TRUE(Producer.PollAcknowledgement(SecondTicket, JobID));
+	EXPECT_EQ(RejectedJobID, JobID);
+}
+
+TEST(CSubmissionRing, rejects_submissions_when_full)
+{
+	CCluster Cluster(100, 32);
+	CSubmissionRing Ring(TestRingName(), 4);
+	CSubmissionRingProducer Producer(TestRingName());
+
+	uint64_t Ticket;
+	for (int i = 0; i < 4; i++)
+		ASSERT_TRUE(Producer.TrySubmit("Program" + std::to_string(i), 1, 10, Ticket));
+
+	EXPECT_FALSE(Producer.TrySubmit("Program4", 1, 10, Ticket));
+
+	Ring.DrainSubmissions(Cluster);
+	EXPECT_TRUE(Producer.TrySubmit("Program4", 1, 10, Ticket));
+}
+
+TEST(CSubmissionRing, concurrent_producers_lose_no_calls)
+{
+	const int ProducerCount = 4;
+	const int SubmissionsPerProducer = 5000;
+
+	CCluster Cluster(100, 32);
+	CSubmissionRing Ring(TestRingName(), 256);
+
+	std::vector<std::thread> Producers;
+	for (int i = 0; i < ProducerCount; i++)
+		Producers.push_back(std::thread([&, i]()
+		{
+			CSubmissionRingProducer Producer(TestRingName());
+			uint64_t Ticket;
+
+			for (int j = 0; j < SubmissionsPerProducer; j++)
+				while (!Producer.TrySubmit("Program" + std::to_string(i) + "_" + std::to_string(j), 1, 10, Ticket))
+					std::this_thread::yield();
+		}));
+
+	while (Cluster.GetWaitingProgramCalls().size() < size_t(ProducerCount * SubmissionsPerProducer))
+		Ring.DrainSubmissions(Cluster);
+
+	for (auto& Producer : Producers)
+		Producer.join();
+
+	EXPECT_EQ(size_t(ProducerCount * SubmissionsPerProducer), Cluster.GetWaitingProgramCalls().size());
+}
+
+// Writes records the way a broken producer would
+class CBrokenRingProducer : public CSubmissionRingProducer
+{
+public:
+	CBrokenRingProducer(const std::string& InName) : CSubmissionRingProducer(InName) {}
+
+	void SetNameLength(uint64_t InTicket, uint16_t InNameLength) { Records[InTicket & (Capacity - 1)].NameLength = InNameLength; }
+};
+
+TEST(CSubmissionRing, rejects_records_with_too_long_name)
+{
+	CCluster Cluster(100, 32);
+	CSubmissionRing Ring(TestRingName(), 16);
+	CBrokenRingProducer Producer(TestRingName());
+
+	uint64_t Ticket, JobID = 0;
+	Producer.TrySubmit("Program", 1, 10, Ticket);
+	Producer.SetNameLength(Ticket, UINT16_MAX);
+
+	Ring.DrainSubmissions(Cluster);
+
+	ASSERT_TRUE(Producer.PollAcknowledgement(Ticket, JobID));
+	EXPECT_EQ(RejectedJobID, JobID);
+	EXPECT_EQ(0, Cluster.GetWaitingProgramCalls().size());
+}
+
+TEST(CSubmissionRing, drains_at_most_capacity_per_tick)
+{
+	const size_t Capacity = 8;
+
+	CCluster Cluster(100, 32);
+	CSubmissionRing Ring(TestRingName(), Capacity);
+
+	std::atomic<bool> Stop(false);
+	std::thread Refill([&]()
+	{
+		CSubmissionRingProducer Producer(TestRingName());
+		uint64_t Ticket;
+
+		for (size_t i = 0; !Stop; i++)
+			Producer.TrySubmit("Program" + std::to_string(i), 1, 10, Ticket);
+	});
+
+	for (int i = 0; i < 1000; i++)
+	{
+		size_t Before = Cluster.GetWaitingProgramCalls().size();
+		Ring.DrainSubmissions(Cluster);
+		EXPECT_LE(Cluster.GetWaitingProgramCalls().size() - Before, Capacity);
+	}
+
+	Stop = true;
+	Refill.join();
+}
+
+TEST(CSubmissionRing, cluster_drains_ring_every_tick)
+{
+	CCluster Cluster(10, 32);
+	CSubmissionRing Ring(TestRingName(), 16);
+	Cluster.AddSubmissionSource(&Ring);
+
+	CSubmissionRingProducer Producer(TestRingName());
+	uint64_t Ticket;
+	Producer.TrySubmit("Program", 2, 3, Ticket);
+
+	Cluster.Start([](CCluster*) {});
+
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramCalls);
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramsFinished);
+}
+
+
+// Benchmark, run with --gtest_also_run_disabled_tests
+
+TEST(CSubmissionRing, DISABLED_benchmark_submission_cost)
+{
+	const int SubmissionCount = 1000000;
+
+	CCluster Cluster(100, 32);
+	CSubmissionRing Ring(TestRingName(), 1 << 20);
+	CSubmissionRingProducer Producer(TestRingName());
+
+	uint64_t Ticket;
+	std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < SubmissionCount; i++)
+		Producer.TrySubmit("Program", 1, 10, Ticket);
+
+	float SubmitTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - StartTime).count();
+
+	StartTime = std::chrono::steady_clock::now();
+	Ring.DrainSubmissions(Cluster);
+	float DrainTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - StartTime).count();
+
+	std::cout << "Submission: " << SubmitTime / SubmissionCount * 1e9 << " ns; Drain into queue: " << DrainTime / SubmissionCount * 1e9 << " ns per call;" << std::endl;
+}
+
+#endif
@@ -0,0 +1,202 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "SubmissionServer.h"
+#include <gtest.h>
+#include <thread>
+#include <chrono>
+
+#ifdef __linux__
+
+#include <unistd.h>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+std::string TestSocketPath()
+{
+	return "/tmp/cluster_test_" + std::to_string(getpid()) + ".sock";
+}
+
+// Lets the server pick up what the clients have sent so far
+void DrainFor(CSubmissionServer& Server, CCluster& Cluster, int Milliseconds)
+{
+	std::chrono::steady_clock::time_point Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(Milliseconds);
+
+	while (std::chrono::steady_clock::now() < Deadline)
+	{
+		Server.DrainSubmissions(Cluster);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// Waits for the poller thread to parse InCount requests, without draining the server
+bool WaitForPendingRequests(CSubmissionServer& Server, size_t InCount)
+{
+	std::chrono::steady_clock::time_point Deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+	while (Server.GetPendingRequestCount() < InCount && std::chrono::steady_clock::now() < Deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	return Server.GetPendingRequestCount() == InCount;
+}
+
+TEST(CSubmissionServer, can_create_server)
+{
+	ASSERT_NO_THROW(CSubmissionServer Server(TestSocketPath()));
+}
+
+TEST(CSubmissionServer, client_throws_without_server)
+{
+	ASSERT_ANY_THROW(CSubmissionClient Client("/tmp/cluster_test_missing.sock"));
+}
+
+TEST(CSubmissionServer, accepts_submissions_in_order)
+{
+	CCluster Cluster(100, 32);
+	CSubmissionServer Server(TestSocketPath());
+	CSubmissionClient Client(TestSocketPath());
+
+	for (int i = 0; i < 100; i++)
+		Client.Submit("Program" + std::to_string(i), 2, 10);
+	Client.Flush();
+
+	DrainFor(Server, Cluster, 20);
+
+	EXPECT_EQ(100, Cluster.GetWaitingProgramCalls().size());
+	EXPECT_EQ("Program42", Cluster.GetWaitingProgramCalls().Check(42).Name);
+
+	for (uint64_t i = 0; i < 100; i++)
+	{
+		uint64_t JobID = 0;
+		ASSERT_TRUE(Client.ReadAcknowledgement(JobID));
+		EXPECT_EQ(i, JobID);
+	}
+}
+
+TEST(CSubmissionServer, rejects_invalid_calls)
+{
+	CCluster Cluster(100, 32);
+	CSubmissionServer Server(TestSocketPath());
+	CSubmissionClient Client(TestSocketPath());
+
+	Client.Submit("Program", 64, 10);
+	Client.Flush();
+
+	DrainFor(Server, Cluster, 10);
+
+	uint64_t JobID = 0;
+	EXPECT_FALSE(Client.ReadAcknowledgement(JobID));
+	EXPECT_EQ(0, Cluster.GetWaitingProgramCalls().size());
+}
+
+TEST(CSubmissionServer, answers_status_queries)
+{
+	CCluster Cluster(100, 32);
+	CSubmissionServer Server(TestSocketPath());
+	CSubmissionClient Client(TestSocketPath());
+
+	Client.Submit("Program", 2, 10);
+	Client.Flush();
+	DrainFor(Server, Cluster, 10);
+
+	uint64_t JobID = 0;
+	Client.ReadAcknowledgement(JobID);
+
+	TSubmissionStatus Status;
+	std::thread Query([&]() { Status = Client.QueryStatus(); });
+	DrainFor(Server, Cluster, 20);
+	Query.join();
+
+	EXPECT_EQ(1, Status.Waiting);
+	EXPECT_EQ(0, Status.Running);
+}
+
+TEST(CSubmissionServer, cluster_drains_server_every_tick)
+{
+	CCluster Cluster(10, 32);
+	CSubmissionServer Server(TestSocketPath());
+	Cluster.AddSubmissionSource(&Server);
+
+	{
+		CSubmissionClient Client(TestSocketPath());
+		Client.Submit("Program", 2, 3);
+		Client.Flush();
+	}
+
+	Cluster.SetRealTimePacing(0.005f);
+	Cluster.Start([](CCluster*) {});
+
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramCalls);
+	EXPECT_EQ(1, Cluster.GetReportData().TotalProgramsFinished);
+}
+
+TEST(CSubmissionServer, closes_connection_on_unknown_message)
+{
+	CCluster Cluster(100, 32);
+	CSubmissionServer Server(TestSocketPath());
+
+	sockaddr_un Address = {};
+	Address.sun_family = AF_UNIX;
+	strcpy(Address.sun_path, TestSocketPath().c_str());
+
+	int FD = socket(AF_UNIX, SOCK_STREAM, 0);
+	ASSERT_EQ(0, connect(FD, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)));
+
+	DrainFor(Server, Cluster, 5);
+	ASSERT_EQ(1, Server.GetConnectionCount());
+
+	uint8_t Garbage = 0xFF;
+	ASSERT_EQ(1, write(FD, &Garbage, 1));
+
+	DrainFor(Server, Cluster, 5);
+	EXPECT_EQ(0, Server.GetConnectionCount());
+
+	close(FD);
+}
+
+TEST(CSubmissionServer, parses_requests_between_drains)
+{
+	CSubmissionServer Server(TestSocketPath());
+	CSubmissionClient Client(TestSocketPath());
+
+	for (int i = 0; i < 10; i++)
+		Client.Submit("Program" + std::to_string(i), 2, 10);
+	Client.Flush();
+
+	EXPECT_TRUE(WaitForPendingRequests(Server, 10));
+}
+
+TEST(CSubmissionServer, stops_reading_when_backlog_is_full)
+{
+	const size_t SubmissionCount = CSubmissionServer::MaxPendingRequests + 1000;
+
+	CCluster Cluster(100, 32);
+	CSubmissionServer Server(TestSocketPath());
+
+	std::thread Sender([&]()
+	{
+		CSubmissionClient Client(TestSocketPath());
+
+		for (size_t i = 0; i < SubmissionCount; i++)
+			Client.Submit("P" + std::to_string(i), 1, 10);
+		Client.Flush();
+
+		uint64_t JobID;
+		for (size_t i = 0; i < SubmissionCount; i++)
+			Client.ReadAcknowledgement(JobID);
+	});
+
+	// The rest stays in the socket until the backlog is drained
+	EXPECT_TRUE(WaitForPendingRequests(Server, CSubmissionServer::MaxPendingRequests));
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_EQ(CSubmissionServer::MaxPendingRequests, Server.GetPendingRequestCount());
+
+	while (Cluster.GetWaitingProgramCalls().size() < SubmissionCount)
+		DrainFor(Server, Cluster, 5);
+
+	Sender.join();
+	EXPECT_EQ(SubmissionCount, Cluster.GetWaitingProgramCalls().size());
+	EXPECT_EQ("P" + std::to_string(SubmissionCount - 1), Cluster.GetWaitingProgramCalls().Check(SubmissionCount - 1).Name);
+}
+
+#endif
@@ -0,0 +1,178 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Cluster.h"
+#include "Topology.h"
+#include "WeightTuner.h"
+#include <gtest.h>
+#include <iostream>
+
+TTopologyShape MakeShape(size_t InProcessorsPerSocket, size_t InSocketsPerNode, size_t InNodesPerRack)
+{
+	TTopologyShape Shape;
+	Shape.ProcessorsPerSocket = InProcessorsPerSocket;
+	Shape.SocketsPerNode = InSocketsPerNode;
+	Shape.NodesPerRack = InNodesPerRack;
+	return Shape;
+}
+
+TEST(CTopology, throws_on_empty_groups)
+{
+	ASSERT_ANY_THROW(CTopology(16, MakeShape(0, 2, 2)));
+	ASSERT_ANY_THROW(CTopology(0, MakeShape(4, 2, 2)));
+	ASSERT_NO_THROW(CTopology(10, MakeShape(4, 2, 2)));
+}
+
+TEST(CTopology, finds_span_of_processors)
+{
+	CTopology Topology(32, MakeShape(4, 2, 2));
+
+	EXPECT_EQ(ETopologyLevel::Processor, Topology.GetSpan({ 5 }));
+	EXPECT_EQ(ETopologyLevel::Socket, Topology.GetSpan({ 0, 3 }));
+	EXPECT_EQ(ETopologyLevel::Node, Topology.GetSpan({ 0, 4 }));
+	EXPECT_EQ(ETopologyLevel::Rack, Topology.GetSpan({ 0, 1, 8 }));
+	EXPECT_EQ(ETopologyLevel::Cluster, Topology.GetSpan({ 15, 16 }));
+	EXPECT_EQ(2, Topology.GetGroup(17, ETopologyLevel::Node));
+}
+
+TEST(CTopology, chooses_fullest_smallest_group)
+{
+	CTopology Topology(16, MakeShape(4, 2, 2));
+
+	// Processors 0 and 1 are taken
+	std::vector<uint8_t> Eligible(16, 1);
+	Eligible[0] = Eligible[1] = 0;
+
+	EXPECT_EQ(std::vector<unsigned>({ 2 }), Topology.ChooseProcessors(Eligible, 1));
+	EXPECT_EQ(std::vector<unsigned>({ 2, 3 }), Topology.ChooseProcessors(Eligible, 2));
+	EXPECT_EQ(std::vector<unsigned>({ 4, 5, 6 }), Topology.ChooseProcessors(Eligible, 3));
+	EXPECT_EQ(std::vector<unsigned>({ 2, 3, 4, 5, 6, 7 }), Topology.ChooseProcessors(Eligible, 6));
+	EXPECT_EQ(std::vector<unsigned>({ 8, 9, 10, 11, 12, 13, 14 }), Topology.ChooseProcessors(Eligible, 7));
+}
+
+TEST(CTopology, spreads_over_fewest_groups)
+{
+	CTopology Topology(16, MakeShape(4, 2, 2));
+
+	// One free processor in socket 0, three in socket 1, four in socket 2, none in socket 3
+	std::vector<uint8_t> Eligible = { 0, 0, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 0, 0, 0 };
+
+	// Within node 0 the emptier socket 1 goes first
+	EXPECT_EQ(std::vector<unsigned>({ 3, 4, 5, 6, 8, 9, 10, 11 }), Topology.ChooseProcessors(Eligible, 8));
+	EXPECT_EQ(std::vector<unsigned>({ 8, 9, 10, 11 }), Topology.ChooseProcessors(Eligible, 4));
+	EXPECT_EQ(std::vector<unsigned>({ 4, 5, 6 }), Topology.ChooseProcessors(Eligible, 3));
+	EXPECT_TRUE(Topology.ChooseProcessors(Eligible, 9).empty());
+}
+
+TEST(CTopology, applies_communication_penalty)
+{
+	CTopology Topology(32, MakeShape(4, 2, 2));
+
+	EXPECT_EQ(20, Topology.ApplyCommunicationPenalty(20, 100, ETopologyLevel::Processor));
+	EXPECT_EQ(20, Topology.ApplyCommunicationPenalty(20, 100, ETopologyLevel::Socket));
+	EXPECT_EQ(21, Topology.ApplyCommunicationPenalty(20, 100, ETopologyLevel::Node));
+	EXPECT_EQ(30, Topology.ApplyCommunicationPenalty(20, 100, ETopologyLevel::Cluster));
+	EXPECT_EQ(25, Topology.ApplyCommunicationPenalty(20, 25, ETopologyLevel::Cluster));
+}
+
+TEST(TCluster, places_program_within_one_socket)
+{
+	CCluster Cluster(1, 16, 5, 2);
+	Cluster.SetTopology(MakeShape(4, 2, 2));
+
+	Cluster.CallProgramExecution(TProgramCall("Small", 2, 10));
+	Cluster.CallProgramExecution(TProgramCall("Socket", 4, 10));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::map<std::string, TProgram> Running = Cluster.GetRunningPrograms();
+	EXPECT_EQ(std::set<unsigned>({ 0, 1 }), Running["Small"].OccupiedProcessors);
+	EXPECT_EQ(std::set<unsigned>({ 4, 5, 6, 7 }), Running["Socket"].OccupiedProcessors);
+}
+
+TEST(TCluster, spread_program_runs_longer)
+{
+	CCluster Cluster(1, 16, 5, 2);
+	TTopologyShape Shape = MakeShape(2, 2, 2);
+	Shape.CommunicationPenalty = { 0, 0, 0.1, 0.5, 1 };
+	Cluster.SetTopology(Shape);
+
+	Cluster.CallProgramExecution(TProgramCall("Node", 4, 100, 10));
+	Cluster.CallProgramExecution(TProgramCall("Cluster", 12, 100, 10));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::map<std::string, TProgram> Running = Cluster.GetRunningPrograms();
+	EXPECT_EQ(11, Running["Node"].ActualExecutionTime);
+	EXPECT_EQ(20, Running["Cluster"].ActualExecutionTime);
+	EXPECT_EQ(ETopologyLevel::Cluster, Cluster.GetTopology().GetSpan(Running["Cluster"].OccupiedProcessors));
+}
+
+TEST(TCluster, topology_placement_respects_node_resources)
+{
+	CCluster Cluster(1, 8);
+	Cluster.SetTopology(MakeShape(2, 2, 2));
+
+	TResources Capacity;
+	Capacity[EResource::Memory] = 64;
+	Cluster.SetNodeResources(TResources());
+	Cluster.SetNodeResources(5, Capacity);
+	Cluster.SetNodeResources(6, Capacity);
+
+	TProgramCall Call("Memory", 2, 10);
+	Call.Resources[EResource::Memory] = 32;
+	Cluster.CallProgramExecution(Call);
+	Cluster.Start([](CCluster* InCluster) {});
+
+	EXPECT_EQ(std::set<unsigned>({ 5, 6 }), Cluster.GetRunningPrograms().at("Memory").OccupiedProcessors);
+}
+
+TEST(TCluster, fork_keeps_topology)
+{
+	CCluster Cluster(1, 8);
+	Cluster.SetTopology(MakeShape(2, 2, 2));
+	Cluster.CallProgramExecution(TProgramCall("First", 3, 10));
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::unique_ptr<CCluster> Forked = Cluster.Fork(2);
+	Forked->CallProgramExecution(TProgramCall("Second", 2, 10));
+	Forked->Start([](CCluster* InCluster) {});
+
+	// A whole socket instead of the last processor of the first node
+	EXPECT_TRUE(Forked->GetTopology().IsSet());
+	EXPECT_EQ(std::set<unsigned>({ 4, 5 }), Forked->GetRunningPrograms().at("Second").OccupiedProcessors);
+}
+
+TEST(CTopology, DISABLED_benchmark_placement)
+{
+	const size_t ProcessorCount = 256;
+	TTopologyShape Shape = MakeShape(8, 2, 4);
+
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 2000;
+	Parameters.RequiredProcessorsMultiplier = 8;
+	std::vector<TWorkloadJob> Jobs = GenerateWorkload(Parameters, ProcessorCount, 1);
+
+	for (bool Placed : { false, true })
+	{
+		CCluster Cluster(Parameters.Duration, ProcessorCount, 5, 5);
+		CTopology Topology(ProcessorCount, Shape);
+		if (Placed)
+			Cluster.SetTopology(Shape);
+
+		// Penalty the started programs get (or would get, when placed without the topology)
+		double Penalty = 0;
+		size_t Started = 0;
+		Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall)
+		{
+			std::set<unsigned> Processors = InCluster->GetRunningPrograms().at(InCall.Name).OccupiedProcessors;
+			Penalty += Shape.CommunicationPenalty[size_t(Topology.GetSpan(Processors))];
+			Started++;
+		});
+
+		CWorkloadSource Source(Jobs);
+		Cluster.AddSubmissionSource(&Source);
+		Cluster.Start([](CCluster* InCluster) {});
+		Cluster.RemoveSubmissionSource(&Source);
+
+		std::cout << (Placed ? "Topology placement: " : "First free processors: ") << Started << " programs started, " << Cluster.GetFinishedProgramCount()
+			<< " finished, mean communication penalty " << Penalty / Started << std::endl;
+	}
+}
@@ -0,0 +1,273 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "WaitingCallFields.h"
+#include "Cluster.h"
+#include <gtest.h>
+#include <deque>
+#include <random>
+#include <chrono>
+#include <iostream>
+
+struct TReferenceCall
+{
+	size_t TimeCalled;
+	size_t ExecutionTime;
+	size_t RequiredProcessors;
+};
+
+// Scalar scorer written the way CCluster::EvaluateWaitingCallScore is
+size_t ReferenceTop(const std::deque<TReferenceCall>& Calls, size_t Depth, size_t CurrentTime, size_t FreeProcessors, TScoreWeights Weights = TScoreWeights())
+{
+	size_t Index = 0;
+	float MaxScore = -1000000000000000000000000000000000.0;
+
+	for (size_t i = 0; i < std::min(Depth, Calls.size()); i++)
+	{
+		float Score = 0;
+		Score += (Depth - i) * Weights.Position;
+		Score += (CurrentTime - Calls[i].TimeCalled) * Weights.Waiting;
+		Score -= Calls[i].ExecutionTime * Weights.ExecutionTime;
+		if (FreeProcessors < Calls[i].RequiredProcessors)
+			Score -= Calls[i].RequiredProcessors * Weights.Processors;
+
+		if (Score > MaxScore)
+		{
+			Index = i;
+			MaxScore = Score;
+		}
+	}
+
+	return Index;
+}
+
+TEST(CWaitingCallFields, empty_by_default)
+{
+	CWaitingCallFields Fields;
+
+	EXPECT_EQ(true, Fields.empty());
+	ASSERT_ANY_THROW(Fields.Pop());
+}
+
+TEST(CWaitingCallFields, follows_queue_across_copies)
+{
+	std::mt19937 Random(3);
+
+	std::vector<CWaitingCallFields> Fields(1);
+	std::vector<std::deque<TReferenceCall>> Expected(1);
+	TWaitingCallScores Scores;
+
+	for (size_t Step = 0; Step < 30000; Step++)
+	{
+		size_t Index = Random() % Fields.size();
+		int Action = Random() % 20;
+
+		if (Action == 0 && Fields.size() < 8)
+		{
+			Fields.push_back(Fields[Index]);
+			Expected.push_back(Expected[Index]);
+		}
+		else if (Action < 11 || Expected[Index].empty())
+		{
+			TReferenceCall Call = { Step, 1 + Random() % 50, 1 + Random() % 64 };
+			Fields[Index].Put(Call.TimeCalled, Call.ExecutionTime, Call.RequiredProcessors);
+			Expected[Index].push_back(Call);
+		}
+		else
+		{
+			size_t Depth = 1 + Random() % 600;
+			size_t Free = Random() % 64;
+
+			size_t Top = Fields[Index].FindTop(TDefaultScoreWeights(), Depth, Depth, Step, Free, Scores);
+			ASSERT_EQ(ReferenceTop(Expected[Index], Depth, Step, Free), Top);
+
+			Fields[Index].Pop(Top);
+			Expected[Index].erase(Expected[Index].begin() + Top);
+		}
+
+		ASSERT_EQ(Expected[Index].size(), Fields[Index].size());
+	}
+}
+
+TEST(CWaitingCallFields, matches_scalar_scores_beyond_int32_terms)
+{
+	std::mt19937_64 Random(5);
+
+	CWaitingCallFields Fields;
+	std::deque<TReferenceCall> Expected;
+	TWaitingCallScores Scores;
+
+	const size_t CurrentTime = size_t(1) << 40;
+
+	for (size_t i = 0; i < 1000; i++)
+	{
+		TReferenceCall Call = { CurrentTime - Random() % (size_t(1) << 36), 1 + Random() % (size_t(1) << 34), 1 + Random() % 1000 };
+		Fields.Put(Call.TimeCalled, Call.ExecutionTime, Call.RequiredProcessors);
+		Expected.push_back(Call);
+	}
+
+	for (size_t Depth : { size_t(1), size_t(7), size_t(300), size_t(1000), size_t(1) << 30 })
+		EXPECT_EQ(ReferenceTop(Expected, Depth, CurrentTime, 500), Fields.FindTop(TDefaultScoreWeights(), Depth, Depth, CurrentTime, 500, Scores));
+}
+
+TEST(CWaitingCallFields, picks_first_of_equal_scores)
+{
+	CWaitingCallFields Fields;
+	TWaitingCallScores Scores;
+
+	// Each later call waited 3 ticks longer, making up for its place in the queue exactly
+	for (size_t i = 0; i < 10; i++)
+		Fields.Put(100 - 3 * i, 5, 1);
+
+	EXPECT_EQ(0, Fields.FindTop(TDefaultScoreWeights(), 10, 10, 100, 4, Scores));
+}
+
+TEST(CWaitingCallFields, matches_scalar_scores_with_runtime_weights)
+{
+	std::mt19937 Random(11);
+
+	CWaitingCallFields Fields;
+	std::deque<TReferenceCall> Expected;
+	TWaitingCallScores Scores;
+
+	for (size_t i = 0; i < 2000; i++)
+	{
+		TReferenceCall Call = { i, 1 + Random() % 100, 1 + Random() % 64 };
+		Fields.Put(Call.TimeCalled, Call.ExecutionTime, Call.RequiredProcessors);
+		Expected.push_back(Call);
+	}
+
+	for (int Round = 0; Round < 200; Round++)
+	{
+		TScoreWeights Weights;
+		Weights.Position = Random() % 40;
+		Weights.Waiting = Random() % 12;
+		Weights.ExecutionTime = Random() % 10;
+		Weights.Processors = Random() % 20;
+
+		size_t Depth = 1 + Random() % 2000;
+		size_t Free = Random() % 64;
+
+		// Large times push the scores past the exact integer range
+		size_t CurrentTime = Round % 2 ? 2000 : 2000 + (size_t(1) << (20 + Round % 12));
+
+		EXPECT_EQ(ReferenceTop(Expected, Depth, CurrentTime, Free, Weights), Fields.FindTop(Weights, Depth, Depth, CurrentTime, Free, Scores));
+	}
+}
+
+TEST(CWaitingCallFields, static_weights_match_runtime_weights)
+{
+	EXPECT_EQ(TScoreWeights(), TScoreWeights(TDefaultScoreWeights()));
+
+	CWaitingCallFields Fields;
+	TWaitingCallScores Scores;
+
+	for (size_t i = 0; i < 500; i++)
+		Fields.Put(i, 1 + (i * 37) % 29, 1 + (i * 11) % 16);
+
+	for (size_t Depth = 1; Depth < 500; Depth += 7)
+		EXPECT_EQ(Fields.FindTop(TScoreWeights(), Depth, Depth, 600, 8, Scores), Fields.FindTop(TDefaultScoreWeights(), Depth, Depth, 600, 8, Scores));
+
+	EXPECT_EQ(float(-1000000000000000000000000000000000.0), LowestWaitingCallScore);
+}
+
+void DeepWindowUpdate(CCluster* InCluster)
+{
+	size_t Time = InCluster->GetCurrentTime();
+
+	for (size_t i = 0; i < 4; i++)
+		InCluster->CallProgramExecution(TProgramCall("Program" + std::to_string(Time) + "_" + std::to_string(i), 1 + (Time * 7 + i * 3) % 16, 1 + (Time + i) % 20));
+}
+
+TEST(CWaitingCallFields, DISABLED_benchmark_deep_window)
+{
+	const size_t Depths[] = { 5, 100, 1000, 10000 };
+
+	for (size_t Depth : Depths)
+	{
+		CCluster Cluster(2000, 32, Depth);
+		Cluster.Start(DeepWindowUpdate);
+
+		const int Rounds = 20;
+		size_t Window = std::min(Depth, Cluster.GetWaitingProgramCalls().size());
+
+		// Scoring one call at a time through the queue, as the scheduler used to
+		auto Begin = std::chrono::steady_clock::now();
+		size_t ScalarTop = 0;
+		for (int Round = 0; Round < Rounds; Round++)
+		{
+			float MaxScore = -1000000000000000000000000000000000.0;
+			for (size_t i = 0; i < Window; i++)
+			{
+				float Score = Cluster.EvaluateWaitingCallScore(i);
+				if (Score > MaxScore)
+				{
+					ScalarTop = i;
+					MaxScore = Score;
+				}
+			}
+		}
+		auto ScalarFinished = std::chrono::steady_clock::now();
+
+		CWaitingCallFields Fields;
+		for (size_t i = 0; i < Cluster.GetWaitingProgramCalls().size(); i++)
+		{
+			const TProgramCall& Call = Cluster.GetWaitingProgramCalls().Check(i);
+			Fields.Put(Call.TimeCalled, Call.ExecutionTime, Call.RequiredProcessors);
+		}
+
+		size_t FreeProcessors = 0;
+		for (auto& Processor : Cluster.GetProcessorData())
+			FreeProcessors += !Processor.IsOccupied();
+
+		TWaitingCallScores Scores;
+		auto BatchBegin = std::chrono::steady_clock::now();
+		size_t BatchTop = 0;
+		for (int Round = 0; Round < Rounds; Round++)
+			BatchTop = Fields.FindTop(TDefaultScoreWeights(), Depth, Depth, Cluster.GetCurrentTime(), FreeProcessors, Scores);
+		auto BatchFinished = std::chrono::steady_clock::now();
+
+		EXPECT_EQ(ScalarTop, BatchTop);
+
+		std::cout << "Window " << Window << ": one by one " << std::chrono::duration<double, std::micro>(ScalarFinished - Begin).count() / Rounds << " us"
+			<< ", in one pass " << std::chrono::duration<double, std::micro>(BatchFinished - BatchBegin).count() / Rounds << " us" << std::endl;
+	}
+}
+
+template<class TWeights>
+double MeasureDecision(const CWaitingCallFields& Fields, const TWeights& Weights, size_t Depth, size_t CurrentTime, size_t& OutTop)
+{
+	TWaitingCallScores Scores;
+	const int Rounds = 2000;
+
+	auto Begin = std::chrono::steady_clock::now();
+	for (int Round = 0; Round < Rounds; Round++)
+		OutTop += Fields.FindTop(Weights, Depth, Depth, CurrentTime + Round % 2, 8, Scores);
+
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Begin).count() / Rounds;
+}
+
+TEST(CWaitingCallFields, DISABLED_benchmark_score_weights)
+{
+	const size_t Depths[] = { 5, 64, 1000 };
+
+	CWaitingCallFields Fields;
+	for (size_t i = 0; i < 1000; i++)
+		Fields.Put(i, 1 + (i * 37) % 29, 1 + (i * 11) % 16);
+
+	// Runtime weights are read through a volatile so that the compiler can not treat them as constants
+	volatile size_t Position = 15;
+	TScoreWeights RuntimeWeights;
+	RuntimeWeights.Position = Position;
+
+	for (size_t Depth : Depths)
+	{
+		size_t Top = 0;
+
+		double Static = MeasureDecision(Fields, TDefaultScoreWeights(), Depth, 1000, Top);
+		double Runtime = MeasureDecision(Fields, RuntimeWeights, Depth, 1000, Top);
+		double Float = MeasureDecision(Fields, TDefaultScoreWeights(), Depth, size_t(1) << 30, Top);
+
+		std::cout << "Window " << Depth << ": static weights " << Static << " ns, runtime weights " << Runtime
+			<< " ns, float scores " << Float << " ns (" << Top << ")" << std::endl;
+	}
+}
@@ -0,0 +1,234 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "WeightTuner.h"
+#include <gtest.h>
+#include <sstream>
+#include <chrono>
+#include <iostream>
+
+std::vector<std::vector<TWorkloadJob>> TuningWorkloads(size_t Count, size_t ProcessorCount)
+{
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 60;
+
+	std::vector<std::vector<TWorkloadJob>> Workloads;
+	for (uint32_t Seed = 1; Seed <= Count; Seed++)
+		Workloads.push_back(GenerateWorkload(Parameters, ProcessorCount, Seed));
+
+	return Workloads;
+}
+
+TWorkloadJob MakeJob(size_t InSubmitTime, size_t InRequiredProcessors, size_t InExecutionTime)
+{
+	TWorkloadJob Job;
+	Job.SubmitTime = InSubmitTime;
+	Job.RequiredProcessors = InRequiredProcessors;
+	Job.ExecutionTime = InExecutionTime;
+	return Job;
+}
+
+TTuningSettings SmallTuningSettings()
+{
+	TTuningSettings Settings;
+	Settings.ProcessorCount = 16;
+	Settings.CandidateCount = 12;
+	Settings.ThreadCount = 3;
+	return Settings;
+}
+
+TEST(CWeightTuner, generates_same_workload_for_same_seed)
+{
+	TWorkloadParameters Parameters;
+	std::vector<TWorkloadJob> First = GenerateWorkload(Parameters, 32, 7);
+	std::vector<TWorkloadJob> Second = GenerateWorkload(Parameters, 32, 7);
+
+	ASSERT_EQ(First.size(), Second.size());
+	EXPECT_FALSE(First.empty());
+
+	for (size_t i = 0; i < First.size(); i++)
+	{
+		EXPECT_EQ(First[i].SubmitTime, Second[i].SubmitTime);
+		EXPECT_EQ(First[i].RequiredProcessors, Second[i].RequiredProcessors);
+		EXPECT_EQ(First[i].ExecutionTime, Second[i].ExecutionTime);
+	}
+}
+
+TEST(CWeightTuner, generated_jobs_fit_the_cluster)
+{
+	TWorkloadParameters Parameters;
+	Parameters.RequiredProcessorsMultiplier = 4;
+
+	for (auto& Job : GenerateWorkload(Parameters, 8, 3))
+	{
+		EXPECT_GE(Job.RequiredProcessors, 1);
+		EXPECT_LE(Job.RequiredProcessors, 8);
+		EXPECT_GE(Job.ExecutionTime, 1);
+	}
+}
+
+TEST(CWeightTuner, parses_swf_trace)
+{
+	std::stringstream Trace;
+	Trace << "; Version: 2.2" << std::endl
+		<< "; MaxProcs: 16" << std::endl
+		<< "1 100 5 30 4 -1 -1 4 60 -1 1 1 1 1 1 -1 -1 -1" << std::endl
+		<< "2 90 0 10 2 -1 -1 -1 60 -1 1 1 1 1 1 -1 -1 -1" << std::endl
+		<< "3 120 0 -1 2 -1 -1 2 60 -1 0 1 1 1 1 -1 -1 -1" << std::endl
+		<< "4 130 0 10 64 -1 -1 64 60 -1 1 1 1 1 1 -1 -1 -1" << std::endl
+		<< std::endl
+		<< "5 150 0 25 1 -1 -1 1 -1 -1 1 1 1 1 1 -1 -1 -1" << std::endl;
+
+	std::vector<TWorkloadJob> Jobs = ParseSwfWorkload(Trace, 16, 10);
+
+	// Job 3 has no run time and job 4 does not fit, times start with the earliest job, job 5 requested no time
+	ASSERT_EQ(3, Jobs.size());
+
+	EXPECT_EQ(0, Jobs[0].SubmitTime);
+	EXPECT_EQ(2, Jobs[0].RequiredProcessors);
+	EXPECT_EQ(6, Jobs[0].ExecutionTime);
+	EXPECT_EQ(1, Jobs[0].ActualExecutionTime);
+
+	EXPECT_EQ(1, Jobs[1].SubmitTime);
+	EXPECT_EQ(4, Jobs[1].RequiredProcessors);
+	EXPECT_EQ(6, Jobs[1].ExecutionTime);
+	EXPECT_EQ(3, Jobs[1].ActualExecutionTime);
+
+	EXPECT_EQ(6, Jobs[2].SubmitTime);
+	EXPECT_EQ(1, Jobs[2].RequiredProcessors);
+	EXPECT_EQ(3, Jobs[2].ExecutionTime);
+	EXPECT_EQ(3, Jobs[2].ActualExecutionTime);
+}
+
+TEST(CWeightTuner, throws_on_short_swf_record)
+{
+	std::stringstream Trace("1 100 5 30");
+
+	ASSERT_ANY_THROW(ParseSwfWorkload(Trace, 16));
+}
+
+TEST(CWeightTuner, throws_when_job_does_not_fit)
+{
+	std::vector<std::vector<TWorkloadJob>> Workloads(1);
+	Workloads[0].push_back(MakeJob(0, 17, 5));
+
+	ASSERT_ANY_THROW(CWeightTuner(SmallTuningSettings(), Workloads));
+}
+
+TEST(CWeightTuner, workload_source_calls_jobs_at_their_submit_time)
+{
+	std::vector<TWorkloadJob> Jobs = { MakeJob(0, 1, 3), MakeJob(2, 2, 1), MakeJob(2, 1, 1) };
+
+	CCluster Cluster(10, 4, 5, 5);
+	CWorkloadSource Source(Jobs);
+	Cluster.AddSubmissionSource(&Source);
+
+	std::vector<std::pair<std::string, size_t>> Started;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall) { Started.push_back({ InCall.Name, InCluster->GetCurrentTime() }); });
+
+	Cluster.Start([](CCluster*) {});
+	Cluster.RemoveSubmissionSource(&Source);
+
+	ASSERT_EQ(3, Started.size());
+	EXPECT_EQ(std::make_pair(std::string("Job0"), size_t(0)), Started[0]);
+	EXPECT_EQ(2, Started[1].second);
+	EXPECT_EQ(2, Started[2].second);
+	EXPECT_EQ(3, Cluster.GetFinishedProgramCount());
+}
+
+TEST(CWeightTuner, measures_mean_wait)
+{
+	// The second job starts on the tick after the first one finishes (tick 4)
+	std::vector<std::vector<TWorkloadJob>> Workloads = { { MakeJob(0, 16, 4), MakeJob(0, 16, 2) } };
+
+	CWeightTuner Tuner(SmallTuningSettings(), Workloads);
+
+	EXPECT_DOUBLE_EQ(2.5, Tuner.Evaluate(TScoreWeights(), 0));
+}
+
+TEST(CWeightTuner, measures_p99_slowdown_and_utilization)
+{
+	// The second job waits 5 ticks and the last one finishes at tick 9
+	std::vector<std::vector<TWorkloadJob>> Workloads = { { MakeJob(0, 16, 4), MakeJob(0, 8, 4) } };
+
+	TTuningSettings Settings = SmallTuningSettings();
+
+	Settings.Metric = ETuningMetric::P99Slowdown;
+	EXPECT_DOUBLE_EQ(2.25, CWeightTuner(Settings, Workloads).Evaluate(TScoreWeights(), 0));
+
+	Settings.Metric = ETuningMetric::Utilization;
+	EXPECT_DOUBLE_EQ(-96.0 / (16 * 9), CWeightTuner(Settings, Workloads).Evaluate(TScoreWeights(), 0));
+}
+
+TEST(CWeightTuner, evaluation_is_deterministic)
+{
+	CWeightTuner Tuner(SmallTuningSettings(), TuningWorkloads(2, 16));
+
+	TScoreWeights Weights;
+	Weights.Waiting = 1;
+
+	EXPECT_EQ(Tuner.Evaluate(Weights, 1), Tuner.Evaluate(Weights, 1));
+}
+
+TEST(CWeightTuner, is_never_worse_than_default_weights)
+{
+	for (ETuningMetric Metric : { ETuningMetric::MeanWait, ETuningMetric::P99Slowdown, ETuningMetric::Utilization })
+	{
+		TTuningSettings Settings = SmallTuningSettings();
+		Settings.Metric = Metric;
+
+		CWeightTuner Tuner(Settings, TuningWorkloads(4, 16));
+		TTuningResult Result = Tuner.Tune();
+
+		EXPECT_LE(Result.BestScore, Result.DefaultScore);
+		EXPECT_EQ(4, Result.WorkloadCount);
+		EXPECT_FALSE(Result.Finalists.empty());
+
+		double Sum = 0;
+		for (size_t Workload = 0; Workload < 4; Workload++)
+			Sum += Tuner.Evaluate(Result.BestWeights, Workload);
+
+		EXPECT_DOUBLE_EQ(Result.BestScore, Sum / 4);
+	}
+}
+
+TEST(CWeightTuner, tuning_does_not_depend_on_thread_count)
+{
+	TTuningSettings Settings = SmallTuningSettings();
+	TTuningResult Parallel = CWeightTuner(Settings, TuningWorkloads(3, 16)).Tune();
+
+	Settings.ThreadCount = 1;
+	TTuningResult Serial = CWeightTuner(Settings, TuningWorkloads(3, 16)).Tune();
+
+	EXPECT_TRUE(Parallel.BestWeights == Serial.BestWeights);
+	EXPECT_EQ(Parallel.BestScore, Serial.BestScore);
+	EXPECT_EQ(Parallel.Evaluations, Serial.Evaluations);
+}
+
+TEST(CWeightTuner, halving_runs_fewer_simulations_than_full_search)
+{
+	TTuningSettings Settings = SmallTuningSettings();
+	Settings.CandidateCount = 27;
+
+	TTuningResult Result = CWeightTuner(Settings, TuningWorkloads(9, 16)).Tune();
+
+	EXPECT_LT(Result.Evaluations, 27 * 9);
+}
+
+TEST(CWeightTuner, DISABLED_benchmark_tuning)
+{
+	TTuningSettings Settings;
+	Settings.Metric = ETuningMetric::MeanWait;
+
+	TWorkloadParameters Parameters;
+	Parameters.Duration = 500;
+
+	std::vector<std::vector<TWorkloadJob>> Workloads;
+	for (uint32_t Seed = 1; Seed <= 27; Seed++)
+		Workloads.push_back(GenerateWorkload(Parameters, Settings.ProcessorCount, Seed));
+
+	auto Start = std::chrono::steady_clock::now();
+	TTuningResult Result = CWeightTuner(Settings, Workloads).Tune();
+	std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+
+	std::cout << Result << std::endl << "Tuning took " << Elapsed.count() << " s" << std::endl;
+}
@@ -0,0 +1,118 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "WorkStealingDeque.h"
+#include <gtest.h>
+#include <thread>
+#include <atomic>
+
+TEST(TWorkStealingDeque, can_create_deque)
+{
+	ASSERT_NO_THROW(TWorkStealingDeque<int> Deque);
+}
+
+TEST(TWorkStealingDeque, throws_when_capacity_is_not_power_of_two)
+{
+	ASSERT_ANY_THROW(TWorkStealingDeque<int> Deque(6));
+}
+
+TEST(TWorkStealingDeque, empty_by_default)
+{
+	TWorkStealingDeque<int> Deque;
+	int OutValue;
+
+	EXPECT_TRUE(Deque.empty());
+	EXPECT_FALSE(Deque.Pop(OutValue));
+	EXPECT_FALSE(Deque.Steal(OutValue));
+}
+
+TEST(TWorkStealingDeque, pop_is_last_in_first_out)
+{
+	TWorkStealingDeque<int> Deque;
+	int OutValue = 0;
+
+	Deque.Push(1);
+	Deque.Push(2);
+
+	ASSERT_TRUE(Deque.Pop(OutValue));
+	EXPECT_EQ(2, OutValue);
+	ASSERT_TRUE(Deque.Pop(OutValue));
+	EXPECT_EQ(1, OutValue);
+}
+
+TEST(TWorkStealingDeque, steal_is_first_in_first_out)
+{
+	TWorkStealingDeque<int> Deque;
+	int OutValue = 0;
+
+	Deque.Push(1);
+	Deque.Push(2);
+
+	ASSERT_TRUE(Deque.Steal(OutValue));
+	EXPECT_EQ(1, OutValue);
+	ASSERT_TRUE(Deque.Steal(OutValue));
+	EXPECT_EQ(2, OutValue);
+}
+
+TEST(TWorkStealingDeque, grows_past_initial_capacity)
+{
+	TWorkStealingDeque<int> Deque(2);
+
+	for (int i = 0; i < 100; i++)
+		Deque.Push(i);
+
+	EXPECT_EQ(100, Deque.size());
+
+	int OutValue = 0;
+	ASSERT_TRUE(Deque.Steal(OutValue));
+	EXPECT_EQ(0, OutValue);
+	ASSERT_TRUE(Deque.Pop(OutValue));
+	EXPECT_EQ(99, OutValue);
+}
+
+TEST(TWorkStealingDeque, every_item_is_taken_exactly_once_under_concurrent_stealing)
+{
+	const int ItemCount = 100000;
+
+	TWorkStealingDeque<int> Deque(16);
+	std::atomic<long long> Sum(0);
+	std::atomic<int> Taken(0);
+	std::atomic<bool> Done(false);
+
+	std::vector<std::thread> Thieves;
+	for (int i = 0; i < 3; i++)
+		Thieves.push_back(std::thread([&]()
+		{
+			int Item;
+			while (!Done || !Deque.empty())
+				if (Deque.Steal(Item))
+				{
+					Sum += Item;
+					Taken++;
+				}
+		}));
+
+	int Item;
+	for (int i = 1; i <= ItemCount; i++)
+	{
+		Deque.Push(i);
+
+		if (i % 3 == 0 && Deque.Pop(Item))
+		{
+			Sum += Item;
+			Taken++;
+		}
+	}
+
+	while (Deque.Pop(Item))
+	{
+		Sum += Item;
+		Taken++;
+	}
+
+	Done = true;
+	for (auto& Thief : Thieves)
+		Thief.join();
+
+	EXPECT_EQ(ItemCount, Taken);
+	EXPECT_EQ((long long)ItemCount * (ItemCount + 1) / 2, Sum);
+}
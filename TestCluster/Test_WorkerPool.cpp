@@ -0,0 +1,54 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "WorkerPool.h"
+#include <gtest.h>
+#include <atomic>
+
+TEST(CWorkerPool, can_create_pool)
+{
+	ASSERT_NO_THROW(CWorkerPool Pool(4));
+}
+
+TEST(CWorkerPool, has_one_slot_per_processor)
+{
+	CWorkerPool Pool(4);
+
+	EXPECT_EQ(4, Pool.GetSlotCount());
+}
+
+TEST(CWorkerPool, throws_when_submitting_to_invalid_slot)
+{
+	CWorkerPool Pool(4);
+
+	ASSERT_ANY_THROW(Pool.Submit(4, []() {}));
+}
+
+TEST(CWorkerPool, runs_all_submitted_tasks_before_destruction)
+{
+	std::atomic<int> Counter(0);
+
+	{
+		CWorkerPool Pool(4);
+
+		for (int i = 0; i < 100; i++)
+			Pool.Submit(i % 4, [&]() { Counter++; });
+	}
+
+	EXPECT_EQ(100, Counter);
+}
+
+TEST(CWorkerPool, runs_slot_tasks_on_the_same_thread)
+{
+	std::thread::id FirstID;
+	std::thread::id SecondID;
+
+	{
+		CWorkerPool Pool(2);
+
+		Pool.Submit(1, [&]() { FirstID = std::this_thread::get_id(); });
+		Pool.Submit(1, [&]() { SecondID = std::this_thread::get_id(); });
+	}
+
+	EXPECT_EQ(FirstID, SecondID);
+	EXPECT_NE(std::this_thread::get_id(), FirstID);
+}
@@ -0,0 +1,241 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+
+#include "Workflow.h"
+#include "Cluster.h"
+#include "WaitingCallFields.h"
+#include <gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <iostream>
+
+// A takes 2 ticks, then B (5 ticks) and C (1 tick), then D (3 ticks)
+CWorkflow DiamondWorkflow()
+{
+	CWorkflow Workflow("Diamond");
+	Workflow.AddJob(1, 2);
+	Workflow.AddJob(1, 5);
+	Workflow.AddJob(1, 1);
+	Workflow.AddJob(1, 3);
+
+	Workflow.AddDependency(1, 0);
+	Workflow.AddDependency(2, 0);
+	Workflow.AddDependency(3, 1);
+	Workflow.AddDependency(3, 2);
+
+	return Workflow;
+}
+
+// Every job after the first layer depends on InDependencies random jobs of the layer before it
+CWorkflow LayeredWorkflow(std::string InName, size_t InLayers, size_t InWidth, size_t InDependencies, size_t InMaxProcessors, uint32_t InSeed)
+{
+	std::mt19937 Random(InSeed);
+
+	CWorkflow Workflow(InName);
+	Workflow.Reserve(InLayers * InWidth, (InLayers - 1) * InWidth * InDependencies);
+
+	for (size_t Layer = 0; Layer < InLayers; Layer++)
+	{
+		for (size_t i = 0; i < InWidth; i++)
+		{
+			size_t Job = Workflow.AddJob(1 + Random() % InMaxProcessors, 1 + Random() % 20);
+
+			for (size_t Dependency = 0; Layer > 0 && Dependency < InDependencies; Dependency++)
+				Workflow.AddDependency(Job, (Layer - 1) * InWidth + Random() % InWidth);
+		}
+	}
+
+	return Workflow;
+}
+
+std::string WorkflowReportToString(CCluster& InCluster)
+{
+	std::stringstream Stream;
+	Stream << InCluster.GetReportData();
+	return Stream.str();
+}
+
+TEST(CWorkflow, prepares_successors_and_critical_paths)
+{
+	CWorkflow Workflow = DiamondWorkflow();
+	Workflow.Prepare();
+
+	EXPECT_EQ(4, Workflow.GetDependencyCount());
+	EXPECT_EQ(std::vector<uint32_t>({ 0, 1, 1, 2 }), Workflow.GetIndegrees());
+
+	ASSERT_EQ(2, Workflow.GetSuccessorCount(0));
+	EXPECT_EQ(1, Workflow.GetSuccessors(0)[0]);
+	EXPECT_EQ(2, Workflow.GetSuccessors(0)[1]);
+	EXPECT_EQ(0, Workflow.GetSuccessorCount(3));
+
+	EXPECT_EQ(10, Workflow.GetCriticalPath(0));
+	EXPECT_EQ(8, Workflow.GetCriticalPath(1));
+	EXPECT_EQ(4, Workflow.GetCriticalPath(2));
+	EXPECT_EQ(3, Workflow.GetCriticalPath(3));
+
+	EXPECT_EQ("Diamond.3", Workflow.GetJobName(3));
+}
+
+TEST(CWorkflow, throws_on_wrong_dependencies)
+{
+	CWorkflow Workflow("Cycle");
+	Workflow.AddJob(1, 1);
+	Workflow.AddJob(1, 1);
+	Workflow.AddJob(1, 1);
+
+	ASSERT_ANY_THROW(Workflow.AddDependency(1, 1));
+	ASSERT_ANY_THROW(Workflow.AddDependency(3, 0));
+	ASSERT_ANY_THROW(Workflow.AddJob(0, 1));
+
+	Workflow.AddDependency(1, 0);
+	Workflow.AddDependency(2, 1);
+	Workflow.AddDependency(0, 2);
+	ASSERT_ANY_THROW(Workflow.Prepare());
+
+	CWorkflow Prepared = DiamondWorkflow();
+	Prepared.Prepare();
+	ASSERT_ANY_THROW(Prepared.AddJob(1, 1));
+	ASSERT_ANY_THROW(Prepared.AddDependency(0, 3));
+}
+
+TEST(CWaitingCallFields, finds_longest_critical_path)
+{
+	const size_t ChunkSize = CWaitingCallFields::ChunkSize;
+	CWaitingCallFields Fields;
+
+	EXPECT_EQ(SIZE_MAX, Fields.FindLongestCriticalPath(5));
+
+	for (size_t i = 0; i < ChunkSize; i++)
+		Fields.Put(0, 1, 1);
+
+	Fields.Put(0, 1, 1, 0, 0, 0, 20);
+	Fields.Put(0, 1, 1, 0, 0, 0, 30);
+	Fields.Put(0, 1, 1, 0, 0, 0, 30);
+
+	EXPECT_EQ(SIZE_MAX, Fields.FindLongestCriticalPath(ChunkSize));
+	EXPECT_EQ(ChunkSize, Fields.FindLongestCriticalPath(ChunkSize + 1));
+	EXPECT_EQ(ChunkSize + 1, Fields.FindLongestCriticalPath(1000));
+
+	Fields.Pop(ChunkSize + 1);
+	Fields.Pop(0);
+	EXPECT_EQ(ChunkSize, Fields.FindLongestCriticalPath(1000));
+}
+
+TEST(TCluster, workflow_jobs_wait_for_their_predecessors)
+{
+	CCluster Cluster(30, 4);
+	EXPECT_EQ(0, Cluster.CallWorkflowExecution(DiamondWorkflow()));
+	EXPECT_EQ(1, Cluster.GetWaitingProgramCalls().size());
+
+	std::vector<std::pair<std::string, size_t>> Starts;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall) { Starts.push_back({ InCall.Name, InCluster->GetCurrentTime() }); });
+	Cluster.Start([](CCluster* InCluster) {});
+
+	// B and C are queued when A finishes at tick 2, D when B finishes at tick 8
+	std::vector<std::pair<std::string, size_t>> Expected = { { "Diamond.0", 0 }, { "Diamond.1", 3 }, { "Diamond.2", 4 }, { "Diamond.3", 9 } };
+	EXPECT_EQ(Expected, Starts);
+
+	EXPECT_EQ(4, Cluster.GetReportData().TotalProgramCalls);
+	EXPECT_EQ(4, Cluster.GetFinishedProgramCount());
+	EXPECT_EQ(0, Cluster.GetWorkflowCount());
+}
+
+TEST(TCluster, critical_path_job_starts_first)
+{
+	CCluster Cluster(30, 1);
+	Cluster.CallProgramExecution(TProgramCall("Solo", 1, 1));
+
+	CWorkflow Workflow("Flow");
+	Workflow.AddJob(1, 1);
+	Workflow.AddJob(1, 1);
+	Workflow.AddJob(1, 5);
+	Workflow.AddDependency(2, 1);
+	EXPECT_EQ(1, Cluster.CallWorkflowExecution(Workflow));
+
+	std::vector<std::string> Starts;
+	Cluster.SetProgramStartedCallback([&](CCluster* InCluster, const TProgramCall& InCall) { Starts.push_back(InCall.Name); });
+	Cluster.Start([](CCluster* InCluster) {});
+
+	std::vector<std::string> Expected = { "Flow.1", "Flow.2", "Flow.0", "Solo" };
+	EXPECT_EQ(Expected, Starts);
+}
+
+TEST(TCluster, throws_on_wrong_workflow)
+{
+	CCluster Cluster(0, 4);
+
+	CWorkflow Wide("Wide");
+	Wide.AddJob(5, 1);
+	ASSERT_ANY_THROW(Cluster.CallWorkflowExecution(Wide));
+	ASSERT_ANY_THROW(Cluster.CallWorkflowExecution(CWorkflow("Empty")));
+
+	CWorkflow Cycle("Cycle");
+	Cycle.AddJob(1, 1);
+	Cycle.AddJob(1, 1);
+	Cycle.AddDependency(0, 1);
+	Cycle.AddDependency(1, 0);
+	ASSERT_ANY_THROW(Cluster.CallWorkflowExecution(Cycle));
+	EXPECT_EQ(0, Cluster.GetReportData().TotalProgramCalls);
+
+	Cluster.CallWorkflowExecution(DiamondWorkflow());
+	ASSERT_ANY_THROW(Cluster.EnableJournal("cluster_test_workflow_journal.bin"));
+	ASSERT_ANY_THROW(Cluster.SaveSnapshot("cluster_test_workflow_snapshot.bin"));
+
+	std::remove("cluster_test_workflow_journal.bin");
+
+	{
+		CCluster Journaled(0, 4);
+		Journaled.EnableJournal("cluster_test_workflow_journal.bin");
+		ASSERT_ANY_THROW(Journaled.CallWorkflowExecution(DiamondWorkflow()));
+	}
+
+	std::remove("cluster_test_workflow_journal.bin");
+}
+
+TEST(TCluster, fork_keeps_workflows)
+{
+	CCluster Uninterrupted(1000, 16, 8, 4);
+	Uninterrupted.CallWorkflowExecution(LayeredWorkflow("Layers", 20, 10, 3, 8, 7));
+	Uninterrupted.Start([](CCluster* InCluster) {});
+
+	CCluster FirstHalf(60, 16, 8, 4);
+	FirstHalf.CallWorkflowExecution(LayeredWorkflow("Layers", 20, 10, 3, 8, 7));
+	FirstHalf.Start([](CCluster* InCluster) {});
+
+	std::unique_ptr<CCluster> Forked = FirstHalf.Fork(1000);
+	Forked->Start([](CCluster* InCluster) {});
+
+	EXPECT_EQ(200, Uninterrupted.GetFinishedProgramCount());
+	EXPECT_EQ(WorkflowReportToString(Uninterrupted), WorkflowReportToString(*Forked));
+
+	// The fork finished the workflow on its own copy of the counters
+	EXPECT_EQ(0, Forked->GetWorkflowCount());
+	EXPECT_EQ(1, FirstHalf.GetWorkflowCount());
+}
+
+TEST(TCluster, DISABLED_benchmark_workflow_of_million_jobs)
+{
+	const size_t ProcessorCount = 1024;
+
+	auto Begin = std::chrono::steady_clock::now();
+	CWorkflow Workflow = LayeredWorkflow("Million", 1000, 1000, 4, 16, 1);
+	Workflow.Prepare();
+	std::chrono::duration<double, std::milli> Built = std::chrono::steady_clock::now() - Begin;
+
+	std::cout << Workflow.GetJobCount() << " jobs, " << Workflow.GetDependencyCount() << " dependencies, critical path "
+		<< Workflow.GetCriticalPath(0) << " ticks, built in " << Built.count() << " ms" << std::endl;
+
+	CCluster Cluster(5000, ProcessorCount, 64, 64);
+
+	Begin = std::chrono::steady_clock::now();
+	Cluster.CallWorkflowExecution(std::move(Workflow));
+	std::chrono::duration<double, std::milli> Called = std::chrono::steady_clock::now() - Begin;
+
+	Begin = std::chrono::steady_clock::now();
+	Cluster.Start([](CCluster* InCluster) {});
+	std::chrono::duration<double, std::milli> Elapsed = std::chrono::steady_clock::now() - Begin;
+
+	std::cout << "Called in " << Called.count() << " ms, " << Cluster.GetFinishedProgramCount() << " finished in " << Cluster.GetCurrentTime()
+		<< " ticks, " << Elapsed.count() << " ms" << std::endl;
+}